@@ -0,0 +1,583 @@
+#include <QtTest>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QQmlComponent>
+#include <QQmlEngine>
+
+#include "MockTransport.hpp"
+#include "TestData.hpp"
+
+#include "BLECentral.hpp"
+#include "BLEDataCodec.hpp"
+#include "BLEDataService.hpp"
+#include "BLEDeltaCodec.hpp"
+#include "BLEExportStream.hpp"
+#include "BLELoopbackLink.hpp"
+#include "BLEPeripheral.hpp"
+#include "BLERateController.hpp"
+#include "BLESampleBus.hpp"
+#include "BLEScheduler.hpp"
+#include "BLESharedSampleReader.hpp"
+#include "BLESharedSamples.hpp"
+#include "BLEStreamLink.hpp"
+#include "BLEStreamTransport.hpp"
+#include "BluetoothController.hpp"
+#include "BluetoothDeviceInfo.hpp"
+#include "BluetoothDiscovery.hpp"
+
+namespace {
+
+//! \brief Number of frames decoded by one round of the stream decoding benchmark
+constexpr int StreamFrames = 1000;
+
+QVariant decodedValue(BLEDataService::DataType type)
+{
+    switch (type) {
+    case BLEDataService::Int:
+        return QVariant::fromValue<short>(1234);
+    case BLEDataService::Float:
+        return QVariant::fromValue<float>(36.6f);
+    case BLEDataService::String:
+        return QStringLiteral("Heart rate");
+    case BLEDataService::Standard:
+        return QVariantMap { { QStringLiteral("heartRate"), 72 } };
+    }
+    return QVariant();
+}
+
+} // namespace
+
+/*!
+ * \brief The QuickBluetoothBench class benchmarks the data path of QuickBluetooth against a mock
+ * transport and a loopback link, so the results don't depend on a radio and are reproducible.
+ * The behaviour of the same paths is checked by QuickBluetoothTests.
+ * Use the usual QtTest options for machine readable results, ie "-o result.xml,xml" or
+ * "-o result.csv,csv"
+ */
+class QuickBluetoothBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void encode_data();
+    void encode();
+
+    void decode_data();
+    void decode();
+
+    void decodeSample_data();
+    void decodeSample();
+
+    void deltaRoundTrip();
+
+    void dispatch_data();
+    void dispatch();
+
+    void qmlDelivery_data();
+    void qmlDelivery();
+
+    void discoveryAddDevice_data();
+    void discoveryAddDevice();
+
+    void loopbackRoundTrip_data();
+    void loopbackRoundTrip();
+
+    void streamRoundTrip();
+    void streamDecode();
+
+    void controllerInitialize();
+
+    void schedulerUrgentBehindBulk();
+
+    void rateController();
+
+    void sharedSamplesFanOut();
+
+    void exportStreamBatches();
+};
+
+void QuickBluetoothBench::initTestCase()
+{
+    //! Publishing is part of the data path, but the bus must not be read by anyone here
+    BLESampleBus::instance();
+}
+
+void QuickBluetoothBench::encode_data()
+{
+    addDataTypeRows();
+}
+
+void QuickBluetoothBench::encode()
+{
+    QFETCH(BLEDataService::DataType, type);
+    const QVariant value = decodedValue(type);
+
+    QByteArray bytes;
+    QBENCHMARK {
+        bytes = BLEDataCodec::encode(BLESample::Type(type), value, CharacterUuid);
+    }
+    QVERIFY(!bytes.isEmpty());
+}
+
+void QuickBluetoothBench::decode_data()
+{
+    addDataTypeRows();
+}
+
+void QuickBluetoothBench::decode()
+{
+    QFETCH(BLEDataService::DataType, type);
+    const QByteArray bytes = encodedValue(type, 1);
+
+    QVariant value;
+    QBENCHMARK {
+        value = BLEDataCodec::decode(BLESample::Type(type), bytes, CharacterUuid);
+    }
+    QVERIFY(value.isValid());
+}
+
+void QuickBluetoothBench::decodeSample_data()
+{
+    addDataTypeRows();
+}
+
+void QuickBluetoothBench::decodeSample()
+{
+    QFETCH(BLEDataService::DataType, type);
+    const QByteArray bytes = encodedValue(type, 1);
+
+    BLESample sample;
+    bool decoded = false;
+    QBENCHMARK {
+        decoded = BLEDataCodec::decode(BLESample::Type(type), bytes, sample, CharacterUuid);
+    }
+    QVERIFY(decoded);
+}
+
+void QuickBluetoothBench::deltaRoundTrip()
+{
+    BLEDeltaCodec::Encoder encoder;
+    BLEDeltaCodec::Decoder decoder;
+
+    //! A counter that grows by small steps, like steps or calories
+    qint16 counter = 1200;
+    int frames = 0;
+
+    QBENCHMARK {
+        counter += frames % 3;
+        const QByteArray frame = encoder.encode(counter);
+
+        BLEDeltaCodec::Values values;
+        decoder.decode(frame, values);
+
+        ++frames;
+    }
+}
+
+void QuickBluetoothBench::dispatch_data()
+{
+    addDataTypeRows();
+}
+
+void QuickBluetoothBench::dispatch()
+{
+    QFETCH(BLEDataService::DataType, type);
+
+    MockRole role;
+    BLEDataService* service = role.addService(ServiceUuid, CharacterUuid, type);
+    const QBluetoothUuid serviceUuid = service->serviceBluetoothUuid();
+    const QBluetoothUuid characterUuid = service->characterBluetoothUuid();
+    const QByteArray values[2] = { encodedValue(type, 0), encodedValue(type, 1) };
+
+    //! A slot connected to the value, like a handler in QML
+    connect(service, &BLEDataService::valueUpdated, this, []() {});
+
+    int index = 0;
+    QBENCHMARK {
+        role.mock()->inject(serviceUuid, characterUuid, values[++index & 1]);
+    }
+}
+
+void QuickBluetoothBench::qmlDelivery_data()
+{
+    addDataTypeRows();
+}
+
+void QuickBluetoothBench::qmlDelivery()
+{
+    QFETCH(BLEDataService::DataType, type);
+
+    MockRole role;
+    BLEDataService* service = role.addService(ServiceUuid, CharacterUuid, type);
+    const QBluetoothUuid serviceUuid = service->serviceBluetoothUuid();
+    const QBluetoothUuid characterUuid = service->characterBluetoothUuid();
+    const QByteArray values[2] = { encodedValue(type, 0), encodedValue(type, 1) };
+
+    //! A binding on the value, like a Text showing it
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData("import QtQml\n"
+                      "QtObject {\n"
+                      "    property QtObject source\n"
+                      "    property int updates: 0\n"
+                      "    property var current: source ? source.value : undefined\n"
+                      "    onCurrentChanged: ++updates\n"
+                      "}\n",
+                      QUrl());
+    QScopedPointer<QObject> binding(component.createWithInitialProperties(
+        { { QStringLiteral("source"), QVariant::fromValue<QObject*>(service) } }));
+    QVERIFY2(binding, qPrintable(component.errorString()));
+
+    int index = 0;
+    QBENCHMARK {
+        role.mock()->inject(serviceUuid, characterUuid, values[++index & 1]);
+    }
+}
+
+void QuickBluetoothBench::discoveryAddDevice_data()
+{
+    QTest::addColumn<int>("devices");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void QuickBluetoothBench::discoveryAddDevice()
+{
+    QFETCH(int, devices);
+
+    BluetoothDiscovery discovery;
+    discovery.setMethods(BluetoothDiscovery::LowEnergyMethod);
+
+    QList<QBluetoothDeviceInfo> infos;
+    infos.reserve(devices);
+    for (int i = 0; i < devices; ++i) {
+        QBluetoothDeviceInfo info(QBluetoothAddress(quint64(0x100000 + i)),
+                                  QStringLiteral("Device %1").arg(i), 0);
+        info.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+        info.setRssi(qint16(-40 - i % 50));
+        infos.append(info);
+    }
+
+    //! addDevice is a private slot, it is called like the discovery agent does
+    auto addDevice = [&discovery](const QBluetoothDeviceInfo& info) {
+        QMetaObject::invokeMethod(&discovery, "addDevice", Qt::DirectConnection,
+                                  Q_ARG(QBluetoothDeviceInfo, info));
+    };
+
+    for (const QBluetoothDeviceInfo& info : std::as_const(infos)) {
+        addDevice(info);
+    }
+
+    //! One scan round, every known device advertises again
+    QBENCHMARK {
+        for (const QBluetoothDeviceInfo& info : std::as_const(infos)) {
+            addDevice(info);
+        }
+    }
+}
+
+void QuickBluetoothBench::loopbackRoundTrip_data()
+{
+    QTest::addColumn<BLERole::ThreadingMode>("mode");
+
+    QTest::newRow("GuiThreadMode") << BLERole::GuiThreadMode;
+    QTest::newRow("IOThreadMode") << BLERole::IOThreadMode;
+}
+
+void QuickBluetoothBench::loopbackRoundTrip()
+{
+    QFETCH(BLERole::ThreadingMode, mode);
+
+    BLELoopbackLink link;
+    link.setSeed(1);
+
+    BLEPeripheral peripheral;
+    peripheral.setThreadingMode(mode);
+    peripheral.setLoopbackLink(&link);
+    peripheral.setLocalName(QStringLiteral("Bench"));
+    BLEDataService* source = addIntService(peripheral);
+
+    BLECentral central;
+    central.setThreadingMode(mode);
+    central.setLoopbackLink(&link);
+    BLEDataService* sink = addIntService(central);
+
+    int received = 0;
+    connect(sink, &BLEDataService::valueUpdated, this, [&received]() {
+        ++received;
+    });
+
+    peripheral.initialize();
+    peripheral.startAdvertising();
+    QTRY_COMPARE(peripheral.state(), BLERole::AdvertisingState);
+
+    central.setDevice(link.device());
+    QTRY_COMPARE(central.state(), BLERole::DiscoveredState);
+
+    //! Values are only notified once the central has subscribed, keep writing until one arrives
+    QTRY_VERIFY_WITH_TIMEOUT((source->writeValue(1), received > 0), 5000);
+
+    short value = 0;
+    QBENCHMARK {
+        const int expected = received + 1;
+        source->writeValue(++value % 1000);
+
+        QDeadlineTimer deadline(5000);
+        while (received < expected && !deadline.hasExpired()) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents);
+        }
+        QVERIFY(received >= expected);
+    }
+}
+
+void QuickBluetoothBench::streamRoundTrip()
+{
+    //! A local socket stands in for RFCOMM, the name is unique so runs don't meet
+    BLEStreamLink link;
+    link.setBackend(BLEStreamLink::LocalSocketBackend);
+    link.setServerName(
+        QStringLiteral("QuickBluetoothBench-%1").arg(QCoreApplication::applicationPid()));
+
+    BLEPeripheral peripheral;
+    peripheral.setStreamLink(&link);
+    peripheral.setLocalName(QStringLiteral("Bench"));
+    BLEDataService* source = addIntService(peripheral);
+
+    BLECentral central;
+    central.setStreamLink(&link);
+    BLEDataService* sink = addIntService(central);
+
+    int received = 0;
+    connect(sink, &BLEDataService::valueUpdated, this, [&received]() {
+        ++received;
+    });
+
+    peripheral.initialize();
+    peripheral.startAdvertising();
+    QTRY_COMPARE(peripheral.state(), BLERole::AdvertisingState);
+
+    central.setDevice(link.device());
+    QTRY_COMPARE(central.state(), BLERole::DiscoveredState);
+
+    QTRY_VERIFY_WITH_TIMEOUT((source->writeValue(1), received > 0), 5000);
+
+    short value = 0;
+    QBENCHMARK {
+        const int expected = received + 1;
+        source->writeValue(++value % 1000);
+
+        QDeadlineTimer deadline(5000);
+        while (received < expected && !deadline.hasExpired()) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents);
+        }
+        QVERIFY(received >= expected);
+    }
+}
+
+void QuickBluetoothBench::streamDecode()
+{
+    //! A read of the stream holding many notifications, each decoded into the same packet
+    BLELoopbackPacket packet;
+    packet.kind = BLELoopbackPacket::Notification;
+    packet.service = QBluetoothUuid(ServiceUuid);
+    packet.characteristic = QBluetoothUuid(CharacterUuid);
+    packet.value = QByteArray(244, 'x');
+
+    QByteArray stream;
+    for (int i = 0; i < StreamFrames; ++i) {
+        BLEStreamTransport::encode(packet, stream);
+    }
+
+    BLELoopbackPacket decoded;
+    QBENCHMARK {
+        qsizetype offset = 0;
+        qsizetype used = 0;
+        while ((used = BLEStreamTransport::decode(QByteArrayView(stream).sliced(offset), decoded))
+               > 0) {
+            offset += used;
+        }
+    }
+}
+
+void QuickBluetoothBench::controllerInitialize()
+{
+    BluetoothController& controller = BluetoothController::instance();
+
+    int started = 0;
+    int finished = 0;
+    //! Called whether an adapter is found or not
+    const QVariant callback = QVariant::fromValue(std::function<void (bool)>([&finished](bool) {
+        ++finished;
+    }));
+
+    //! The time the calling thread, ie the GUI thread at startup, is blocked by initialize. The
+    //! adapters are enumerated on the I/O thread meanwhile
+    QBENCHMARK {
+        controller.initialize(callback);
+        ++started;
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished, started, 30000);
+}
+
+void QuickBluetoothBench::schedulerUrgentBehindBulk()
+{
+    const QBluetoothUuid service(ServiceUuid);
+    const QBluetoothUuid bulk(CharacterUuid);
+    const QBluetoothUuid alarm(quint32(CharacterUuid + 1));
+    const QByteArray value = encodedValue(BLEDataService::Int, 1);
+
+    BLEScheduler scheduler;
+    scheduler.setPriority(bulk, BLEScheduler::BulkPriority);
+    scheduler.setPriority(alarm, BLEScheduler::UrgentPriority);
+
+    BLEScheduler::Entry entry;
+    BLEScheduler::Priority priority;
+
+    //! An alarm raised during a burst of telemetry, taken out ahead of it
+    QBENCHMARK {
+        const qint64 now = BLEMetrics::now();
+        for (int i = 0; i < BLEScheduler::QueueSize; ++i) {
+            scheduler.push(service, bulk, value, now);
+        }
+        scheduler.push(service, alarm, value, now);
+
+        scheduler.pop(now, entry, priority);
+        scheduler.clear();
+    }
+}
+
+void QuickBluetoothBench::rateController()
+{
+    //! 20 s of a link that drains one value every 10 ms, simulated on a virtual clock
+    constexpr qint64 Millisecond = 1000000;
+    constexpr qint64 Drain = 10 * Millisecond;
+
+    BLERateController controller;
+    QBENCHMARK {
+        controller.reset();
+
+        int inFlight = 0;
+        qint64 drained = 0;
+        for (qint64 now = Millisecond; now <= 20000 * Millisecond; now += Millisecond) {
+            if (inFlight > 0 && now >= drained + Drain) {
+                --inFlight;
+                drained = now;
+                controller.onWritten(now);
+            }
+
+            if (controller.admit(now)) {
+                if (inFlight++ == 0) {
+                    drained = now;
+                }
+            }
+        }
+    }
+}
+
+void QuickBluetoothBench::sharedSamplesFanOut()
+{
+    constexpr int Count = 256;
+
+    BLESharedSamples samples;
+    samples.setKey(
+        QStringLiteral("QuickBluetoothBench-%1").arg(QCoreApplication::applicationPid()));
+    samples.setCapacity(Count);
+    QVERIFY(samples.start());
+
+    //! Two readers, as two processes would, each with its own cursor
+    BLESharedSampleReader first(samples.key());
+    BLESharedSampleReader second(samples.key());
+    QVERIFY(first.attach());
+    QVERIFY(second.attach());
+
+    BLESample sample;
+    sample.serviceUuid = ServiceUuid;
+    sample.characterUuid = CharacterUuid;
+    sample.type = BLESample::Int;
+
+    QBENCHMARK {
+        for (int i = 0; i < Count; ++i) {
+            sample.timestamp = BLESample::now();
+            sample.intValue = qint16(i);
+            samples.publish(sample);
+        }
+
+        //! Read in place, the samples aren't copied out of the shared memory
+        first.readAll([](const BLESample&) {});
+
+        //! Copied out one by one
+        BLESample copy;
+        while (second.read(copy)) {
+        }
+    }
+
+    samples.stop();
+}
+
+void QuickBluetoothBench::exportStreamBatches()
+{
+    constexpr int Count = 1024;
+
+    //! A local socket consumer, the name is unique so runs don't meet
+    QLocalServer consumer;
+    QVERIFY(consumer.listen(
+        QStringLiteral("QuickBluetoothBenchExport-%1").arg(QCoreApplication::applicationPid())));
+
+    BLEExportStream stream;
+    stream.setBackend(BLEExportStream::LocalSocketBackend);
+    stream.setServerName(consumer.serverName());
+    stream.setBatchSize(64);
+    stream.setBatchDelay(1);
+    stream.setQueueSize(Count);
+    stream.start();
+
+    QTRY_VERIFY(consumer.hasPendingConnections());
+    QLocalSocket* socket = consumer.nextPendingConnection();
+    QTRY_VERIFY(stream.isConnected());
+
+    QByteArray buffer;
+    BLEExportStream::Frame frame;
+    int received = 0;
+    connect(socket, &QLocalSocket::readyRead, this, [&]() {
+        buffer.append(socket->readAll());
+
+        qsizetype offset = 0;
+        qsizetype used = 0;
+        while ((used = BLEExportStream::decode(QByteArrayView(buffer).sliced(offset), frame)) > 0) {
+            offset += used;
+            received += int(frame.samples.size());
+        }
+        buffer.remove(0, offset);
+    });
+
+    BLESample sample;
+    sample.serviceUuid = ServiceUuid;
+    sample.characterUuid = CharacterUuid;
+    sample.type = BLESample::Int;
+
+    QBENCHMARK {
+        received = 0;
+        for (int i = 0; i < Count; ++i) {
+            sample.timestamp = BLESample::now();
+            sample.intValue = qint16(i % 1000);
+            stream.publish(sample);
+        }
+
+        QDeadlineTimer deadline(5000);
+        while (received < Count && !deadline.hasExpired()) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents);
+        }
+        QVERIFY(received >= Count);
+    }
+
+    stream.stop();
+}
+
+QTEST_GUILESS_MAIN(QuickBluetoothBench)
+
+#include "QuickBluetoothBench.moc"
@@ -208,9 +208,16 @@ Page {
             text: "Start Advertising"
 
             onClicked: {
-                BluetoothController.initialize();
-                peripheral.initialize();
-                peripheral.startAdvertising();
+                //! The peripheral needs the local adapter, which is brought up asynchronously
+                BluetoothController.initialize(function(ready) {
+                    if (!ready) {
+                        console.warn("Bluetooth is not available, can't start advertising");
+                        return;
+                    }
+
+                    peripheral.initialize();
+                    peripheral.startAdvertising();
+                });
             }
         }
     }
@@ -78,8 +78,13 @@ Popup {
 
                 onClicked: startScan()
 
-                function startScan()
+                function startScan(ready)
                 {
+                    //! Called back with false when bluetooth can't be brought up
+                    if (ready === false) {
+                        return;
+                    }
+
                     if (!BluetoothController.isReady) {
                         BluetoothController.initialize(startScan);
                         return;
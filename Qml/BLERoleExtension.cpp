@@ -0,0 +1,38 @@
+#include "BLERoleExtension.hpp"
+#include "BLERole.hpp"
+
+BLERoleExtension::BLERoleExtension(QObject* parent)
+    : QObject{ parent }
+    , mRole { qobject_cast<BLERole*>(parent) }
+{
+    connect(mRole, &BLERole::servicesChanged, this, &BLERoleExtension::servicesChanged);
+}
+
+ServicesListProperty BLERoleExtension::services()
+{
+    return QQmlListProperty<BLEDataService>(this, mRole,
+                                            &BLERoleExtension::servicesListAppend,
+                                            &BLERoleExtension::servicesListCount,
+                                            &BLERoleExtension::servicesListAt,
+                                            &BLERoleExtension::servicesListClear);
+}
+
+void BLERoleExtension::servicesListAppend(ServicesListProperty* services, BLEDataService* service)
+{
+    reinterpret_cast<BLERole*>(services->data)->serviceAdd(service);
+}
+
+BLEDataService* BLERoleExtension::servicesListAt(ServicesListProperty* services, qsizetype index)
+{
+    return reinterpret_cast<BLERole*>(services->data)->serviceAt(index);
+}
+
+qsizetype BLERoleExtension::servicesListCount(ServicesListProperty* services)
+{
+    return reinterpret_cast<BLERole*>(services->data)->serviceCount();
+}
+
+void BLERoleExtension::servicesListClear(ServicesListProperty* services)
+{
+    reinterpret_cast<BLERole*>(services->data)->serviceClear();
+}
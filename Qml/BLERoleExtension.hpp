@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QObject>
+#include <QQmlListProperty>
+
+#include "BLEDataService.hpp"
+
+class BLERole;
+
+using ServicesListProperty = QQmlListProperty<BLEDataService>;
+
+/*!
+ * \brief The BLERoleExtension class adds the QML only parts of \ref BLERole, ie the list of
+ * services declared as its children
+ */
+class BLERoleExtension : public QObject
+{
+    Q_OBJECT
+
+    Q_CLASSINFO("DefaultProperty", "services")
+    Q_PROPERTY(ServicesListProperty services READ services NOTIFY servicesChanged FINAL)
+
+public:
+    explicit BLERoleExtension(QObject* parent);
+
+    /*!
+     * \brief services Returns a \a QQmlListProperty instance for services property
+     * \return
+     */
+    ServicesListProperty services();
+
+private:
+    //! ServicesListProperty methods
+    static void servicesListAppend(ServicesListProperty* services, BLEDataService* service);
+    static BLEDataService* servicesListAt(ServicesListProperty* services, qsizetype index);
+    static qsizetype servicesListCount(ServicesListProperty* services);
+    static void servicesListClear(ServicesListProperty* services);
+
+signals:
+    void servicesChanged();
+
+private:
+    //! \brief mRole The extended role
+    BLERole* mRole;
+};
@@ -0,0 +1,44 @@
+#include "QuickBluetoothQml.hpp"
+
+#include <QJSValue>
+
+#include <functional>
+
+namespace {
+
+/*!
+ * \brief registerJsCallbacks Lets \ref BluetoothController call JS functions passed as callbacks,
+ * it only knows about \a std::function. It's registered when the module is loaded, so a JS function
+ * can be passed before the singleton is created by QML
+ */
+void registerJsCallbacks()
+{
+    QMetaType::registerConverter<QJSValue, std::function<void (bool)>>([](const QJSValue& cb) {
+        return std::function<void (bool)>([cb](bool success) {
+            if (!cb.isCallable()) {
+                return;
+            }
+
+            QJSValue result = cb.call({ QJSValue(success) });
+
+            if (result.isError()) {
+                qDebug("%s:%s: %s",
+                       qPrintable(result.property("fileName").toString()),
+                       qPrintable(result.property("lineNumber").toString()),
+                       qPrintable(result.toString()));
+            }
+        });
+    });
+}
+
+} // namespace
+
+Q_CONSTRUCTOR_FUNCTION(registerJsCallbacks)
+
+BluetoothController* BluetoothControllerForeign::create(QQmlEngine* qmlEngine, QJSEngine* jsEngine)
+{
+    Q_UNUSED(qmlEngine)
+    Q_UNUSED(jsEngine)
+
+    return &BluetoothController::instance();
+}
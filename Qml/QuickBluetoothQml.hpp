@@ -0,0 +1,156 @@
+#pragma once
+
+#include <QObject>
+#include <QQmlEngine>
+
+#include "BLEAdvertiser.hpp"
+#include "BLEBroadcastValue.hpp"
+#include "BLECentral.hpp"
+#include "BLEDataService.hpp"
+#include "BLEExportStream.hpp"
+#include "BLELoopbackLink.hpp"
+#include "BLEMetrics.hpp"
+#include "BLEPeripheral.hpp"
+#include "BLERole.hpp"
+#include "BLERoleExtension.hpp"
+#include "BLESessionRecorder.hpp"
+#include "BLESessionReplayer.hpp"
+#include "BLESharedSamples.hpp"
+#include "BLEStreamLink.hpp"
+#include "BluetoothController.hpp"
+#include "BluetoothDeviceInfo.hpp"
+#include "BluetoothDiscovery.hpp"
+
+/*!
+ * The QML types of the QuickBluetooth module. The classes themselves live in the core library
+ * which only depends on QtCore and QtBluetooth, they are registered here as foreign types
+ */
+
+struct BluetoothControllerForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BluetoothController)
+    QML_NAMED_ELEMENT(BluetoothController)
+    QML_SINGLETON
+
+public:
+    /*!
+     * \brief create Custom factory method for QML to make sure both QML and C++ accesses the same
+     * instance
+     * \param qmlEngine
+     * \param jsEngine
+     * \return
+     */
+    static BluetoothController* create(QQmlEngine* qmlEngine, QJSEngine* jsEngine);
+};
+
+struct BluetoothDeviceInfoForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BluetoothDeviceInfo)
+    QML_NAMED_ELEMENT(BluetoothDeviceInfo)
+    QML_UNCREATABLE("BluetoothDeviceInfo can only be created from C++")
+};
+
+struct BluetoothDiscoveryForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BluetoothDiscovery)
+    QML_NAMED_ELEMENT(BluetoothDiscovery)
+};
+
+struct BLEDataServiceForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLEDataService)
+    QML_NAMED_ELEMENT(BLEDataService)
+};
+
+struct BLERoleForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLERole)
+    QML_NAMED_ELEMENT(BLERole)
+    QML_UNCREATABLE("BLERole is an interface")
+    QML_EXTENDED(BLERoleExtension)
+};
+
+struct BLECentralForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLECentral)
+    QML_NAMED_ELEMENT(BLECentral)
+};
+
+struct BLEPeripheralForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLEPeripheral)
+    QML_NAMED_ELEMENT(BLEPeripheral)
+};
+
+struct BLEAdvertiserForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLEAdvertiser)
+    QML_NAMED_ELEMENT(BLEAdvertiser)
+    QML_UNCREATABLE("BLEAdvertiser is provided by BLEPeripheral")
+};
+
+struct BLEBroadcastValueForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLEBroadcastValue)
+    QML_NAMED_ELEMENT(BLEBroadcastValue)
+    QML_UNCREATABLE("BLEBroadcastValue is provided by BluetoothDiscovery")
+};
+
+struct BLELoopbackLinkForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLELoopbackLink)
+    QML_NAMED_ELEMENT(BLELoopbackLink)
+};
+
+struct BLEStreamLinkForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLEStreamLink)
+    QML_NAMED_ELEMENT(BLEStreamLink)
+};
+
+struct BLEMetricsForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLEMetrics)
+    QML_NAMED_ELEMENT(BLEMetrics)
+    QML_UNCREATABLE("BLEMetrics is provided by BLERole and BluetoothDiscovery")
+};
+
+struct BLESessionRecorderForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLESessionRecorder)
+    QML_NAMED_ELEMENT(BLESessionRecorder)
+};
+
+struct BLESessionReplayerForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLESessionReplayer)
+    QML_NAMED_ELEMENT(BLESessionReplayer)
+};
+
+struct BLESharedSamplesForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLESharedSamples)
+    QML_NAMED_ELEMENT(BLESharedSamples)
+};
+
+struct BLEExportStreamForeign
+{
+    Q_GADGET
+    QML_FOREIGN(BLEExportStream)
+    QML_NAMED_ELEMENT(BLEExportStream)
+};
@@ -0,0 +1,536 @@
+#include "BLEAdvertiser.hpp"
+
+#include <QBluetoothAddress>
+#include <QLowEnergyController>
+#include <QtEndian>
+
+#include <algorithm>
+
+namespace {
+
+//! \brief Types of the advertising data structures, from the Bluetooth assigned numbers
+enum AdType : quint8 {
+    Flags = 0x01,
+    IncompleteServices16 = 0x02,
+    CompleteServices16 = 0x03,
+    IncompleteServices32 = 0x04,
+    CompleteServices32 = 0x05,
+    IncompleteServices128 = 0x06,
+    CompleteServices128 = 0x07,
+    ShortenedLocalName = 0x08,
+    CompleteLocalName = 0x09,
+    TxPowerLevel = 0x0A,
+    ServiceData16 = 0x16,
+    ServiceData32 = 0x20,
+    ServiceData128 = 0x21,
+    ManufacturerData = 0xFF,
+};
+
+//! \brief LE General Discoverable and BR/EDR not supported
+constexpr quint8 GeneralDiscoverableFlags = 0x06;
+
+//! \brief Size of the length and type of a data structure
+constexpr int HeaderSize = 2;
+
+//! \brief Appends \a uuid in its shortest form, little endian like every field of the payload
+void appendUuid(QByteArray& out, const QBluetoothUuid& uuid)
+{
+    bool ok = false;
+    switch (uuid.minimumSize()) {
+    case 2: {
+        const quint16 value = qToLittleEndian(uuid.toUInt16(&ok));
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        break;
+    }
+    case 4: {
+        const quint32 value = qToLittleEndian(uuid.toUInt32(&ok));
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        break;
+    }
+    default: {
+        const quint128 value = uuid.toUInt128();
+        for (int i = 15; i >= 0; --i) {
+            out.append(char(value.data[i]));
+        }
+        break;
+    }
+    }
+}
+
+/*!
+ * \brief The Payload class is one payload being packed
+ */
+class Payload
+{
+public:
+    int space() const
+    {
+        return BLEAdvertiser::MaxPayload - mRaw.size();
+    }
+
+    bool fits(qsizetype body) const
+    {
+        return HeaderSize + body <= space();
+    }
+
+    void append(quint8 type, const QByteArray& body)
+    {
+        mRaw.append(char(body.size() + 1));
+        mRaw.append(char(type));
+        mRaw.append(body);
+    }
+
+    void addFlags()
+    {
+        append(Flags, QByteArray(1, char(GeneralDiscoverableFlags)));
+        mDiscoverable = true;
+    }
+
+    void addServices(const QList<QBluetoothUuid>& services, quint8 type, bool complete)
+    {
+        QByteArray body;
+        for (const QBluetoothUuid& uuid : services) {
+            appendUuid(body, uuid);
+        }
+        append(type, body);
+
+        mServices.append(services);
+        mStructured = mStructured && complete;
+    }
+
+    void addName(const QString& name, const QByteArray& utf8, bool complete)
+    {
+        append(complete ? CompleteLocalName : ShortenedLocalName, utf8);
+        mData.setLocalName(name);
+        mStructured = mStructured && complete;
+    }
+
+    void addPowerLevel(int powerLevel)
+    {
+        append(TxPowerLevel, QByteArray(1, char(qint8(powerLevel))));
+        mData.setIncludePowerLevel(true);
+    }
+
+    void addData(const BLEAdvertiser::DataField& field)
+    {
+        QByteArray body;
+        quint8 type = ManufacturerData;
+
+        if (field.manufacturer) {
+            const quint16 companyId = qToLittleEndian(field.companyId);
+            body.append(reinterpret_cast<const char*>(&companyId), sizeof(companyId));
+
+            //! Qt represents a single manufacturer data entry
+            mStructured = mStructured && !mHasManufacturer;
+            mHasManufacturer = true;
+            mData.setManufacturerData(field.companyId, field.data);
+        } else {
+            appendUuid(body, field.service);
+            const int size = field.service.minimumSize();
+            type = size == 2 ? ServiceData16 : size == 4 ? ServiceData32 : ServiceData128;
+
+            //! Service data can only be set as raw data
+            mStructured = false;
+        }
+
+        body.append(field.data);
+        append(type, body);
+    }
+
+    int size() const
+    {
+        return int(mRaw.size());
+    }
+
+    QLowEnergyAdvertisingData finish()
+    {
+        if (!mStructured) {
+            QLowEnergyAdvertisingData data;
+            data.setDiscoverability(QLowEnergyAdvertisingData::DiscoverabilityNone);
+            data.setRawData(mRaw);
+            return data;
+        }
+
+        mData.setDiscoverability(mDiscoverable ? QLowEnergyAdvertisingData::DiscoverabilityGeneral
+                                               : QLowEnergyAdvertisingData::DiscoverabilityNone);
+        mData.setServices(mServices);
+        return mData;
+    }
+
+private:
+    QByteArray mRaw;
+    QLowEnergyAdvertisingData mData;
+    QList<QBluetoothUuid> mServices;
+    bool mStructured = true;
+    bool mDiscoverable = false;
+    bool mHasManufacturer = false;
+};
+
+//! \brief Body size of a data field
+qsizetype bodySize(const BLEAdvertiser::DataField& field)
+{
+    return (field.manufacturer ? 2 : field.service.minimumSize()) + field.data.size();
+}
+
+} // namespace
+
+BLEAdvertiser::BLEAdvertiser(QObject* parent)
+    : QObject{ parent }
+    , mConnectable { true }
+    , mIntervalMin { QLowEnergyAdvertisingParameters().minimumInterval() }
+    , mIntervalMax { QLowEnergyAdvertisingParameters().maximumInterval() }
+    , mFilterPolicy { IgnoreWhiteList }
+    , mPowerLevel { 0 }
+    , mRotation { 0 }
+    , mUpdateTimer { new QTimer(this) }
+    , mRotationTimer { new QTimer(this) }
+{
+    mUpdateTimer->setSingleShot(true);
+    connect(mUpdateTimer, &QTimer::timeout, this, &BLEAdvertiser::changed);
+    connect(mRotationTimer, &QTimer::timeout, this, &BLEAdvertiser::rotate);
+}
+
+void BLEAdvertiser::setConnectable(bool connectable)
+{
+    if (mConnectable == connectable) {
+        return;
+    }
+
+    mConnectable = connectable;
+    emit connectableChanged();
+    emit changed();
+}
+
+void BLEAdvertiser::setIntervalMin(int interval)
+{
+    interval = std::clamp(interval, 20, 10240);
+    if (mIntervalMin == interval) {
+        return;
+    }
+
+    mIntervalMin = interval;
+    if (mIntervalMax < mIntervalMin) {
+        mIntervalMax = mIntervalMin;
+        emit intervalMaxChanged();
+    }
+    emit intervalMinChanged();
+    emit changed();
+}
+
+void BLEAdvertiser::setIntervalMax(int interval)
+{
+    interval = std::clamp(interval, 20, 10240);
+    if (mIntervalMax == interval) {
+        return;
+    }
+
+    mIntervalMax = interval;
+    if (mIntervalMin > mIntervalMax) {
+        mIntervalMin = mIntervalMax;
+        emit intervalMinChanged();
+    }
+    emit intervalMaxChanged();
+    emit changed();
+}
+
+void BLEAdvertiser::setFilterPolicy(FilterPolicy policy)
+{
+    if (mFilterPolicy == policy) {
+        return;
+    }
+
+    mFilterPolicy = policy;
+    emit filterPolicyChanged();
+    emit changed();
+}
+
+void BLEAdvertiser::setWhiteList(const QStringList& whiteList)
+{
+    if (mWhiteList == whiteList) {
+        return;
+    }
+
+    mWhiteList = whiteList;
+    emit whiteListChanged();
+    emit changed();
+}
+
+void BLEAdvertiser::setPowerLevel(int powerLevel)
+{
+    powerLevel = std::clamp(powerLevel, NoPowerLevel, 127);
+    if (mPowerLevel == powerLevel) {
+        return;
+    }
+
+    mPowerLevel = powerLevel;
+    emit powerLevelChanged();
+    emit changed();
+}
+
+int BLEAdvertiser::rotationInterval() const
+{
+    return mRotationTimer->interval();
+}
+
+void BLEAdvertiser::setRotationInterval(int interval)
+{
+    if (mRotationTimer->interval() == interval || interval < 0) {
+        return;
+    }
+
+    mRotationTimer->setInterval(interval);
+    updateRotation();
+    emit rotationIntervalChanged();
+}
+
+void BLEAdvertiser::setManufacturerData(int companyId, const QByteArray& data)
+{
+    if (companyId < 0 || companyId > 0xFFFF) {
+        qWarning() << "BLEAdvertiser: Invalid company id" << companyId;
+        return;
+    }
+
+    auto it = std::find_if(mData.begin(), mData.end(), [companyId](const DataField& field) {
+        return field.manufacturer && field.companyId == companyId;
+    });
+    if (it == mData.end()) {
+        mData.append(DataField { true, quint16(companyId), QBluetoothUuid(), data });
+        updateRotation();
+    } else if (it->data == data) {
+        return;
+    } else {
+        it->data = data;
+    }
+
+    scheduleUpdate();
+}
+
+void BLEAdvertiser::removeManufacturerData(int companyId)
+{
+    const qsizetype removed = mData.removeIf([companyId](const DataField& field) {
+        return field.manufacturer && field.companyId == companyId;
+    });
+    if (removed > 0) {
+        updateRotation();
+        scheduleUpdate();
+    }
+}
+
+void BLEAdvertiser::setServiceData(quint32 serviceUuid, const QByteArray& data)
+{
+    const QBluetoothUuid uuid(serviceUuid);
+    auto it = std::find_if(mData.begin(), mData.end(), [&uuid](const DataField& field) {
+        return !field.manufacturer && field.service == uuid;
+    });
+    if (it == mData.end()) {
+        mData.append(DataField { false, 0, uuid, data });
+        updateRotation();
+    } else if (it->data == data) {
+        return;
+    } else {
+        it->data = data;
+    }
+
+    scheduleUpdate();
+}
+
+void BLEAdvertiser::removeServiceData(quint32 serviceUuid)
+{
+    const QBluetoothUuid uuid(serviceUuid);
+    const qsizetype removed = mData.removeIf([&uuid](const DataField& field) {
+        return !field.manufacturer && field.service == uuid;
+    });
+    if (removed > 0) {
+        updateRotation();
+        scheduleUpdate();
+    }
+}
+
+void BLEAdvertiser::clearData()
+{
+    if (mData.isEmpty()) {
+        return;
+    }
+
+    mData.clear();
+    updateRotation();
+    scheduleUpdate();
+}
+
+QLowEnergyAdvertisingParameters BLEAdvertiser::parameters() const
+{
+    QLowEnergyAdvertisingParameters parameters;
+    parameters.setMode(mConnectable ? QLowEnergyAdvertisingParameters::AdvInd
+                                    : QLowEnergyAdvertisingParameters::AdvScanInd);
+    parameters.setInterval(quint16(mIntervalMin), quint16(mIntervalMax));
+
+    QList<QLowEnergyAdvertisingParameters::AddressInfo> whiteList;
+    for (const QString& address : mWhiteList) {
+        const QBluetoothAddress bluetoothAddress(address);
+        if (!bluetoothAddress.isNull()) {
+            whiteList.append(QLowEnergyAdvertisingParameters::AddressInfo(
+                bluetoothAddress, QLowEnergyController::PublicAddress));
+        }
+    }
+    parameters.setWhiteList(whiteList,
+                            QLowEnergyAdvertisingParameters::FilterPolicy(mFilterPolicy));
+
+    return parameters;
+}
+
+BLEAdvertiser::Content BLEAdvertiser::content(const QString& localName) const
+{
+    Content content;
+    content.localName = localName;
+    content.powerLevel = mPowerLevel;
+    content.data = mData;
+    content.rotation = mRotation;
+    return content;
+}
+
+BLEAdvertiser::Payloads BLEAdvertiser::pack(const Content& content)
+{
+    //! The order only matters when something is dropped, keeping it otherwise lets a rotation
+    //! leave the payloads unchanged
+    Payloads payloads = packFrom(content, 0);
+    if (payloads.dropped > 0 && content.rotation > 0) {
+        payloads = packFrom(content, content.rotation);
+    }
+    return payloads;
+}
+
+BLEAdvertiser::Payloads BLEAdvertiser::packFrom(const Content& content, int rotation)
+{
+    Payload advertising;
+    Payload scanResponse;
+    int dropped = 0;
+
+    advertising.addFlags();
+
+    //! Service uuids by size, what doesn't fit in the advertising payload goes to the scan response
+    //! and the lists are then marked incomplete
+    for (int size : { 2, 4, 16 }) {
+        QList<QBluetoothUuid> services;
+        for (const QBluetoothUuid& uuid : content.services) {
+            if (uuid.minimumSize() == size) {
+                services.append(uuid);
+            }
+        }
+        if (services.isEmpty()) {
+            continue;
+        }
+
+        const quint8 complete = size == 2 ? CompleteServices16
+                              : size == 4 ? CompleteServices32 : CompleteServices128;
+        const quint8 incomplete = complete - 1;
+
+        const qsizetype inAdvertising = std::min<qsizetype>(
+            services.size(), std::max(0, advertising.space() - HeaderSize) / size);
+        if (inAdvertising == services.size()) {
+            advertising.addServices(services, complete, true);
+            continue;
+        }
+
+        if (inAdvertising > 0) {
+            advertising.addServices(services.first(inAdvertising), incomplete, false);
+        }
+
+        const QList<QBluetoothUuid> rest = services.sliced(inAdvertising);
+        const qsizetype inScanResponse = std::min<qsizetype>(
+            rest.size(), std::max(0, scanResponse.space() - HeaderSize) / size);
+        if (inScanResponse > 0) {
+            scanResponse.addServices(rest.first(inScanResponse), incomplete, false);
+        }
+        dropped += int(rest.size() - inScanResponse);
+    }
+
+    //! The name prefers the scan response and is shortened when it doesn't fit
+    if (!content.localName.isEmpty()) {
+        const QByteArray utf8 = content.localName.toUtf8();
+        Payload* target = scanResponse.fits(1) ? &scanResponse
+                        : advertising.fits(1) ? &advertising : nullptr;
+
+        if (!target) {
+            ++dropped;
+        } else if (target->fits(utf8.size())) {
+            target->addName(content.localName, utf8, true);
+        } else {
+            //! Cut on a character boundary
+            qsizetype length = target->space() - HeaderSize;
+            while (length > 0 && (quint8(utf8.at(length)) & 0xC0) == 0x80) {
+                --length;
+            }
+            if (length > 0) {
+                const QByteArray shortened = utf8.first(length);
+                target->addName(QString::fromUtf8(shortened), shortened, false);
+            } else {
+                ++dropped;
+            }
+        }
+    }
+
+    //! Data entries starting with the current one of the rotation
+    const qsizetype count = content.data.size();
+    for (qsizetype i = 0; i < count; ++i) {
+        const DataField& field = content.data.at((rotation + i) % count);
+        const qsizetype body = bodySize(field);
+
+        if (advertising.fits(body)) {
+            advertising.addData(field);
+        } else if (scanResponse.fits(body)) {
+            scanResponse.addData(field);
+        } else {
+            ++dropped;
+        }
+    }
+
+    if (content.powerLevel != NoPowerLevel) {
+        if (scanResponse.fits(1)) {
+            scanResponse.addPowerLevel(content.powerLevel);
+        } else if (advertising.fits(1)) {
+            advertising.addPowerLevel(content.powerLevel);
+        } else {
+            ++dropped;
+        }
+    }
+
+    Payloads payloads;
+    payloads.advertisingSize = advertising.size();
+    payloads.scanResponseSize = scanResponse.size();
+    payloads.advertising = advertising.finish();
+    payloads.scanResponse = scanResponse.finish();
+    payloads.dropped = dropped;
+    return payloads;
+}
+
+void BLEAdvertiser::scheduleUpdate()
+{
+    if (!mUpdateTimer->isActive()) {
+        mUpdateTimer->start(mIntervalMax);
+    }
+}
+
+void BLEAdvertiser::rotate()
+{
+    if (mData.size() < 2) {
+        return;
+    }
+
+    mRotation = (mRotation + 1) % int(mData.size());
+    emit changed();
+}
+
+void BLEAdvertiser::updateRotation()
+{
+    if (mRotation >= mData.size()) {
+        mRotation = 0;
+    }
+
+    if (mRotationTimer->interval() > 0 && mData.size() > 1) {
+        if (!mRotationTimer->isActive()) {
+            mRotationTimer->start();
+        }
+    } else {
+        mRotationTimer->stop();
+    }
+}
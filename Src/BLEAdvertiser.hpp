@@ -0,0 +1,265 @@
+#pragma once
+
+#include <QObject>
+#include <QBluetoothUuid>
+#include <QLowEnergyAdvertisingData>
+#include <QLowEnergyAdvertisingParameters>
+#include <QStringList>
+#include <QTimer>
+
+/*!
+ * \brief The BLEAdvertiser class builds the advertising and scan response payloads of a
+ * \ref BLEPeripheral and holds its advertising parameters. Fields are packed by priority within the
+ * 31 bytes of each payload: flags and service uuids first in the advertising payload, then
+ * manufacturer and service data, with the local name and power level preferring the scan response.
+ * Manufacturer and service data can change at any time, e.g. for a live summary of a sensor, and
+ * the payloads are updated in place without recreating the controller. When there is more data than
+ * fits, \ref rotationInterval cycles through it
+ */
+class BLEAdvertiser : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(bool connectable READ connectable WRITE setConnectable NOTIFY connectableChanged FINAL)
+    Q_PROPERTY(int intervalMin READ intervalMin WRITE setIntervalMin NOTIFY intervalMinChanged FINAL)
+    Q_PROPERTY(int intervalMax READ intervalMax WRITE setIntervalMax NOTIFY intervalMaxChanged FINAL)
+    Q_PROPERTY(FilterPolicy filterPolicy READ filterPolicy WRITE setFilterPolicy NOTIFY filterPolicyChanged FINAL)
+    Q_PROPERTY(QStringList whiteList READ whiteList WRITE setWhiteList NOTIFY whiteListChanged FINAL)
+    Q_PROPERTY(int powerLevel READ powerLevel WRITE setPowerLevel NOTIFY powerLevelChanged FINAL)
+    Q_PROPERTY(int rotationInterval READ rotationInterval WRITE setRotationInterval NOTIFY rotationIntervalChanged FINAL)
+
+public:
+    /*!
+     * \brief The FilterPolicy enum mirrors \ref QLowEnergyAdvertisingParameters::FilterPolicy
+     */
+    enum FilterPolicy {
+        IgnoreWhiteList = QLowEnergyAdvertisingParameters::IgnoreWhiteList,
+        UseWhiteListForScanning = QLowEnergyAdvertisingParameters::UseWhiteListForScanning,
+        UseWhiteListForConnecting = QLowEnergyAdvertisingParameters::UseWhiteListForConnecting,
+        UseWhiteListForScanningAndConnecting
+        = QLowEnergyAdvertisingParameters::UseWhiteListForScanningAndConnecting,
+    };
+    Q_ENUM(FilterPolicy)
+
+    //! \brief NoPowerLevel Value of \ref powerLevel when it's not advertised
+    static constexpr int NoPowerLevel = -128;
+
+    //! \brief MaxPayload Size of a legacy advertising or scan response payload
+    static constexpr int MaxPayload = 31;
+
+    /*!
+     * \brief The DataField struct is a manufacturer or service data entry
+     */
+    struct DataField
+    {
+        bool manufacturer;      //! Manufacturer data if true, service data otherwise
+        quint16 companyId;
+        QBluetoothUuid service;
+        QByteArray data;
+    };
+
+    /*!
+     * \brief The Content struct is everything that may be advertised
+     */
+    struct Content
+    {
+        QString localName;
+        int powerLevel = NoPowerLevel;
+        QList<QBluetoothUuid> services;
+        QList<DataField> data;
+        int rotation = 0;       //! Index of the data entry packed first
+    };
+
+    /*!
+     * \brief The Payloads struct is the result of \ref pack()
+     */
+    struct Payloads
+    {
+        QLowEnergyAdvertisingData advertising;
+        QLowEnergyAdvertisingData scanResponse;
+        int advertisingSize = 0;
+        int scanResponseSize = 0;
+        int dropped = 0;        //! Number of fields or service uuids that didn't fit
+    };
+
+    explicit BLEAdvertiser(QObject* parent = nullptr);
+
+    /*!
+     * \brief connectable When false centrals can scan but not connect, for a peripheral that only
+     * broadcasts
+     * \return
+     */
+    bool connectable() const;
+    void setConnectable(bool connectable);
+
+    /*!
+     * \brief intervalMin Minimum advertising interval in milliseconds, shorter intervals are found
+     * faster and cost more power
+     * \return
+     */
+    int intervalMin() const;
+    void setIntervalMin(int interval);
+
+    /*!
+     * \brief intervalMax Maximum advertising interval in milliseconds
+     * \return
+     */
+    int intervalMax() const;
+    void setIntervalMax(int interval);
+
+    /*!
+     * \brief filterPolicy Whether scan and connection requests are only accepted from the devices
+     * in \ref whiteList
+     * \return
+     */
+    FilterPolicy filterPolicy() const;
+    void setFilterPolicy(FilterPolicy policy);
+
+    /*!
+     * \brief whiteList Addresses of the devices used by \ref filterPolicy
+     * \return
+     */
+    QStringList whiteList() const;
+    void setWhiteList(const QStringList& whiteList);
+
+    /*!
+     * \brief powerLevel The advertised TX power level in dBm, \ref NoPowerLevel leaves it out.
+     * The value is only used in a raw payload, otherwise the controller fills in its own level
+     * \return
+     */
+    int powerLevel() const;
+    void setPowerLevel(int powerLevel);
+
+    /*!
+     * \brief rotationInterval Interval in milliseconds of rotating the manufacturer and service
+     * data entries when they don't all fit, 0 disables rotation
+     * \return
+     */
+    int rotationInterval() const;
+    void setRotationInterval(int interval);
+
+    /*!
+     * \brief setManufacturerData Advertises \a data as the manufacturer data of \a companyId,
+     * replacing its previous data
+     */
+    Q_INVOKABLE void setManufacturerData(int companyId, const QByteArray& data);
+    Q_INVOKABLE void removeManufacturerData(int companyId);
+
+    /*!
+     * \brief setServiceData Advertises \a data as the service data of \a serviceUuid, replacing
+     * its previous data
+     */
+    Q_INVOKABLE void setServiceData(quint32 serviceUuid, const QByteArray& data);
+    Q_INVOKABLE void removeServiceData(quint32 serviceUuid);
+
+    /*!
+     * \brief clearData Removes every manufacturer and service data entry
+     */
+    Q_INVOKABLE void clearData();
+
+    /*!
+     * \brief parameters Returns the advertising parameters
+     */
+    QLowEnergyAdvertisingParameters parameters() const;
+
+    /*!
+     * \brief content Returns what is advertised with \a localName, without the services which are
+     * only known once they are set up
+     */
+    Content content(const QString& localName) const;
+
+    /*!
+     * \brief pack Packs \a content into the advertising and scan response payloads. Fields Qt can
+     * represent are set on \ref QLowEnergyAdvertisingData, a payload holding service data or
+     * several manufacturer data entries is set as raw data instead
+     */
+    static Payloads pack(const Content& content);
+
+signals:
+    /*!
+     * \brief changed Emitted when the payloads or parameters must be applied again. Data updates
+     * are coalesced and emitted at most once per \ref intervalMax since the advertised data can't
+     * change faster
+     */
+    void changed();
+
+    void connectableChanged();
+    void intervalMinChanged();
+    void intervalMaxChanged();
+    void filterPolicyChanged();
+    void whiteListChanged();
+    void powerLevelChanged();
+    void rotationIntervalChanged();
+
+private:
+    /*!
+     * \brief packFrom Packs \a content starting with the data entry at \a rotation
+     */
+    static Payloads packFrom(const Content& content, int rotation);
+
+    /*!
+     * \brief scheduleUpdate Emits \ref changed() once the update timer fires
+     */
+    void scheduleUpdate();
+
+    /*!
+     * \brief rotate Moves the rotation to the next data entry
+     */
+    void rotate();
+
+    /*!
+     * \brief updateRotation Starts or stops the rotation timer
+     */
+    void updateRotation();
+
+private:
+    bool mConnectable;
+    int mIntervalMin;
+    int mIntervalMax;
+    FilterPolicy mFilterPolicy;
+    QStringList mWhiteList;
+    int mPowerLevel;
+
+    //! \brief mData Manufacturer and service data entries in the order they were added
+    QList<DataField> mData;
+
+    //! \brief mRotation Index of the data entry packed first
+    int mRotation;
+
+    //! \brief mUpdateTimer Coalesces data updates
+    QTimer* mUpdateTimer;
+
+    //! \brief mRotationTimer Rotates the data entries
+    QTimer* mRotationTimer;
+};
+
+
+inline bool BLEAdvertiser::connectable() const
+{
+    return mConnectable;
+}
+
+inline int BLEAdvertiser::intervalMin() const
+{
+    return mIntervalMin;
+}
+
+inline int BLEAdvertiser::intervalMax() const
+{
+    return mIntervalMax;
+}
+
+inline BLEAdvertiser::FilterPolicy BLEAdvertiser::filterPolicy() const
+{
+    return mFilterPolicy;
+}
+
+inline QStringList BLEAdvertiser::whiteList() const
+{
+    return mWhiteList;
+}
+
+inline int BLEAdvertiser::powerLevel() const
+{
+    return mPowerLevel;
+}
@@ -0,0 +1,187 @@
+#include "BLEBroadcastFormat.hpp"
+#include "BLECodecRegistry.hpp"
+
+#include <QString>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+//! \brief Size of the version and sequence
+constexpr int HeaderSize = 2;
+
+//! \brief Size of the characteristic and type of an entry
+constexpr int EntryHeaderSize = 3;
+
+//! \brief The size takes the low 6 bits of the type byte
+constexpr int MaxValueSize = 0x3F;
+
+//! \brief Binary form of \a value
+QByteArray encodeValue(BLESample::Type type, quint16 characteristic, const QVariant& value)
+{
+    switch (type) {
+    case BLESample::Int: {
+        if (!value.canConvert<int>()) {
+            return QByteArray();
+        }
+        const qint16 number = qToLittleEndian(qint16(value.toInt()));
+        return QByteArray(reinterpret_cast<const char*>(&number), sizeof(number));
+    }
+    case BLESample::Float: {
+        if (!value.canConvert<float>()) {
+            return QByteArray();
+        }
+        const float number = value.toFloat();
+        quint32 bits = 0;
+        std::memcpy(&bits, &number, sizeof(bits));
+        bits = qToLittleEndian(bits);
+        return QByteArray(reinterpret_cast<const char*>(&bits), sizeof(bits));
+    }
+    case BLESample::String:
+        return value.toString().toUtf8().left(MaxValueSize);
+    case BLESample::Standard: {
+        const QByteArray bytes = BLECodecRegistry::encode(characteristic, value);
+        return bytes.size() <= MaxValueSize ? bytes : QByteArray();
+    }
+    }
+
+    return QByteArray();
+}
+
+//! \brief Value of the binary form in \a bytes
+QVariant decodeValue(BLESample::Type type, quint16 characteristic, const char* bytes, int size)
+{
+    switch (type) {
+    case BLESample::Int:
+        if (size != int(sizeof(qint16))) {
+            return QVariant();
+        }
+        return QVariant(qFromLittleEndian<qint16>(bytes));
+    case BLESample::Float: {
+        if (size != int(sizeof(quint32))) {
+            return QVariant();
+        }
+        const quint32 bits = qFromLittleEndian<quint32>(bytes);
+        float number = 0;
+        std::memcpy(&number, &bits, sizeof(number));
+        return QVariant(number);
+    }
+    case BLESample::String:
+        return QString::fromUtf8(bytes, size);
+    case BLESample::Standard: {
+        const QVariantMap fields = BLECodecRegistry::decode(characteristic, bytes, size);
+        return fields.isEmpty() ? QVariant() : QVariant(fields);
+    }
+    }
+
+    return QVariant();
+}
+
+} // namespace
+
+QByteArray BLEBroadcastFormat::encode(quint8 sequence,
+                                      const QList<Entry>& entries,
+                                      int maxSize,
+                                      int* encoded)
+{
+    QList<QByteArray> encodedEntries;
+    encodedEntries.reserve(entries.size());
+    for (const Entry& entry : entries) {
+        QByteArray bytes = encodeEntry(entry);
+        if (!bytes.isEmpty()) {
+            encodedEntries.append(std::move(bytes));
+        }
+    }
+
+    return assemble(sequence, encodedEntries, maxSize, encoded);
+}
+
+QByteArray BLEBroadcastFormat::encodeEntry(const Entry& entry)
+{
+    const QByteArray value = encodeValue(entry.type, entry.characteristic, entry.value);
+    if (value.isEmpty() && entry.type != BLESample::String) {
+        return QByteArray();
+    }
+
+    QByteArray data;
+    data.reserve(EntryHeaderSize + value.size());
+    const quint16 characteristic = qToLittleEndian(entry.characteristic);
+    data.append(reinterpret_cast<const char*>(&characteristic), sizeof(characteristic));
+    data.append(char((quint8(entry.type) << 6) | quint8(value.size())));
+    data.append(value);
+    return data;
+}
+
+QByteArray BLEBroadcastFormat::assemble(quint8 sequence,
+                                        const QList<QByteArray>& entries,
+                                        int maxSize,
+                                        int* encoded)
+{
+    QByteArray data;
+    data.reserve(maxSize);
+    data.append(char(Version));
+    data.append(char(sequence));
+
+    int count = 0;
+    for (const QByteArray& entry : entries) {
+        if (data.size() + entry.size() > maxSize) {
+            break;
+        }
+
+        data.append(entry);
+        ++count;
+    }
+
+    if (encoded) {
+        *encoded = count;
+    }
+    return data;
+}
+
+int BLEBroadcastFormat::sequence(const QByteArray& data)
+{
+    if (data.size() < HeaderSize || quint8(data.at(0)) != Version) {
+        return -1;
+    }
+
+    return quint8(data.at(1));
+}
+
+bool BLEBroadcastFormat::decode(const QByteArray& data, QList<Entry>& entries)
+{
+    if (sequence(data) < 0) {
+        return false;
+    }
+
+    const char* bytes = data.constData();
+    qsizetype offset = HeaderSize;
+
+    while (offset < data.size()) {
+        if (offset + EntryHeaderSize > data.size()) {
+            return false;
+        }
+
+        Entry entry;
+        entry.characteristic = qFromLittleEndian<quint16>(bytes + offset);
+
+        const quint8 typeAndSize = quint8(bytes[offset + 2]);
+        const quint8 type = typeAndSize >> 6;
+        const int size = typeAndSize & MaxValueSize;
+        offset += EntryHeaderSize;
+
+        if (type > BLESample::Standard || offset + size > data.size()) {
+            return false;
+        }
+
+        entry.type = BLESample::Type(type);
+        entry.value = decodeValue(entry.type, entry.characteristic, bytes + offset, size);
+        offset += size;
+
+        if (entry.value.isValid()) {
+            entries.append(std::move(entry));
+        }
+    }
+
+    return true;
+}
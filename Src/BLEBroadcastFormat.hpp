@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QVariant>
+
+#include "BLESample.hpp"
+
+/*!
+ * \brief The BLEBroadcastFormat class encodes values of \ref BLEDataService into the manufacturer
+ * data of an advertisement and back, so they can be read without a connection. The layout is
+ *
+ *     u8 version, u8 sequence, then for each value
+ *     u16 characteristic (LE), u8 type << 6 | size, size bytes of value
+ *
+ * The characteristic is the low 16 bits of its uuid. Values are binary and little endian: Int is
+ * 2 bytes, Float 4 bytes, String its UTF-8 text and Standard the value of the characteristic as
+ * its codec in \ref BLECodecRegistry builds it. The sequence changes whenever a value changes,
+ * so an observer can skip repeated advertisements. It holds no state so it can be used from any
+ * thread
+ */
+class BLEBroadcastFormat
+{
+public:
+    //! \brief Version The version of the layout, the first byte of the payload
+    static constexpr quint8 Version = 1;
+
+    //! \brief DefaultCompanyId The company id reserved for testing by the Bluetooth SIG
+    static constexpr int DefaultCompanyId = 0xFFFF;
+
+    //! \brief MaxSize Room for manufacturer data in an advertising payload next to the flags
+    static constexpr int MaxSize = 24;
+
+    /*!
+     * \brief The Entry struct is one broadcast value
+     */
+    struct Entry
+    {
+        quint16 characteristic = 0;
+        BLESample::Type type = BLESample::Int;
+        QVariant value;
+    };
+
+    /*!
+     * \brief encode Encodes \a entries, stopping at the first one that doesn't fit in \a maxSize
+     * \param encoded Set to the number of encoded entries when not null
+     */
+    static QByteArray encode(quint8 sequence,
+                             const QList<Entry>& entries,
+                             int maxSize = MaxSize,
+                             int* encoded = nullptr);
+
+    /*!
+     * \brief encodeEntry Encodes \a entry alone, so a caller can keep the entries that didn't
+     * change encoded and \ref assemble() them
+     * \return Empty if the value of \a entry can't be encoded
+     */
+    static QByteArray encodeEntry(const Entry& entry);
+
+    /*!
+     * \brief assemble Builds a payload of entries encoded by \ref encodeEntry(), stopping at the
+     * first one that doesn't fit in \a maxSize
+     * \param encoded Set to the number of entries in the payload when not null
+     */
+    static QByteArray assemble(quint8 sequence,
+                               const QList<QByteArray>& entries,
+                               int maxSize = MaxSize,
+                               int* encoded = nullptr);
+
+    /*!
+     * \brief sequence Returns the sequence of \a data, or -1 if it's not a broadcast payload
+     */
+    static int sequence(const QByteArray& data);
+
+    /*!
+     * \brief decode Decodes the entries of \a data
+     * \return False if \a data is not a valid broadcast payload
+     */
+    static bool decode(const QByteArray& data, QList<Entry>& entries);
+};
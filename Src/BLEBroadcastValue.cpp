@@ -0,0 +1,49 @@
+#include "BLEBroadcastValue.hpp"
+
+BLEBroadcastValue::BLEBroadcastValue(const QBluetoothAddress& address,
+                                     quint16 characterUuid,
+                                     QObject* parent)
+    : QObject{ parent }
+    , mAddress { address }
+    , mCharacterUuid { characterUuid }
+    , mDataType { BLEDataService::Int }
+    , mRssi { 0 }
+{}
+
+void BLEBroadcastValue::setName(const QString& name)
+{
+    if (mName == name) {
+        return;
+    }
+
+    mName = name;
+    emit nameChanged();
+}
+
+void BLEBroadcastValue::setRssi(int rssi)
+{
+    if (mRssi == rssi) {
+        return;
+    }
+
+    mRssi = rssi;
+    emit rssiChanged();
+}
+
+void BLEBroadcastValue::setValue(BLEDataService::DataType type, const QVariant& value)
+{
+    if (mDataType != type) {
+        mDataType = type;
+        emit dataTypeChanged();
+    }
+
+    mLastUpdate = QDateTime::currentDateTime();
+    emit lastUpdateChanged();
+
+    if (mValue != value) {
+        mValue = value;
+        emit valueChanged();
+    }
+
+    emit valueUpdated(value);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <QObject>
+#include <QBluetoothAddress>
+#include <QDateTime>
+#include <QVariant>
+
+#include "BLEDataService.hpp"
+
+/*!
+ * \brief The BLEBroadcastValue class is a value broadcast by a \ref BLEPeripheral and observed by a
+ * \ref BluetoothDiscovery without a connection. It mirrors the value part of a \ref BLEDataService
+ */
+class BLEBroadcastValue : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString address READ address CONSTANT)
+    Q_PROPERTY(QString name READ name NOTIFY nameChanged)
+    Q_PROPERTY(uint32_t characterUuid READ characterUuid CONSTANT)
+    Q_PROPERTY(BLEDataService::DataType dataType READ dataType NOTIFY dataTypeChanged)
+    Q_PROPERTY(QVariant value READ value NOTIFY valueChanged)
+    Q_PROPERTY(int rssi READ rssi NOTIFY rssiChanged)
+    Q_PROPERTY(QDateTime lastUpdate READ lastUpdate NOTIFY lastUpdateChanged)
+
+public:
+    BLEBroadcastValue(const QBluetoothAddress& address,
+                      quint16 characterUuid,
+                      QObject* parent = nullptr);
+
+    /*!
+     * \brief address Returns the address of the broadcasting device
+     * \return
+     */
+    QString address() const;
+
+    /*!
+     * \brief name Returns the name of the broadcasting device, if it advertises one
+     * \return
+     */
+    QString name() const;
+    void setName(const QString& name);
+
+    /*!
+     * \brief characterUuid Returns the characteristic uuid, broadcasts carry its low 16 bits
+     * \return
+     */
+    uint32_t characterUuid() const;
+
+    BLEDataService::DataType dataType() const;
+
+    /*!
+     * \brief value Returns the latest value
+     * \return
+     */
+    QVariant value() const;
+
+    /*!
+     * \brief rssi Returns the signal strength of the latest advertisement
+     * \return
+     */
+    int rssi() const;
+    void setRssi(int rssi);
+
+    /*!
+     * \brief lastUpdate Returns the time the value was last broadcast
+     * \return
+     */
+    QDateTime lastUpdate() const;
+
+    /*!
+     * \brief setValue Sets the value and its type, emits \ref valueUpdated() even if it is unchanged
+     */
+    void setValue(BLEDataService::DataType type, const QVariant& value);
+
+signals:
+    void nameChanged();
+    void dataTypeChanged();
+    void valueChanged();
+    void rssiChanged();
+    void lastUpdateChanged();
+
+    /*!
+     * \brief valueUpdated This signal is emitted for every observed broadcast of a new sequence
+     * \param value
+     */
+    void valueUpdated(QVariant value);
+
+private:
+    const QBluetoothAddress mAddress;
+    const quint16 mCharacterUuid;
+    QString mName;
+    BLEDataService::DataType mDataType;
+    QVariant mValue;
+    int mRssi;
+    QDateTime mLastUpdate;
+};
+
+
+inline QString BLEBroadcastValue::address() const
+{
+    return mAddress.toString();
+}
+
+inline QString BLEBroadcastValue::name() const
+{
+    return mName;
+}
+
+inline uint32_t BLEBroadcastValue::characterUuid() const
+{
+    return mCharacterUuid;
+}
+
+inline BLEDataService::DataType BLEBroadcastValue::dataType() const
+{
+    return mDataType;
+}
+
+inline QVariant BLEBroadcastValue::value() const
+{
+    return mValue;
+}
+
+inline int BLEBroadcastValue::rssi() const
+{
+    return mRssi;
+}
+
+inline QDateTime BLEBroadcastValue::lastUpdate() const
+{
+    return mLastUpdate;
+}
@@ -1,5 +1,6 @@
 #include "BLECentral.hpp"
 #include "BLEDataService.hpp"
+#include "BLETrace.hpp"
 
 BLECentral::BLECentral(QObject *parent)
     : BLERole{ parent }
@@ -13,36 +14,33 @@ void BLECentral::setDevice(BluetoothDeviceInfo* dev)
 
     mDevice = dev;
 
-    if (mController) {
-        mController->disconnectFromDevice();
-        delete mController;
-        mController = nullptr;
-    }
+    destroyTransport();
 
     if (mDevice) {
-        mController = QLowEnergyController::createCentral(mDevice->device(), this);
-        mController->setRemoteAddressType(QLowEnergyController::PublicAddress);
+        mTransport = createTransport(QLowEnergyController::CentralRole, mDevice->device());
 
-        connect(mController, &QLowEnergyController::serviceDiscovered,
-                this, &BLECentral::serviceDiscovered);
+        //! Discovery runs on the transport's thread since it sets up the services
+        connect(mTransport, &BLETransport::serviceDiscovered,
+                mTransport, [this, transport = mTransport](const QBluetoothUuid& uuid) {
+                    serviceDiscovered(*transport, uuid);
+                });
 
-        connect(mController, &QLowEnergyController::errorOccurred, this,
+        connect(mTransport, &BLETransport::errorOccurred, this,
                 [this](QLowEnergyController::Error error) {
                     emit stateChanged();
                     Q_UNUSED(error);
                     qWarning("BLECentral: Cannot connect to remote device.");
                 });
-        connect(mController, &QLowEnergyController::connected, this, [this]() {
-            emit stateChanged();
-            mController->discoverServices();
-        });
-        connect(mController, &QLowEnergyController::disconnected, this, [this]() {
-            emit stateChanged();
+        connect(mTransport, &BLETransport::connected, mTransport,
+                &BLETransport::discoverServices);
+        connect(mTransport, &BLETransport::disconnected, this, []() {
             qWarning("BLECentral: LowEnergy controller disconnected");
         });
 
         // Connect
-        mController->connectToDevice();
+        invokeOnTransport([transport = mTransport]() {
+            transport->connectToDevice();
+        });
     }
 
     emit deviceChanged();
@@ -51,24 +49,22 @@ void BLECentral::setDevice(BluetoothDeviceInfo* dev)
 
 void BLECentral::disconnect()
 {
-    if (mController->state() == QLowEnergyController::ConnectedState) {
-        mController->disconnectFromDevice();
-        emit stateChanged();
+    if (mTransport && mTransport->state() == QLowEnergyController::ConnectedState) {
+        invokeOnTransport([transport = mTransport]() {
+            transport->disconnectFromDevice();
+        });
     }
 }
 
-void BLECentral::serviceDiscovered(const QBluetoothUuid& uuid)
+void BLECentral::serviceDiscovered(BLETransport& transport, const QBluetoothUuid& uuid)
 {
-    auto dtService = std::find_if(mServices.begin(), mServices.end(), [&](BLEDataService* s) {
-        return s->serviceBluetoothUuid() == uuid;
-    });
-
-    if (dtService == mServices.end()) {
-        return;
-    }
+    QB_TRACE_SCOPE("serviceDiscovered");
 
-    if (QLowEnergyService* service = (*dtService)->setup(*mController)) {
-        service->discoverDetails();
+    //! Every data service of the discovered service is set up, they share the remote service
+    for (BLEDataService* dtService : std::as_const(mTransportServices)) {
+        if (dtService->serviceBluetoothUuid() == uuid) {
+            dtService->setup(transport);
+        }
     }
 }
 
@@ -1,8 +1,6 @@
 #pragma once
 
 #include <QObject>
-#include <QQmlEngine>
-#include <QLowEnergyService>
 #include <QLowEnergyController>
 
 #include "BLERole.hpp"
@@ -13,7 +11,6 @@
 class BLECentral : public BLERole
 {
     Q_OBJECT
-    QML_ELEMENT
 
     Q_PROPERTY(BluetoothDeviceInfo* device READ device WRITE setDevice NOTIFY deviceChanged)
 
@@ -46,11 +43,12 @@ protected:
      */
     virtual void writeData(const QBluetoothUuid& uuid, const QVariant& value) override;
 
-private slots:
+private:
     /*!
      * \brief serviceDiscovered This is called when a new service is found in the peripheral. The
-     * discovered service is added to controller if it exists in the \ref mServices
+     * services in \ref mServices with this uuid are set up on \a transport, the one that found it.
+     * This runs on the thread of \a transport
      * \param uuid The \a QBluetoothUuid of the discovered service
      */
-    void serviceDiscovered(const QBluetoothUuid& uuid);
+    void serviceDiscovered(BLETransport& transport, const QBluetoothUuid& uuid);
 };
@@ -0,0 +1,811 @@
+#include "BLECodecRegistry.hpp"
+
+#include <QDateTime>
+#include <QtEndian>
+#include <QVariantList>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+/*!
+ * \brief The Reader struct reads little endian fields of a value and checks that each fits
+ */
+struct Reader
+{
+    const char* it;
+    const char* end;
+
+    template <typename T>
+    bool take(T& value)
+    {
+        if (end - it < qsizetype(sizeof(T))) {
+            return false;
+        }
+        value = qFromLittleEndian<T>(it);
+        it += sizeof(T);
+        return true;
+    }
+};
+
+template <typename T>
+void put(QByteArray& data, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    data.append(bytes, sizeof(T));
+}
+
+//! \brief Reads a field of \a fields as an integer, false if it's missing or not a number
+bool field(const QVariantMap& fields, const QString& name, int& value)
+{
+    const auto it = fields.constFind(name);
+    if (it == fields.cend()) {
+        return false;
+    }
+
+    bool ok = false;
+    value = it->toInt(&ok);
+    return ok;
+}
+
+//! \brief Reads a field of \a fields as a real number, false if it's missing or not a number
+bool field(const QVariantMap& fields, const QString& name, double& value)
+{
+    const auto it = fields.constFind(name);
+    if (it == fields.cend()) {
+        return false;
+    }
+
+    bool ok = false;
+    value = it->toDouble(&ok);
+    return ok;
+}
+
+/*!
+ * \brief Converts an IEEE 11073 medical float, \a Mantissa bits of signed mantissa and the rest of
+ * \a Raw a signed base 10 exponent. The reserved mantissas are NaN, NRes and the infinities
+ */
+template <typename Raw, int Mantissa>
+double medicalFloat(Raw raw)
+{
+    constexpr Raw Mask = (Raw(1) << Mantissa) - 1;
+    constexpr qint32 NaN = (1 << (Mantissa - 1)) - 1;
+
+    const qint32 mantissa = qint32(raw & Mask) << (32 - Mantissa) >> (32 - Mantissa);
+    const qint32 exponent = qint32(std::make_signed_t<Raw>(raw) >> Mantissa);
+
+    if (mantissa == NaN - 1) {
+        return std::numeric_limits<double>::infinity();
+    } else if (mantissa == -(NaN - 1)) {
+        return -std::numeric_limits<double>::infinity();
+    } else if (mantissa == NaN || mantissa == -NaN - 1 || mantissa == -NaN) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    return mantissa * std::pow(10.0, exponent);
+}
+
+/*!
+ * \brief Builds the IEEE 11073 medical float of \a value with the smallest exponent its mantissa
+ * fits with, so as many digits as possible are kept
+ */
+template <typename Raw, int Mantissa, int MaxExponent>
+Raw toMedicalFloat(double value)
+{
+    constexpr Raw Mask = (Raw(1) << Mantissa) - 1;
+    constexpr qint32 NaN = (1 << (Mantissa - 1)) - 1;
+
+    auto pack = [](qint32 mantissa, qint32 exponent) {
+        return Raw((Raw(exponent) << Mantissa) | (Raw(mantissa) & Mask));
+    };
+
+    if (std::isnan(value)) {
+        return pack(NaN, 0);
+    } else if (std::isinf(value)) {
+        return pack(value > 0 ? NaN - 1 : -(NaN - 1), 0);
+    }
+
+    //! The reserved mantissas are the 3 largest and the 2 smallest
+    for (int exponent = -8; exponent <= MaxExponent; ++exponent) {
+        const double mantissa = std::round(value / std::pow(10.0, exponent));
+        if (mantissa >= -NaN + 2 && mantissa <= NaN - 2) {
+            return pack(qint32(mantissa), exponent);
+        }
+    }
+
+    return pack(value > 0 ? NaN - 1 : -(NaN - 1), 0);
+}
+
+bool takeSFloat(Reader& reader, double& value)
+{
+    quint16 raw;
+    if (!reader.take(raw)) {
+        return false;
+    }
+    value = medicalFloat<quint16, 12>(raw);
+    return true;
+}
+
+bool takeFloat(Reader& reader, double& value)
+{
+    quint32 raw;
+    if (!reader.take(raw)) {
+        return false;
+    }
+    value = medicalFloat<quint32, 24>(raw);
+    return true;
+}
+
+void putSFloat(QByteArray& data, double value)
+{
+    put(data, toMedicalFloat<quint16, 12, 7>(value));
+}
+
+void putFloat(QByteArray& data, double value)
+{
+    put(data, toMedicalFloat<quint32, 24, 127>(value));
+}
+
+/*!
+ * \brief Reads a Date Time, 7 bytes of year, month, day, hours, minutes and seconds. An unknown
+ * year, month or day is an invalid \a QDateTime
+ */
+bool takeDateTime(Reader& reader, QDateTime& value)
+{
+    quint16 year;
+    quint8 month, day, hours, minutes, seconds;
+    if (!reader.take(year) || !reader.take(month) || !reader.take(day) || !reader.take(hours)
+        || !reader.take(minutes) || !reader.take(seconds)) {
+        return false;
+    }
+
+    value = QDateTime(QDate(year, month, day), QTime(hours, minutes, seconds));
+    return true;
+}
+
+void putDateTime(QByteArray& data, const QDateTime& value)
+{
+    const QDate date = value.date();
+    const QTime time = value.time();
+    put<quint16>(data, quint16(date.year()));
+    put<quint8>(data, quint8(date.month()));
+    put<quint8>(data, quint8(date.day()));
+    put<quint8>(data, quint8(time.hour()));
+    put<quint8>(data, quint8(time.minute()));
+    put<quint8>(data, quint8(time.second()));
+}
+
+/*!
+ * \brief Heart Rate Measurement 0x2A37: flags, the heart rate as u8 or u16, the energy expended
+ * in kJ and RR intervals in 1/1024 s
+ */
+namespace HeartRate {
+
+constexpr quint8 Wide = 0x01;
+constexpr quint8 ContactDetected = 0x02;
+constexpr quint8 ContactSupported = 0x04;
+constexpr quint8 Energy = 0x08;
+constexpr quint8 Intervals = 0x10;
+
+bool takeRate(Reader& reader, quint8 flags, int& rate)
+{
+    if (flags & Wide) {
+        quint16 value;
+        if (!reader.take(value)) {
+            return false;
+        }
+        rate = value;
+    } else {
+        quint8 value;
+        if (!reader.take(value)) {
+            return false;
+        }
+        rate = value;
+    }
+    return true;
+}
+
+bool primary(const char* data, qsizetype size, float& value)
+{
+    Reader reader { data, data + size };
+
+    quint8 flags;
+    int rate;
+    if (!reader.take(flags) || !takeRate(reader, flags, rate)) {
+        return false;
+    }
+
+    value = float(rate);
+    return true;
+}
+
+QVariantMap fields(const char* data, qsizetype size)
+{
+    Reader reader { data, data + size };
+    QVariantMap fields;
+
+    quint8 flags;
+    int rate;
+    if (!reader.take(flags) || !takeRate(reader, flags, rate)) {
+        return QVariantMap();
+    }
+    fields.insert(QStringLiteral("heartRate"), rate);
+
+    if (flags & ContactSupported) {
+        fields.insert(QStringLiteral("sensorContact"), bool(flags & ContactDetected));
+    }
+
+    if (flags & Energy) {
+        quint16 energy;
+        if (!reader.take(energy)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("energyExpended"), energy);
+    }
+
+    if (flags & Intervals) {
+        QVariantList intervals;
+        quint16 interval;
+        while (reader.take(interval)) {
+            intervals.append(interval * 1000.0 / 1024.0);
+        }
+        fields.insert(QStringLiteral("rrIntervals"), intervals);
+    }
+
+    return fields;
+}
+
+QByteArray encode(const QVariantMap& fields)
+{
+    int rate;
+    if (!field(fields, QStringLiteral("heartRate"), rate) || rate < 0 || rate > 0xFFFF) {
+        return QByteArray();
+    }
+
+    quint8 flags = rate > 0xFF ? Wide : 0;
+    QByteArray data;
+    data.append(char(0));
+
+    if (flags & Wide) {
+        put<quint16>(data, quint16(rate));
+    } else {
+        put<quint8>(data, quint8(rate));
+    }
+
+    if (const auto contact = fields.constFind(QStringLiteral("sensorContact"));
+        contact != fields.cend()) {
+        flags |= ContactSupported | (contact->toBool() ? ContactDetected : 0);
+    }
+
+    int energy;
+    if (field(fields, QStringLiteral("energyExpended"), energy)) {
+        flags |= Energy;
+        put<quint16>(data, quint16(qBound(0, energy, 0xFFFF)));
+    }
+
+    if (const auto intervals = fields.constFind(QStringLiteral("rrIntervals"));
+        intervals != fields.cend()) {
+        flags |= Intervals;
+        for (const QVariant& interval : intervals->toList()) {
+            put<quint16>(data, quint16(qBound(0.0, std::round(interval.toDouble() * 1.024),
+                                              65535.0)));
+        }
+    }
+
+    data[0] = char(flags);
+    return data;
+}
+
+} // namespace HeartRate
+
+/*!
+ * \brief Temperature Measurement 0x2A1C: flags, the temperature as a FLOAT in Celsius or
+ * Fahrenheit, the time stamp and the temperature type, ie where it's measured
+ */
+namespace Temperature {
+
+constexpr quint8 Fahrenheit = 0x01;
+constexpr quint8 TimeStamp = 0x02;
+constexpr quint8 Type = 0x04;
+
+bool primary(const char* data, qsizetype size, float& value)
+{
+    Reader reader { data, data + size };
+
+    quint8 flags;
+    double temperature;
+    if (!reader.take(flags) || !takeFloat(reader, temperature)) {
+        return false;
+    }
+
+    value = float(temperature);
+    return true;
+}
+
+QVariantMap fields(const char* data, qsizetype size)
+{
+    Reader reader { data, data + size };
+    QVariantMap fields;
+
+    quint8 flags;
+    double temperature;
+    if (!reader.take(flags) || !takeFloat(reader, temperature)) {
+        return QVariantMap();
+    }
+    fields.insert(QStringLiteral("temperature"), temperature);
+    fields.insert(QStringLiteral("fahrenheit"), bool(flags & Fahrenheit));
+
+    if (flags & TimeStamp) {
+        QDateTime timestamp;
+        if (!takeDateTime(reader, timestamp)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("timestamp"), timestamp);
+    }
+
+    if (flags & Type) {
+        quint8 type;
+        if (!reader.take(type)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("temperatureType"), type);
+    }
+
+    return fields;
+}
+
+QByteArray encode(const QVariantMap& fields)
+{
+    double temperature;
+    if (!field(fields, QStringLiteral("temperature"), temperature)) {
+        return QByteArray();
+    }
+
+    quint8 flags = fields.value(QStringLiteral("fahrenheit")).toBool() ? Fahrenheit : 0;
+    QByteArray data;
+    data.append(char(0));
+    putFloat(data, temperature);
+
+    if (const QDateTime timestamp = fields.value(QStringLiteral("timestamp")).toDateTime();
+        timestamp.isValid()) {
+        flags |= TimeStamp;
+        putDateTime(data, timestamp);
+    }
+
+    int type;
+    if (field(fields, QStringLiteral("temperatureType"), type)) {
+        flags |= Type;
+        put<quint8>(data, quint8(type));
+    }
+
+    data[0] = char(flags);
+    return data;
+}
+
+} // namespace Temperature
+
+/*!
+ * \brief Blood Pressure Measurement 0x2A35: flags, systolic, diastolic and mean arterial pressure
+ * as SFLOATs in mmHg or kPa, the time stamp, the pulse rate as an SFLOAT, the user id and the
+ * measurement status bits
+ */
+namespace BloodPressure {
+
+constexpr quint8 Kilopascal = 0x01;
+constexpr quint8 TimeStamp = 0x02;
+constexpr quint8 PulseRate = 0x04;
+constexpr quint8 UserId = 0x08;
+constexpr quint8 Status = 0x10;
+
+bool primary(const char* data, qsizetype size, float& value)
+{
+    Reader reader { data, data + size };
+
+    quint8 flags;
+    double systolic;
+    if (!reader.take(flags) || !takeSFloat(reader, systolic)) {
+        return false;
+    }
+
+    value = float(systolic);
+    return true;
+}
+
+QVariantMap fields(const char* data, qsizetype size)
+{
+    Reader reader { data, data + size };
+    QVariantMap fields;
+
+    quint8 flags;
+    double systolic, diastolic, mean;
+    if (!reader.take(flags) || !takeSFloat(reader, systolic) || !takeSFloat(reader, diastolic)
+        || !takeSFloat(reader, mean)) {
+        return QVariantMap();
+    }
+    fields.insert(QStringLiteral("systolic"), systolic);
+    fields.insert(QStringLiteral("diastolic"), diastolic);
+    fields.insert(QStringLiteral("meanArterialPressure"), mean);
+    fields.insert(QStringLiteral("kilopascal"), bool(flags & Kilopascal));
+
+    if (flags & TimeStamp) {
+        QDateTime timestamp;
+        if (!takeDateTime(reader, timestamp)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("timestamp"), timestamp);
+    }
+
+    if (flags & PulseRate) {
+        double pulseRate;
+        if (!takeSFloat(reader, pulseRate)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("pulseRate"), pulseRate);
+    }
+
+    if (flags & UserId) {
+        quint8 userId;
+        if (!reader.take(userId)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("userId"), userId);
+    }
+
+    if (flags & Status) {
+        quint16 status;
+        if (!reader.take(status)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("status"), status);
+    }
+
+    return fields;
+}
+
+QByteArray encode(const QVariantMap& fields)
+{
+    double systolic;
+    if (!field(fields, QStringLiteral("systolic"), systolic)) {
+        return QByteArray();
+    }
+
+    //! A missing pressure is sent as NaN, the way a monitor marks a value it didn't measure
+    double diastolic = std::numeric_limits<double>::quiet_NaN();
+    double mean = std::numeric_limits<double>::quiet_NaN();
+    field(fields, QStringLiteral("diastolic"), diastolic);
+    field(fields, QStringLiteral("meanArterialPressure"), mean);
+
+    quint8 flags = fields.value(QStringLiteral("kilopascal")).toBool() ? Kilopascal : 0;
+    QByteArray data;
+    data.append(char(0));
+    putSFloat(data, systolic);
+    putSFloat(data, diastolic);
+    putSFloat(data, mean);
+
+    if (const QDateTime timestamp = fields.value(QStringLiteral("timestamp")).toDateTime();
+        timestamp.isValid()) {
+        flags |= TimeStamp;
+        putDateTime(data, timestamp);
+    }
+
+    double pulseRate;
+    if (field(fields, QStringLiteral("pulseRate"), pulseRate)) {
+        flags |= PulseRate;
+        putSFloat(data, pulseRate);
+    }
+
+    int userId;
+    if (field(fields, QStringLiteral("userId"), userId)) {
+        flags |= UserId;
+        put<quint8>(data, quint8(userId));
+    }
+
+    int status;
+    if (field(fields, QStringLiteral("status"), status)) {
+        flags |= Status;
+        put<quint16>(data, quint16(status));
+    }
+
+    data[0] = char(flags);
+    return data;
+}
+
+} // namespace BloodPressure
+
+/*!
+ * \brief RSC Measurement 0x2A53: flags, the speed in 1/256 m/s, the cadence in steps per minute,
+ * the stride length in cm and the total distance in dm. Reported in m/s and m
+ */
+namespace RunningSpeed {
+
+constexpr quint8 StrideLength = 0x01;
+constexpr quint8 TotalDistance = 0x02;
+constexpr quint8 Running = 0x04;
+
+bool primary(const char* data, qsizetype size, float& value)
+{
+    Reader reader { data, data + size };
+
+    quint8 flags;
+    quint16 speed;
+    if (!reader.take(flags) || !reader.take(speed)) {
+        return false;
+    }
+
+    value = speed / 256.0f;
+    return true;
+}
+
+QVariantMap fields(const char* data, qsizetype size)
+{
+    Reader reader { data, data + size };
+    QVariantMap fields;
+
+    quint8 flags, cadence;
+    quint16 speed;
+    if (!reader.take(flags) || !reader.take(speed) || !reader.take(cadence)) {
+        return QVariantMap();
+    }
+    fields.insert(QStringLiteral("speed"), speed / 256.0);
+    fields.insert(QStringLiteral("cadence"), cadence);
+    fields.insert(QStringLiteral("running"), bool(flags & Running));
+
+    if (flags & StrideLength) {
+        quint16 stride;
+        if (!reader.take(stride)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("strideLength"), stride / 100.0);
+    }
+
+    if (flags & TotalDistance) {
+        quint32 distance;
+        if (!reader.take(distance)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("totalDistance"), distance / 10.0);
+    }
+
+    return fields;
+}
+
+QByteArray encode(const QVariantMap& fields)
+{
+    double speed;
+    if (!field(fields, QStringLiteral("speed"), speed)) {
+        return QByteArray();
+    }
+
+    int cadence = 0;
+    field(fields, QStringLiteral("cadence"), cadence);
+
+    quint8 flags = fields.value(QStringLiteral("running")).toBool() ? Running : 0;
+    QByteArray data;
+    data.append(char(0));
+    put<quint16>(data, quint16(qBound(0.0, std::round(speed * 256), 65535.0)));
+    put<quint8>(data, quint8(qBound(0, cadence, 0xFF)));
+
+    double stride;
+    if (field(fields, QStringLiteral("strideLength"), stride)) {
+        flags |= StrideLength;
+        put<quint16>(data, quint16(qBound(0.0, std::round(stride * 100), 65535.0)));
+    }
+
+    double distance;
+    if (field(fields, QStringLiteral("totalDistance"), distance)) {
+        flags |= TotalDistance;
+        put<quint32>(data, quint32(qBound(0.0, std::round(distance * 10), 4294967295.0)));
+    }
+
+    data[0] = char(flags);
+    return data;
+}
+
+} // namespace RunningSpeed
+
+/*!
+ * \brief CSC Measurement 0x2A5B: flags, the cumulative wheel revolutions as u32 with the time of
+ * the last wheel event and the cumulative crank revolutions as u16 with the time of the last
+ * crank event, times in 1/1024 s. Reported in s
+ */
+namespace CyclingSpeed {
+
+constexpr quint8 Wheel = 0x01;
+constexpr quint8 Crank = 0x02;
+
+bool primary(const char* data, qsizetype size, float& value)
+{
+    Reader reader { data, data + size };
+
+    quint8 flags;
+    if (!reader.take(flags)) {
+        return false;
+    }
+
+    if (flags & Wheel) {
+        quint32 revolutions;
+        if (!reader.take(revolutions)) {
+            return false;
+        }
+        value = float(revolutions);
+        return true;
+    } else if (flags & Crank) {
+        quint16 revolutions;
+        if (!reader.take(revolutions)) {
+            return false;
+        }
+        value = float(revolutions);
+        return true;
+    }
+
+    return false;
+}
+
+QVariantMap fields(const char* data, qsizetype size)
+{
+    Reader reader { data, data + size };
+    QVariantMap fields;
+
+    quint8 flags;
+    if (!reader.take(flags)) {
+        return QVariantMap();
+    }
+
+    if (flags & Wheel) {
+        quint32 revolutions;
+        quint16 time;
+        if (!reader.take(revolutions) || !reader.take(time)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("wheelRevolutions"), revolutions);
+        fields.insert(QStringLiteral("wheelEventTime"), time / 1024.0);
+    }
+
+    if (flags & Crank) {
+        quint16 revolutions, time;
+        if (!reader.take(revolutions) || !reader.take(time)) {
+            return QVariantMap();
+        }
+        fields.insert(QStringLiteral("crankRevolutions"), revolutions);
+        fields.insert(QStringLiteral("crankEventTime"), time / 1024.0);
+    }
+
+    return fields;
+}
+
+QByteArray encode(const QVariantMap& fields)
+{
+    quint8 flags = 0;
+    QByteArray data;
+    data.append(char(0));
+
+    double revolutions, time = 0;
+    if (field(fields, QStringLiteral("wheelRevolutions"), revolutions)) {
+        field(fields, QStringLiteral("wheelEventTime"), time);
+        flags |= Wheel;
+        put<quint32>(data, quint32(qBound(0.0, revolutions, 4294967295.0)));
+        put<quint16>(data, quint16(qint64(std::round(time * 1024))));
+    }
+
+    time = 0;
+    if (field(fields, QStringLiteral("crankRevolutions"), revolutions)) {
+        field(fields, QStringLiteral("crankEventTime"), time);
+        flags |= Crank;
+        put<quint16>(data, quint16(qBound(0.0, revolutions, 65535.0)));
+        put<quint16>(data, quint16(qint64(std::round(time * 1024))));
+    }
+
+    if (flags == 0) {
+        return QByteArray();
+    }
+
+    data[0] = char(flags);
+    return data;
+}
+
+} // namespace CyclingSpeed
+
+/*!
+ * \brief Battery Level 0x2A19: the charge in percent as u8
+ */
+namespace Battery {
+
+bool primary(const char* data, qsizetype size, float& value)
+{
+    Reader reader { data, data + size };
+
+    quint8 level;
+    if (!reader.take(level)) {
+        return false;
+    }
+
+    value = level;
+    return true;
+}
+
+QVariantMap fields(const char* data, qsizetype size)
+{
+    Reader reader { data, data + size };
+
+    quint8 level;
+    if (!reader.take(level)) {
+        return QVariantMap();
+    }
+
+    return QVariantMap { { QStringLiteral("batteryLevel"), level } };
+}
+
+QByteArray encode(const QVariantMap& fields)
+{
+    int level;
+    if (!field(fields, QStringLiteral("batteryLevel"), level)) {
+        return QByteArray();
+    }
+
+    return QByteArray(1, char(qBound(0, level, 100)));
+}
+
+} // namespace Battery
+
+//! \brief The codecs sorted by characteristic
+constexpr BLECodecRegistry::Codec Codecs[] = {
+    { 0x2A19, "Battery Level", "batteryLevel", Battery::primary, Battery::fields, Battery::encode },
+    { 0x2A1C, "Temperature Measurement", "temperature", Temperature::primary, Temperature::fields,
+      Temperature::encode },
+    { 0x2A35, "Blood Pressure Measurement", "systolic", BloodPressure::primary,
+      BloodPressure::fields, BloodPressure::encode },
+    { 0x2A37, "Heart Rate Measurement", "heartRate", HeartRate::primary, HeartRate::fields,
+      HeartRate::encode },
+    { 0x2A53, "RSC Measurement", "speed", RunningSpeed::primary, RunningSpeed::fields,
+      RunningSpeed::encode },
+    { 0x2A5B, "CSC Measurement", "wheelRevolutions", CyclingSpeed::primary, CyclingSpeed::fields,
+      CyclingSpeed::encode },
+};
+
+} // namespace
+
+const BLECodecRegistry::Codec* BLECodecRegistry::find(quint32 characteristic)
+{
+    if (characteristic > 0xFFFF) {
+        return nullptr;
+    }
+
+    const auto it = std::lower_bound(std::begin(Codecs), std::end(Codecs), characteristic,
+                                     [](const Codec& codec, quint32 characteristic) {
+                                         return codec.characteristic < characteristic;
+                                     });
+
+    return it != std::end(Codecs) && it->characteristic == characteristic ? it : nullptr;
+}
+
+bool BLECodecRegistry::primary(quint32 characteristic, const char* data, qsizetype size,
+                               float& value)
+{
+    const Codec* codec = find(characteristic);
+    return codec && codec->primary(data, size, value);
+}
+
+QVariantMap BLECodecRegistry::decode(quint32 characteristic, const char* data, qsizetype size)
+{
+    const Codec* codec = find(characteristic);
+    return codec ? codec->fields(data, size) : QVariantMap();
+}
+
+QByteArray BLECodecRegistry::encode(quint32 characteristic, const QVariant& value)
+{
+    const Codec* codec = find(characteristic);
+    if (!codec) {
+        return QByteArray();
+    }
+
+    if (value.canConvert<QVariantMap>()) {
+        return codec->encode(value.toMap());
+    }
+
+    return codec->encode(QVariantMap { { QString::fromLatin1(codec->primaryField), value } });
+}
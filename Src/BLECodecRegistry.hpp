@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVariant>
+#include <QVariantMap>
+
+/*!
+ * \brief The BLECodecRegistry class holds the codecs of the Bluetooth SIG standard
+ * characteristics, keyed by their 16 bit uuid, so off-the-shelf sensors are read without knowing
+ * their layout:
+ *  - Heart Rate Measurement 0x2A37
+ *  - Temperature Measurement 0x2A1C
+ *  - Blood Pressure Measurement 0x2A35
+ *  - RSC Measurement 0x2A53
+ *  - CSC Measurement 0x2A5B
+ *  - Battery Level 0x2A19
+ *
+ * A value has a main field, eg the heart rate, read on its own without any allocation while
+ * values are received. Every field is read into a map keyed by the field names when the value is
+ * used. A \ref BLEDataService whose characteristic has a codec uses \ref BLEDataService::Standard
+ * unless its data type is set. The codecs are built in, so the registry holds no state and can be
+ * used from any thread
+ */
+class BLECodecRegistry
+{
+public:
+    /*!
+     * \brief The Codec struct converts the values of one standard characteristic
+     */
+    struct Codec
+    {
+        //! \brief characteristic The 16 bit uuid of the characteristic
+        quint16 characteristic;
+
+        //! \brief name The name of the characteristic in the Bluetooth SIG assigned numbers
+        const char* name;
+
+        //! \brief primaryField The name of the main field
+        const char* primaryField;
+
+        //! \brief primary Reads the main field of a value, false if the value is malformed
+        bool (*primary)(const char* data, qsizetype size, float& value);
+
+        //! \brief fields Reads every field of a value, an empty map if the value is malformed
+        QVariantMap (*fields)(const char* data, qsizetype size);
+
+        //! \brief encode Builds a value from its fields, empty if the main field is missing
+        QByteArray (*encode)(const QVariantMap& fields);
+    };
+
+    /*!
+     * \brief find Returns the codec of \a characteristic, null if it has none
+     */
+    static const Codec* find(quint32 characteristic);
+
+    /*!
+     * \brief contains Returns true if \a characteristic has a codec
+     */
+    static bool contains(quint32 characteristic);
+
+    /*!
+     * \brief primary Reads the main field of the value of \a characteristic in \a data
+     * \return False if there is no codec or the value is malformed
+     */
+    static bool primary(quint32 characteristic, const char* data, qsizetype size, float& value);
+
+    /*!
+     * \brief decode Reads every field of the value of \a characteristic in \a data
+     * \return An empty map if there is no codec or the value is malformed
+     */
+    static QVariantMap decode(quint32 characteristic, const char* data, qsizetype size);
+
+    /*!
+     * \brief encode Builds a value of \a characteristic from \a value, a map of its fields or a
+     * number taken as its main field
+     * \return An empty \a QByteArray if there is no codec or \a value misses the main field
+     */
+    static QByteArray encode(quint32 characteristic, const QVariant& value);
+};
+
+
+inline bool BLECodecRegistry::contains(quint32 characteristic)
+{
+    return find(characteristic) != nullptr;
+}
@@ -0,0 +1,94 @@
+#include "BLEDataCodec.hpp"
+#include "BLECodecRegistry.hpp"
+
+#include <QString>
+
+QByteArray BLEDataCodec::encode(BLESample::Type type, const QVariant& value,
+                                quint32 characteristic)
+{
+    QByteArray data;
+
+    switch (type) {
+    case BLESample::Int: { //! This is 16 bit
+        if (!value.canConvert<int>()) {
+            return QByteArray();
+        }
+        data.setNum(static_cast<uint16_t>(value.value<int>()));
+        break;
+    }
+    case BLESample::Float:
+        if (!value.canConvert<float>()) {
+            return QByteArray();
+        }
+        data.setNum(static_cast<float>(value.value<float>()));
+        break;
+    case BLESample::String:
+        if (!value.canConvert<QString>()) {
+            return QByteArray();
+        }
+        data.append(value.value<QString>().toUtf8());
+        break;
+    case BLESample::Standard:
+        data = BLECodecRegistry::encode(characteristic, value);
+        break;
+    }
+
+    return data;
+}
+
+QVariant BLEDataCodec::decode(BLESample::Type type, const QByteArray& bytes,
+                              quint32 characteristic)
+{
+    QVariant newValue;
+
+    bool ok = true;
+
+    switch (type) {
+    case BLESample::Int:
+        newValue = bytes.toShort(&ok);
+        break;
+    case BLESample::Float:
+        newValue = bytes.toFloat(&ok);
+        break;
+    case BLESample::String:
+        newValue = QString(bytes);
+        break;
+    case BLESample::Standard: {
+        const QVariantMap fields
+            = BLECodecRegistry::decode(characteristic, bytes.constData(), bytes.size());
+        ok = !fields.isEmpty();
+        newValue = fields;
+        break;
+    }
+    }
+
+    return ok ? newValue : QVariant();
+}
+
+bool BLEDataCodec::decode(BLESample::Type type, const QByteArray& bytes, BLESample& sample,
+                          quint32 characteristic)
+{
+    if (!sample.setData(bytes)) {
+        return false;
+    }
+
+    bool ok = true;
+    sample.type = type;
+
+    switch (type) {
+    case BLESample::Int:
+        sample.intValue = bytes.toShort(&ok);
+        break;
+    case BLESample::Float:
+        sample.floatValue = bytes.toFloat(&ok);
+        break;
+    case BLESample::String:
+        break;
+    case BLESample::Standard:
+        ok = BLECodecRegistry::primary(characteristic, sample.data, sample.size,
+                                       sample.floatValue);
+        break;
+    }
+
+    return ok;
+}
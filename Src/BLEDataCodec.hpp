@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVariant>
+
+#include "BLESample.hpp"
+
+/*!
+ * \brief The BLEDataCodec class converts values of a \ref BLEDataService to and from the bytes that
+ * are sent over a BLE connection. It holds no state so it can be used from any thread
+ */
+class BLEDataCodec
+{
+public:
+    /*!
+     * \brief encode Converts \a value to bytes based on \a type. A \ref BLESample::Standard value
+     * is built by the codec of \a characteristic in \ref BLECodecRegistry
+     * \return An empty \a QByteArray if \a value can't be converted to \a type
+     */
+    static QByteArray encode(BLESample::Type type, const QVariant& value,
+                             quint32 characteristic = 0);
+
+    /*!
+     * \brief decode Converts \a bytes to a value based on \a type, a \ref BLESample::Standard
+     * value is read into a map of the fields of \a characteristic
+     * \return An invalid \a QVariant if \a bytes is not a valid \a type
+     */
+    static QVariant decode(BLESample::Type type, const QByteArray& bytes,
+                           quint32 characteristic = 0);
+
+    /*!
+     * \brief decode Decodes \a bytes into \a sample in place. The sample type is set to \a type and
+     * the raw bytes are kept in \ref BLESample::data. Only the main field of a
+     * \ref BLESample::Standard value is read, into \ref BLESample::floatValue, the rest is read
+     * from the raw bytes when the sample is used
+     * \return False if \a bytes is not a valid \a type or is too long to fit in a sample
+     */
+    static bool decode(BLESample::Type type, const QByteArray& bytes, BLESample& sample,
+                       quint32 characteristic = 0);
+};
@@ -1,87 +1,362 @@
 #include "BLEDataService.hpp"
+#include "BLECodecRegistry.hpp"
+#include "BLEDataCodec.hpp"
+#include "BLEExportStream.hpp"
+#include "BLESampleBus.hpp"
+#include "BLESessionRecorder.hpp"
+#include "BLESharedSamples.hpp"
+#include "BLETrace.hpp"
+#include "BLETransport.hpp"
 
 #include <QtEndian>
+#include <QMetaMethod>
+#include <QThread>
 #include <QLowEnergyCharacteristicData>
 #include <QLowEnergyDescriptorData>
 #include <QLowEnergyServiceData>
 
+#include <cstring>
+
+static_assert(int(BLEDataService::Int) == BLESample::Int
+                  && int(BLEDataService::Float) == BLESample::Float
+                  && int(BLEDataService::String) == BLESample::String
+                  && int(BLEDataService::Standard) == BLESample::Standard,
+              "BLEDataService::DataType must match BLESample::Type");
+
+static_assert(int(BLEDataService::UrgentPriority) == BLEScheduler::UrgentPriority
+                  && int(BLEDataService::HighPriority) == BLEScheduler::HighPriority
+                  && int(BLEDataService::NormalPriority) == BLEScheduler::NormalPriority
+                  && int(BLEDataService::BulkPriority) == BLEScheduler::BulkPriority,
+              "BLEDataService::Priority must match BLEScheduler::Priority");
+
+static_assert(int(BLEDataService::DeltaEncoding) == 1 && int(BLEDataService::BulkPriority) == 3,
+              "BLEGattSchema::valid() must accept every BLEDataService::Encoding and Priority");
+
 BLEDataService::BLEDataService(QObject *parent)
     : QObject{ parent }
-    , mService { nullptr }
+    , mTransport { nullptr }
     , mValueLength { 2 }
     , mDataType { DataType::Int }
+    , mDataTypeExplicit { false }
     , mValue { uint16_t(0) }
+    , mDrainScheduled { false }
+    , mDroppedSamples { 0 }
+    , mSampleBus { &BLESampleBus::instance() }
+    , mSharedSamples { nullptr }
+    , mExportStream { nullptr }
+    , mIndicate { false }
+    , mBroadcast { false }
+    , mSubscribers { 0 }
+    , mStale { false }
+    , mMetrics { nullptr }
+    , mChannel { nullptr }
+    , mEncoding { Encoding::TextEncoding }
+    , mDeltaEncoded { false }
+    , mKeyFrameRequested { true }
+    , mReceivedValid { false }
+    , mAppliedValid { false }
+    , mValueStale { false }
+    , mPriority { Priority::NormalPriority }
+    , mDeadline { 0 }
+    , mAdaptiveRate { false }
+    , mSendRate { 0 }
+    , mStamped { false }
+    , mStampApplied { false }
+    , mStampSequence { 0 }
+    , mAcknowledged { BLEDeltaCodec::NoFrame }
 {}
 
-QLowEnergyService* BLEDataService::setup(QLowEnergyController& leController)
+BLEDataService::~BLEDataService()
 {
-    if (mServiceUuid.isNull() || mCharacterUuid.isNull()) {
-        return nullptr;
+    disconnect(mServiceReady);
+}
+
+BLEDataService::BLEDataService(const BLEGattSchema::Characteristic& schema, QObject *parent)
+    : BLEDataService(parent)
+{
+    mServiceUuid = QBluetoothUuid(schema.service);
+    mCharacterUuid = QBluetoothUuid(schema.characteristic);
+    mDataType = DataType(schema.type);
+    mDataTypeExplicit = true;
+    mValue = defaultValue(mDataType);
+    mValueLength = schema.valueLength;
+    mIndicate = schema.indicate;
+    mBroadcast = schema.broadcast;
+    mEncoding = Encoding(schema.encoding);
+    mEncoder.setKeyFrameInterval(schema.keyFrameInterval);
+    mStamped = schema.stamped;
+    mPriority = Priority(schema.priority);
+    mDeadline = schema.deadline;
+    mAdaptiveRate = schema.adaptiveRate;
+}
+
+QLowEnergyServiceData BLEDataService::buildServiceData(const QBluetoothUuid& service,
+                                                       const QBluetoothUuid& characteristic,
+                                                       quint8 valueLength,
+                                                       bool indicate)
+{
+    //! First set up characteristic data
+    QLowEnergyCharacteristicData charData;
+    charData.setUuid(characteristic);
+    charData.setValue(QByteArray(valueLength, 0));
+    QLowEnergyCharacteristic::PropertyTypes properties = QLowEnergyCharacteristic::Read
+                                                         | QLowEnergyCharacteristic::Write
+                                                         | QLowEnergyCharacteristic::Notify;
+    if (indicate) {
+        properties |= QLowEnergyCharacteristic::Indicate;
     }
+    charData.setProperties(properties);
 
-    if (leController.role() == QLowEnergyController::PeripheralRole) {
-        //! This service is used in a Peripheral
+    //! Add Descriptor data, nobody is subscribed until a central writes it
+    QLowEnergyDescriptorData des(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration,
+                                 QLowEnergyCharacteristic::CCCDDisable);
 
-        //! First set up characteristic data
-        QLowEnergyCharacteristicData charData;
-        charData.setUuid(mCharacterUuid);
-        charData.setValue(QByteArray(mValueLength, 0));
-        charData.setProperties(QLowEnergyCharacteristic::Read
-                               | QLowEnergyCharacteristic::Write
-                               | QLowEnergyCharacteristic::Notify);
+    charData.addDescriptor(des);
 
-        //! Add Descriptor data
-        QLowEnergyDescriptorData des(
-            QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration,
-            QLowEnergyCharacteristic::CCCDEnableNotification);
+    //! Create a service data
+    QLowEnergyServiceData serviceData;
+    serviceData.setType(QLowEnergyServiceData::ServiceTypePrimary);
+    serviceData.setUuid(service);
+    serviceData.addCharacteristic(charData);
+    return serviceData;
+}
 
-        charData.addDescriptor(des);
+void BLEDataService::setServiceData(const QLowEnergyServiceData& serviceData)
+{
+    mServiceData = serviceData;
+}
 
-        //! Create a service data
-        QLowEnergyServiceData serviceData;
-        serviceData.setType(QLowEnergyServiceData::ServiceTypePrimary);
-        serviceData.setUuid(mServiceUuid);
-        serviceData.addCharacteristic(charData);
+bool BLEDataService::setup(BLETransport& transport)
+{
+    QB_TRACE_SCOPE("setup");
 
-        mService = leController.addService(serviceData);
+    if (mServiceUuid.isNull() || mCharacterUuid.isNull()) {
+        return false;
+    }
+
+    if (transport.role() == QLowEnergyController::PeripheralRole) {
+        //! This service is used in a Peripheral
+        const QLowEnergyServiceData serviceData
+            = mServiceData.isValid()
+                  ? mServiceData
+                  : buildServiceData(mServiceUuid, mCharacterUuid, mValueLength, mIndicate);
+
+        if (!transport.addService(serviceData)) {
+            return false;
+        }
+
+        if (mPriority != Priority::NormalPriority || mDeadline > 0) {
+            transport.setPriority(mCharacterUuid, BLEScheduler::Priority(mPriority), mDeadline);
+        }
+
+        transport.setRateControlled(mCharacterUuid, mAdaptiveRate);
     } else {
-        //! This service is used in a Central
-        mService = leController.createServiceObject(mServiceUuid, this);
-        if (mService) {
-            connect(mService, &QLowEnergyService::stateChanged, this,
-                    &BLEDataService::serviceStateChanged);
+        //! This service is used in a Central, enable notifications once the details are known
+        disconnect(mServiceReady);
+        mServiceReady = connect(&transport, &BLETransport::serviceReady, &transport,
+                                [this, &transport](const QBluetoothUuid& uuid) {
+                                    if (uuid == mServiceUuid) {
+                                        transport.subscribe(mServiceUuid, mCharacterUuid,
+                                                            mIndicate);
+                                    }
+                                });
+
+        if (!transport.openService(mServiceUuid)) {
+            return false;
         }
     }
 
-    if (mService) {
-        connect(mService, &QLowEnergyService::characteristicChanged, this,
-                &BLEDataService::onValueWritten);
-
-        return mService;
+    if (mMetrics) {
+        mChannel = mMetrics->channel(mServiceUuid.toUInt32(), mCharacterUuid.toUInt32());
     }
 
-    return nullptr;
+    //! Both ends start over from a key frame on a new transport
+    mDeltaEncoded.store(mEncoding == Encoding::DeltaEncoding && mDataType == DataType::Int,
+                        std::memory_order_relaxed);
+    mDecoder.reset();
+    mReceivedValid = false;
+    mAcknowledged.store(BLEDeltaCodec::NoFrame, std::memory_order_relaxed);
+    mKeyFrameRequested.store(true, std::memory_order_relaxed);
+
+    mStampApplied.store(mStamped, std::memory_order_relaxed);
+    mStampTracker.reset();
+
+    //! Published last, the GUI thread writes through the transport once it's set
+    mTransport.store(&transport, std::memory_order_release);
+    return true;
+}
+
+void BLEDataService::release()
+{
+    disconnect(mServiceReady);
+    mTransport.store(nullptr, std::memory_order_release);
+    setSendRate(0);
 }
 
 void BLEDataService::writeValue(const QVariant& value)
 {
-    if (!isValid() || !value.isValid()) {
+    BLETransport* transport = mTransport.load(std::memory_order_acquire);
+    if (!isValid() || !transport || !value.isValid()) {
         return;
     }
 
-    QByteArray data = valueToByteArray(value);
+    //! A peripheral doesn't notify a value that no central is subscribed to, it only keeps it
+    //! for the centrals that read it
+    if (transport->role() == QLowEnergyController::PeripheralRole && subscribers() == 0) {
+        mStale.store(true, std::memory_order_relaxed);
+        storeValue(value);
+        setValue(value);
+        return;
+    }
+
+    QByteArray data;
+    if (isDeltaEncoded()) {
+        if (!value.canConvert<int>()) {
+            return;
+        }
+
+        if (mKeyFrameRequested.exchange(false, std::memory_order_relaxed)) {
+            mEncoder.requestKeyFrame();
+        }
+
+        //! Indications are coalesced while one is in flight, so deltas refer to a confirmed one.
+        //! A transport that doesn't confirm writes only echoes them, the deltas refer to the last
+        //! frame then and the periodic key frames resynchronize a central that missed one
+        const bool confirmed = mIndicate
+                               && transport->role() == QLowEnergyController::PeripheralRole
+                               && transport->confirmsWrites();
+        data = mEncoder.encode(qint16(value.toInt()),
+                               confirmed ? mAcknowledged.load(std::memory_order_relaxed)
+                                         : BLEDeltaCodec::LastFrame);
+    } else {
+        data = BLEDataCodec::encode(sampleType(), value, mCharacterUuid.toUInt32());
+    }
+
     if (data.isEmpty()) {
         return;
     }
 
-    QLowEnergyCharacteristic charac = mService->characteristic(mCharacterUuid);
-    if (!charac.isValid()) {
+    if (!sendData(data)) {
+        //! The other end never sees this frame, so the next one must not refer to it
+        mEncoder.requestKeyFrame();
         return;
     }
-    mService->writeCharacteristic(charac, data);
     setValue(value);
 }
 
+void BLEDataService::writeValues(const QVariantList& values)
+{
+    BLETransport* transport = mTransport.load(std::memory_order_acquire);
+    if (!isValid() || !transport || values.isEmpty()) {
+        return;
+    }
+
+    if (!isDeltaEncoded()) {
+        for (const QVariant& value : values) {
+            writeValue(value);
+        }
+        return;
+    }
+
+    if (transport->role() == QLowEnergyController::PeripheralRole && subscribers() == 0) {
+        mStale.store(true, std::memory_order_relaxed);
+        storeValue(values.constLast());
+        setValue(values.constLast());
+        return;
+    }
+
+    BLEDeltaCodec::Values numbers;
+    for (const QVariant& value : values) {
+        if (!value.canConvert<int>()) {
+            qWarning() << "BLEDataService: Can't send" << value << "as a number";
+            return;
+        }
+        numbers.append(qint16(value.toInt()));
+    }
+
+    qsizetype offset = 0;
+    while (offset < numbers.size()) {
+        int encoded = 0;
+        const QByteArray frame = mEncoder.encodeBatch(numbers.constData() + offset,
+                                                      int(numbers.size() - offset), &encoded);
+        if (!sendData(frame)) {
+            mEncoder.requestKeyFrame();
+            return;
+        }
+        offset += encoded;
+    }
+
+    setValue(values.constLast());
+}
+
+bool BLEDataService::sendData(const QByteArray& payload)
+{
+    BLETransport* transport = mTransport.load(std::memory_order_acquire);
+    if (!transport) {
+        return false;
+    }
+
+    const QByteArray data = mStampApplied.load(std::memory_order_relaxed)
+                                ? BLEStamp::stamp(payload, mStampSequence++)
+                                : payload;
+
+    if (mMetrics) {
+        mMetrics->startWrite(mChannel, data.size());
+    }
+
+    if (transport->thread() != QThread::currentThread()) {
+        //! The transport lives in the I/O thread, write from there
+        QMetaObject::invokeMethod(transport, [transport, service = mServiceUuid,
+                                              character = mCharacterUuid, data]() {
+            transport->sendValue(service, character, data);
+        });
+        return true;
+    }
+
+    return transport->sendValue(mServiceUuid, mCharacterUuid, data);
+}
+
+void BLEDataService::storeValue(const QVariant& value)
+{
+    BLETransport* transport = mTransport.load(std::memory_order_acquire);
+    if (!transport) {
+        return;
+    }
+
+    QByteArray payload;
+    if (isDeltaEncoded()) {
+        if (!value.canConvert<int>()) {
+            return;
+        }
+
+        //! A central that reads gets a key frame, which decodes without any earlier frame
+        mEncoder.requestKeyFrame();
+        payload = mEncoder.encode(qint16(value.toInt()));
+    } else {
+        payload = BLEDataCodec::encode(sampleType(), value, mCharacterUuid.toUInt32());
+    }
+
+    if (payload.isEmpty()) {
+        return;
+    }
+
+    const QByteArray data = mStampApplied.load(std::memory_order_relaxed)
+                                ? BLEStamp::stamp(payload, mStampSequence++)
+                                : payload;
+
+    //! Written to the characteristic directly, without pacing, scheduling or rate control since
+    //! nothing is notified
+    if (transport->thread() != QThread::currentThread()) {
+        QMetaObject::invokeMethod(transport, [transport, service = mServiceUuid,
+                                              character = mCharacterUuid, data]() {
+            transport->writeCharacteristic(service, character, data);
+        });
+        return;
+    }
+
+    transport->writeCharacteristic(mServiceUuid, mCharacterUuid, data);
+}
+
 void BLEDataService::setValue(QVariant value)
 {
     if (!value.isValid()) {
@@ -89,6 +364,8 @@ void BLEDataService::setValue(QVariant value)
     }
 
     mValue = value;
+    mAppliedValid = false;
+    mValueStale = false;
     emit valueChanged();
 }
 
@@ -98,17 +375,21 @@ void BLEDataService::setValue(QByteArray byteArray)
         return;
     }
 
-    QVariant newValue = byteArrayToValue(byteArray);
-    if (mValue == newValue || !newValue.isValid()) {
+    QVariant newValue = BLEDataCodec::decode(sampleType(), byteArray, mCharacterUuid.toUInt32());
+    if (value() == newValue || !newValue.isValid()) {
         return;
     }
 
     mValue = newValue;
+    mAppliedValid = false;
+    mValueStale = false;
     emit valueChanged();
 }
 
 void BLEDataService::setDataType(DataType dataType)
 {
+    mDataTypeExplicit = true;
+
     if (mDataType == dataType) {
         return;
     }
@@ -117,17 +398,23 @@ void BLEDataService::setDataType(DataType dataType)
     emit dataTypeChanged();
 
     //! When data type is changed mValue should also be changed to a QVariant with this type
-    switch (mDataType) {
+    setValue(defaultValue(mDataType));
+}
+
+QVariant BLEDataService::defaultValue(DataType dataType)
+{
+    switch (dataType) {
     case DataType::Int:
-        setValue(QVariant::fromValue<uint16_t>(0));
-        break;
+        return QVariant::fromValue<uint16_t>(0);
     case DataType::Float:
-        setValue(QVariant::fromValue<float>(0));
-        break;
+        return QVariant::fromValue<float>(0);
     case DataType::String:
-        setValue(QVariant::fromValue<QString>(""));
-        break;
+        return QVariant::fromValue<QString>("");
+    case DataType::Standard:
+        return QVariantMap();
     }
+
+    return QVariant();
 }
 
 uint32_t BLEDataService::serviceUuid() const
@@ -144,6 +431,7 @@ void BLEDataService::setServiceUuid(uint32_t newServiceUuid)
     }
 
     mServiceUuid = uuid;
+    mServiceData = QLowEnergyServiceData();
     emit serviceUuidChanged();
 }
 
@@ -161,7 +449,19 @@ void BLEDataService::setCharacterUuid(uint32_t newCharacterUuid)
     }
 
     mCharacterUuid = uuid;
+    mServiceData = QLowEnergyServiceData();
     emit characterUuidChanged();
+
+    if (mDataTypeExplicit) {
+        return;
+    }
+
+    //! Off-the-shelf sensors are read by the codec of their characteristic unless told otherwise
+    const bool standard = BLECodecRegistry::contains(newCharacterUuid);
+    if (standard != (mDataType == DataType::Standard)) {
+        setDataType(standard ? DataType::Standard : DataType::Int);
+        mDataTypeExplicit = false;
+    }
 }
 
 quint8 BLEDataService::valueLength() const
@@ -181,17 +481,219 @@ void BLEDataService::setValueLength(quint8 newValueLength)
     }
 
     mValueLength = newValueLength;
+    mServiceData = QLowEnergyServiceData();
     emit valueLengthChanged();
 }
 
-void BLEDataService::onValueWritten(const QLowEnergyCharacteristic& characteristic,
-                                    const QByteArray& value)
+void BLEDataService::setIndicate(bool indicate)
+{
+    if (mIndicate == indicate) {
+        return;
+    }
+
+    mIndicate = indicate;
+    mServiceData = QLowEnergyServiceData();
+    emit indicateChanged();
+}
+
+void BLEDataService::setBroadcast(bool broadcast)
+{
+    if (mBroadcast == broadcast) {
+        return;
+    }
+
+    mBroadcast = broadcast;
+    emit broadcastChanged();
+}
+
+void BLEDataService::setEncoding(Encoding encoding)
+{
+    if (mEncoding == encoding) {
+        return;
+    }
+
+    mEncoding = encoding;
+    emit encodingChanged();
+}
+
+void BLEDataService::setKeyFrameInterval(int interval)
+{
+    if (mEncoder.keyFrameInterval() == interval) {
+        return;
+    }
+
+    if (interval < 1) {
+        qWarning() << "Key frame interval must be greater than 0";
+        return;
+    }
+
+    mEncoder.setKeyFrameInterval(interval);
+    emit keyFrameIntervalChanged();
+}
+
+void BLEDataService::setPriority(Priority priority)
+{
+    if (mPriority == priority) {
+        return;
+    }
+
+    mPriority = priority;
+    emit priorityChanged();
+}
+
+void BLEDataService::setDeadline(int deadline)
 {
-    if (characteristic.uuid() != mCharacterUuid) {
+    if (mDeadline == deadline) {
         return;
     }
 
-    QVariant newValue = byteArrayToValue(value);
+    if (deadline < 0) {
+        qWarning() << "Deadline can't be negative";
+        return;
+    }
+
+    mDeadline = deadline;
+    emit deadlineChanged();
+}
+
+void BLEDataService::setAdaptiveRate(bool adaptive)
+{
+    if (mAdaptiveRate == adaptive) {
+        return;
+    }
+
+    mAdaptiveRate = adaptive;
+    emit adaptiveRateChanged();
+}
+
+void BLEDataService::setSendRate(qreal rate)
+{
+    if (mSendRate.exchange(rate, std::memory_order_relaxed) == rate) {
+        return;
+    }
+
+    emit sendRateChanged();
+}
+
+void BLEDataService::setStamped(bool stamped)
+{
+    if (mStamped == stamped) {
+        return;
+    }
+
+    mStamped = stamped;
+    emit stampedChanged();
+}
+
+void BLEDataService::setSubscribers(int subscribers)
+{
+    const int previous = mSubscribers.exchange(subscribers, std::memory_order_relaxed);
+    if (previous == subscribers) {
+        return;
+    }
+
+    //! A new central has no reference for the deltas yet
+    if (subscribers > previous) {
+        mKeyFrameRequested.store(true, std::memory_order_relaxed);
+    }
+
+    emit subscribersChanged();
+}
+
+void BLEDataService::acknowledgeValue(const QByteArray& value)
+{
+    if (!isDeltaEncoded() || !mIndicate) {
+        return;
+    }
+
+    const int sequence = BLEDeltaCodec::sequence(
+        mStampApplied.load(std::memory_order_relaxed) ? BLEStamp::payload(value) : value);
+    if (sequence >= 0) {
+        mAcknowledged.store(sequence, std::memory_order_relaxed);
+    }
+}
+
+void BLEDataService::sendStaleValue()
+{
+    if (mStale.exchange(false, std::memory_order_relaxed)) {
+        writeValue(value());
+    }
+}
+
+void BLEDataService::setSampleBus(BLESampleBus* bus)
+{
+    mSampleBus.store(bus, std::memory_order_release);
+}
+
+void BLEDataService::setSharedSamples(BLESharedSamples* samples)
+{
+    mSharedSamples.store(samples, std::memory_order_release);
+}
+
+void BLEDataService::setExportStream(BLEExportStream* stream)
+{
+    mExportStream.store(stream, std::memory_order_release);
+}
+
+void BLEDataService::setMetrics(BLEMetrics* metrics)
+{
+    mMetrics = metrics;
+    mChannel = nullptr;
+}
+
+void BLEDataService::receiveValue(const QByteArray& value)
+{
+    if (mMetrics) {
+        mMetrics->countNotification(mChannel, value.size());
+    }
+
+    BLESessionRecorder::recordNotification(mServiceUuid.toUInt32(), mCharacterUuid.toUInt32(),
+                                           value);
+
+    if (!mStampApplied.load(std::memory_order_relaxed)) {
+        receivePayload(value);
+        return;
+    }
+
+    quint16 sequence = 0;
+    quint32 sendTime = 0;
+    if (!BLEStamp::read(value, sequence, sendTime)) {
+        qWarning() << "Unstamped value recieved: " << value;
+        return;
+    }
+
+    const BLEStamp::Result result = mStampTracker.track(sequence, sendTime, BLEStamp::clock());
+    if (mMetrics) {
+        mMetrics->countStamp(mChannel, result.lost, result.reordered, result.duplicate,
+                             result.latency >= 0 ? result.latency * 1000 : -1);
+    }
+
+    if (!result.duplicate) {
+        receivePayload(BLEStamp::payload(value));
+    }
+}
+
+void BLEDataService::receivePayload(const QByteArray& value)
+{
+    if (isDeltaEncoded()) {
+        receiveFrame(value);
+    } else if (thread() == QThread::currentThread()) {
+        onValueWritten(value);
+    } else {
+        queueValue(value);
+    }
+}
+
+void BLEDataService::onValueWritten(const QByteArray& value)
+{
+    if (decodeReceived(value)) {
+        publishSample(mReceived);
+        applySample(mReceived);
+        return;
+    }
+
+    //! Values that don't fit in a sample are only delivered through the signals
+    QVariant newValue = BLEDataCodec::decode(sampleType(), value, mCharacterUuid.toUInt32());
     if (!newValue.isValid()) {
         qWarning() << "Invalid value recieved: " << mDataType << value << newValue;
         return;
@@ -201,67 +703,140 @@ void BLEDataService::onValueWritten(const QLowEnergyCharacteristic& characterist
     emit valueUpdated(newValue, QPrivateSignal());
 }
 
-void BLEDataService::serviceStateChanged(QLowEnergyService::ServiceState st)
+void BLEDataService::queueValue(const QByteArray& value)
 {
-    if (st == QLowEnergyService::RemoteServiceDiscovered) {
-        //! Enable notification for the descriptor of the service characteristics
-        QLowEnergyCharacteristic charData = mService->characteristic(mCharacterUuid);
-        if (charData.isValid()) {
-            QLowEnergyDescriptor srvDescriptor = charData.descriptor(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration);
-            if (srvDescriptor.isValid()) {
-                mService->writeDescriptor(srvDescriptor,
-                                          QLowEnergyCharacteristic::CCCDEnableNotification);
-            }
-        }
+    if (!decodeReceived(value)) {
+        qWarning() << "Invalid value recieved: " << mDataType << value;
+        return;
     }
+
+    publishSample(mReceived);
+    queueSample(mReceived);
 }
 
-QByteArray BLEDataService::valueToByteArray(const QVariant& value)
+void BLEDataService::receiveFrame(const QByteArray& frame)
 {
-    QByteArray data;
+    const qint64 start = mMetrics && mMetrics->enabled() ? BLEMetrics::now() : 0;
 
-    switch (mDataType) {
-    case DataType::Int: { //! This is 16 bit
-        if (!value.canConvert<int>()) {
-            return QByteArray();
-        }
-        data.setNum(static_cast<uint16_t>(value.value<int>()));
-        break;
+    BLEDeltaCodec::Values values;
+    if (!mDecoder.decode(frame, values)) {
+        //! The reference of a delta was lost, the next key frame resynchronizes the decoder
+        return;
     }
-    case DataType::Float:
-        if (!value.canConvert<float>()) {
-            return QByteArray();
+
+    if (start) {
+        mMetrics->record(BLEMetrics::DecodeTime, quint64(BLEMetrics::now() - start));
+    }
+
+    //! The values of a batch share the frame as their raw payload
+    BLESample sample;
+    sample.setData(frame);
+    sample.type = BLESample::Int;
+    sample.timestamp = BLESample::now();
+    sample.serviceUuid = mServiceUuid.toUInt32();
+    sample.characterUuid = mCharacterUuid.toUInt32();
+
+    const bool sameThread = thread() == QThread::currentThread();
+    for (qint16 value : std::as_const(values)) {
+        sample.intValue = value;
+        publishSample(sample);
+
+        if (sameThread) {
+            applySample(sample);
+        } else {
+            queueSample(sample);
         }
-        data.setNum(static_cast<float>(value.value<float>()));
-        break;
-    case DataType::String:
-        if (!value.canConvert<QString>()) {
-            return QByteArray();
+    }
+}
+
+void BLEDataService::queueSample(const BLESample& sample)
+{
+    if (!mSamples.push(sample)) {
+        mDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+        if (mMetrics) {
+            mMetrics->increment(BLEMetrics::DroppedSamples);
         }
-        data.append(value.value<QString>().toUtf8());
-        break;
+    } else if (mMetrics) {
+        mMetrics->record(BLEMetrics::QueueDepth, mSamples.size());
     }
 
-    return data;
+    //! Only one drain is queued at a time no matter how many samples are waiting
+    if (!mDrainScheduled.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, &BLEDataService::drainSamples, Qt::QueuedConnection);
+    }
 }
 
-QVariant BLEDataService::byteArrayToValue(const QByteArray& byteArray)
+bool BLEDataService::decodeReceived(const QByteArray& value)
 {
-    QVariant newValue;
+    //! Sensors often repeat their value, there is nothing new to decode then
+    if (mReceivedValid && mReceived.type == sampleType() && mReceived.size == value.size()
+        && std::memcmp(mReceived.data, value.constData(), mReceived.size) == 0) {
+        mReceived.timestamp = BLESample::now();
+        return true;
+    }
 
-    bool ok = true;
+    mReceivedValid = decodeSample(value, mReceived);
+    return mReceivedValid;
+}
 
-    switch (mDataType) {
-    case DataType::Int:
-        newValue = byteArray.toShort(&ok);
-        break;
-    case DataType::Float:
-        newValue = byteArray.toFloat(&ok);
-        break;
-    case DataType::String:
-        newValue = QString(byteArray);
-        break;
+void BLEDataService::applySample(const BLESample& sample)
+{
+    if (!mAppliedValid || !sample.samePayload(mApplied)) {
+        mApplied = sample;
+        mAppliedValid = true;
+
+        //! The value is built once something reads it, ie a QML binding notified below
+        mValueStale = true;
+        emit valueChanged();
+    }
+
+    static const QMetaMethod updatedSignal
+        = QMetaMethod::fromSignal(&BLEDataService::valueUpdated);
+    if (isSignalConnected(updatedSignal)) {
+        emit valueUpdated(value(), QPrivateSignal());
+    }
+}
+
+bool BLEDataService::decodeSample(const QByteArray& value, BLESample& sample) const
+{
+    const qint64 start = mMetrics && mMetrics->enabled() ? BLEMetrics::now() : 0;
+
+    if (!BLEDataCodec::decode(sampleType(), value, sample, mCharacterUuid.toUInt32())) {
+        return false;
+    }
+
+    if (start) {
+        mMetrics->record(BLEMetrics::DecodeTime, quint64(BLEMetrics::now() - start));
+    }
+
+    sample.timestamp = BLESample::now();
+    sample.serviceUuid = mServiceUuid.toUInt32();
+    sample.characterUuid = mCharacterUuid.toUInt32();
+    return true;
+}
+
+void BLEDataService::publishSample(const BLESample& sample)
+{
+    if (BLESampleBus* bus = mSampleBus.load(std::memory_order_acquire)) {
+        bus->publish(sample);
     }
 
-    return ok ? newValue : QVariant();
+    if (BLESharedSamples* samples = mSharedSamples.load(std::memory_order_acquire)) {
+        samples->publish(sample);
+    }
+
+    if (BLEExportStream* stream = mExportStream.load(std::memory_order_acquire)) {
+        stream->publish(sample);
+    }
+}
+
+void BLEDataService::drainSamples()
+{
+    QB_TRACE_SCOPE("drainSamples");
+    mDrainScheduled.store(false, std::memory_order_release);
+
+    BLESample sample;
+    while (mSamples.pop(sample)) {
+        applySample(sample);
+    }
 }
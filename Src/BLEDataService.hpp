@@ -1,10 +1,23 @@
 #pragma once
 
 #include <QObject>
-#include <QQmlEngine>
 #include <QBluetoothUuid>
 #include <QLowEnergyController>
-#include <QLowEnergyService>
+#include <QLowEnergyServiceData>
+
+#include <atomic>
+
+#include "BLEDeltaCodec.hpp"
+#include "BLEGattSchema.hpp"
+#include "BLEMetrics.hpp"
+#include "BLESample.hpp"
+#include "BLEStamp.hpp"
+#include "SPSCQueue.hpp"
+
+class BLEExportStream;
+class BLESampleBus;
+class BLESharedSamples;
+class BLETransport;
 
 /*!
  * \brief The BLEDataService class describes a service in a BLE connection that can be read or write
@@ -12,13 +25,25 @@
 class BLEDataService : public QObject
 {
     Q_OBJECT
-    QML_ELEMENT
+
+    friend class BLERole;
+    friend class BLEPeripheral;
 
     Q_PROPERTY(QVariant value READ value NOTIFY valueChanged)
     Q_PROPERTY(quint8 valueLength READ valueLength WRITE setValueLength NOTIFY valueLengthChanged FINAL)
     Q_PROPERTY(DataType dataType READ dataType WRITE setDataType NOTIFY dataTypeChanged)
     Q_PROPERTY(uint32_t serviceUuid READ serviceUuid WRITE setServiceUuid NOTIFY serviceUuidChanged FINAL)
     Q_PROPERTY(uint32_t characterUuid READ characterUuid WRITE setCharacterUuid NOTIFY characterUuidChanged FINAL)
+    Q_PROPERTY(bool indicate READ indicate WRITE setIndicate NOTIFY indicateChanged FINAL)
+    Q_PROPERTY(int subscribers READ subscribers NOTIFY subscribersChanged FINAL)
+    Q_PROPERTY(bool broadcast READ broadcast WRITE setBroadcast NOTIFY broadcastChanged FINAL)
+    Q_PROPERTY(Encoding encoding READ encoding WRITE setEncoding NOTIFY encodingChanged FINAL)
+    Q_PROPERTY(int keyFrameInterval READ keyFrameInterval WRITE setKeyFrameInterval NOTIFY keyFrameIntervalChanged FINAL)
+    Q_PROPERTY(bool stamped READ stamped WRITE setStamped NOTIFY stampedChanged FINAL)
+    Q_PROPERTY(Priority priority READ priority WRITE setPriority NOTIFY priorityChanged FINAL)
+    Q_PROPERTY(int deadline READ deadline WRITE setDeadline NOTIFY deadlineChanged FINAL)
+    Q_PROPERTY(bool adaptiveRate READ adaptiveRate WRITE setAdaptiveRate NOTIFY adaptiveRateChanged FINAL)
+    Q_PROPERTY(qreal sendRate READ sendRate NOTIFY sendRateChanged FINAL)
 
 public:
     /*!
@@ -27,12 +52,60 @@ public:
     enum DataType {
         Int,    //! 16 bit number
         Float,
-        String
+        String,
+        Standard //! A Bluetooth SIG standard characteristic read by its codec in
+                 //! \ref BLECodecRegistry, the value is a map of its fields
     };
     Q_ENUM(DataType)
 
+    /*!
+     * \brief The Encoding enum determines how values are sent, both ends must use the same
+     */
+    enum Encoding {
+        TextEncoding = 0,   //! Every value is sent in full as text
+        DeltaEncoding,      //! \ref Int values are sent as differences to a previous value with
+                            //! periodic key frames, see \ref BLEDeltaCodec. Other types are still
+                            //! sent as text
+    };
+    Q_ENUM(Encoding)
+
+    /*!
+     * \brief The Priority enum is the class of the values a peripheral sends, see
+     * \ref BLEScheduler
+     */
+    enum Priority {
+        UrgentPriority = 0, //! Alarms, sent in the next connection event
+        HighPriority,
+        NormalPriority,
+        BulkPriority,       //! Telemetry that may wait up to a second
+    };
+    Q_ENUM(Priority)
+
     explicit BLEDataService(QObject *parent = nullptr);
 
+    /*!
+     * \brief BLEDataService Creates a service with the properties of \a schema, used by the code
+     * generated from a schema file. No signal is emitted for them
+     */
+    explicit BLEDataService(const BLEGattSchema::Characteristic& schema, QObject *parent = nullptr);
+    ~BLEDataService() override;
+
+    /*!
+     * \brief buildServiceData Builds the \a QLowEnergyServiceData a peripheral adds for a service
+     * with these properties
+     */
+    static QLowEnergyServiceData buildServiceData(const QBluetoothUuid& service,
+                                                  const QBluetoothUuid& characteristic,
+                                                  quint8 valueLength,
+                                                  bool indicate);
+
+    /*!
+     * \brief setServiceData Makes \a serviceData the service a peripheral adds in \ref setup()
+     * instead of building it each time. It's dropped once a property it's built from changes
+     * \param serviceData
+     */
+    void setServiceData(const QLowEnergyServiceData& serviceData);
+
     /*!
      * \brief isValid
      * \return
@@ -40,10 +113,18 @@ public:
     bool isValid() const;
 
     /*!
-     * \brief setup Set up this \ref BLEDataService so it can be used
-     * \return The \a QLowEnergyService of this
+     * \brief setup Set up this \ref BLEDataService on \a transport so it can be used. For a
+     * peripheral this adds the service, for a central it opens the remote service and enables
+     * notifications. This must be called on the thread of \a transport
+     * \return True if the service is set up
+     */
+    bool setup(BLETransport& transport);
+
+    /*!
+     * \brief release Detaches this \ref BLEDataService from its transport, called before the
+     * transport is deleted
      */
-    QLowEnergyService* setup(QLowEnergyController& leController);
+    void release();
 
     /*!
      * \brief writeValue Send the value to the other end of connection
@@ -52,7 +133,15 @@ public:
     Q_INVOKABLE void writeValue(const QVariant& value);
 
     /*!
-     * \brief value Returns the current value
+     * \brief writeValues Sends \a values in order. With \ref DeltaEncoding they are packed in as
+     * few batch frames as possible, otherwise each is sent like \ref writeValue()
+     * \param values
+     */
+    Q_INVOKABLE void writeValues(const QVariantList& values);
+
+    /*!
+     * \brief value Returns the current value. A received value is only converted to a
+     * \a QVariant when it is read
      * \return
      */
     QVariant value() const;
@@ -79,6 +168,8 @@ public:
     /*!
      * \brief setDataType
      * \param dataType
+     * \note Until it's set, \ref Standard is used for a characteristic with a codec in
+     * \ref BLECodecRegistry
      */
     void setDataType(DataType dataType);
 
@@ -123,36 +214,305 @@ public:
      */
     void setValueLength(quint8 newValueLength);
 
+    /*!
+     * \brief indicate Getter for indicate
+     * \return
+     */
+    bool indicate() const;
+    /*!
+     * \brief setIndicate When true values are sent as indications, which the other end confirms,
+     * instead of notifications. A peripheral then waits for the confirmation of a value before
+     * sending the next one and only sends the latest value written meanwhile, if its transport
+     * \ref BLETransport::confirmsWrites(), ie on the loopback and stream backends but not on the Qt
+     * backend. A central subscribes for indications
+     * \note Only applied on the next \ref setup()
+     * \param indicate
+     */
+    void setIndicate(bool indicate);
+
+    /*!
+     * \brief broadcast Getter for broadcast
+     * \return
+     */
+    bool broadcast() const;
+    /*!
+     * \brief setBroadcast When true a \ref BLEPeripheral also puts the value in its advertisement
+     * so it can be observed without a connection, see \ref BluetoothDiscovery::observe
+     * \param broadcast
+     */
+    void setBroadcast(bool broadcast);
+
+    /*!
+     * \brief encoding Getter for encoding
+     * \return
+     */
+    Encoding encoding() const;
+    /*!
+     * \brief setEncoding Sets how values are sent and decoded
+     * \note Only applied on the next \ref setup()
+     * \param encoding
+     */
+    void setEncoding(Encoding encoding);
+
+    /*!
+     * \brief keyFrameInterval Getter for key frame interval
+     * \return
+     */
+    int keyFrameInterval() const;
+    /*!
+     * \brief setKeyFrameInterval Sets the number of frames between two key frames of
+     * \ref DeltaEncoding. A lost delta is only recovered at the next key frame
+     * \param interval
+     */
+    void setKeyFrameInterval(int interval);
+
+    /*!
+     * \brief stamped Getter for stamped
+     * \return
+     */
+    bool stamped() const;
+    /*!
+     * \brief setStamped When true every value sent carries a sequence number and its send time,
+     * see \ref BLEStamp. The receiving end counts lost, reordered and duplicate values and the
+     * latency of each value in the \ref BLEMetrics of its role. Both ends must use the same.
+     * \note Only applied on the next \ref setup(). It adds \ref BLEStamp::HeaderSize bytes to
+     * every value
+     * \param stamped
+     */
+    void setStamped(bool stamped);
+
+    /*!
+     * \brief priority Getter for priority
+     * \return
+     */
+    Priority priority() const;
+    /*!
+     * \brief setPriority Sets the class of the values sent by a peripheral. Once a service of a
+     * \ref BLEPeripheral has a priority other than \ref NormalPriority or a \ref deadline, the
+     * values of all its services are scheduled by priority instead of written in turn
+     * \note Only applied on the next \ref setup()
+     * \param priority
+     */
+    void setPriority(Priority priority);
+
+    /*!
+     * \brief deadline Getter for deadline
+     * \return
+     */
+    int deadline() const;
+    /*!
+     * \brief setDeadline Sets the time in milliseconds a value sent may wait before it goes ahead
+     * of any other class, 0 uses the default of \ref priority
+     * \note Only applied on the next \ref setup()
+     * \param deadline
+     */
+    void setDeadline(int deadline);
+
+    /*!
+     * \brief adaptiveRate Getter for adaptiveRate
+     * \return
+     */
+    bool adaptiveRate() const;
+    /*!
+     * \brief setAdaptiveRate When true a peripheral adapts the rate of the values it sends to what
+     * the link drains, see \ref BLERateController. Values set faster than \ref sendRate replace
+     * each other, the latest one is sent. Only the loopback and stream backends support it, the
+     * Qt backend doesn't report when the central got a value
+     * \note Only applied on the next \ref setup()
+     * \param adaptive
+     */
+    void setAdaptiveRate(bool adaptive);
+
+    /*!
+     * \brief sendRate Returns the values per second a peripheral currently sends when
+     * \ref adaptiveRate, 0 otherwise
+     * \return
+     */
+    qreal sendRate() const;
+
+    /*!
+     * \brief subscribers Returns the number of centrals subscribed to this characteristic, only
+     * used by a peripheral. A peripheral doesn't send values while this is 0, it sends the latest
+     * value once a central subscribes
+     * \return
+     */
+    int subscribers() const;
+
+    /*!
+     * \brief droppedSamples Returns the number of received values dropped because the thread of
+     * this object could not keep up with the I/O thread
+     * \return
+     */
+    quint64 droppedSamples() const;
+
+    /*!
+     * \brief sampleBus Returns the bus that received values are published to
+     * \return
+     */
+    BLESampleBus* sampleBus() const;
+    /*!
+     * \brief setSampleBus Sets the bus that received values are published to. By default this is
+     * \ref BLESampleBus::instance(), nullptr disables publishing
+     * \param bus
+     */
+    void setSampleBus(BLESampleBus* bus);
+
+    /*!
+     * \brief sharedSamples Returns the shared memory that received values are also published to
+     * for other processes, set by \ref BLERole
+     */
+    BLESharedSamples* sharedSamples() const;
+    /*!
+     * \brief setSharedSamples Sets the shared memory that received values are also published to,
+     * nullptr disables it
+     * \param samples
+     */
+    void setSharedSamples(BLESharedSamples* samples);
+
+    /*!
+     * \brief exportStream Returns the stream that received values are also exported to, set by
+     * \ref BLERole
+     */
+    BLEExportStream* exportStream() const;
+    /*!
+     * \brief setExportStream Sets the stream that received values are also exported to, nullptr
+     * disables it
+     * \param stream
+     */
+    void setExportStream(BLEExportStream* stream);
+
 private slots:
     /*!
-     * \brief onValueWritten This slot is connected to \a QLowEnergyService::characteristicWritten()
-     * signal
-     * \param characteristic
+     * \brief drainSamples Applies the samples queued by \ref queueValue(). This is called on the
+     * thread of this object
+     */
+    void drainSamples();
+
+private:
+    /*!
+     * \brief setSubscribers Sets the number of subscribed centrals, called by \ref BLEPeripheral
+     * on the thread of the transport
+     */
+    void setSubscribers(int subscribers);
+
+    /*!
+     * \brief setSendRate Sets the rate the transport admits, called by \ref BLEPeripheral on the
+     * thread of the transport
+     */
+    void setSendRate(qreal rate);
+
+    /*!
+     * \brief sendStaleValue Sends the value if it was not sent because nobody was subscribed.
+     * This is called on the thread of this object
+     */
+    void sendStaleValue();
+
+    /*!
+     * \brief setMetrics Sets the metrics this service records to, called by \ref BLERole
+     */
+    void setMetrics(BLEMetrics* metrics);
+
+    /*!
+     * \brief isDeltaEncoded Returns true if values are sent and received with \ref DeltaEncoding
+     */
+    bool isDeltaEncoded() const;
+
+    /*!
+     * \brief sendData Sends the encoded \a payload from the thread of the transport, behind a
+     * \ref BLEStamp header if \ref stamped
+     * \return False if the transport refused it
+     */
+    bool sendData(const QByteArray& payload);
+
+    /*!
+     * \brief storeValue Updates the local value of the characteristic of a peripheral without
+     * notifying it, so a central that reads it gets \a value
+     */
+    void storeValue(const QVariant& value);
+
+    /*!
+     * \brief acknowledgeValue Handles the transport reporting \a value written, called by
+     * \ref BLERole on the thread of the transport. An indicated delta frame becomes the reference
+     * of the next ones, only used if the transport \ref BLETransport::confirmsWrites()
+     */
+    void acknowledgeValue(const QByteArray& value);
+
+    /*!
+     * \brief receiveValue Handles a value received from the other end of the connection. This is
+     * called by \ref BLERole on the thread of the transport
      * \param value
      */
-    void onValueWritten(const QLowEnergyCharacteristic &characteristic, const QByteArray &value);
+    void receiveValue(const QByteArray& value);
 
     /*!
-     * \brief serviceStateChanged This slot is connected to \a QLowEnergyService::stateChanged()
-     * signal if this \ref BLEDataService is used in a Cental
-     * \param st
+     * \brief onValueWritten Decodes \a value and updates the value of this service. This is used
+     * when the transport lives in the thread of this object
+     * \param value
      */
-    void serviceStateChanged(QLowEnergyService::ServiceState st);
+    void onValueWritten(const QByteArray& value);
 
-private:
     /*!
-     * \brief valueToByteArray
+     * \brief queueValue Decodes \a value and queues it for \ref drainSamples(). This is used
+     * instead of \ref onValueWritten() when the transport lives in another thread, ie the I/O
+     * thread
      * \param value
-     * \return
      */
-    QByteArray valueToByteArray(const QVariant& value);
+    void queueValue(const QByteArray& value);
 
     /*!
-     * \brief byteArrayToValue
-     * \param byteArray
-     * \return
+     * \brief receivePayload Hands \a value, without any stamp, to the decoding of
+     * \ref mEncoding. This is called on the thread of the transport
      */
-    QVariant byteArrayToValue(const QByteArray& byteArray);
+    void receivePayload(const QByteArray& value);
+
+    /*!
+     * \brief receiveFrame Decodes the \ref DeltaEncoding \a frame and delivers each of its values.
+     * This is called on the thread of the transport
+     */
+    void receiveFrame(const QByteArray& frame);
+
+    /*!
+     * \brief queueSample Queues the decoded \a sample for \ref drainSamples()
+     */
+    void queueSample(const BLESample& sample);
+
+    /*!
+     * \brief decodeReceived Decodes \a value in place into \ref mReceived. A payload equal to the
+     * previous one is not decoded again, only its timestamp is updated. This is called on the
+     * thread of the transport
+     * \return False if \a value is not valid or doesn't fit in a sample
+     */
+    bool decodeReceived(const QByteArray& value);
+
+    /*!
+     * \brief applySample Makes \a sample the value of this service and emits \ref valueUpdated()
+     * if anything is connected to it. \ref valueChanged() is only emitted if the payload differs
+     * from the one applied before. This is called on the thread of this object
+     */
+    void applySample(const BLESample& sample);
+
+    /*!
+     * \brief defaultValue Returns the value of a service of \a dataType before anything is set
+     */
+    static QVariant defaultValue(DataType dataType);
+
+    /*!
+     * \brief sampleType Returns \ref mDataType as a \ref BLESample::Type
+     */
+    BLESample::Type sampleType() const;
+
+    /*!
+     * \brief decodeSample Decodes \a value into \a sample and stamps it with the uuids of this
+     * service and the current time
+     * \return False if \a value is not valid or doesn't fit in a sample
+     */
+    bool decodeSample(const QByteArray& value, BLESample& sample) const;
+
+    /*!
+     * \brief publishSample Publishes \a sample to \ref mSampleBus, \ref mSharedSamples and
+     * \ref mExportStream if any
+     */
+    void publishSample(const BLESample& sample);
 
 signals:
     /*!
@@ -178,6 +538,16 @@ signals:
     void serviceUuidChanged();
     void characterUuidChanged();
     void descriptorUuidChanged();
+    void indicateChanged();
+    void subscribersChanged();
+    void broadcastChanged();
+    void encodingChanged();
+    void keyFrameIntervalChanged();
+    void stampedChanged();
+    void priorityChanged();
+    void deadlineChanged();
+    void adaptiveRateChanged();
+    void sendRateChanged();
 
     void valueLengthChanged();
 
@@ -188,8 +558,9 @@ protected:
     //! \brief mCharacterUuid Characteristic uuid for \a QLowEnergyCharacteristicData
     QBluetoothUuid mCharacterUuid;
 
-    //! \brief mValue Value of this service data
-    QVariant mValue;
+    //! \brief mValue Value of this service data, built from \ref mApplied when read if
+    //! \ref mValueStale is set
+    mutable QVariant mValue;
 
     //! \brief mValueLength Holds the length of the value for this service
     quint8 mValueLength;
@@ -197,9 +568,121 @@ protected:
     //! \brief mDataType Holds the data type of this service
     DataType mDataType;
 
-    //! \brief mService The \a QLowEenergyService responsible for reading and writing for this \ref
-    //! BLEDataService
-    QLowEnergyService* mService;
+    //! \brief mDataTypeExplicit True once \ref setDataType is called, the data type is no longer
+    //! chosen by the characteristic uuid
+    bool mDataTypeExplicit;
+
+    //! \brief mServiceData The service a peripheral adds, built in \ref setup() if it's not valid
+    QLowEnergyServiceData mServiceData;
+
+    //! \brief mTransport The transport responsible for reading and writing for this \ref
+    //! BLEDataService. It's set on the thread of the transport and used on the thread of this
+    //! object
+    std::atomic<BLETransport*> mTransport;
+
+    //! \brief SampleQueueSize Number of decoded samples that can wait for the GUI thread
+    static constexpr std::size_t SampleQueueSize = 64;
+
+    //! \brief mSamples Decoded samples handed from the I/O thread to the thread of this object
+    SPSCQueue<BLESample, SampleQueueSize> mSamples;
+
+    //! \brief mDrainScheduled Is true while a call to \ref drainSamples() is queued
+    std::atomic_bool mDrainScheduled;
+
+    //! \brief mDroppedSamples Number of samples dropped because \ref mSamples was full
+    std::atomic<quint64> mDroppedSamples;
+
+    //! \brief mSampleBus The bus that received values are published to, may be null
+    std::atomic<BLESampleBus*> mSampleBus;
+
+    //! \brief mSharedSamples The shared memory that received values are published to, may be null
+    std::atomic<BLESharedSamples*> mSharedSamples;
+
+    //! \brief mExportStream The stream that received values are exported to, may be null
+    std::atomic<BLEExportStream*> mExportStream;
+
+    //! \brief mIndicate Send values as indications instead of notifications
+    bool mIndicate;
+
+    //! \brief mBroadcast Put the value in the advertisement of a peripheral
+    bool mBroadcast;
+
+    //! \brief mSubscribers Number of centrals subscribed, written on the thread of the transport
+    std::atomic<int> mSubscribers;
+
+    //! \brief mStale True if the value was not sent because nobody was subscribed
+    std::atomic_bool mStale;
+
+    //! \brief mMetrics The metrics of the role of this service, may be null
+    BLEMetrics* mMetrics;
+
+    //! \brief mChannel The metrics of this characteristic, set by \ref setup()
+    BLEMetrics::Channel* mChannel;
+
+    //! \brief mEncoding How values are sent and decoded
+    Encoding mEncoding;
+
+    //! \brief mDeltaEncoded The \ref mEncoding applied by \ref setup(), read on both threads
+    std::atomic_bool mDeltaEncoded;
+
+    //! \brief mEncoder Encodes the values sent, used on the thread of this object
+    BLEDeltaCodec::Encoder mEncoder;
+
+    //! \brief mDecoder Decodes the values received, used on the thread of the transport
+    BLEDeltaCodec::Decoder mDecoder;
+
+    //! \brief mKeyFrameRequested Makes the next value sent a key frame, ie after a central
+    //! subscribed
+    std::atomic_bool mKeyFrameRequested;
+
+    //! \brief mReceived The last value decoded, used on the thread of the transport. Values are
+    //! decoded in place here so receiving allocates nothing
+    BLESample mReceived;
+
+    //! \brief mReceivedValid True if \ref mReceived holds a decoded value
+    bool mReceivedValid;
+
+    //! \brief mApplied The sample \ref mValue was set from, used on the thread of this object
+    BLESample mApplied;
+
+    //! \brief mAppliedValid False once \ref mValue was set by anything else than a sample
+    bool mAppliedValid;
+
+    //! \brief mValueStale True if \ref mValue is not built from \ref mApplied yet. Services
+    //! only used from C++ never pay for the \a QVariant
+    mutable bool mValueStale;
+
+    //! \brief mPriority The class of the values sent by a peripheral
+    Priority mPriority;
+
+    //! \brief mDeadline Time in milliseconds a value sent may wait, 0 for the class default
+    int mDeadline;
+
+    //! \brief mAdaptiveRate Adapt the rate of the values sent by a peripheral to the link
+    bool mAdaptiveRate;
+
+    //! \brief mSendRate Values per second admitted, written on the thread of the transport
+    std::atomic<qreal> mSendRate;
+
+    //! \brief mStamped Stamp the values sent and track the values received
+    bool mStamped;
+
+    //! \brief mStampApplied The \ref mStamped applied by \ref setup(), read on both threads
+    std::atomic_bool mStampApplied;
+
+    //! \brief mStampSequence Sequence of the next value sent, used on the thread of this object
+    quint16 mStampSequence;
+
+    //! \brief mStampTracker Follows the values received, used on the thread of the transport
+    BLEStamp::Tracker mStampTracker;
+
+    //! \brief mAcknowledged Sequence of the last indicated frame the central confirmed, or
+    //! \ref BLEDeltaCodec::NoFrame
+    std::atomic<int> mAcknowledged;
+
+    //! \brief mServiceReady Subscribes a central once its service is open, disconnected by
+    //! \ref release() since it refers to this object from the thread of the transport
+    QMetaObject::Connection mServiceReady;
 };
 
 
@@ -207,11 +690,16 @@ inline bool BLEDataService::isValid() const
 {
     return !mServiceUuid.isNull()
            && !mCharacterUuid.isNull()
-           && mService;
+           && mTransport.load(std::memory_order_acquire);
 }
 
 inline QVariant BLEDataService::value() const
 {
+    if (mValueStale) {
+        mValue = mApplied.toVariant();
+        mValueStale = false;
+    }
+
     return mValue;
 }
 
@@ -220,6 +708,86 @@ inline BLEDataService::DataType BLEDataService::dataType() const
     return mDataType;
 }
 
+inline bool BLEDataService::indicate() const
+{
+    return mIndicate;
+}
+
+inline bool BLEDataService::broadcast() const
+{
+    return mBroadcast;
+}
+
+inline BLEDataService::Encoding BLEDataService::encoding() const
+{
+    return mEncoding;
+}
+
+inline int BLEDataService::keyFrameInterval() const
+{
+    return mEncoder.keyFrameInterval();
+}
+
+inline BLEDataService::Priority BLEDataService::priority() const
+{
+    return mPriority;
+}
+
+inline int BLEDataService::deadline() const
+{
+    return mDeadline;
+}
+
+inline bool BLEDataService::adaptiveRate() const
+{
+    return mAdaptiveRate;
+}
+
+inline qreal BLEDataService::sendRate() const
+{
+    return mSendRate.load(std::memory_order_relaxed);
+}
+
+inline bool BLEDataService::stamped() const
+{
+    return mStamped;
+}
+
+inline bool BLEDataService::isDeltaEncoded() const
+{
+    return mDeltaEncoded.load(std::memory_order_relaxed);
+}
+
+inline int BLEDataService::subscribers() const
+{
+    return mSubscribers.load(std::memory_order_relaxed);
+}
+
+inline quint64 BLEDataService::droppedSamples() const
+{
+    return mDroppedSamples.load(std::memory_order_relaxed);
+}
+
+inline BLESampleBus* BLEDataService::sampleBus() const
+{
+    return mSampleBus.load(std::memory_order_acquire);
+}
+
+inline BLESharedSamples* BLEDataService::sharedSamples() const
+{
+    return mSharedSamples.load(std::memory_order_acquire);
+}
+
+inline BLEExportStream* BLEDataService::exportStream() const
+{
+    return mExportStream.load(std::memory_order_acquire);
+}
+
+inline BLESample::Type BLEDataService::sampleType() const
+{
+    return BLESample::Type(mDataType);
+}
+
 inline QBluetoothUuid BLEDataService::serviceBluetoothUuid() const
 {
     return mServiceUuid;
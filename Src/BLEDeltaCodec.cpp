@@ -0,0 +1,308 @@
+#include "BLEDeltaCodec.hpp"
+
+#include <QtGlobal>
+
+namespace {
+
+//! \brief The sequence takes the low 6 bits of the header
+constexpr quint8 SequenceMask = 0x3F;
+
+//! \brief Values are 16 bits, so their zigzag varint takes at most 3 bytes
+constexpr int MaxNumberSize = 3;
+
+//! \brief Index of \a sequence in a history
+constexpr int slot(int sequence)
+{
+    return sequence & (BLEDeltaCodec::HistorySize - 1);
+}
+
+quint32 zigzag(qint16 value)
+{
+    const qint32 wide = value;
+    return (quint32(wide) << 1) ^ quint32(wide >> 31);
+}
+
+qint16 unzigzag(quint32 value)
+{
+    return qint16(qint32(value >> 1) ^ -qint32(value & 1));
+}
+
+//! \brief Difference of two values, wrapping like the 16 bit values themselves
+qint16 difference(qint16 value, qint16 reference)
+{
+    return qint16(quint16(value) - quint16(reference));
+}
+
+int varintSize(quint32 value)
+{
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+void appendVarint(QByteArray& data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(char(quint8(value) | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+}
+
+bool readVarint(const char*& it, const char* end, quint32& value)
+{
+    value = 0;
+    for (int shift = 0; it != end && shift < 7 * MaxNumberSize; shift += 7) {
+        const quint8 byte = quint8(*it++);
+        value |= quint32(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value <= 0xFFFF;
+        }
+    }
+    return false;
+}
+
+bool readNumber(const char*& it, const char* end, qint16& value)
+{
+    quint32 raw = 0;
+    if (!readVarint(it, end, raw)) {
+        return false;
+    }
+    value = unzigzag(raw);
+    return true;
+}
+
+} // namespace
+
+int BLEDeltaCodec::sequence(const QByteArray& frame)
+{
+    return frame.isEmpty() ? -1 : quint8(frame.at(0)) & SequenceMask;
+}
+
+QByteArray BLEDeltaCodec::Encoder::encode(qint16 value, int reference)
+{
+    QByteArray frame;
+    frame.reserve(2 + MaxNumberSize);
+
+    const int last = (mSequence - 1) & SequenceMask;
+    if (reference == LastFrame) {
+        reference = last;
+    }
+
+    const Entry base = reference >= 0 ? mHistory[slot(reference)] : Entry();
+    const bool useBase = mSinceKeyFrame >= 0 && mSinceKeyFrame < mKeyFrameInterval && base.valid
+                         && base.sequence == reference;
+
+    if (!useBase) {
+        frame.append(char((KeyFrame << 6) | advance(value)));
+        appendVarint(frame, zigzag(value));
+        mSinceKeyFrame = 0;
+        return frame;
+    }
+
+    if (reference == last) {
+        frame.append(char((DeltaFrame << 6) | advance(value)));
+    } else {
+        frame.append(char((DeltaFromFrame << 6) | advance(value)));
+        frame.append(char(base.sequence));
+    }
+    appendVarint(frame, zigzag(difference(value, base.value)));
+    ++mSinceKeyFrame;
+    return frame;
+}
+
+QByteArray BLEDeltaCodec::Encoder::encodeBatch(const qint16* values, int count, int* encoded)
+{
+    count = qMin(count, MaxBatchSize);
+    if (count <= 0) {
+        if (encoded) {
+            *encoded = 0;
+        }
+        return QByteArray();
+    }
+
+    //! The header and the count are written once the values that fit are known
+    QByteArray frame;
+    frame.reserve(MaxFrameSize);
+    frame.append(2, char(0));
+    appendVarint(frame, zigzag(values[0]));
+
+    int index = 1;
+    while (index < count) {
+        const qint16 delta = difference(values[index], values[index - 1]);
+        if (delta != 0) {
+            const quint32 number = zigzag(delta);
+            if (frame.size() + varintSize(number) > MaxFrameSize) {
+                break;
+            }
+            appendVarint(frame, number);
+            ++index;
+            continue;
+        }
+
+        //! A run of equal values, the count is below 64 so the run always takes 2 bytes
+        if (frame.size() + 2 > MaxFrameSize) {
+            break;
+        }
+        int run = 1;
+        while (index + run < count && values[index + run] == values[index - 1]) {
+            ++run;
+        }
+        frame.append(char(0));
+        appendVarint(frame, quint32(run - 1));
+        index += run;
+    }
+
+    frame[0] = char((BatchFrame << 6) | advance(values[index - 1]));
+    frame[1] = char(index);
+
+    //! A batch doesn't need a reference, so it counts as a key frame
+    mSinceKeyFrame = 0;
+
+    if (encoded) {
+        *encoded = index;
+    }
+    return frame;
+}
+
+void BLEDeltaCodec::Encoder::requestKeyFrame()
+{
+    mSinceKeyFrame = -1;
+}
+
+void BLEDeltaCodec::Encoder::setKeyFrameInterval(int interval)
+{
+    mKeyFrameInterval = qMax(1, interval);
+}
+
+quint8 BLEDeltaCodec::Encoder::advance(qint16 value)
+{
+    const quint8 sequence = mSequence;
+    mSequence = (mSequence + 1) & SequenceMask;
+
+    Entry& entry = mHistory[slot(sequence)];
+    entry.value = value;
+    entry.sequence = sequence;
+    entry.valid = true;
+    return sequence;
+}
+
+bool BLEDeltaCodec::Decoder::decode(const QByteArray& frame, Values& values)
+{
+    if (frame.isEmpty()) {
+        return false;
+    }
+
+    const char* it = frame.constData();
+    const char* const end = it + frame.size();
+
+    const quint8 header = quint8(*it++);
+    const quint8 kind = header >> 6;
+    const quint8 sequence = header & SequenceMask;
+
+    const qsizetype start = values.size();
+    auto fail = [&values, start]() {
+        values.resize(start);
+        return false;
+    };
+
+    qint16 value = 0;
+    switch (kind) {
+    case KeyFrame:
+        if (!readNumber(it, end, value)) {
+            return fail();
+        }
+        values.append(value);
+        break;
+    case DeltaFrame:
+    case DeltaFromFrame: {
+        int reference = (sequence - 1) & SequenceMask;
+        if (kind == DeltaFromFrame) {
+            if (it == end) {
+                return fail();
+            }
+            reference = quint8(*it++) & SequenceMask;
+        }
+
+        const Entry& base = mHistory[slot(reference)];
+        qint16 delta = 0;
+        if (!base.valid || base.sequence != reference || !readNumber(it, end, delta)) {
+            return fail();
+        }
+        value = qint16(quint16(base.value) + quint16(delta));
+        values.append(value);
+        break;
+    }
+    case BatchFrame: {
+        if (it == end) {
+            return fail();
+        }
+        const int count = quint8(*it++);
+        if (count < 1 || count > MaxBatchSize || !readNumber(it, end, value)) {
+            return fail();
+        }
+        values.append(value);
+
+        int decoded = 1;
+        while (decoded < count) {
+            quint32 number = 0;
+            if (!readVarint(it, end, number)) {
+                return fail();
+            }
+
+            if (number != 0) {
+                value = qint16(quint16(value) + quint16(unzigzag(number)));
+                values.append(value);
+                ++decoded;
+                continue;
+            }
+
+            quint32 repeats = 0;
+            if (!readVarint(it, end, repeats) || decoded + 1 + int(repeats) > count) {
+                return fail();
+            }
+            for (quint32 i = 0; i <= repeats; ++i) {
+                values.append(value);
+            }
+            decoded += 1 + int(repeats);
+        }
+        break;
+    }
+    }
+
+    if (it != end) {
+        return fail();
+    }
+
+    remember(sequence, value);
+    return true;
+}
+
+void BLEDeltaCodec::Decoder::reset()
+{
+    for (Entry& entry : mHistory) {
+        entry.valid = false;
+    }
+    mLast = -1;
+}
+
+void BLEDeltaCodec::Decoder::remember(quint8 sequence, qint16 value)
+{
+    //! Frames lost since the previous one must not be mistaken for older frames in their slots
+    if (mLast >= 0 && mLast != sequence) {
+        int skipped = (mLast + 1) & SequenceMask;
+        for (int i = 0; skipped != sequence && i < HistorySize; ++i) {
+            mHistory[slot(skipped)].valid = false;
+            skipped = (skipped + 1) & SequenceMask;
+        }
+    }
+
+    Entry& entry = mHistory[slot(sequence)];
+    entry.value = value;
+    entry.sequence = sequence;
+    entry.valid = true;
+    mLast = sequence;
+}
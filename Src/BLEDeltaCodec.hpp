@@ -0,0 +1,155 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVarLengthArray>
+
+/*!
+ * \brief The BLEDeltaCodec class holds the delta encoding of \ref BLEDataService::DeltaEncoding.
+ * Each frame starts with a header byte, the frame kind in the high 2 bits and a 6 bits sequence
+ * number in the low bits. Numbers are zigzag varints:
+ *  - \ref KeyFrame carries the value itself
+ *  - \ref DeltaFrame carries the difference to the value of the previous sequence
+ *  - \ref DeltaFromFrame carries the sequence of its reference in a second byte, then the
+ *    difference to the value of that sequence
+ *  - \ref BatchFrame carries a count, the first value and the differences of the next ones, a
+ *    zero difference is followed by the number of repeated zeros. It doesn't need a reference
+ *
+ * The \ref Encoder and \ref Decoder remember the last \ref HistorySize frames, a delta whose
+ * reference the decoder doesn't have is dropped and the next key frame resynchronizes it
+ */
+class BLEDeltaCodec
+{
+public:
+    enum FrameKind : quint8 {
+        DeltaFrame = 0,
+        KeyFrame,
+        BatchFrame,
+        DeltaFromFrame,
+    };
+
+    //! \brief MaxFrameSize Frames fit in a notification of the default ATT MTU
+    static constexpr int MaxFrameSize = 20;
+
+    //! \brief MaxBatchSize Maximum number of values in a \ref BatchFrame
+    static constexpr int MaxBatchSize = 64;
+
+    //! \brief HistorySize Number of frames remembered as references
+    static constexpr int HistorySize = 8;
+
+    //! \brief DefaultKeyFrameInterval Number of frames between two key frames
+    static constexpr int DefaultKeyFrameInterval = 16;
+
+    //! \brief LastFrame Reference of \ref Encoder::encode() meaning the last frame encoded
+    static constexpr int LastFrame = -1;
+
+    //! \brief NoFrame Reference of \ref Encoder::encode() meaning no frame is known to the other
+    //! end, so a key frame is encoded
+    static constexpr int NoFrame = -2;
+
+    //! \brief Values Decoded values of a frame
+    using Values = QVarLengthArray<qint16, MaxBatchSize>;
+
+    /*!
+     * \brief sequence Returns the sequence number of \a frame, -1 if it is empty
+     */
+    static int sequence(const QByteArray& frame);
+
+private:
+    //! \brief The value of a remembered frame
+    struct Entry
+    {
+        qint16 value = 0;
+        quint8 sequence = 0;
+        bool valid = false;
+    };
+
+public:
+    /*!
+     * \brief The Encoder class encodes the values sent on one characteristic
+     */
+    class Encoder
+    {
+    public:
+        /*!
+         * \brief encode Encodes \a value against \a reference, the sequence of a frame the other
+         * end is known to have, or one of \ref LastFrame and \ref NoFrame. A key frame is
+         * encoded instead when \a reference is no longer remembered, when one was requested or
+         * every \ref keyFrameInterval() frames
+         */
+        QByteArray encode(qint16 value, int reference = LastFrame);
+
+        /*!
+         * \brief encodeBatch Encodes as many of the \a count \a values as fit in one
+         * \ref BatchFrame
+         * \param encoded Set to the number of values encoded
+         */
+        QByteArray encodeBatch(const qint16* values, int count, int* encoded = nullptr);
+
+        /*!
+         * \brief requestKeyFrame Makes the next frame a key frame, ie when a central subscribes
+         */
+        void requestKeyFrame();
+
+        int keyFrameInterval() const;
+        void setKeyFrameInterval(int interval);
+
+    private:
+        /*!
+         * \brief advance Takes the next sequence for a frame that ends with \a value and
+         * remembers it as a reference
+         * \return The sequence of the frame
+         */
+        quint8 advance(qint16 value);
+
+    private:
+        //! \brief mHistory The last frames, indexed by their sequence
+        Entry mHistory[HistorySize];
+
+        //! \brief mSequence Sequence of the next frame
+        quint8 mSequence = 0;
+
+        //! \brief mSinceKeyFrame Frames encoded since the last key frame, a negative value makes
+        //! the next frame a key frame
+        int mSinceKeyFrame = -1;
+
+        int mKeyFrameInterval = DefaultKeyFrameInterval;
+    };
+
+    /*!
+     * \brief The Decoder class decodes the frames received on one characteristic
+     */
+    class Decoder
+    {
+    public:
+        /*!
+         * \brief decode Appends the values of \a frame to \a values
+         * \return False if \a frame is malformed or its reference is not known
+         */
+        bool decode(const QByteArray& frame, Values& values);
+
+        /*!
+         * \brief reset Forgets every reference, only key and batch frames are decoded afterwards
+         */
+        void reset();
+
+    private:
+        /*!
+         * \brief remember Keeps \a value as the value of \a sequence and forgets the sequences
+         * skipped since the previous frame
+         */
+        void remember(quint8 sequence, qint16 value);
+
+    private:
+        //! \brief mHistory The last frames, indexed by their sequence
+        Entry mHistory[HistorySize];
+
+        //! \brief mLast Sequence of the last frame decoded, -1 if none
+        int mLast = -1;
+    };
+};
+
+
+inline int BLEDeltaCodec::Encoder::keyFrameInterval() const
+{
+    return mKeyFrameInterval;
+}
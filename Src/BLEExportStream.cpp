@@ -0,0 +1,507 @@
+#include "BLEExportStream.hpp"
+
+#include <QDebug>
+#include <QLocalSocket>
+#include <QMutexLocker>
+#include <QTcpSocket>
+#include <QThread>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+
+constexpr int SizeField = 4;
+
+//! u32 dropped and u16 count
+constexpr int FrameHeaderSize = 6;
+
+constexpr qsizetype MaxFrameSize
+    = FrameHeaderSize
+      + std::numeric_limits<quint16>::max() * (BLEExportStream::RecordSize + BLESample::MaxSize);
+
+quint32 floatBits(float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(quint32 bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+BLEExportStream::BLEExportStream(QObject* parent)
+    : QObject{ parent }
+    , mBackend { TcpBackend }
+    , mHost { QStringLiteral("127.0.0.1") }
+    , mPort { 0 }
+    , mBatchSize { DefaultBatchSize }
+    , mBatchDelay { DefaultBatchDelay }
+    , mQueueSize { DefaultQueueSize }
+    , mDropPolicy { DropOldest }
+    , mQueueHead { 0 }
+    , mQueueCount { 0 }
+    , mPendingDrops { 0 }
+    , mExporting { false }
+    , mFlushScheduled { false }
+    , mClosing { false }
+    , mPublishers { 0 }
+    , mSent { 0 }
+    , mDropped { 0 }
+    , mSocket { nullptr }
+    , mConnected { false }
+    , mBatchTimer { new QTimer(this) }
+    , mReconnectTimer { new QTimer(this) }
+{
+    mBatchTimer->setSingleShot(true);
+    connect(mBatchTimer, &QTimer::timeout, this, &BLEExportStream::flush);
+
+    mReconnectTimer->setSingleShot(true);
+    mReconnectTimer->setInterval(ReconnectInterval);
+    connect(mReconnectTimer, &QTimer::timeout, this, &BLEExportStream::connectToConsumer);
+}
+
+BLEExportStream::~BLEExportStream()
+{
+    //! A service may still hold this stream on another thread until its role unsets it
+    mClosing.store(true, std::memory_order_seq_cst);
+    while (mPublishers.load(std::memory_order_seq_cst) > 0) {
+        QThread::yieldCurrentThread();
+    }
+
+    stop();
+}
+
+bool BLEExportStream::warnIfExporting(const char* property) const
+{
+    if (!isExporting()) {
+        return false;
+    }
+
+    qWarning() << "BLEExportStream:" << property << "can't be changed while exporting";
+    return true;
+}
+
+void BLEExportStream::setBackend(Backend backend)
+{
+    if (mBackend == backend || warnIfExporting("Backend")) {
+        return;
+    }
+
+    mBackend = backend;
+    emit backendChanged();
+}
+
+void BLEExportStream::setHost(const QString& host)
+{
+    if (mHost == host || warnIfExporting("Host")) {
+        return;
+    }
+
+    mHost = host;
+    emit hostChanged();
+}
+
+void BLEExportStream::setPort(int port)
+{
+    if (mPort == port || warnIfExporting("Port")) {
+        return;
+    }
+
+    if (port < 0 || port > std::numeric_limits<quint16>::max()) {
+        qWarning() << "BLEExportStream: Port must be between 0 and 65535";
+        return;
+    }
+
+    mPort = port;
+    emit portChanged();
+}
+
+void BLEExportStream::setServerName(const QString& name)
+{
+    if (mServerName == name || warnIfExporting("Server name")) {
+        return;
+    }
+
+    mServerName = name;
+    emit serverNameChanged();
+}
+
+void BLEExportStream::setBatchSize(int size)
+{
+    if (mBatchSize == size || warnIfExporting("Batch size")) {
+        return;
+    }
+
+    if (size < 1 || size > std::numeric_limits<quint16>::max()) {
+        qWarning() << "BLEExportStream: Batch size must be between 1 and 65535";
+        return;
+    }
+
+    mBatchSize = size;
+    emit batchSizeChanged();
+}
+
+void BLEExportStream::setBatchDelay(int delay)
+{
+    if (mBatchDelay == delay || warnIfExporting("Batch delay")) {
+        return;
+    }
+
+    if (delay < 0) {
+        qWarning() << "BLEExportStream: Batch delay can't be negative";
+        return;
+    }
+
+    mBatchDelay = delay;
+    emit batchDelayChanged();
+}
+
+void BLEExportStream::setQueueSize(int size)
+{
+    if (mQueueSize == size || warnIfExporting("Queue size")) {
+        return;
+    }
+
+    if (size < 1) {
+        qWarning() << "BLEExportStream: Queue size must be at least 1";
+        return;
+    }
+
+    mQueueSize = size;
+    emit queueSizeChanged();
+}
+
+void BLEExportStream::setDropPolicy(DropPolicy policy)
+{
+    if (mDropPolicy == policy || warnIfExporting("Drop policy")) {
+        return;
+    }
+
+    mDropPolicy = policy;
+    emit dropPolicyChanged();
+}
+
+bool BLEExportStream::isExporting() const
+{
+    //! Only changed on the thread of the stream, the lock is for publish()
+    return mExporting;
+}
+
+void BLEExportStream::start()
+{
+    if (isExporting()) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&mMutex);
+        mQueue.assign(std::size_t(mQueueSize), BLESample());
+        mQueueHead = 0;
+        mQueueCount = 0;
+        mPendingDrops = 0;
+        mExporting = true;
+    }
+    mFlushScheduled.store(false, std::memory_order_relaxed);
+    mSent.store(0, std::memory_order_relaxed);
+    mDropped.store(0, std::memory_order_relaxed);
+    mBatchTimer->setInterval(mBatchDelay);
+    mBatch.reserve(std::size_t(mQueueSize));
+
+    emit exportingChanged();
+    connectToConsumer();
+}
+
+void BLEExportStream::stop()
+{
+    if (!isExporting()) {
+        return;
+    }
+
+    //! What is queued still goes out when the consumer is there
+    flush();
+
+    {
+        QMutexLocker locker(&mMutex);
+        mExporting = false;
+        mQueue.clear();
+        mQueueCount = 0;
+    }
+
+    mBatchTimer->stop();
+    mReconnectTimer->stop();
+    dropSocket();
+
+    emit exportingChanged();
+}
+
+void BLEExportStream::publish(const BLESample& sample)
+{
+    mPublishers.fetch_add(1, std::memory_order_seq_cst);
+    if (!mClosing.load(std::memory_order_seq_cst)) {
+        enqueue(sample);
+    }
+    mPublishers.fetch_sub(1, std::memory_order_release);
+}
+
+void BLEExportStream::enqueue(const BLESample& sample)
+{
+    std::size_t count = 0;
+    {
+        QMutexLocker locker(&mMutex);
+        if (!mExporting) {
+            return;
+        }
+
+        if (mQueueCount == mQueue.size()) {
+            ++mPendingDrops;
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            if (mDropPolicy == DropNewest) {
+                return;
+            }
+
+            mQueueHead = (mQueueHead + 1) % mQueue.size();
+            --mQueueCount;
+        }
+
+        mQueue[(mQueueHead + mQueueCount) % mQueue.size()] = sample;
+        count = ++mQueueCount;
+    }
+
+    //! A full batch goes out right away, the first sample of a batch starts its delay
+    if (count >= std::size_t(mBatchSize) || mBatchDelay == 0) {
+        if (!mFlushScheduled.exchange(true, std::memory_order_acq_rel)) {
+            QMetaObject::invokeMethod(this, &BLEExportStream::flush, Qt::QueuedConnection);
+        }
+    } else if (count == 1) {
+        QMetaObject::invokeMethod(this, &BLEExportStream::armBatch, Qt::QueuedConnection);
+    }
+}
+
+void BLEExportStream::armBatch()
+{
+    if (isExporting() && !mBatchTimer->isActive()) {
+        mBatchTimer->start();
+    }
+}
+
+void BLEExportStream::flush()
+{
+    //! The samples stay queued, connecting or bytesWritten() flush them. Like Nagle's algorithm,
+    //! what queued up while the consumer was reading goes out as soon as it has read
+    if (!mConnected || mSocket->bytesToWrite() > MaxPendingBytes) {
+        return;
+    }
+
+    mFlushScheduled.store(false, std::memory_order_release);
+    mBatchTimer->stop();
+
+    quint32 dropped = 0;
+    {
+        QMutexLocker locker(&mMutex);
+        if (mQueueCount == 0 && mPendingDrops == 0) {
+            return;
+        }
+
+        const std::size_t first = std::min(mQueueCount, mQueue.size() - mQueueHead);
+        mBatch.assign(mQueue.cbegin() + qsizetype(mQueueHead),
+                      mQueue.cbegin() + qsizetype(mQueueHead + first));
+        mBatch.insert(mBatch.end(), mQueue.cbegin(),
+                      mQueue.cbegin() + qsizetype(mQueueCount - first));
+
+        mQueueHead = 0;
+        mQueueCount = 0;
+        dropped = std::exchange(mPendingDrops, 0);
+    }
+
+    mFrame.resize(0);
+    qsizetype offset = 0;
+    do {
+        const qsizetype count
+            = std::min<qsizetype>(qsizetype(mBatch.size()) - offset, mBatchSize);
+        encode(mBatch.data() + offset, count, std::exchange(dropped, 0), mFrame);
+        offset += count;
+    } while (offset < qsizetype(mBatch.size()));
+
+    mSocket->write(mFrame);
+    mSent.fetch_add(mBatch.size(), std::memory_order_relaxed);
+}
+
+void BLEExportStream::connectToConsumer()
+{
+    if (!isExporting()) {
+        return;
+    }
+
+    dropSocket();
+
+    if (mBackend == LocalSocketBackend) {
+        auto* socket = new QLocalSocket(this);
+        connect(socket, &QLocalSocket::connected, this, &BLEExportStream::onSocketConnected);
+        connect(socket, &QLocalSocket::disconnected, this,
+                &BLEExportStream::onSocketDisconnected);
+        connect(socket, &QLocalSocket::errorOccurred, this, [this, socket]() {
+            qWarning() << "BLEExportStream: Local socket" << mServerName << socket->errorString();
+            onSocketDisconnected();
+        });
+        mSocket = socket;
+        connect(mSocket, &QIODevice::bytesWritten, this, &BLEExportStream::flush);
+        socket->connectToServer(mServerName, QIODevice::WriteOnly);
+    } else {
+        auto* socket = new QTcpSocket(this);
+        connect(socket, &QTcpSocket::connected, this, &BLEExportStream::onSocketConnected);
+        connect(socket, &QTcpSocket::disconnected, this, &BLEExportStream::onSocketDisconnected);
+        connect(socket, &QTcpSocket::errorOccurred, this, [this, socket]() {
+            qWarning() << "BLEExportStream: TCP" << mHost << mPort << socket->errorString();
+            onSocketDisconnected();
+        });
+        mSocket = socket;
+        connect(mSocket, &QIODevice::bytesWritten, this, &BLEExportStream::flush);
+        socket->connectToHost(mHost, quint16(mPort), QIODevice::WriteOnly);
+    }
+}
+
+void BLEExportStream::dropSocket()
+{
+    if (!mSocket) {
+        return;
+    }
+
+    QIODevice* socket = std::exchange(mSocket, nullptr);
+    socket->disconnect(this);
+
+    //! What was written still goes out, the socket is deleted once it's closed
+    if (auto* localSocket = qobject_cast<QLocalSocket*>(socket)) {
+        connect(localSocket, &QLocalSocket::disconnected, localSocket, &QObject::deleteLater);
+        localSocket->disconnectFromServer();
+        if (localSocket->state() == QLocalSocket::UnconnectedState) {
+            localSocket->deleteLater();
+        }
+    } else if (auto* tcpSocket = qobject_cast<QTcpSocket*>(socket)) {
+        connect(tcpSocket, &QTcpSocket::disconnected, tcpSocket, &QObject::deleteLater);
+        tcpSocket->disconnectFromHost();
+        if (tcpSocket->state() == QAbstractSocket::UnconnectedState) {
+            tcpSocket->deleteLater();
+        }
+    }
+
+    if (std::exchange(mConnected, false)) {
+        emit connectedChanged();
+    }
+}
+
+void BLEExportStream::onSocketConnected()
+{
+    //! The samples are batched here, the kernel must not hold the frames back once more
+    if (auto* tcpSocket = qobject_cast<QTcpSocket*>(mSocket)) {
+        tcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    }
+
+    mConnected = true;
+    emit connectedChanged();
+    flush();
+}
+
+void BLEExportStream::onSocketDisconnected()
+{
+    if (mConnected) {
+        mConnected = false;
+        emit connectedChanged();
+    }
+
+    //! Queued samples wait for the next connection, the queue drops what doesn't fit meanwhile
+    if (isExporting() && !mReconnectTimer->isActive()) {
+        mReconnectTimer->start();
+    }
+}
+
+void BLEExportStream::encode(const BLESample* samples, qsizetype count, quint32 dropped,
+                             QByteArray& frame)
+{
+    Q_ASSERT(count <= std::numeric_limits<quint16>::max());
+
+    const qsizetype start = frame.size();
+    frame.append(SizeField + FrameHeaderSize, '\0');
+
+    for (qsizetype i = 0; i < count; ++i) {
+        const BLESample& sample = samples[i];
+
+        char record[RecordSize];
+        qToLittleEndian<qint64>(sample.timestamp, record);
+        qToLittleEndian<quint32>(sample.serviceUuid, record + 8);
+        qToLittleEndian<quint32>(sample.characterUuid, record + 12);
+        record[16] = char(sample.type);
+        record[17] = char(sample.size);
+        qToLittleEndian<qint16>(sample.intValue, record + 18);
+        qToLittleEndian<quint32>(floatBits(sample.floatValue), record + 20);
+
+        frame.append(record, RecordSize);
+        frame.append(sample.data, sample.size);
+    }
+
+    char* header = frame.data() + start;
+    qToLittleEndian(quint32(frame.size() - start - SizeField), header);
+    qToLittleEndian(dropped, header + SizeField);
+    qToLittleEndian(quint16(count), header + SizeField + 4);
+}
+
+qsizetype BLEExportStream::decode(QByteArrayView data, Frame& frame)
+{
+    if (data.size() < SizeField) {
+        return 0;
+    }
+
+    const quint32 size = qFromLittleEndian<quint32>(data.data());
+    if (size < quint32(FrameHeaderSize) || size > quint32(MaxFrameSize)) {
+        return -1;
+    }
+    if (data.size() < SizeField + qsizetype(size)) {
+        return 0;
+    }
+
+    const QByteArrayView body = data.sliced(SizeField, size);
+    frame.dropped = qFromLittleEndian<quint32>(body.data());
+    const quint16 count = qFromLittleEndian<quint16>(body.data() + 4);
+
+    frame.samples.clear();
+    frame.samples.reserve(count);
+
+    qsizetype offset = FrameHeaderSize;
+    for (quint16 i = 0; i < count; ++i) {
+        if (body.size() < offset + RecordSize) {
+            return -1;
+        }
+
+        const char* record = body.data() + offset;
+        BLESample sample;
+        sample.timestamp = qFromLittleEndian<qint64>(record);
+        sample.serviceUuid = qFromLittleEndian<quint32>(record + 8);
+        sample.characterUuid = qFromLittleEndian<quint32>(record + 12);
+
+        //! Standard is the last type
+        const quint8 type = quint8(record[16]);
+        sample.size = quint8(record[17]);
+        if (type > BLESample::Standard || sample.size > BLESample::MaxSize
+            || body.size() < offset + RecordSize + sample.size) {
+            return -1;
+        }
+        sample.type = BLESample::Type(type);
+        sample.intValue = qFromLittleEndian<qint16>(record + 18);
+        sample.floatValue = bitsFloat(qFromLittleEndian<quint32>(record + 20));
+        std::memcpy(sample.data, record + RecordSize, sample.size);
+
+        frame.samples.append(sample);
+        offset += RecordSize + sample.size;
+    }
+
+    return offset == body.size() ? SizeField + qsizetype(size) : -1;
+}
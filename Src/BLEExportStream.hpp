@@ -0,0 +1,353 @@
+#pragma once
+
+#include <QByteArrayView>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+
+#include <atomic>
+#include <vector>
+
+#include "BLESample.hpp"
+
+class QIODevice;
+
+/*!
+ * \brief The BLEExportStream class streams the samples received by the services of one or more
+ * \ref BLERole to a consumer listening on a TCP port or a local socket, e.g. the process that
+ * forwards the data of a gateway. A role exports its samples when its \ref BLERole::exportStream
+ * is set. Samples are queued by any thread and sent in batches: a batch goes out once it has
+ * \ref batchSize samples, or \ref batchDelay after its first sample. The queue holds at most
+ * \ref queueSize samples, while the consumer is slow or away the samples that don't fit are
+ * dropped as \ref dropPolicy says and counted in the next frame. The stream reconnects by itself.
+ *
+ * A frame is, little endian:
+ *  - u32 size of the rest of the frame
+ *  - u32 samples dropped since the previous frame
+ *  - u16 count
+ *  - count records of i64 \ref BLESample::timestamp, u32 service, u32 characteristic, u8 type,
+ *    u8 size, i16 int value, f32 float value and size bytes of raw payload
+ */
+class BLEExportStream : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(Backend backend READ backend WRITE setBackend NOTIFY backendChanged FINAL)
+    Q_PROPERTY(QString host READ host WRITE setHost NOTIFY hostChanged FINAL)
+    Q_PROPERTY(int port READ port WRITE setPort NOTIFY portChanged FINAL)
+    Q_PROPERTY(QString serverName READ serverName WRITE setServerName NOTIFY serverNameChanged FINAL)
+    Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize NOTIFY batchSizeChanged FINAL)
+    Q_PROPERTY(int batchDelay READ batchDelay WRITE setBatchDelay NOTIFY batchDelayChanged FINAL)
+    Q_PROPERTY(int queueSize READ queueSize WRITE setQueueSize NOTIFY queueSizeChanged FINAL)
+    Q_PROPERTY(DropPolicy dropPolicy READ dropPolicy WRITE setDropPolicy NOTIFY dropPolicyChanged FINAL)
+    Q_PROPERTY(bool exporting READ isExporting NOTIFY exportingChanged FINAL)
+    Q_PROPERTY(bool connected READ isConnected NOTIFY connectedChanged FINAL)
+
+public:
+    /*!
+     * \brief The Backend enum lists what carries the stream
+     */
+    enum Backend : quint8 {
+        TcpBackend = 0,     //! A TCP connection to \ref host and \ref port
+        LocalSocketBackend, //! A local socket named \ref serverName
+    };
+    Q_ENUM(Backend)
+
+    /*!
+     * \brief The DropPolicy enum lists which samples are dropped when the queue is full
+     */
+    enum DropPolicy : quint8 {
+        DropOldest = 0, //! The oldest queued sample makes room, the consumer gets the latest values
+        DropNewest,     //! The new sample is dropped, the consumer gets a gap-free prefix
+    };
+    Q_ENUM(DropPolicy)
+
+    /*!
+     * \brief The Frame struct is a decoded frame, see \ref decode()
+     */
+    struct Frame
+    {
+        //! \brief dropped Samples dropped between the previous frame and this one
+        quint32 dropped = 0;
+        QList<BLESample> samples;
+    };
+
+    //! \brief DefaultBatchSize Samples per frame by default
+    static constexpr int DefaultBatchSize = 64;
+
+    //! \brief DefaultBatchDelay Milliseconds a sample waits for its batch to fill by default
+    static constexpr int DefaultBatchDelay = 5;
+
+    //! \brief DefaultQueueSize Samples queued by default
+    static constexpr int DefaultQueueSize = 4096;
+
+    //! \brief MaxPendingBytes Bytes the socket may hold unsent before the samples stay queued
+    static constexpr qint64 MaxPendingBytes = 256 * 1024;
+
+    //! \brief ReconnectInterval Milliseconds between two attempts to connect
+    static constexpr int ReconnectInterval = 1000;
+
+    //! \brief RecordSize Size of a record without its payload
+    static constexpr int RecordSize = 24;
+
+    explicit BLEExportStream(QObject* parent = nullptr);
+    ~BLEExportStream() override;
+
+    /*!
+     * \brief backend Getter for backend
+     */
+    Backend backend() const;
+    void setBackend(Backend backend);
+
+    /*!
+     * \brief host The host of the consumer with \ref TcpBackend, the loopback address by default
+     */
+    QString host() const;
+    void setHost(const QString& host);
+
+    /*!
+     * \brief port The port of the consumer with \ref TcpBackend
+     */
+    int port() const;
+    void setPort(int port);
+
+    /*!
+     * \brief serverName The name of the local socket of the consumer with
+     * \ref LocalSocketBackend
+     */
+    QString serverName() const;
+    void setServerName(const QString& name);
+
+    /*!
+     * \brief batchSize Samples sent in one frame at most, a full batch is sent right away
+     */
+    int batchSize() const;
+    void setBatchSize(int size);
+
+    /*!
+     * \brief batchDelay Milliseconds the first sample of a batch waits for more samples, 0 sends
+     * every sample as soon as the thread of the stream runs
+     */
+    int batchDelay() const;
+    void setBatchDelay(int delay);
+
+    /*!
+     * \brief queueSize Samples waiting to be sent at most, including while disconnected
+     */
+    int queueSize() const;
+    void setQueueSize(int size);
+
+    /*!
+     * \brief dropPolicy Getter for dropPolicy
+     */
+    DropPolicy dropPolicy() const;
+    void setDropPolicy(DropPolicy policy);
+
+    /*!
+     * \brief isExporting Returns true between \ref start() and \ref stop()
+     */
+    bool isExporting() const;
+
+    /*!
+     * \brief isConnected Returns true while the consumer is connected
+     */
+    bool isConnected() const;
+
+    /*!
+     * \brief start Starts queuing samples and connecting to the consumer
+     */
+    Q_INVOKABLE void start();
+
+    /*!
+     * \brief stop Sends the queued samples if connected, then stops exporting and disconnects
+     */
+    Q_INVOKABLE void stop();
+
+    /*!
+     * \brief sent Returns the number of samples handed to the socket
+     */
+    Q_INVOKABLE quint64 sent() const;
+
+    /*!
+     * \brief dropped Returns the number of samples dropped because the queue was full
+     */
+    Q_INVOKABLE quint64 dropped() const;
+
+    /*!
+     * \brief publish Queues a copy of \a sample if exporting. This is thread safe and never
+     * blocks on the consumer. The destructor waits for the calls in progress
+     */
+    void publish(const BLESample& sample);
+
+    /*!
+     * \brief encode Appends the frame of \a count samples to \a frame
+     * \param dropped Samples dropped since the previous frame
+     */
+    static void encode(const BLESample* samples, qsizetype count, quint32 dropped,
+                       QByteArray& frame);
+
+    /*!
+     * \brief decode Reads the frame at the start of \a data into \a frame
+     * \return The size of the frame, 0 if it's not complete yet or -1 if it's malformed
+     */
+    static qsizetype decode(QByteArrayView data, Frame& frame);
+
+signals:
+    void backendChanged();
+    void hostChanged();
+    void portChanged();
+    void serverNameChanged();
+    void batchSizeChanged();
+    void batchDelayChanged();
+    void queueSizeChanged();
+    void dropPolicyChanged();
+    void exportingChanged();
+    void connectedChanged();
+
+private slots:
+    /*!
+     * \brief flush Sends the queued samples in frames of \ref batchSize, unless the consumer is
+     * away or hasn't read what was sent before
+     */
+    void flush();
+
+    /*!
+     * \brief armBatch Starts the delay of the batch that just got its first sample
+     */
+    void armBatch();
+
+private:
+    /*!
+     * \brief connectToConsumer Creates the socket and connects it to the consumer
+     */
+    void connectToConsumer();
+
+    /*!
+     * \brief dropSocket Deletes the socket, the samples it didn't send are lost
+     */
+    void dropSocket();
+
+    void onSocketConnected();
+    void onSocketDisconnected();
+
+    /*!
+     * \brief enqueue Queues a copy of \a sample as \ref dropPolicy says and schedules its batch
+     */
+    void enqueue(const BLESample& sample);
+
+    /*!
+     * \brief warnIfExporting Returns true, with a warning, if \a property can't be changed
+     */
+    bool warnIfExporting(const char* property) const;
+
+private:
+    Backend mBackend;
+    QString mHost;
+    int mPort;
+    QString mServerName;
+    int mBatchSize;
+    int mBatchDelay;
+    int mQueueSize;
+    DropPolicy mDropPolicy;
+
+    //! \brief mMutex Protects \ref mQueue, \ref mQueueHead, \ref mQueueCount, \ref mPendingDrops
+    //! and \ref mExporting
+    QMutex mMutex;
+
+    //! \brief mQueue Ring of \ref queueSize samples waiting to be sent
+    std::vector<BLESample> mQueue;
+
+    //! \brief mQueueHead Index of the oldest queued sample
+    std::size_t mQueueHead;
+
+    //! \brief mQueueCount Number of queued samples
+    std::size_t mQueueCount;
+
+    //! \brief mPendingDrops Samples dropped since the last frame
+    quint32 mPendingDrops;
+
+    bool mExporting;
+
+    //! \brief mFlushScheduled A full batch already scheduled \ref flush()
+    std::atomic<bool> mFlushScheduled;
+
+    //! \brief mClosing Set by the destructor, \ref publish() does nothing afterwards
+    std::atomic<bool> mClosing;
+
+    //! \brief mPublishers Number of \ref publish() calls in progress, the destructor waits for
+    //! them
+    std::atomic<int> mPublishers;
+
+    std::atomic<quint64> mSent;
+    std::atomic<quint64> mDropped;
+
+    //! \brief mSocket A QTcpSocket or a QLocalSocket, null while not exporting
+    QIODevice* mSocket;
+    bool mConnected;
+
+    //! \brief mFrame Frames encoded by \ref flush(), reused to avoid an allocation per batch
+    QByteArray mFrame;
+
+    //! \brief mBatch Samples taken from the queue by \ref flush()
+    std::vector<BLESample> mBatch;
+
+    QTimer* mBatchTimer;
+    QTimer* mReconnectTimer;
+};
+
+
+inline BLEExportStream::Backend BLEExportStream::backend() const
+{
+    return mBackend;
+}
+
+inline QString BLEExportStream::host() const
+{
+    return mHost;
+}
+
+inline int BLEExportStream::port() const
+{
+    return mPort;
+}
+
+inline QString BLEExportStream::serverName() const
+{
+    return mServerName;
+}
+
+inline int BLEExportStream::batchSize() const
+{
+    return mBatchSize;
+}
+
+inline int BLEExportStream::batchDelay() const
+{
+    return mBatchDelay;
+}
+
+inline int BLEExportStream::queueSize() const
+{
+    return mQueueSize;
+}
+
+inline BLEExportStream::DropPolicy BLEExportStream::dropPolicy() const
+{
+    return mDropPolicy;
+}
+
+inline bool BLEExportStream::isConnected() const
+{
+    return mConnected;
+}
+
+inline quint64 BLEExportStream::sent() const
+{
+    return mSent.load(std::memory_order_relaxed);
+}
+
+inline quint64 BLEExportStream::dropped() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstddef>
+
+#include "BLESample.hpp"
+
+/*!
+ * \brief The BLEGattSchema class describes services at compile time. A schema file is turned into
+ * a constexpr table of \ref Characteristic by quickbluetooth_add_gatt_schema() in
+ * cmake/QuickBluetoothGattSchema.cmake, along with a class that creates its \ref BLEDataService
+ * instances and builds their \a QLowEnergyServiceData once. The generated code checks the table
+ * with static_assert, so a malformed schema fails the build instead of the first connection
+ */
+class BLEGattSchema
+{
+public:
+    /*!
+     * \brief The Characteristic struct is one \ref BLEDataService of a schema, the fields match
+     * its properties
+     */
+    struct Characteristic
+    {
+        //! \brief name The name of the service in the schema, a C++ and QML identifier
+        const char* name;
+
+        //! \brief service The 16 or 32 bit service uuid
+        quint32 service;
+
+        //! \brief characteristic The 16 or 32 bit characteristic uuid
+        quint32 characteristic;
+
+        BLESample::Type type;
+        quint8 valueLength;
+        bool indicate;
+        bool broadcast;
+
+        //! \brief encoding A \ref BLEDataService::Encoding
+        quint8 encoding;
+
+        //! \brief keyFrameInterval Frames between two key frames with
+        //! \ref BLEDataService::DeltaEncoding
+        int keyFrameInterval;
+
+        bool stamped;
+
+        //! \brief priority A \ref BLEDataService::Priority
+        quint8 priority;
+
+        int deadline;
+        bool adaptiveRate;
+    };
+
+    /*!
+     * \brief valid Returns true if every field of \a characteristic is in range, ie the uuids
+     * are set, the value length fits in a sample and only Int values are delta encoded
+     */
+    static constexpr bool valid(const Characteristic& characteristic);
+
+    /*!
+     * \brief unique Returns true if no two of \a characteristics have the same service and
+     * characteristic uuids
+     */
+    template <std::size_t N>
+    static constexpr bool unique(const Characteristic (&characteristics)[N]);
+};
+
+
+constexpr bool BLEGattSchema::valid(const Characteristic& characteristic)
+{
+    return characteristic.name && characteristic.name[0] != '\0' && characteristic.service != 0
+           && characteristic.characteristic != 0 && characteristic.type <= BLESample::Standard
+           && characteristic.valueLength >= 1 && characteristic.valueLength <= BLESample::MaxSize
+           && characteristic.encoding <= 1
+           && (characteristic.encoding == 0 || characteristic.type == BLESample::Int)
+           && characteristic.keyFrameInterval >= 1 && characteristic.priority <= 3
+           && characteristic.deadline >= 0;
+}
+
+template <std::size_t N>
+constexpr bool BLEGattSchema::unique(const Characteristic (&characteristics)[N])
+{
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = i + 1; j < N; ++j) {
+            if (characteristics[i].service == characteristics[j].service
+                && characteristics[i].characteristic == characteristics[j].characteristic) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
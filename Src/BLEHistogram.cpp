@@ -0,0 +1,75 @@
+#include "BLEHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+BLEHistogram::BLEHistogram()
+    : mCount { 0 }
+    , mSum { 0 }
+    , mMax { 0 }
+{
+    for (std::atomic<quint64>& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+qreal BLEHistogram::mean() const
+{
+    const quint64 n = count();
+    return n ? qreal(sum()) / n : 0;
+}
+
+quint64 BLEHistogram::percentile(qreal p) const
+{
+    const quint64 n = count();
+    if (n == 0) {
+        return 0;
+    }
+
+    //! Rank of the value, the buckets may hold a few more values than n if recording goes on
+    const quint64 rank = std::max<quint64>(1, quint64(std::ceil(qBound(0.0, p, 100.0) / 100 * n)));
+
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += mBuckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(upperBound(i), max());
+        }
+    }
+
+    return max();
+}
+
+void BLEHistogram::reset()
+{
+    for (std::atomic<quint64>& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    mCount.store(0, std::memory_order_relaxed);
+    mSum.store(0, std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+QVariantMap BLEHistogram::toVariantMap(qreal scale) const
+{
+    return {
+        { QStringLiteral("count"), count() },
+        { QStringLiteral("mean"), mean() / scale },
+        { QStringLiteral("p50"), percentile(50) / scale },
+        { QStringLiteral("p90"), percentile(90) / scale },
+        { QStringLiteral("p99"), percentile(99) / scale },
+        { QStringLiteral("max"), max() / scale },
+    };
+}
+
+quint64 BLEHistogram::upperBound(int index)
+{
+    if (index < SubBuckets) {
+        return quint64(index);
+    }
+
+    const int shift = index / SubBuckets - 1;
+    const int sub = index % SubBuckets;
+    const quint64 lower = (quint64(SubBuckets + sub) << shift);
+    return lower + ((quint64(1) << shift) - 1);
+}
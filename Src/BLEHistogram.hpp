@@ -0,0 +1,129 @@
+#pragma once
+
+#include <QVariantMap>
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+
+/*!
+ * \brief The BLEHistogram class is a lock-free histogram of unsigned values such as durations in
+ * nanoseconds or queue depths. Values are counted in logarithmic buckets, each power of two split
+ * in \ref SubBuckets buckets, so percentiles are accurate to 25% from one to 2^64 with a fixed
+ * amount of memory. Recording is a few relaxed atomic operations and is safe from any thread
+ */
+class BLEHistogram
+{
+public:
+    //! \brief SubBits Number of bits below the most significant bit that select a sub bucket
+    static constexpr int SubBits = 2;
+
+    //! \brief SubBuckets Number of buckets each power of two is split into
+    static constexpr int SubBuckets = 1 << SubBits;
+
+    //! \brief BucketCount Number of buckets needed to cover every 64 bit value
+    static constexpr int BucketCount = (64 - SubBits + 1) * SubBuckets;
+
+    BLEHistogram();
+
+    BLEHistogram(const BLEHistogram&) = delete;
+    BLEHistogram& operator=(const BLEHistogram&) = delete;
+
+    /*!
+     * \brief record Adds \a value to the histogram
+     */
+    void record(quint64 value);
+
+    /*!
+     * \brief count Returns the number of recorded values
+     */
+    quint64 count() const;
+
+    /*!
+     * \brief sum Returns the sum of the recorded values
+     */
+    quint64 sum() const;
+
+    /*!
+     * \brief max Returns the largest recorded value
+     */
+    quint64 max() const;
+
+    /*!
+     * \brief mean Returns the average of the recorded values, 0 if there is none
+     */
+    qreal mean() const;
+
+    /*!
+     * \brief percentile Returns the upper bound of the bucket holding the \a p percentile, \a p is
+     * in [0, 100]
+     */
+    quint64 percentile(qreal p) const;
+
+    /*!
+     * \brief reset Forgets every recorded value. Values recorded concurrently may be lost
+     */
+    void reset();
+
+    /*!
+     * \brief toVariantMap Returns count, mean, p50, p90, p99 and max with the values divided by
+     * \a scale, ie 1000 to turn nanoseconds into microseconds
+     */
+    QVariantMap toVariantMap(qreal scale = 1) const;
+
+    /*!
+     * \brief indexOf Returns the bucket that \a value is counted in
+     */
+    static int indexOf(quint64 value);
+
+    /*!
+     * \brief upperBound Returns the largest value counted in the bucket \a index
+     */
+    static quint64 upperBound(int index);
+
+private:
+    std::array<std::atomic<quint64>, BucketCount> mBuckets;
+    std::atomic<quint64> mCount;
+    std::atomic<quint64> mSum;
+    std::atomic<quint64> mMax;
+};
+
+
+inline void BLEHistogram::record(quint64 value)
+{
+    mBuckets[indexOf(value)].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(value, std::memory_order_relaxed);
+
+    quint64 max = mMax.load(std::memory_order_relaxed);
+    while (value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+inline quint64 BLEHistogram::count() const
+{
+    return mCount.load(std::memory_order_relaxed);
+}
+
+inline quint64 BLEHistogram::sum() const
+{
+    return mSum.load(std::memory_order_relaxed);
+}
+
+inline quint64 BLEHistogram::max() const
+{
+    return mMax.load(std::memory_order_relaxed);
+}
+
+inline int BLEHistogram::indexOf(quint64 value)
+{
+    if (value < quint64(SubBuckets)) {
+        return int(value);
+    }
+
+    const int msb = 63 - int(qCountLeadingZeroBits(value));
+    const int shift = msb - SubBits;
+    const int sub = int((value >> shift) & (SubBuckets - 1));
+    return (shift + 1) * SubBuckets + sub;
+}
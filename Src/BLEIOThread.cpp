@@ -0,0 +1,48 @@
+#include "BLEIOThread.hpp"
+
+#include <QCoreApplication>
+
+//! \brief Initialize the single instance
+BLEIOThread* BLEIOThread::sInstance = nullptr;
+
+BLEIOThread& BLEIOThread::instance()
+{
+    if (!sInstance) {
+        sInstance = new BLEIOThread;
+    }
+
+    return *sInstance;
+}
+
+BLEIOThread::BLEIOThread(QObject* parent)
+    : QObject{ parent }
+    , mThread { new QThread(this) }
+    , mContext { new QObject }
+{
+    mThread->setObjectName("QuickBluetooth I/O");
+    mContext->moveToThread(mThread);
+
+    //! The context is deleted in the I/O thread right before it exits
+    connect(mThread, &QThread::finished, mContext, &QObject::deleteLater);
+
+    if (qApp) {
+        connect(qApp, &QCoreApplication::aboutToQuit, this, &BLEIOThread::stop);
+    }
+
+    mThread->start();
+}
+
+BLEIOThread::~BLEIOThread()
+{
+    stop();
+}
+
+void BLEIOThread::stop()
+{
+    if (!mThread->isRunning()) {
+        return;
+    }
+
+    mThread->quit();
+    mThread->wait();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+
+/*!
+ * \brief The BLEIOThread class owns the dedicated thread that BLE controllers, services and the
+ * decoding of received values run on when a \ref BLERole uses \ref BLERole::IOThreadMode. There is a
+ * single I/O thread shared by all roles, it is started on first use and stopped when the
+ * application quits
+ */
+class BLEIOThread : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * \brief instance Returns the single instance of this class
+     */
+    static BLEIOThread& instance();
+
+    /*!
+     * \brief ioThread Returns the I/O thread
+     */
+    QThread* ioThread() const;
+
+    /*!
+     * \brief context Returns an object living in the I/O thread which can be used as the context of
+     * connections and invocations that must run on the I/O thread
+     */
+    QObject* context() const;
+
+    /*!
+     * \brief isCurrentThread Returns true if called from the I/O thread
+     */
+    bool isCurrentThread() const;
+
+    /*!
+     * \brief post Queues \a func to be called on the I/O thread. It is called directly if this is
+     * already the I/O thread
+     */
+    template <typename Func>
+    void post(Func&& func);
+
+    /*!
+     * \brief run Calls \a func on the I/O thread and blocks until it returns. It is called
+     * directly if this is already the I/O thread, or if the I/O thread stopped since nothing runs
+     * there anymore
+     */
+    template <typename Func>
+    void run(Func&& func);
+
+    /*!
+     * \brief stop Quits the I/O thread and waits for it to finish
+     */
+    void stop();
+
+private:
+    explicit BLEIOThread(QObject* parent = nullptr);
+    ~BLEIOThread() override;
+
+private:
+    //! \brief The single instance of this class
+    static BLEIOThread* sInstance;
+
+    //! \brief mThread The I/O thread
+    QThread* mThread;
+
+    //! \brief mContext An object which lives in \ref mThread
+    QObject* mContext;
+};
+
+
+inline QThread* BLEIOThread::ioThread() const
+{
+    return mThread;
+}
+
+inline QObject* BLEIOThread::context() const
+{
+    return mContext;
+}
+
+inline bool BLEIOThread::isCurrentThread() const
+{
+    return QThread::currentThread() == mThread;
+}
+
+template <typename Func>
+inline void BLEIOThread::post(Func&& func)
+{
+    if (isCurrentThread()) {
+        func();
+        return;
+    }
+
+    QMetaObject::invokeMethod(mContext, std::forward<Func>(func), Qt::QueuedConnection);
+}
+
+template <typename Func>
+inline void BLEIOThread::run(Func&& func)
+{
+    if (isCurrentThread() || !mThread->isRunning()) {
+        func();
+        return;
+    }
+
+    QMetaObject::invokeMethod(mContext, std::forward<Func>(func), Qt::BlockingQueuedConnection);
+}
@@ -0,0 +1,297 @@
+#include "BLELoopbackLink.hpp"
+#include "BLELoopbackTransport.hpp"
+#include "BluetoothDeviceInfo.hpp"
+
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+
+namespace {
+
+//! \brief Index of the direction that delivers to a transport with the given role
+int directionOf(int role)
+{
+    return role == QLowEnergyController::CentralRole ? 0 : 1;
+}
+
+} // namespace
+
+BLELoopbackLink::BLELoopbackLink(QObject* parent)
+    : QObject{ parent }
+    , mTimer { new QTimer(this) }
+    , mPumpScheduled { false }
+    , mRandom { 0 }
+    , mDevice { nullptr }
+    , mLatency { 0 }
+    , mMtu { 23 }
+    , mPacketLoss { 0 }
+    , mConnectionInterval { 0 }
+    , mPacketsPerEvent { 4 }
+    , mSeed { 0 }
+{
+    QBluetoothDeviceInfo info(addressOf(QLowEnergyController::PeripheralRole),
+                              QStringLiteral("Loopback"), 0);
+    info.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+    mDevice = new BluetoothDeviceInfo(info, this);
+
+    mClock.start();
+
+    mTimer->setSingleShot(true);
+    mTimer->setTimerType(Qt::PreciseTimer);
+    connect(mTimer, &QTimer::timeout, this, &BLELoopbackLink::pump);
+}
+
+BLELoopbackLink::~BLELoopbackLink() = default;
+
+QBluetoothAddress BLELoopbackLink::addressOf(int role)
+{
+    return QBluetoothAddress(role == QLowEnergyController::CentralRole ? 0x02 : 0x01);
+}
+
+void BLELoopbackLink::setLatency(int latency)
+{
+    QMutexLocker locker(&mMutex);
+    if (mLatency == latency || latency < 0) {
+        return;
+    }
+
+    mLatency = latency;
+    locker.unlock();
+    emit latencyChanged();
+}
+
+void BLELoopbackLink::setMtu(int mtu)
+{
+    QMutexLocker locker(&mMutex);
+    if (mMtu == mtu || mtu < 23 || mtu > 517) {
+        return;
+    }
+
+    mMtu = mtu;
+    locker.unlock();
+    emit mtuChanged();
+}
+
+void BLELoopbackLink::setPacketLoss(qreal packetLoss)
+{
+    QMutexLocker locker(&mMutex);
+    packetLoss = std::clamp(packetLoss, 0.0, 1.0);
+    if (qFuzzyCompare(mPacketLoss + 1, packetLoss + 1)) {
+        return;
+    }
+
+    mPacketLoss = packetLoss;
+    locker.unlock();
+    emit packetLossChanged();
+}
+
+void BLELoopbackLink::setConnectionInterval(qreal interval)
+{
+    QMutexLocker locker(&mMutex);
+    if (qFuzzyCompare(mConnectionInterval + 1, interval + 1) || interval < 0) {
+        return;
+    }
+
+    mConnectionInterval = interval;
+    locker.unlock();
+    emit connectionIntervalChanged();
+}
+
+void BLELoopbackLink::setPacketsPerEvent(int packets)
+{
+    QMutexLocker locker(&mMutex);
+    if (mPacketsPerEvent == packets || packets < 1) {
+        return;
+    }
+
+    mPacketsPerEvent = packets;
+    locker.unlock();
+    emit packetsPerEventChanged();
+}
+
+void BLELoopbackLink::setSeed(quint32 seed)
+{
+    QMutexLocker locker(&mMutex);
+    if (mSeed == seed) {
+        return;
+    }
+
+    mSeed = seed;
+    mRandom.seed(seed);
+    locker.unlock();
+    emit seedChanged();
+}
+
+void BLELoopbackLink::attach(BLELoopbackTransport* transport)
+{
+    QMutexLocker locker(&mMutex);
+    Direction& direction = mDirections[directionOf(transport->role())];
+    direction.target = transport;
+    direction.queue.clear();
+}
+
+void BLELoopbackLink::detach(BLELoopbackTransport* transport)
+{
+    QMutexLocker locker(&mMutex);
+    Direction& direction = mDirections[directionOf(transport->role())];
+    if (direction.target == transport) {
+        direction.target = nullptr;
+        direction.queue.clear();
+    }
+}
+
+bool BLELoopbackLink::send(const BLELoopbackTransport* from, BLELoopbackPacket packet)
+{
+    QMutexLocker locker(&mMutex);
+
+    //! Packets go to the other end of the link
+    Direction& direction = mDirections[1 - directionOf(from->role())];
+    if (!direction.target) {
+        return false;
+    }
+
+    const qint64 now = mClock.nsecsElapsed();
+    const int payload = mMtu - 3;
+    int packets = 1;
+
+    if (packet.kind == BLELoopbackPacket::Notification
+        || packet.kind == BLELoopbackPacket::Indication) {
+        //! Notifications are not fragmented, whatever doesn't fit in the MTU is lost
+        packet.value.truncate(payload);
+    } else if (packet.value.size() > payload) {
+        //! Long writes and reads take one packet per MTU sized chunk
+        packets = int((packet.value.size() + payload - 1) / payload);
+    }
+
+    const qint64 sendTime = scheduleLocked(direction, now, packets);
+
+    const bool lost = packet.kind == BLELoopbackPacket::Notification && mPacketLoss > 0
+                      && std::uniform_real_distribution<qreal>(0, 1)(mRandom) < mPacketLoss;
+
+    if (lost) {
+        //! The sender still sees the notification leave
+        BLELoopbackPacket sent;
+        sent.kind = BLELoopbackPacket::NotificationSent;
+        sent.service = packet.service;
+        sent.characteristic = packet.characteristic;
+        sent.value = packet.value;
+
+        Direction& back = mDirections[directionOf(from->role())];
+        back.queue.push_back(Queued { sendTime, sendTime, std::move(sent), true });
+    } else {
+        direction.queue.push_back(
+            Queued { sendTime, sendTime + qint64(mLatency) * 1000000, std::move(packet), false });
+    }
+
+    locker.unlock();
+
+    //! The timer lives in the thread of the link, one pump is enough for any number of packets
+    if (!mPumpScheduled.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, &BLELoopbackLink::pump, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+qint64 BLELoopbackLink::scheduleLocked(Direction& direction, qint64 now, int packets)
+{
+    if (mConnectionInterval <= 0) {
+        return now;
+    }
+
+    const qint64 interval = qint64(mConnectionInterval * 1000000);
+    qint64 event = ((now + interval - 1) / interval) * interval;
+
+    if (event <= direction.lastEvent) {
+        event = direction.lastEvent;
+    } else {
+        direction.lastEvent = event;
+        direction.usedInEvent = 0;
+    }
+
+    //! Move to later events while the packets don't fit in the current one
+    while (direction.usedInEvent + packets > mPacketsPerEvent
+           && direction.usedInEvent > 0) {
+        event += interval;
+        direction.lastEvent = event;
+        direction.usedInEvent = 0;
+    }
+
+    direction.usedInEvent += packets;
+    return event;
+}
+
+void BLELoopbackLink::pump()
+{
+    mPumpScheduled.store(false, std::memory_order_release);
+
+    QList<QPair<QPointer<BLELoopbackTransport>, BLELoopbackPacket>> due;
+    qint64 next = -1;
+
+    {
+        QMutexLocker locker(&mMutex);
+        const qint64 now = mClock.nsecsElapsed();
+
+        for (int d = 0; d < 2; ++d) {
+            Direction& direction = mDirections[d];
+            Direction& back = mDirections[1 - d];
+
+            for (auto it = direction.queue.begin(); it != direction.queue.end();) {
+                //! Report notifications to their sender once they leave it
+                if (it->packet.kind == BLELoopbackPacket::Notification && !it->sentReported
+                    && it->sendTime <= now) {
+                    BLELoopbackPacket sent;
+                    sent.kind = BLELoopbackPacket::NotificationSent;
+                    sent.service = it->packet.service;
+                    sent.characteristic = it->packet.characteristic;
+                    sent.value = it->packet.value;
+                    due.append({ back.target, std::move(sent) });
+                    it->sentReported = true;
+                }
+
+                if (it->dueTime <= now) {
+                    due.append({ direction.target, std::move(it->packet) });
+                    it = direction.queue.erase(it);
+                    continue;
+                }
+
+                const qint64 wake = it->sentReported ? it->dueTime
+                                                     : std::min(it->sendTime, it->dueTime);
+                next = next < 0 ? wake : std::min(next, wake);
+                ++it;
+            }
+        }
+
+        if (next >= 0) {
+            const qint64 wait = (next - now + 999999) / 1000000;
+            mTimer->start(int(std::max<qint64>(wait, 0)));
+        }
+
+        //! A transport of another thread is only used while the lock keeps it attached, its
+        //! destructor detaches it. The packets are posted to it and dropped by Qt if it's deleted
+        //! before they run
+        for (auto it = due.begin(); it != due.end();) {
+            if (it->first && it->first->thread() != QThread::currentThread()) {
+                post(it->first, std::move(it->second));
+                it = due.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    //! Deliver to the transports of this thread without holding the lock since receivers may
+    //! send right away, they can only be deleted on this thread
+    for (const auto& [target, packet] : std::as_const(due)) {
+        if (target) {
+            target->receive(packet);
+        }
+    }
+}
+
+void BLELoopbackLink::post(BLELoopbackTransport* target, BLELoopbackPacket packet)
+{
+    QMetaObject::invokeMethod(target, [target, packet = std::move(packet)]() {
+        target->receive(packet);
+    }, Qt::QueuedConnection);
+}
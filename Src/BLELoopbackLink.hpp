@@ -0,0 +1,260 @@
+#pragma once
+
+#include <QObject>
+#include <QBluetoothUuid>
+#include <QElapsedTimer>
+#include <QLowEnergyConnectionParameters>
+#include <QMutex>
+#include <QPointer>
+#include <QTimer>
+
+#include <atomic>
+#include <deque>
+#include <random>
+
+#include "BluetoothDeviceInfo.hpp"
+
+class BLELoopbackTransport;
+
+/*!
+ * \brief The BLELoopbackPacket struct is a message carried by a \ref BLELoopbackLink between the
+ * two \ref BLELoopbackTransport ends of the link
+ */
+struct BLELoopbackPacket
+{
+    enum Kind : quint8 {
+        ConnectRequest,
+        ConnectResponse,
+        ConnectFailed,
+        Disconnect,
+        DiscoverRequest,
+        DiscoverResponse,
+        DetailsRequest,
+        DetailsResponse,
+        WriteRequest,
+        WriteResponse,
+        ReadRequest,
+        ReadResponse,
+        DescriptorWriteRequest,
+        DescriptorWriteResponse,
+        Notification,
+        NotificationSent,   //! Sent back to the peripheral when a notification leaves it
+        Indication,
+        IndicationConfirm,
+        ConnectionUpdateRequest,    //! Sent by the peripheral, the central picks the parameters
+        ConnectionUpdate,           //! Sent by the central with the parameters in effect
+    };
+
+    Kind kind = ConnectRequest;
+    QBluetoothUuid service;
+    QBluetoothUuid characteristic;
+    QBluetoothUuid descriptor;
+    QByteArray value;
+    QList<QBluetoothUuid> services;
+    QLowEnergyConnectionParameters connectionParameters;
+};
+
+/*!
+ * \brief The BLELoopbackLink class connects a central and a peripheral \ref BLELoopbackTransport in
+ * the same process. It simulates the latency, ATT MTU, notification loss and connection interval
+ * of a real link so the data path can be exercised, benchmarked and load tested without a radio.
+ * A \ref BLERole uses a loopback transport when its \ref BLERole::loopbackLink is set and a
+ * \ref BLECentral connects to the link's peripheral by setting its device to \ref device()
+ */
+class BLELoopbackLink : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int latency READ latency WRITE setLatency NOTIFY latencyChanged FINAL)
+    Q_PROPERTY(int mtu READ mtu WRITE setMtu NOTIFY mtuChanged FINAL)
+    Q_PROPERTY(qreal packetLoss READ packetLoss WRITE setPacketLoss NOTIFY packetLossChanged FINAL)
+    Q_PROPERTY(qreal connectionInterval READ connectionInterval WRITE setConnectionInterval NOTIFY connectionIntervalChanged FINAL)
+    Q_PROPERTY(int packetsPerEvent READ packetsPerEvent WRITE setPacketsPerEvent NOTIFY packetsPerEventChanged FINAL)
+    Q_PROPERTY(quint32 seed READ seed WRITE setSeed NOTIFY seedChanged FINAL)
+    Q_PROPERTY(BluetoothDeviceInfo* device READ device CONSTANT)
+
+public:
+    explicit BLELoopbackLink(QObject* parent = nullptr);
+    ~BLELoopbackLink() override;
+
+    /*!
+     * \brief latency One way latency of a packet in milliseconds, added after the connection event
+     * the packet is sent in
+     */
+    int latency() const;
+    void setLatency(int latency);
+
+    /*!
+     * \brief mtu The ATT MTU, notifications carry at most mtu - 3 bytes and longer values are
+     * truncated like a real link does
+     */
+    int mtu() const;
+    void setMtu(int mtu);
+
+    /*!
+     * \brief packetLoss Probability in [0, 1] of losing a notification. Requests and responses are
+     * never lost since they are acknowledged by ATT
+     */
+    qreal packetLoss() const;
+    void setPacketLoss(qreal packetLoss);
+
+    /*!
+     * \brief connectionInterval The connection interval in milliseconds. Packets are only sent at
+     * connection events, 0 sends them immediately
+     */
+    qreal connectionInterval() const;
+    void setConnectionInterval(qreal interval);
+
+    /*!
+     * \brief packetsPerEvent Maximum number of packets sent in each direction per connection event
+     */
+    int packetsPerEvent() const;
+    void setPacketsPerEvent(int packets);
+
+    /*!
+     * \brief seed Seed of the random generator deciding lost packets, so runs are reproducible
+     */
+    quint32 seed() const;
+    void setSeed(quint32 seed);
+
+    /*!
+     * \brief device Returns the device info that a \ref BLECentral uses to connect to the
+     * peripheral of this link
+     */
+    BluetoothDeviceInfo* device() const;
+
+    /*!
+     * \brief attach Attaches \a transport as the end of its role, replacing any previous one
+     */
+    void attach(BLELoopbackTransport* transport);
+
+    /*!
+     * \brief detach Detaches \a transport, packets in flight to it are dropped
+     */
+    void detach(BLELoopbackTransport* transport);
+
+    /*!
+     * \brief send Sends \a packet from \a from to the other end of the link. This is thread safe
+     * \return False if the other end is not attached
+     */
+    bool send(const BLELoopbackTransport* from, BLELoopbackPacket packet);
+
+    /*!
+     * \brief addressOf Returns the address of the end of the link with the given role
+     */
+    static QBluetoothAddress addressOf(int role);
+
+signals:
+    void latencyChanged();
+    void mtuChanged();
+    void packetLossChanged();
+    void connectionIntervalChanged();
+    void packetsPerEventChanged();
+    void seedChanged();
+
+private slots:
+    /*!
+     * \brief pump Delivers the packets that are due and schedules the next delivery
+     */
+    void pump();
+
+private:
+    /*!
+     * \brief The Queued struct is a packet waiting for delivery
+     */
+    struct Queued
+    {
+        qint64 sendTime;        //! Connection event the packet is sent in, in nanoseconds
+        qint64 dueTime;         //! Arrival time in nanoseconds
+        BLELoopbackPacket packet;
+        bool sentReported;      //! True when \a NotificationSent is already reported
+    };
+
+    /*!
+     * \brief The Direction struct holds the packets going to one end of the link
+     */
+    struct Direction
+    {
+        QPointer<BLELoopbackTransport> target;
+        std::deque<Queued> queue;
+        qint64 lastEvent = -1;
+        int usedInEvent = 0;
+    };
+
+    /*!
+     * \brief scheduleLocked Returns the connection event a new packet is sent in and reserves its
+     * slot. \ref mMutex must be locked
+     */
+    qint64 scheduleLocked(Direction& direction, qint64 now, int packets);
+
+    /*!
+     * \brief post Hands \a packet to \a target on its thread. \ref mMutex must be locked so
+     * \a target stays attached until the packet is posted
+     */
+    static void post(BLELoopbackTransport* target, BLELoopbackPacket packet);
+
+private:
+    //! \brief mMutex Protects the directions and the random generator
+    QMutex mMutex;
+
+    //! \brief mDirections Index 0 goes to the central, 1 goes to the peripheral
+    Direction mDirections[2];
+
+    //! \brief mClock Time base of the link
+    QElapsedTimer mClock;
+
+    //! \brief mTimer Fires when the next packet is due, lives in the thread of the link
+    QTimer* mTimer;
+
+    //! \brief mPumpScheduled True while a call to \ref pump() is queued
+    std::atomic_bool mPumpScheduled;
+
+    //! \brief mRandom Decides which notifications are lost
+    std::mt19937 mRandom;
+
+    //! \brief mDevice The device info of the peripheral end
+    BluetoothDeviceInfo* mDevice;
+
+    int mLatency;
+    int mMtu;
+    qreal mPacketLoss;
+    qreal mConnectionInterval;
+    int mPacketsPerEvent;
+    quint32 mSeed;
+};
+
+
+inline int BLELoopbackLink::latency() const
+{
+    return mLatency;
+}
+
+inline int BLELoopbackLink::mtu() const
+{
+    return mMtu;
+}
+
+inline qreal BLELoopbackLink::packetLoss() const
+{
+    return mPacketLoss;
+}
+
+inline qreal BLELoopbackLink::connectionInterval() const
+{
+    return mConnectionInterval;
+}
+
+inline int BLELoopbackLink::packetsPerEvent() const
+{
+    return mPacketsPerEvent;
+}
+
+inline quint32 BLELoopbackLink::seed() const
+{
+    return mSeed;
+}
+
+inline BluetoothDeviceInfo* BLELoopbackLink::device() const
+{
+    return mDevice;
+}
@@ -0,0 +1,429 @@
+#include "BLELoopbackTransport.hpp"
+#include "BLETrace.hpp"
+
+#include <QLowEnergyCharacteristicData>
+
+BLELoopbackTransport::BLELoopbackTransport(BLELoopbackLink* link, Role role, QObject* parent)
+    : BLETransport{ role, parent }
+    , mLink { link }
+    , mAdvertising { false }
+    , mConnectable { true }
+{
+    if (mLink) {
+        mLink->attach(this);
+    }
+}
+
+BLELoopbackTransport::~BLELoopbackTransport()
+{
+    if (mLink) {
+        mLink->detach(this);
+    }
+}
+
+QString BLELoopbackTransport::errorString() const
+{
+    return mErrorString;
+}
+
+QBluetoothAddress BLELoopbackTransport::localAddress() const
+{
+    return BLELoopbackLink::addressOf(role());
+}
+
+QBluetoothAddress BLELoopbackTransport::remoteAddress() const
+{
+    switch (state()) {
+    case QLowEnergyController::UnconnectedState:
+    case QLowEnergyController::ConnectingState:
+    case QLowEnergyController::AdvertisingState:
+        return QBluetoothAddress();
+    default:
+        return BLELoopbackLink::addressOf(role() == QLowEnergyController::CentralRole
+                                              ? QLowEnergyController::PeripheralRole
+                                              : QLowEnergyController::CentralRole);
+    }
+}
+
+int BLELoopbackTransport::mtu() const
+{
+    return mLink ? mLink->mtu() : 23;
+}
+
+bool BLELoopbackTransport::confirmsWrites() const
+{
+    return true;
+}
+
+void BLELoopbackTransport::connectToDevice()
+{
+    if (role() != QLowEnergyController::CentralRole
+        || state() != QLowEnergyController::UnconnectedState) {
+        return;
+    }
+
+    setState(QLowEnergyController::ConnectingState);
+    if (!sendPacket(BLELoopbackPacket::ConnectRequest)) {
+        fail(QLowEnergyController::UnknownRemoteDeviceError,
+             QStringLiteral("There is no peripheral on the loopback link"));
+    }
+}
+
+void BLELoopbackTransport::disconnectFromDevice()
+{
+    if (state() == QLowEnergyController::UnconnectedState
+        || state() == QLowEnergyController::AdvertisingState) {
+        return;
+    }
+
+    sendPacket(BLELoopbackPacket::Disconnect);
+
+    mSubscribed.clear();
+    mOpenServices.clear();
+    setState(QLowEnergyController::UnconnectedState);
+    emit disconnected();
+}
+
+void BLELoopbackTransport::discoverServices()
+{
+    if (role() != QLowEnergyController::CentralRole
+        || state() != QLowEnergyController::ConnectedState) {
+        return;
+    }
+
+    setState(QLowEnergyController::DiscoveringState);
+    sendPacket(BLELoopbackPacket::DiscoverRequest);
+}
+
+bool BLELoopbackTransport::openService(const QBluetoothUuid& service)
+{
+    if (!mRemoteServices.contains(service)) {
+        return false;
+    }
+
+    QB_TRACE_BEGIN("discoverDetails", BLETrace::id(this, service));
+
+    if (mOpenServices.contains(service)) {
+        emit serviceReady(service);
+        return true;
+    }
+
+    return sendPacket(BLELoopbackPacket::DetailsRequest, service);
+}
+
+void BLELoopbackTransport::subscribe(const QBluetoothUuid& service,
+                                     const QBluetoothUuid& characteristic,
+                                     bool indication)
+{
+    BLELoopbackPacket packet;
+    packet.kind = BLELoopbackPacket::DescriptorWriteRequest;
+    packet.service = service;
+    packet.characteristic = characteristic;
+    packet.descriptor = QBluetoothUuid(
+        QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration);
+    packet.value = indication ? QLowEnergyCharacteristic::CCCDEnableIndication
+                              : QLowEnergyCharacteristic::CCCDEnableNotification;
+
+    QB_TRACE_BEGIN("writeCCCD", BLETrace::id(this, service, characteristic));
+    post(std::move(packet));
+}
+
+bool BLELoopbackTransport::addService(const QLowEnergyServiceData& service)
+{
+    if (role() != QLowEnergyController::PeripheralRole || mValues.contains(service.uuid())) {
+        return false;
+    }
+
+    QHash<QBluetoothUuid, QByteArray>& values = mValues[service.uuid()];
+    const QList<QLowEnergyCharacteristicData> characteristics = service.characteristics();
+    for (const QLowEnergyCharacteristicData& charData : characteristics) {
+        values.insert(charData.uuid(), charData.value());
+    }
+
+    return true;
+}
+
+void BLELoopbackTransport::startAdvertising(const QLowEnergyAdvertisingParameters& parameters,
+                                            const QLowEnergyAdvertisingData& advertisingData,
+                                            const QLowEnergyAdvertisingData& scanResponseData)
+{
+    Q_UNUSED(advertisingData);
+    Q_UNUSED(scanResponseData);
+
+    if (role() != QLowEnergyController::PeripheralRole) {
+        return;
+    }
+
+    mAdvertising = true;
+    mConnectable = parameters.mode() == QLowEnergyAdvertisingParameters::AdvInd;
+    if (state() == QLowEnergyController::UnconnectedState) {
+        setState(QLowEnergyController::AdvertisingState);
+    }
+}
+
+void BLELoopbackTransport::stopAdvertising()
+{
+    mAdvertising = false;
+    if (state() == QLowEnergyController::AdvertisingState) {
+        setState(QLowEnergyController::UnconnectedState);
+    }
+}
+
+bool BLELoopbackTransport::writeCharacteristic(const QBluetoothUuid& service,
+                                               const QBluetoothUuid& characteristic,
+                                               const QByteArray& value)
+{
+    if (role() == QLowEnergyController::CentralRole) {
+        if (!mOpenServices.contains(service)) {
+            return false;
+        }
+
+        QB_TRACE_BEGIN("writeCharacteristic", BLETrace::id(this, service, characteristic));
+        return sendPacket(BLELoopbackPacket::WriteRequest, service, characteristic, value);
+    }
+
+    auto srv = mValues.find(service);
+    if (srv == mValues.end() || !srv->contains(characteristic)) {
+        return false;
+    }
+
+    srv->insert(characteristic, value);
+
+    if (state() == QLowEnergyController::ConnectedState
+        || state() == QLowEnergyController::DiscoveredState) {
+        auto subscription = mSubscribed.constFind(characteristic);
+        if (subscription != mSubscribed.constEnd()) {
+            QB_TRACE_INSTANT("notify");
+            sendPacket(*subscription ? BLELoopbackPacket::Indication
+                                     : BLELoopbackPacket::Notification,
+                       service, characteristic, value);
+        }
+    }
+
+    return true;
+}
+
+void BLELoopbackTransport::readCharacteristic(const QBluetoothUuid& service,
+                                              const QBluetoothUuid& characteristic)
+{
+    if (role() == QLowEnergyController::CentralRole) {
+        QB_TRACE_BEGIN("readCharacteristic", BLETrace::id(this, service, characteristic));
+        sendPacket(BLELoopbackPacket::ReadRequest, service, characteristic);
+        return;
+    }
+
+    auto srv = mValues.constFind(service);
+    if (srv != mValues.constEnd() && srv->contains(characteristic)) {
+        emit characteristicRead(service, characteristic, srv->value(characteristic));
+    }
+}
+
+void BLELoopbackTransport::requestConnectionUpdate(
+    const QLowEnergyConnectionParameters& parameters)
+{
+    if (role() == QLowEnergyController::CentralRole) {
+        updateConnection(parameters);
+        return;
+    }
+
+    BLELoopbackPacket packet;
+    packet.kind = BLELoopbackPacket::ConnectionUpdateRequest;
+    packet.connectionParameters = parameters;
+    post(std::move(packet));
+}
+
+void BLELoopbackTransport::receive(const BLELoopbackPacket& packet)
+{
+    if (role() == QLowEnergyController::CentralRole) {
+        receiveAsCentral(packet);
+    } else {
+        receiveAsPeripheral(packet);
+    }
+}
+
+void BLELoopbackTransport::receiveAsCentral(const BLELoopbackPacket& packet)
+{
+    switch (packet.kind) {
+    case BLELoopbackPacket::ConnectResponse:
+        setState(QLowEnergyController::ConnectedState);
+        emit connected();
+        break;
+    case BLELoopbackPacket::ConnectFailed:
+        fail(QLowEnergyController::UnknownRemoteDeviceError,
+             QStringLiteral("The loopback peripheral is not advertising"));
+        break;
+    case BLELoopbackPacket::Disconnect:
+        mSubscribed.clear();
+        mOpenServices.clear();
+        setState(QLowEnergyController::UnconnectedState);
+        emit disconnected();
+        break;
+    case BLELoopbackPacket::DiscoverResponse:
+        mRemoteServices = packet.services;
+        for (const QBluetoothUuid& uuid : std::as_const(mRemoteServices)) {
+            emit serviceDiscovered(uuid);
+        }
+        setState(QLowEnergyController::DiscoveredState);
+        break;
+    case BLELoopbackPacket::DetailsResponse:
+        mOpenServices.insert(packet.service);
+        emit serviceReady(packet.service);
+        break;
+    case BLELoopbackPacket::WriteResponse:
+        emit characteristicWritten(packet.service, packet.characteristic, packet.value);
+        break;
+    case BLELoopbackPacket::ReadResponse:
+        emit characteristicRead(packet.service, packet.characteristic, packet.value);
+        break;
+    case BLELoopbackPacket::DescriptorWriteResponse:
+        emit descriptorWritten(packet.service, packet.characteristic, packet.descriptor,
+                               packet.value);
+        break;
+    case BLELoopbackPacket::Notification:
+        emit characteristicChanged(packet.service, packet.characteristic, packet.value);
+        break;
+    case BLELoopbackPacket::Indication:
+        //! Confirmed before the value is handled, like the ATT layer does
+        sendPacket(BLELoopbackPacket::IndicationConfirm, packet.service, packet.characteristic,
+                   packet.value);
+        emit characteristicChanged(packet.service, packet.characteristic, packet.value);
+        break;
+    case BLELoopbackPacket::ConnectionUpdateRequest:
+        updateConnection(packet.connectionParameters);
+        break;
+    default:
+        break;
+    }
+}
+
+void BLELoopbackTransport::receiveAsPeripheral(const BLELoopbackPacket& packet)
+{
+    switch (packet.kind) {
+    case BLELoopbackPacket::ConnectRequest:
+        if (!mAdvertising || !mConnectable) {
+            sendPacket(BLELoopbackPacket::ConnectFailed);
+            break;
+        }
+
+        //! Like a real controller, advertising stops once a central is connected
+        mAdvertising = false;
+        sendPacket(BLELoopbackPacket::ConnectResponse);
+        setState(QLowEnergyController::ConnectedState);
+        emit connected();
+        break;
+    case BLELoopbackPacket::Disconnect:
+        mSubscribed.clear();
+        setState(QLowEnergyController::UnconnectedState);
+        emit disconnected();
+        break;
+    case BLELoopbackPacket::DiscoverRequest: {
+        BLELoopbackPacket response;
+        response.kind = BLELoopbackPacket::DiscoverResponse;
+        response.services = mValues.keys();
+        post(std::move(response));
+        break;
+    }
+    case BLELoopbackPacket::DetailsRequest:
+        if (mValues.contains(packet.service)) {
+            sendPacket(BLELoopbackPacket::DetailsResponse, packet.service);
+        }
+        break;
+    case BLELoopbackPacket::WriteRequest: {
+        auto srv = mValues.find(packet.service);
+        if (srv == mValues.end() || !srv->contains(packet.characteristic)) {
+            break;
+        }
+
+        srv->insert(packet.characteristic, packet.value);
+        sendPacket(BLELoopbackPacket::WriteResponse, packet.service, packet.characteristic,
+                   packet.value);
+        emit characteristicChanged(packet.service, packet.characteristic, packet.value);
+        break;
+    }
+    case BLELoopbackPacket::ReadRequest: {
+        auto srv = mValues.constFind(packet.service);
+        if (srv != mValues.constEnd() && srv->contains(packet.characteristic)) {
+            sendPacket(BLELoopbackPacket::ReadResponse, packet.service, packet.characteristic,
+                       srv->value(packet.characteristic));
+        }
+        break;
+    }
+    case BLELoopbackPacket::DescriptorWriteRequest: {
+        if (packet.descriptor
+            == QBluetoothUuid(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration)) {
+            if (packet.value == QLowEnergyCharacteristic::CCCDDisable) {
+                mSubscribed.remove(packet.characteristic);
+            } else {
+                mSubscribed.insert(packet.characteristic,
+                                   packet.value == QLowEnergyCharacteristic::CCCDEnableIndication);
+            }
+        }
+
+        BLELoopbackPacket response = packet;
+        response.kind = BLELoopbackPacket::DescriptorWriteResponse;
+        post(std::move(response));
+        emit descriptorWritten(packet.service, packet.characteristic, packet.descriptor,
+                               packet.value);
+        break;
+    }
+    case BLELoopbackPacket::NotificationSent:
+    case BLELoopbackPacket::IndicationConfirm:
+        emit characteristicWritten(packet.service, packet.characteristic, packet.value);
+        break;
+    case BLELoopbackPacket::ConnectionUpdate:
+        emit connectionUpdated(packet.connectionParameters);
+        break;
+    default:
+        break;
+    }
+}
+
+void BLELoopbackTransport::updateConnection(const QLowEnergyConnectionParameters& parameters)
+{
+    if (!mLink || state() == QLowEnergyController::UnconnectedState) {
+        return;
+    }
+
+    //! The fastest interval allowed is picked, the link uses it for its connection events
+    QLowEnergyConnectionParameters effective = parameters;
+    effective.setIntervalRange(parameters.minimumInterval(), parameters.minimumInterval());
+
+    QMetaObject::invokeMethod(mLink, [link = mLink, interval = effective.minimumInterval()]() {
+        if (link) {
+            link->setConnectionInterval(interval);
+        }
+    });
+
+    BLELoopbackPacket packet;
+    packet.kind = BLELoopbackPacket::ConnectionUpdate;
+    packet.connectionParameters = effective;
+    post(std::move(packet));
+
+    emit connectionUpdated(effective);
+}
+
+bool BLELoopbackTransport::post(BLELoopbackPacket packet)
+{
+    return mLink ? mLink->send(this, std::move(packet)) : false;
+}
+
+bool BLELoopbackTransport::sendPacket(BLELoopbackPacket::Kind kind,
+                                      const QBluetoothUuid& service,
+                                      const QBluetoothUuid& characteristic,
+                                      const QByteArray& value)
+{
+    BLELoopbackPacket packet;
+    packet.kind = kind;
+    packet.service = service;
+    packet.characteristic = characteristic;
+    packet.value = value;
+
+    return post(std::move(packet));
+}
+
+void BLELoopbackTransport::fail(QLowEnergyController::Error error, const QString& description)
+{
+    mErrorString = description;
+    setState(QLowEnergyController::UnconnectedState);
+    emit errorOccurred(error);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+
+#include "BLETransport.hpp"
+#include "BLELoopbackLink.hpp"
+
+/*!
+ * \brief The BLELoopbackTransport class is the \ref BLETransport of one end of a
+ * \ref BLELoopbackLink. The peripheral end keeps the values of its services and the central end
+ * sees them as a remote device, exactly like over a radio. Packets leave through \ref post(), so
+ * a subclass can carry them over another medium, see \ref BLEStreamTransport
+ */
+class BLELoopbackTransport : public BLETransport
+{
+    Q_OBJECT
+
+public:
+    BLELoopbackTransport(BLELoopbackLink* link, Role role, QObject* parent = nullptr);
+    ~BLELoopbackTransport() override;
+
+    QString errorString() const override;
+    QBluetoothAddress localAddress() const override;
+    QBluetoothAddress remoteAddress() const override;
+    int mtu() const override;
+    bool confirmsWrites() const override;
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+    void discoverServices() override;
+    bool openService(const QBluetoothUuid& service) override;
+    void subscribe(const QBluetoothUuid& service,
+                   const QBluetoothUuid& characteristic,
+                   bool indication = false) override;
+
+    bool addService(const QLowEnergyServiceData& service) override;
+    void startAdvertising(const QLowEnergyAdvertisingParameters& parameters,
+                          const QLowEnergyAdvertisingData& advertisingData,
+                          const QLowEnergyAdvertisingData& scanResponseData) override;
+    void stopAdvertising() override;
+
+    bool writeCharacteristic(const QBluetoothUuid& service,
+                             const QBluetoothUuid& characteristic,
+                             const QByteArray& value) override;
+    void readCharacteristic(const QBluetoothUuid& service,
+                            const QBluetoothUuid& characteristic) override;
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters) override;
+
+    /*!
+     * \brief receive Handles a packet from the other end, called by the link on the thread of this
+     * transport
+     */
+    void receive(const BLELoopbackPacket& packet);
+
+protected:
+    /*!
+     * \brief post Sends \a packet to the other end, through \ref mLink by default
+     * \return False if the other end can't be reached
+     */
+    virtual bool post(BLELoopbackPacket packet);
+
+    /*!
+     * \brief fail Reports \a error and drops the connection
+     */
+    void fail(QLowEnergyController::Error error, const QString& description);
+
+private:
+    /*!
+     * \brief receiveAsCentral Handles packets sent by the peripheral
+     */
+    void receiveAsCentral(const BLELoopbackPacket& packet);
+
+    /*!
+     * \brief receiveAsPeripheral Handles packets sent by the central
+     */
+    void receiveAsPeripheral(const BLELoopbackPacket& packet);
+
+    /*!
+     * \brief updateConnection Picks the parameters in effect from the requested \a parameters
+     * like the central of a real link does, applies them to the link and reports them to both ends
+     */
+    void updateConnection(const QLowEnergyConnectionParameters& parameters);
+
+    /*!
+     * \brief sendPacket Sends a packet without a value to the other end
+     */
+    bool sendPacket(BLELoopbackPacket::Kind kind,
+                    const QBluetoothUuid& service = QBluetoothUuid(),
+                    const QBluetoothUuid& characteristic = QBluetoothUuid(),
+                    const QByteArray& value = QByteArray());
+
+private:
+    //! \brief mLink The link this transport is attached to
+    QPointer<BLELoopbackLink> mLink;
+
+    //! \brief mErrorString Description of the last error
+    QString mErrorString;
+
+    //! \brief mAdvertising True while the peripheral end is advertising
+    bool mAdvertising;
+
+    //! \brief mConnectable False if the peripheral end advertises without accepting connections
+    bool mConnectable;
+
+    //! \brief mValues Characteristic values of the local services of a peripheral, by service
+    QHash<QBluetoothUuid, QHash<QBluetoothUuid, QByteArray>> mValues;
+
+    //! \brief mSubscribed Characteristics that the central subscribed to, true for indications
+    QHash<QBluetoothUuid, bool> mSubscribed;
+
+    //! \brief mRemoteServices Services of the peripheral found by the central
+    QList<QBluetoothUuid> mRemoteServices;
+
+    //! \brief mOpenServices Services of the peripheral opened by the central
+    QSet<QBluetoothUuid> mOpenServices;
+};
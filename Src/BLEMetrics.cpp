@@ -0,0 +1,266 @@
+#include "BLEMetrics.hpp"
+#include "BLESample.hpp"
+
+#include <QMetaEnum>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+namespace {
+
+//! \brief Snapshot key of an enum value, ie "Connections" becomes "connections"
+QString keyOf(const QMetaEnum& metaEnum, int value)
+{
+    QString key = QString::fromLatin1(metaEnum.valueToKey(value));
+    if (!key.isEmpty()) {
+        key[0] = key[0].toLower();
+    }
+    return key;
+}
+
+} // namespace
+
+BLEMetrics::Channel::Channel(quint32 service, quint32 characteristic)
+    : serviceUuid { service }
+    , characterUuid { characteristic }
+    , notifications { 0 }
+    , notificationBytes { 0 }
+    , writes { 0 }
+    , writeBytes { 0 }
+    , writeStart { 0 }
+    , lost { 0 }
+    , reordered { 0 }
+    , duplicates { 0 }
+{}
+
+BLEMetrics::BLEMetrics(QObject* parent)
+    : QObject{ parent }
+    , mEnabled { true }
+    , mTimer { new QTimer(this) }
+    , mLastSnapshot { now() }
+    , mLastCounters {}
+{
+    for (std::atomic<quint64>& counter : mCounters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+
+    connect(mTimer, &QTimer::timeout, this, &BLEMetrics::update);
+}
+
+BLEMetrics::~BLEMetrics() = default;
+
+void BLEMetrics::setEnabled(bool enabled)
+{
+    if (mEnabled.exchange(enabled, std::memory_order_relaxed) == enabled) {
+        return;
+    }
+
+    emit enabledChanged();
+}
+
+int BLEMetrics::updateInterval() const
+{
+    return mTimer->isActive() ? mTimer->interval() : 0;
+}
+
+void BLEMetrics::setUpdateInterval(int interval)
+{
+    if (updateInterval() == interval || interval < 0) {
+        return;
+    }
+
+    if (interval > 0) {
+        mTimer->start(interval);
+    } else {
+        mTimer->stop();
+    }
+    emit updateIntervalChanged();
+}
+
+BLEMetrics::Channel* BLEMetrics::channel(quint32 service, quint32 characteristic)
+{
+    QMutexLocker locker(&mMutex);
+
+    for (const std::unique_ptr<Channel>& channel : mChannels) {
+        if (channel->serviceUuid == service && channel->characterUuid == characteristic) {
+            return channel.get();
+        }
+    }
+
+    mChannels.push_back(std::make_unique<Channel>(service, characteristic));
+    return mChannels.back().get();
+}
+
+void BLEMetrics::startWrite(Channel* channel, qsizetype bytes)
+{
+    if (!enabled()) {
+        return;
+    }
+
+    mCounters[Writes].fetch_add(1, std::memory_order_relaxed);
+    mCounters[WriteBytes].fetch_add(quint64(bytes), std::memory_order_relaxed);
+    if (channel) {
+        channel->writes.fetch_add(1, std::memory_order_relaxed);
+        channel->writeBytes.fetch_add(quint64(bytes), std::memory_order_relaxed);
+
+        //! Only the oldest pending write is measured, ATT handles one write at a time anyway
+        qint64 none = 0;
+        channel->writeStart.compare_exchange_strong(none, now(), std::memory_order_relaxed);
+    }
+}
+
+void BLEMetrics::finishWrite(Channel* channel)
+{
+    if (!channel || !enabled()) {
+        return;
+    }
+
+    const qint64 start = channel->writeStart.exchange(0, std::memory_order_relaxed);
+    if (start > 0) {
+        const quint64 latency = quint64(std::max<qint64>(now() - start, 0));
+        channel->writeLatency.record(latency);
+        mHistograms[WriteLatency].record(latency);
+    }
+}
+
+void BLEMetrics::countStamp(Channel* channel, int lost, bool reordered, bool duplicate,
+                            qint64 latency)
+{
+    if (!enabled()) {
+        return;
+    }
+
+    //! A late value takes back the loss counted for it, unsigned atomics wrap both ways
+    if (lost != 0) {
+        mCounters[LostSamples].fetch_add(quint64(qint64(lost)), std::memory_order_relaxed);
+    }
+    if (reordered) {
+        mCounters[ReorderedSamples].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (duplicate) {
+        mCounters[DuplicateSamples].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (latency >= 0) {
+        mHistograms[Latency].record(quint64(latency));
+    }
+
+    if (!channel) {
+        return;
+    }
+
+    if (lost != 0) {
+        channel->lost.fetch_add(quint64(qint64(lost)), std::memory_order_relaxed);
+    }
+    if (reordered) {
+        channel->reordered.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (duplicate) {
+        channel->duplicates.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (latency >= 0) {
+        channel->latency.record(quint64(latency));
+    }
+}
+
+QVariantMap BLEMetrics::snapshot() const
+{
+    QMutexLocker locker(&mMutex);
+    return mSnapshot;
+}
+
+void BLEMetrics::update()
+{
+    QMutexLocker locker(&mMutex);
+
+    const qint64 time = now();
+    const qreal seconds = qreal(time - mLastSnapshot) / 1e9;
+    auto rate = [seconds](quint64 current, quint64 last) -> qreal {
+        return seconds > 0 && current >= last ? qreal(current - last) / seconds : 0;
+    };
+
+    QVariantMap map;
+    map.insert(QStringLiteral("interval"), seconds);
+
+    const QMetaEnum counters = QMetaEnum::fromType<Counter>();
+    for (int i = 0; i < CounterCount; ++i) {
+        const quint64 value = mCounters[i].load(std::memory_order_relaxed);
+        const QString key = keyOf(counters, i);
+        map.insert(key, value);
+        map.insert(key + QStringLiteral("PerSecond"), rate(value, mLastCounters[i]));
+        mLastCounters[i] = value;
+    }
+
+    const QMetaEnum histograms = QMetaEnum::fromType<Histogram>();
+    for (int i = 0; i < HistogramCount; ++i) {
+        //! Durations are reported in microseconds
+        map.insert(keyOf(histograms, i), mHistograms[i].toVariantMap(i == QueueDepth ? 1 : 1000));
+    }
+
+    QVariantList characteristics;
+    for (const std::unique_ptr<Channel>& channel : mChannels) {
+        const quint64 notifications = channel->notifications.load(std::memory_order_relaxed);
+        const quint64 bytes = channel->notificationBytes.load(std::memory_order_relaxed);
+        const QPair<quint64, quint64> last = mLastChannels.value(channel.get());
+
+        characteristics.append(QVariantMap {
+            { QStringLiteral("serviceUuid"), channel->serviceUuid },
+            { QStringLiteral("characterUuid"), channel->characterUuid },
+            { QStringLiteral("notifications"), notifications },
+            { QStringLiteral("notificationsPerSecond"), rate(notifications, last.first) },
+            { QStringLiteral("notificationBytes"), bytes },
+            { QStringLiteral("notificationBytesPerSecond"), rate(bytes, last.second) },
+            { QStringLiteral("writes"), channel->writes.load(std::memory_order_relaxed) },
+            { QStringLiteral("writeBytes"), channel->writeBytes.load(std::memory_order_relaxed) },
+            { QStringLiteral("writeLatency"), channel->writeLatency.toVariantMap(1000) },
+            { QStringLiteral("lost"), channel->lost.load(std::memory_order_relaxed) },
+            { QStringLiteral("reordered"), channel->reordered.load(std::memory_order_relaxed) },
+            { QStringLiteral("duplicates"), channel->duplicates.load(std::memory_order_relaxed) },
+            { QStringLiteral("latency"), channel->latency.toVariantMap(1000) },
+        });
+        mLastChannels.insert(channel.get(), { notifications, bytes });
+    }
+    map.insert(QStringLiteral("characteristics"), characteristics);
+
+    mSnapshot = map;
+    mLastSnapshot = time;
+    locker.unlock();
+
+    emit updated();
+}
+
+void BLEMetrics::reset()
+{
+    QMutexLocker locker(&mMutex);
+
+    for (std::atomic<quint64>& counter : mCounters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (BLEHistogram& histogram : mHistograms) {
+        histogram.reset();
+    }
+    for (const std::unique_ptr<Channel>& channel : mChannels) {
+        channel->notifications.store(0, std::memory_order_relaxed);
+        channel->notificationBytes.store(0, std::memory_order_relaxed);
+        channel->writes.store(0, std::memory_order_relaxed);
+        channel->writeBytes.store(0, std::memory_order_relaxed);
+        channel->writeStart.store(0, std::memory_order_relaxed);
+        channel->writeLatency.reset();
+        channel->lost.store(0, std::memory_order_relaxed);
+        channel->reordered.store(0, std::memory_order_relaxed);
+        channel->duplicates.store(0, std::memory_order_relaxed);
+        channel->latency.reset();
+    }
+
+    mSnapshot.clear();
+    mLastCounters.fill(0);
+    mLastChannels.clear();
+    mLastSnapshot = now();
+    locker.unlock();
+
+    emit updated();
+}
+
+qint64 BLEMetrics::now()
+{
+    return BLESample::now();
+}
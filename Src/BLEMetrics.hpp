@@ -0,0 +1,271 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "BLEHistogram.hpp"
+
+/*!
+ * \brief The BLEMetrics class holds the runtime counters and histograms of a \ref BLERole or a
+ * \ref BluetoothDiscovery. Recording uses relaxed atomics only and is safe from any thread, so it
+ * can stay enabled on the I/O thread. \ref update() computes the \ref snapshot and the rates
+ * since the previous update. From QML, set \ref updateInterval and bind to \ref snapshot
+ */
+class BLEMetrics : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY enabledChanged FINAL)
+    Q_PROPERTY(int updateInterval READ updateInterval WRITE setUpdateInterval NOTIFY updateIntervalChanged FINAL)
+    Q_PROPERTY(QVariantMap snapshot READ snapshot NOTIFY updated)
+
+public:
+    /*!
+     * \brief The Counter enum lists the counters, the snapshot uses their names starting with a
+     * lower case letter as keys
+     */
+    enum Counter {
+        Connections = 0,
+        Reconnects,         //! Connections after the first one
+        Disconnections,
+        Errors,
+        Notifications,      //! Values received from the other end
+        NotificationBytes,
+        Writes,             //! Values sent to the other end
+        WriteBytes,
+        DroppedSamples,     //! Received values dropped because the GUI thread fell behind
+        DiscoveryReports,   //! Advertising reports seen by a discovery
+        DiscoveredDevices,  //! Distinct devices found by a discovery
+        LostSamples,        //! Stamped values that never arrived, see \ref BLEStamp
+        ReorderedSamples,   //! Stamped values that arrived after a later one
+        DuplicateSamples,   //! Stamped values received more than once
+        MissedDeadlines,    //! Scheduled values written after their deadline, see \ref BLEScheduler
+        ScheduleDrops,      //! Scheduled values dropped because their class queue was full
+        CounterCount
+    };
+    Q_ENUM(Counter)
+
+    /*!
+     * \brief The Histogram enum lists the histograms. Durations are recorded in nanoseconds and
+     * reported in microseconds by \ref snapshot
+     */
+    enum Histogram {
+        DecodeTime = 0,     //! Decoding a received value
+        DispatchTime,       //! Handing a received value to its service, decoding included
+        WriteLatency,       //! From writing a value until the transport reports it written
+        QueueDepth,         //! Samples waiting for the GUI thread, recorded on each push
+        Latency,            //! Age of a stamped value when received, above the fastest one
+        UrgentQueueTime,    //! Time a value of each priority class waited in the scheduler
+        HighQueueTime,
+        NormalQueueTime,
+        BulkQueueTime,
+        HistogramCount
+    };
+    Q_ENUM(Histogram)
+
+    /*!
+     * \brief The Channel struct holds the metrics of one characteristic
+     */
+    struct Channel
+    {
+        Channel(quint32 service, quint32 characteristic);
+
+        const quint32 serviceUuid;
+        const quint32 characterUuid;
+
+        std::atomic<quint64> notifications;
+        std::atomic<quint64> notificationBytes;
+        std::atomic<quint64> writes;
+        std::atomic<quint64> writeBytes;
+
+        //! \brief writeStart Time of the write waiting for completion, 0 if there is none
+        std::atomic<qint64> writeStart;
+
+        BLEHistogram writeLatency;
+
+        //! \brief The sequence statistics of stamped values, see \ref countStamp()
+        std::atomic<quint64> lost;
+        std::atomic<quint64> reordered;
+        std::atomic<quint64> duplicates;
+
+        BLEHistogram latency;
+    };
+
+    explicit BLEMetrics(QObject* parent = nullptr);
+    ~BLEMetrics() override;
+
+    /*!
+     * \brief enabled When false nothing is recorded and no time is measured
+     * \return
+     */
+    bool enabled() const;
+    void setEnabled(bool enabled);
+
+    /*!
+     * \brief updateInterval Interval in milliseconds of calling \ref update(), 0 disables it
+     * \return
+     */
+    int updateInterval() const;
+    void setUpdateInterval(int interval);
+
+    /*!
+     * \brief increment Adds \a n to \a counter
+     */
+    void increment(Counter counter, quint64 n = 1);
+
+    /*!
+     * \brief counter Returns the value of \a counter
+     */
+    Q_INVOKABLE quint64 counter(Counter counter) const;
+
+    /*!
+     * \brief record Adds \a value to \a histogram
+     */
+    void record(Histogram histogram, quint64 value);
+
+    /*!
+     * \brief histogram Returns \a histogram
+     */
+    const BLEHistogram& histogram(Histogram histogram) const;
+
+    /*!
+     * \brief channel Returns the metrics of a characteristic, created on first use. The returned
+     * pointer is valid as long as this object
+     */
+    Channel* channel(quint32 service, quint32 characteristic);
+
+    /*!
+     * \brief countNotification Counts a value of \a bytes bytes received on \a channel
+     */
+    void countNotification(Channel* channel, qsizetype bytes);
+
+    /*!
+     * \brief startWrite Counts a value of \a bytes bytes written on \a channel and starts measuring
+     * its latency
+     */
+    void startWrite(Channel* channel, qsizetype bytes);
+
+    /*!
+     * \brief finishWrite Records the latency of the pending write of \a channel
+     */
+    void finishWrite(Channel* channel);
+
+    /*!
+     * \brief countStamp Counts what the \ref BLEStamp::Tracker of \a channel learned from a
+     * stamped value. \a lost may be negative when a value counted as lost arrives late, a
+     * negative \a latency, in nanoseconds like every duration, is not recorded
+     */
+    void countStamp(Channel* channel, int lost, bool reordered, bool duplicate, qint64 latency);
+
+    /*!
+     * \brief snapshot Returns the snapshot computed by the last \ref update(): every counter, the
+     * rate per second of every counter since the update before, the histograms and the metrics of
+     * each characteristic
+     * \return
+     */
+    QVariantMap snapshot() const;
+
+    /*!
+     * \brief update Computes the \ref snapshot, then emits \ref updated()
+     */
+    Q_INVOKABLE void update();
+
+    /*!
+     * \brief reset Sets every counter and histogram back to zero
+     */
+    Q_INVOKABLE void reset();
+
+    /*!
+     * \brief now Monotonic time in nanoseconds used for durations
+     */
+    static qint64 now();
+
+signals:
+    /*!
+     * \brief updated Emitted by \ref update() and \ref reset()
+     */
+    void updated();
+
+    void enabledChanged();
+    void updateIntervalChanged();
+
+private:
+    //! \brief mEnabled Checked before recording anything
+    std::atomic_bool mEnabled;
+
+    std::array<std::atomic<quint64>, CounterCount> mCounters;
+    std::array<BLEHistogram, HistogramCount> mHistograms;
+
+    //! \brief mMutex Protects \ref mChannels, \ref mSnapshot and the state of the rates
+    mutable QMutex mMutex;
+
+    //! \brief mChannels Metrics of each characteristic, never removed so pointers stay valid
+    std::vector<std::unique_ptr<Channel>> mChannels;
+
+    //! \brief mTimer Calls \ref update()
+    QTimer* mTimer;
+
+    //! \brief mSnapshot Computed by \ref update()
+    QVariantMap mSnapshot;
+
+    //! \brief mLastSnapshot Time of the previous snapshot, used for rates
+    qint64 mLastSnapshot;
+
+    //! \brief mLastCounters Counters at the previous snapshot
+    std::array<quint64, CounterCount> mLastCounters;
+
+    //! \brief mLastChannels Notifications and bytes of each channel at the previous snapshot
+    QHash<const Channel*, QPair<quint64, quint64>> mLastChannels;
+};
+
+
+inline bool BLEMetrics::enabled() const
+{
+    return mEnabled.load(std::memory_order_relaxed);
+}
+
+inline void BLEMetrics::increment(Counter counter, quint64 n)
+{
+    if (enabled()) {
+        mCounters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+inline quint64 BLEMetrics::counter(Counter counter) const
+{
+    return counter < CounterCount ? mCounters[counter].load(std::memory_order_relaxed) : 0;
+}
+
+inline void BLEMetrics::record(Histogram histogram, quint64 value)
+{
+    if (enabled()) {
+        mHistograms[histogram].record(value);
+    }
+}
+
+inline const BLEHistogram& BLEMetrics::histogram(Histogram histogram) const
+{
+    return mHistograms[histogram];
+}
+
+inline void BLEMetrics::countNotification(Channel* channel, qsizetype bytes)
+{
+    if (!enabled()) {
+        return;
+    }
+
+    mCounters[Notifications].fetch_add(1, std::memory_order_relaxed);
+    mCounters[NotificationBytes].fetch_add(quint64(bytes), std::memory_order_relaxed);
+    if (channel) {
+        channel->notifications.fetch_add(1, std::memory_order_relaxed);
+        channel->notificationBytes.fetch_add(quint64(bytes), std::memory_order_relaxed);
+    }
+}
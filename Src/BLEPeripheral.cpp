@@ -1,34 +1,69 @@
 #include "BLEPeripheral.hpp"
 #include "BLEDataService.hpp"
 #include "BluetoothController.hpp"
+#include "BLETrace.hpp"
+#include "BLEBroadcastFormat.hpp"
 
 #include <QLowEnergyAdvertisingParameters>
+#include <QtEndian>
 
 BLEPeripheral::BLEPeripheral(QObject *parent)
     : BLERole{ parent }
-{}
+    , mAdvertiser { new BLEAdvertiser(this) }
+    , mBroadcastCompanyId { BLEBroadcastFormat::DefaultCompanyId }
+    , mBroadcastSequence { 0 }
+    , mBroadcastTimer { new QTimer(this) }
+{
+    connect(mAdvertiser, &BLEAdvertiser::changed, this, &BLEPeripheral::updateAdvertising);
+
+    mBroadcastTimer->setSingleShot(true);
+    connect(mBroadcastTimer, &QTimer::timeout, this, &BLEPeripheral::refreshBroadcast);
+}
 
 void BLEPeripheral::initialize()
 {
-    if (!BluetoothController::instance().isReady()) {
+    //! A loopback link and a local socket don't need the local adapter
+    const bool radio = !mLoopbackLink
+                       && !(mStreamLink
+                            && mStreamLink->backend() == BLEStreamLink::LocalSocketBackend);
+    if (radio && !BluetoothController::instance().isReady()) {
         qWarning() << "BluetoothController is not ready";
         return;
     }
 
-    mController = QLowEnergyController::createPeripheral(this);
+    destroyTransport();
+
+    mTransport = createTransport(QLowEnergyController::PeripheralRole);
     connect(
-        mController, &QLowEnergyController::errorOccurred, this, &BLEPeripheral::onErrorOccured);
-    connect(mController, &QLowEnergyController::connected, this, [&]() {
-        emit stateChanged();
+        mTransport, &BLETransport::errorOccurred, this, &BLEPeripheral::onErrorOccured);
+
+    //! Subscriptions are tracked on the transport's thread
+    connect(mTransport, &BLETransport::connected, mTransport, [this, transport = mTransport]() {
+        mClient = transport->remoteAddress();
     });
-    connect(mController, &QLowEnergyController::disconnected, this, [&]() {
-        emit stateChanged();
+    connect(mTransport, &BLETransport::disconnected, mTransport, [this, transport = mTransport]() {
+        onClientDisconnected(*transport);
     });
+    connect(mTransport, &BLETransport::descriptorWritten, mTransport,
+            [this, transport = mTransport](const QBluetoothUuid&,
+                                           const QBluetoothUuid& characteristic,
+                                           const QBluetoothUuid& descriptor,
+                                           const QByteArray& value) {
+                onDescriptorWritten(*transport, characteristic, descriptor, value);
+            });
+    connect(mTransport, &BLETransport::sendRateChanged, mTransport,
+            [this](const QBluetoothUuid& characteristic, qreal rate) {
+                for (BLEDataService* srv : std::as_const(mTransportServices)) {
+                    if (srv->characterBluetoothUuid() == characteristic) {
+                        srv->setSendRate(rate);
+                    }
+                }
+            });
 }
 
 void BLEPeripheral::startAdvertising()
 {
-    if (!mController || mController->localAddress().isNull()) {
+    if (!mTransport) {
         qWarning() << "Can't start advertising, BLEPeripheral is not initialized.";
         return;
     }
@@ -38,43 +73,193 @@ void BLEPeripheral::startAdvertising()
         return;
     }
 
-    //! Create the list of service class uuids for advertising
-    QList<QBluetoothUuid> services;
-    for (BLEDataService* srv : mServices) {
-        //! If a service with the same service uuid is already added abort adding this
-        auto buIt = std::find_if(services.begin(), services.end(), [srv](const QBluetoothUuid& bu) {
-            return bu == srv->serviceBluetoothUuid();
-        });
-        if (buIt != services.end()) {
-            //! This service is already added
-            qWarning() << "BLEDataService with uuid: " << srv->serviceBluetoothUuid().toUInt32()
-                       << " is already added.";
+    //! Broadcast values follow their services, connected once however often this is called
+    for (BLEDataService* srv : std::as_const(mServices)) {
+        disconnect(srv, &BLEDataService::valueChanged, this, nullptr);
+        disconnect(srv, &BLEDataService::broadcastChanged, this, nullptr);
+
+        auto mark = [this, srv]() {
+            markBroadcast(srv);
+        };
+        connect(srv, &BLEDataService::valueChanged, this, mark);
+        connect(srv, &BLEDataService::broadcastChanged, this, mark);
+    }
+    refreshAllBroadcast();
+
+    //! Services are added and advertising is started on the transport's thread
+    invokeOnTransport([this, transport = mTransport, localName = mLocalName,
+                       parameters = mAdvertiser->parameters(),
+                       content = mAdvertiser->content(mLocalName)]() mutable {
+        QB_TRACE_SCOPE("startAdvertising");
+
+        //! The backend is only asked on its own thread
+        if (transport->localAddress().isNull()) {
+            qWarning() << "Can't start advertising, BLEPeripheral is not initialized.";
+            return;
+        }
+
+        //! Create the list of service class uuids for advertising
+        QList<QBluetoothUuid> services;
+        for (BLEDataService* srv : std::as_const(mTransportServices)) {
+            //! If a service with the same service uuid is already added abort adding this
+            auto buIt = std::find_if(services.begin(), services.end(), [srv](const QBluetoothUuid& bu) {
+                return bu == srv->serviceBluetoothUuid();
+            });
+            if (buIt != services.end()) {
+                //! This service is already added
+                qWarning() << "BLEDataService with uuid: " << srv->serviceBluetoothUuid().toUInt32()
+                           << " is already added.";
+                continue;
+            }
+
+            if (srv->setup(*transport)) {
+                services.append(srv->serviceBluetoothUuid());
+            }
+        }
+
+        //! Pack the advertising and scan response payloads and start advertising
+        mAdvertisedServices = services;
+        content.services = services;
+        applyAdvertising(*transport, parameters, content, false);
+
+        qDebug() << "BLEPeripheral advertising started with name : " << localName;
+    });
+}
+
+void BLEPeripheral::setBroadcastCompanyId(int companyId)
+{
+    if (mBroadcastCompanyId == companyId || companyId < 0 || companyId > 0xFFFF) {
+        return;
+    }
+
+    if (!mBroadcastData.isEmpty()) {
+        mAdvertiser->removeManufacturerData(mBroadcastCompanyId);
+        mBroadcastData.clear();
+    }
+
+    mBroadcastCompanyId = companyId;
+    emit broadcastCompanyIdChanged();
+
+    refreshAllBroadcast();
+}
+
+void BLEPeripheral::markBroadcast(const BLEDataService* srv)
+{
+    mBroadcastChanged.insert(srv);
+    if (!mBroadcastTimer->isActive()) {
+        mBroadcastTimer->start(mAdvertiser->intervalMax());
+    }
+}
+
+void BLEPeripheral::refreshAllBroadcast()
+{
+    mBroadcastTimer->stop();
+    mBroadcastEntries.clear();
+    for (const BLEDataService* srv : std::as_const(mServices)) {
+        mBroadcastChanged.insert(srv);
+    }
+    refreshBroadcast();
+}
+
+void BLEPeripheral::refreshBroadcast()
+{
+    //! Only the values that changed are encoded again, the others keep their entry
+    QHash<const BLEDataService*, QByteArray> entries;
+    QList<QByteArray> payload;
+    for (const BLEDataService* srv : std::as_const(mServices)) {
+        if (!srv->broadcast()) {
             continue;
         }
 
-        if (srv->setup(*mController)) {
-            services.append(srv->serviceBluetoothUuid());
+        QByteArray entry;
+        auto cached = mBroadcastEntries.constFind(srv);
+        if (cached != mBroadcastEntries.constEnd() && !mBroadcastChanged.contains(srv)) {
+            entry = *cached;
+        } else {
+            entry = BLEBroadcastFormat::encodeEntry(
+                { quint16(srv->characterUuid()), srv->sampleType(), srv->value() });
         }
+        if (!entry.isEmpty()) {
+            payload.append(entry);
+            entries.insert(srv, std::move(entry));
+        }
+    }
+    mBroadcastEntries = std::move(entries);
+    mBroadcastChanged.clear();
+
+    if (payload.isEmpty()) {
+        if (!mBroadcastData.isEmpty()) {
+            mAdvertiser->removeManufacturerData(mBroadcastCompanyId);
+            mBroadcastData.clear();
+        }
+        return;
+    }
+
+    int encoded = 0;
+    QByteArray data = BLEBroadcastFormat::assemble(0, payload, BLEBroadcastFormat::MaxSize,
+                                                   &encoded);
+    if (data == mBroadcastData) {
+        return;
+    }
+
+    if (encoded < payload.size()) {
+        qWarning() << "BLEPeripheral: Only " << encoded << " of " << payload.size()
+                   << " broadcast values fit in the advertisement";
+    }
+
+    mBroadcastData = data;
+
+    //! A new sequence tells observers the values changed
+    data[1] = char(++mBroadcastSequence);
+    mAdvertiser->setManufacturerData(mBroadcastCompanyId, data);
+}
+
+void BLEPeripheral::updateAdvertising()
+{
+    if (!mTransport) {
+        return;
     }
 
-    //! Setting up the advertising data and parameters
-    QLowEnergyAdvertisingData advertisingData;
-    advertisingData.setDiscoverability(QLowEnergyAdvertisingData::DiscoverabilityGeneral);
-    advertisingData.setIncludePowerLevel(true);
-    advertisingData.setLocalName(mLocalName);
-    advertisingData.setServices(services);
+    invokeOnTransport([this, transport = mTransport, parameters = mAdvertiser->parameters(),
+                       content = mAdvertiser->content(mLocalName)]() mutable {
+        //! Otherwise the changes are applied on the next start
+        if (transport->state() != QLowEnergyController::AdvertisingState) {
+            return;
+        }
+
+        content.services = mAdvertisedServices;
+        applyAdvertising(*transport, parameters, content, true);
+    });
+}
+
+void BLEPeripheral::applyAdvertising(BLETransport& transport,
+                                     const QLowEnergyAdvertisingParameters& parameters,
+                                     const BLEAdvertiser::Content& content,
+                                     bool update)
+{
+    BLEAdvertiser::Payloads payloads = BLEAdvertiser::pack(content);
+
+    //! A rotation that leaves the payloads unchanged doesn't restart advertising
+    if (update && parameters == mAdvertisingParameters
+        && payloads.advertising == mPayloads.advertising
+        && payloads.scanResponse == mPayloads.scanResponse) {
+        return;
+    }
 
-    //! Start advertising
-    mController->startAdvertising(QLowEnergyAdvertisingParameters(),
-                                  advertisingData,
-                                  advertisingData);
+    if (payloads.dropped > 0 && payloads.dropped != mPayloads.dropped) {
+        qWarning() << "BLEPeripheral: " << payloads.dropped
+                   << " advertising fields don't fit in the advertising and scan response payloads";
+    }
 
-    qDebug() << "BLEPeripheral advertising started with name : " << mLocalName;
+    mAdvertisingParameters = parameters;
+    mPayloads = std::move(payloads);
+    transport.startAdvertising(mAdvertisingParameters, mPayloads.advertising,
+                               mPayloads.scanResponse);
 }
 
 void BLEPeripheral::onErrorOccured(QLowEnergyController::Error error)
 {
-    qWarning() << "BLEPeripheral " << error << ", " << mController->errorString();
+    qWarning() << "BLEPeripheral " << error << ", " << mTransport->errorString();
 }
 
 QString BLEPeripheral::localName() const
@@ -94,10 +279,90 @@ void BLEPeripheral::setLocalName(const QString& localName)
 
 void BLEPeripheral::readData(const QBluetoothUuid& uuid)
 {
-
+    for (BLEDataService* srv : std::as_const(mServices)) {
+        if (srv->characterBluetoothUuid() == uuid && srv->isValid()) {
+            invokeOnTransport([transport = mTransport, service = srv->serviceBluetoothUuid(),
+                               uuid]() {
+                transport->readCharacteristic(service, uuid);
+            });
+            return;
+        }
+    }
 }
 
 void BLEPeripheral::writeData(const QBluetoothUuid& uuid, const QVariant& value)
 {
+    for (BLEDataService* srv : std::as_const(mServices)) {
+        if (srv->characterBluetoothUuid() == uuid) {
+            srv->writeValue(value);
+            return;
+        }
+    }
+}
+
+void BLEPeripheral::onDescriptorWritten(BLETransport& transport,
+                                        const QBluetoothUuid& characteristic,
+                                        const QBluetoothUuid& descriptor,
+                                        const QByteArray& value)
+{
+    if (descriptor
+        != QBluetoothUuid(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration)) {
+        return;
+    }
+
+    //! Bit 0 enables notifications and bit 1 indications
+    quint16 configuration = 0;
+    if (value.size() >= 2) {
+        configuration = qFromLittleEndian<quint16>(value.constData());
+    } else if (value.size() == 1) {
+        configuration = quint8(value.at(0));
+    }
+
+    QHash<QBluetoothAddress, quint16>& clients = mSubscriptions[characteristic];
+    if (configuration & 0x3) {
+        clients.insert(mClient, configuration);
+    } else {
+        clients.remove(mClient);
+    }
+
+    updateSubscribers(transport, characteristic);
+}
+
+void BLEPeripheral::onClientDisconnected(BLETransport& transport)
+{
+    for (auto it = mSubscriptions.begin(); it != mSubscriptions.end(); ++it) {
+        if (it->remove(mClient)) {
+            updateSubscribers(transport, it.key());
+        }
+    }
+
+    mClient = QBluetoothAddress();
+}
+
+void BLEPeripheral::updateSubscribers(BLETransport& transport,
+                                      const QBluetoothUuid& characteristic)
+{
+    const QHash<QBluetoothAddress, quint16> clients = mSubscriptions.value(characteristic);
+
+    bool indications = false;
+    for (quint16 configuration : clients) {
+        indications = indications || (configuration & 0x2);
+    }
+
+    //! Indications wait for the confirmation of the previous one
+    transport.setPaced(characteristic, indications);
 
+    for (BLEDataService* srv : std::as_const(mTransportServices)) {
+        if (srv->characterBluetoothUuid() != characteristic) {
+            continue;
+        }
+
+        const bool firstSubscriber = srv->subscribers() == 0 && !clients.isEmpty();
+        srv->setSubscribers(int(clients.size()));
+
+        if (firstSubscriber) {
+            //! The value was not sent while nobody was subscribed
+            QMetaObject::invokeMethod(srv, &BLEDataService::sendStaleValue);
+        }
+    }
 }
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <QObject>
-#include <QQmlEngine>
-#include <QQmlListProperty>
 #include <QLowEnergyController>
+#include <QBluetoothAddress>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
 
 #include "BLERole.hpp"
+#include "BLEAdvertiser.hpp"
 
 
 /*!
@@ -15,10 +18,11 @@
 class BLEPeripheral : public BLERole
 {
     Q_OBJECT
-    QML_ELEMENT
 
     Q_PROPERTY(QString localName READ localName WRITE setLocalName NOTIFY localNameChanged FINAL)
     Q_PROPERTY(BluetoothDeviceInfo* device READ device WRITE setDevice NOTIFY deviceChanged)
+    Q_PROPERTY(BLEAdvertiser* advertiser READ advertiser CONSTANT)
+    Q_PROPERTY(int broadcastCompanyId READ broadcastCompanyId WRITE setBroadcastCompanyId NOTIFY broadcastCompanyIdChanged FINAL)
 
 public:
     void setDevice(BluetoothDeviceInfo* d)  { }
@@ -38,15 +42,31 @@ public:
     QString localName() const;
     void setLocalName(const QString& localName);
 
+    /*!
+     * \brief advertiser Returns the advertising parameters and data, changes are applied while
+     * advertising
+     */
+    BLEAdvertiser* advertiser() const;
+
+    /*!
+     * \brief broadcastCompanyId The company id of the manufacturer data that the values of the
+     * services with \ref BLEDataService::broadcast are advertised in, see \ref BLEBroadcastFormat
+     * \return
+     */
+    int broadcastCompanyId() const;
+    void setBroadcastCompanyId(int companyId);
+
 protected:
     /*!
-     * \brief Override \ref BLERole::readData() to read data from other end
+     * \brief Override \ref BLERole::readData() to read the local value of the characteristic
+     * back from the transport. The result updates the value of its \ref BLEDataService
      * \param uuid
      */
     virtual void readData(const QBluetoothUuid& uuid) override;
 
     /*!
-     * \brief Override \ref BLERole::writeData() to write data to other end
+     * \brief Override \ref BLERole::writeData() to update the value of the characteristic and send
+     * it to the subscribed centrals
      * \param uuid
      * \param value
      */
@@ -55,11 +75,114 @@ protected:
 private slots:
     void onErrorOccured(QLowEnergyController::Error error);
 
+private:
+    /*!
+     * \brief markBroadcast Marks the broadcast value of \a srv changed. The manufacturer data is
+     * refreshed once per advertising interval at most since it can't change faster
+     */
+    void markBroadcast(const BLEDataService* srv);
+
+    /*!
+     * \brief refreshBroadcast Encodes the broadcast values that changed and updates the
+     * manufacturer data of the advertisement when the payload changed
+     */
+    void refreshBroadcast();
+
+    /*!
+     * \brief refreshAllBroadcast Encodes the broadcast values of every service again, right away
+     */
+    void refreshAllBroadcast();
+
+    /*!
+     * \brief updateAdvertising Applies the changes of \ref advertiser() if advertising
+     */
+    void updateAdvertising();
+
+    /*!
+     * \brief applyAdvertising Packs \a content and starts advertising it on \a transport, or
+     * updates the advertised payloads when they changed. This is called on the thread of
+     * \a transport
+     */
+    void applyAdvertising(BLETransport& transport,
+                          const QLowEnergyAdvertisingParameters& parameters,
+                          const BLEAdvertiser::Content& content,
+                          bool update);
+
+    /*!
+     * \brief onDescriptorWritten Tracks the subscriptions of the connected central from its
+     * writes to the client characteristic configuration descriptors. This is called on the thread
+     * of the transport
+     */
+    void onDescriptorWritten(BLETransport& transport,
+                             const QBluetoothUuid& characteristic,
+                             const QBluetoothUuid& descriptor,
+                             const QByteArray& value);
+
+    /*!
+     * \brief onClientDisconnected Drops the subscriptions of the central that disconnected from
+     * \a transport. This is called on the thread of the transport
+     */
+    void onClientDisconnected(BLETransport& transport);
+
+    /*!
+     * \brief updateSubscribers Updates the subscriber count and the pacing on \a transport of
+     * \a characteristic and sends its latest value to a first subscriber. This is called on the
+     * thread of the transport
+     */
+    void updateSubscribers(BLETransport& transport, const QBluetoothUuid& characteristic);
+
 signals:
     void localNameChanged();
+    void broadcastCompanyIdChanged();
 
 private:
-
     //! \brief mLocalName A name for advertising service
     QString mLocalName;
+
+    //! \brief mAdvertiser Advertising parameters and data
+    BLEAdvertiser* mAdvertiser;
+
+    //! \brief mBroadcastCompanyId Company id of the broadcast manufacturer data
+    int mBroadcastCompanyId;
+
+    //! \brief mBroadcastData The broadcast payload with a zero sequence, to detect changes
+    QByteArray mBroadcastData;
+
+    //! \brief mBroadcastSequence Sequence of the broadcast payload
+    quint8 mBroadcastSequence;
+
+    //! \brief mBroadcastEntries The encoded broadcast value of each service, see
+    //! \ref BLEBroadcastFormat::encodeEntry()
+    QHash<const BLEDataService*, QByteArray> mBroadcastEntries;
+
+    //! \brief mBroadcastChanged Services whose broadcast value changed since the last refresh.
+    //! Only compared against \ref mServices, never dereferenced
+    QSet<const BLEDataService*> mBroadcastChanged;
+
+    //! \brief mBroadcastTimer Coalesces the refreshes of the broadcast values
+    QTimer* mBroadcastTimer;
+
+    //! \brief mAdvertisedServices Services set up by \ref startAdvertising(), only used on the
+    //! thread of the transport like the advertised payloads below
+    QList<QBluetoothUuid> mAdvertisedServices;
+    QLowEnergyAdvertisingParameters mAdvertisingParameters;
+    BLEAdvertiser::Payloads mPayloads;
+
+    //! \brief mClient Address of the connected central, only used on the thread of the transport
+    QBluetoothAddress mClient;
+
+    //! \brief mSubscriptions The client characteristic configuration written by each central, by
+    //! characteristic. Only used on the thread of the transport
+    QHash<QBluetoothUuid, QHash<QBluetoothAddress, quint16>> mSubscriptions;
 };
+
+
+inline BLEAdvertiser* BLEPeripheral::advertiser() const
+{
+    return mAdvertiser;
+}
+
+inline int BLEPeripheral::broadcastCompanyId() const
+{
+    return mBroadcastCompanyId;
+}
@@ -0,0 +1,253 @@
+#include "BLEQtTransport.hpp"
+#include "BLETrace.hpp"
+
+#include <QLowEnergyCharacteristic>
+#include <QLowEnergyDescriptor>
+
+BLEQtTransport* BLEQtTransport::createCentral(const QBluetoothDeviceInfo& remoteDevice,
+                                              const QBluetoothAddress& localAdapter,
+                                              QObject* parent)
+{
+    QLowEnergyController* controller
+        = localAdapter.isNull() ? QLowEnergyController::createCentral(remoteDevice)
+                                : QLowEnergyController::createCentral(remoteDevice, localAdapter);
+    controller->setRemoteAddressType(QLowEnergyController::PublicAddress);
+
+    return new BLEQtTransport(controller, parent);
+}
+
+BLEQtTransport* BLEQtTransport::createPeripheral(QObject* parent)
+{
+    return new BLEQtTransport(QLowEnergyController::createPeripheral(), parent);
+}
+
+BLEQtTransport::BLEQtTransport(QLowEnergyController* controller, QObject* parent)
+    : BLETransport{ controller->role(), parent }
+    , mController { controller }
+    , mRestartingAdvertising { false }
+{
+    mController->setParent(this);
+
+    connect(mController, &QLowEnergyController::stateChanged, this,
+            [this](QLowEnergyController::ControllerState state) {
+                if (!mRestartingAdvertising) {
+                    setState(state);
+                }
+            });
+    connect(mController, &QLowEnergyController::connected, this, &BLETransport::connected);
+    connect(mController, &QLowEnergyController::disconnected, this, &BLETransport::disconnected);
+    connect(mController, &QLowEnergyController::errorOccurred, this,
+            &BLETransport::errorOccurred);
+    connect(mController, &QLowEnergyController::serviceDiscovered, this,
+            &BLETransport::serviceDiscovered);
+    connect(mController, &QLowEnergyController::connectionUpdated, this,
+            &BLETransport::connectionUpdated);
+}
+
+QString BLEQtTransport::errorString() const
+{
+    return mController->errorString();
+}
+
+QBluetoothAddress BLEQtTransport::localAddress() const
+{
+    return mController->localAddress();
+}
+
+QBluetoothAddress BLEQtTransport::remoteAddress() const
+{
+    return mController->remoteAddress();
+}
+
+int BLEQtTransport::mtu() const
+{
+    return mController->mtu();
+}
+
+bool BLEQtTransport::confirmsWrites() const
+{
+    return role() == QLowEnergyController::CentralRole;
+}
+
+void BLEQtTransport::connectToDevice()
+{
+    mController->connectToDevice();
+}
+
+void BLEQtTransport::disconnectFromDevice()
+{
+    mController->disconnectFromDevice();
+}
+
+void BLEQtTransport::discoverServices()
+{
+    mController->discoverServices();
+}
+
+bool BLEQtTransport::openService(const QBluetoothUuid& uuid)
+{
+    if (QLowEnergyService* service = mServices.value(uuid)) {
+        if (service->state() == QLowEnergyService::RemoteServiceDiscovered) {
+            QB_TRACE_BEGIN("discoverDetails", BLETrace::id(this, uuid));
+            emit serviceReady(uuid);
+        }
+        return true;
+    }
+
+    QLowEnergyService* service = mController->createServiceObject(uuid, this);
+    if (!service) {
+        return false;
+    }
+
+    mServices.insert(uuid, service);
+    watchService(service);
+
+    connect(service, &QLowEnergyService::stateChanged, this,
+            [this, uuid](QLowEnergyService::ServiceState st) {
+                if (st == QLowEnergyService::RemoteServiceDiscovered) {
+                    emit serviceReady(uuid);
+                }
+            });
+
+    QB_TRACE_BEGIN("discoverDetails", BLETrace::id(this, uuid));
+    service->discoverDetails();
+    return true;
+}
+
+void BLEQtTransport::subscribe(const QBluetoothUuid& service,
+                               const QBluetoothUuid& characteristic,
+                               bool indication)
+{
+    QLowEnergyService* srv = mServices.value(service);
+    if (!srv) {
+        return;
+    }
+
+    //! Enable notification or indication for the descriptor of the service characteristic
+    QLowEnergyCharacteristic charData = srv->characteristic(characteristic);
+    if (charData.isValid()) {
+        QLowEnergyDescriptor srvDescriptor = charData.descriptor(
+            QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration);
+        if (srvDescriptor.isValid()) {
+            QB_TRACE_BEGIN("writeCCCD", BLETrace::id(this, service, characteristic));
+            srv->writeDescriptor(srvDescriptor,
+                                 indication ? QLowEnergyCharacteristic::CCCDEnableIndication
+                                            : QLowEnergyCharacteristic::CCCDEnableNotification);
+        }
+    }
+}
+
+bool BLEQtTransport::addService(const QLowEnergyServiceData& serviceData)
+{
+    if (mServices.contains(serviceData.uuid())) {
+        return false;
+    }
+
+    QLowEnergyService* service = mController->addService(serviceData, this);
+    if (!service) {
+        return false;
+    }
+
+    mServices.insert(serviceData.uuid(), service);
+    watchService(service);
+    return true;
+}
+
+void BLEQtTransport::startAdvertising(const QLowEnergyAdvertisingParameters& parameters,
+                                      const QLowEnergyAdvertisingData& advertisingData,
+                                      const QLowEnergyAdvertisingData& scanResponseData)
+{
+    if (mController->state() != QLowEnergyController::AdvertisingState) {
+        mController->startAdvertising(parameters, advertisingData, scanResponseData);
+        return;
+    }
+
+    //! The controller only takes new payloads when it starts advertising, it's restarted without
+    //! reporting the unconnected state in between
+    mRestartingAdvertising = true;
+    mController->stopAdvertising();
+    mController->startAdvertising(parameters, advertisingData, scanResponseData);
+    mRestartingAdvertising = false;
+
+    setState(mController->state());
+}
+
+void BLEQtTransport::stopAdvertising()
+{
+    mController->stopAdvertising();
+}
+
+bool BLEQtTransport::writeCharacteristic(const QBluetoothUuid& service,
+                                         const QBluetoothUuid& characteristic,
+                                         const QByteArray& value)
+{
+    QLowEnergyService* srv = mServices.value(service);
+    if (!srv) {
+        return false;
+    }
+
+    QLowEnergyCharacteristic charac = srv->characteristic(characteristic);
+    if (!charac.isValid()) {
+        return false;
+    }
+
+    if (role() == QLowEnergyController::CentralRole) {
+        QB_TRACE_BEGIN("writeCharacteristic", BLETrace::id(this, service, characteristic));
+    } else {
+        QB_TRACE_INSTANT("notify");
+    }
+
+    srv->writeCharacteristic(charac, value);
+    return true;
+}
+
+void BLEQtTransport::readCharacteristic(const QBluetoothUuid& service,
+                                        const QBluetoothUuid& characteristic)
+{
+    QLowEnergyService* srv = mServices.value(service);
+    if (!srv) {
+        return;
+    }
+
+    QLowEnergyCharacteristic charac = srv->characteristic(characteristic);
+    if (charac.isValid()) {
+        if (role() == QLowEnergyController::CentralRole) {
+            QB_TRACE_BEGIN("readCharacteristic", BLETrace::id(this, service, characteristic));
+        }
+        srv->readCharacteristic(charac);
+    }
+}
+
+void BLEQtTransport::requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters)
+{
+    mController->requestConnectionUpdate(parameters);
+}
+
+void BLEQtTransport::watchService(QLowEnergyService* service)
+{
+    const QBluetoothUuid uuid = service->serviceUuid();
+
+    connect(service, &QLowEnergyService::characteristicChanged, this,
+            [this, uuid](const QLowEnergyCharacteristic& c, const QByteArray& value) {
+                emit characteristicChanged(uuid, c.uuid(), value);
+            });
+    connect(service, &QLowEnergyService::characteristicRead, this,
+            [this, uuid](const QLowEnergyCharacteristic& c, const QByteArray& value) {
+                emit characteristicRead(uuid, c.uuid(), value);
+            });
+    connect(service, &QLowEnergyService::characteristicWritten, this,
+            [this, uuid](const QLowEnergyCharacteristic& c, const QByteArray& value) {
+                emit characteristicWritten(uuid, c.uuid(), value);
+            });
+    connect(service, &QLowEnergyService::descriptorWritten, this,
+            [this, uuid, service](const QLowEnergyDescriptor& d, const QByteArray& value) {
+                //! Descriptors don't know their characteristic, look it up
+                const QList<QLowEnergyCharacteristic> characteristics = service->characteristics();
+                for (const QLowEnergyCharacteristic& c : characteristics) {
+                    if (c.descriptors().contains(d)) {
+                        emit descriptorWritten(uuid, c.uuid(), d.uuid(), value);
+                        return;
+                    }
+                }
+            });
+}
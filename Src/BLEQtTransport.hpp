@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QHash>
+#include <QBluetoothDeviceInfo>
+#include <QLowEnergyController>
+#include <QLowEnergyService>
+
+#include "BLETransport.hpp"
+
+/*!
+ * \brief The BLEQtTransport class is the \ref BLETransport backed by \a QLowEnergyController and
+ * \a QLowEnergyService, ie a real radio
+ */
+class BLEQtTransport : public BLETransport
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * \brief createCentral Creates a central transport that connects to \a remoteDevice through
+     * the local adapter \a localAdapter, or the default adapter if it is null
+     */
+    static BLEQtTransport* createCentral(const QBluetoothDeviceInfo& remoteDevice,
+                                         const QBluetoothAddress& localAdapter = QBluetoothAddress(),
+                                         QObject* parent = nullptr);
+
+    /*!
+     * \brief createPeripheral Creates a peripheral transport
+     */
+    static BLEQtTransport* createPeripheral(QObject* parent = nullptr);
+
+    /*!
+     * \brief controller Returns the underlying controller
+     */
+    QLowEnergyController* controller() const;
+
+    QString errorString() const override;
+    QBluetoothAddress localAddress() const override;
+    QBluetoothAddress remoteAddress() const override;
+    int mtu() const override;
+    bool confirmsWrites() const override;
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+    void discoverServices() override;
+    bool openService(const QBluetoothUuid& service) override;
+    void subscribe(const QBluetoothUuid& service,
+                   const QBluetoothUuid& characteristic,
+                   bool indication = false) override;
+
+    bool addService(const QLowEnergyServiceData& service) override;
+    void startAdvertising(const QLowEnergyAdvertisingParameters& parameters,
+                          const QLowEnergyAdvertisingData& advertisingData,
+                          const QLowEnergyAdvertisingData& scanResponseData) override;
+    void stopAdvertising() override;
+
+    bool writeCharacteristic(const QBluetoothUuid& service,
+                             const QBluetoothUuid& characteristic,
+                             const QByteArray& value) override;
+    void readCharacteristic(const QBluetoothUuid& service,
+                            const QBluetoothUuid& characteristic) override;
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters) override;
+
+private:
+    BLEQtTransport(QLowEnergyController* controller, QObject* parent);
+
+    /*!
+     * \brief watchService Forwards the signals of \a service as signals of this transport
+     */
+    void watchService(QLowEnergyService* service);
+
+private:
+    //! \brief mController The Qt controller, owned by this
+    QLowEnergyController* mController;
+
+    //! \brief mServices The service objects created by this transport by their uuid
+    QHash<QBluetoothUuid, QLowEnergyService*> mServices;
+
+    //! \brief mRestartingAdvertising True while advertising is restarted with new payloads
+    bool mRestartingAdvertising;
+};
+
+
+inline QLowEnergyController* BLEQtTransport::controller() const
+{
+    return mController;
+}
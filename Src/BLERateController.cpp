@@ -0,0 +1,104 @@
+#include "BLERateController.hpp"
+
+#include <QtMath>
+
+namespace {
+
+//! \brief Weight of the newest interval in the moving average of the throughput
+constexpr qreal ThroughputWeight = 0.125;
+
+} // namespace
+
+BLERateController::BLERateController()
+{
+    reset();
+}
+
+bool BLERateController::admit(qint64 now)
+{
+    refill(now);
+    if (mTokens < 1) {
+        return false;
+    }
+
+    //! The writes pile up in the backend, it can't keep up with the rate
+    if (mReportsWrites && mOutstanding >= MaxOutstanding) {
+        onCongestion(now);
+        return false;
+    }
+
+    mTokens -= 1;
+    ++mOutstanding;
+    return true;
+}
+
+qint64 BLERateController::nextAdmission(qint64 now) const
+{
+    if (mReportsWrites && mOutstanding >= MaxOutstanding) {
+        return -1;
+    }
+
+    const qreal tokens = qMin(Burst, mTokens + qreal(now - mRefilled) * mRate / 1e9);
+    if (tokens >= 1) {
+        return 0;
+    }
+
+    return qint64(qCeil((1 - tokens) * 1e9 / mRate));
+}
+
+void BLERateController::onWritten(qint64 now)
+{
+    mReportsWrites = true;
+    if (mOutstanding > 0) {
+        --mOutstanding;
+    }
+
+    //! One write per value sent, so the rate grows by AdditiveIncrease each second
+    mRate = qMin(MaximumRate, mRate + AdditiveIncrease / mRate);
+
+    if (mWritten > 0 && now > mWritten) {
+        const qreal instant = 1e9 / qreal(now - mWritten);
+        mThroughput += ThroughputWeight * (instant - mThroughput);
+    }
+    mWritten = now;
+}
+
+void BLERateController::onLost(qint64 now)
+{
+    if (mOutstanding > 0) {
+        --mOutstanding;
+    }
+    onCongestion(now);
+}
+
+void BLERateController::onCongestion(qint64 now)
+{
+    if (mDecreased > 0 && now - mDecreased < CongestionRound) {
+        return;
+    }
+
+    refill(now);
+    mRate = qMax(MinimumRate, mRate * DecreaseFactor);
+    mTokens = qMin(mTokens, qreal(1));
+    mDecreased = now;
+}
+
+void BLERateController::reset()
+{
+    mRate = InitialRate;
+    mTokens = Burst;
+    mRefilled = 0;
+    mOutstanding = 0;
+    mReportsWrites = false;
+    mDecreased = 0;
+    mThroughput = 0;
+    mWritten = 0;
+}
+
+void BLERateController::refill(qint64 now)
+{
+    if (mRefilled > 0 && now > mRefilled) {
+        mTokens = qMin(Burst, mTokens + qreal(now - mRefilled) * mRate / 1e9);
+    }
+    mRefilled = now;
+}
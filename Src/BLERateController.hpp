@@ -0,0 +1,130 @@
+#pragma once
+
+#include <QtGlobal>
+
+/*!
+ * \brief The BLERateController class adapts the rate of the values sent on one characteristic to
+ * what the link drains, additive increase and multiplicative decrease like TCP. Values are admitted
+ * by a token bucket refilled at \ref rate(). Every completed write raises the rate so it grows by
+ * \ref AdditiveIncrease values per second each second, a sign of congestion halves it at most once
+ * per \ref CongestionRound. Congestion is:
+ *  - \ref MaxOutstanding writes not reported done yet, once the backend is known to report them
+ *  - a write the backend refused
+ *  - a value the \ref BLEScheduler dropped or sent after its deadline
+ * \note A rate controller is used from the thread of its transport only, and only on a transport
+ * that \ref BLETransport::confirmsWrites(). A Qt peripheral reports every write done at once, the
+ * rate would climb to \ref MaximumRate whatever the link drains
+ */
+class BLERateController
+{
+public:
+    //! \brief InitialRate Values per second admitted before anything is measured
+    static constexpr qreal InitialRate = 20;
+
+    //! \brief MinimumRate The rate never goes below this, in values per second
+    static constexpr qreal MinimumRate = 1;
+
+    //! \brief MaximumRate The rate never goes above this, in values per second
+    static constexpr qreal MaximumRate = 1000;
+
+    //! \brief AdditiveIncrease Values per second added to the rate each second without congestion
+    static constexpr qreal AdditiveIncrease = 10;
+
+    //! \brief DecreaseFactor The rate is multiplied by this on congestion
+    static constexpr qreal DecreaseFactor = 0.5;
+
+    //! \brief MaxOutstanding Writes not reported done that mean the link doesn't keep up
+    static constexpr int MaxOutstanding = 4;
+
+    //! \brief CongestionRound Nanoseconds during which one decrease covers every congestion sign
+    static constexpr qint64 CongestionRound = 100000000;
+
+    //! \brief Burst Number of values that can be admitted back to back
+    static constexpr qreal Burst = 2;
+
+    BLERateController();
+
+    /*!
+     * \brief admit Returns true and counts a write in flight if a value may be sent at \a now
+     */
+    bool admit(qint64 now);
+
+    /*!
+     * \brief nextAdmission Returns the nanoseconds from \a now until a value may be sent, -1 while
+     * \ref MaxOutstanding writes wait to be reported done
+     */
+    qint64 nextAdmission(qint64 now) const;
+
+    /*!
+     * \brief onWritten Counts a write reported done at \a now
+     */
+    void onWritten(qint64 now);
+
+    /*!
+     * \brief onLost Counts a write that won't be reported done at \a now, refused or dropped,
+     * as a sign of congestion
+     */
+    void onLost(qint64 now);
+
+    /*!
+     * \brief onCongestion Halves the rate unless it was already done this round
+     */
+    void onCongestion(qint64 now);
+
+    /*!
+     * \brief rate Returns the values per second currently admitted, ie the sustainable rate
+     */
+    qreal rate() const;
+
+    /*!
+     * \brief throughput Returns the moving average of the writes reported done per second
+     */
+    qreal throughput() const;
+
+    /*!
+     * \brief reset Starts over from \ref InitialRate, ie on a new connection
+     */
+    void reset();
+
+private:
+    /*!
+     * \brief refill Adds the tokens earned since the last refill
+     */
+    void refill(qint64 now);
+
+private:
+    //! \brief mRate Values per second admitted
+    qreal mRate;
+
+    //! \brief mTokens Values that may be sent right away
+    qreal mTokens;
+
+    //! \brief mRefilled Time of the last refill
+    qint64 mRefilled;
+
+    //! \brief mOutstanding Writes admitted and not reported done
+    int mOutstanding;
+
+    //! \brief mReportsWrites True once the backend reported a write done
+    bool mReportsWrites;
+
+    //! \brief mDecreased Time of the last decrease
+    qint64 mDecreased;
+
+    //! \brief mThroughput Moving average of the completed writes per second
+    qreal mThroughput;
+
+    //! \brief mWritten Time of the last completed write
+    qint64 mWritten;
+};
+
+
+inline qreal BLERateController::rate() const
+{
+    return mRate;
+}
+
+inline qreal BLERateController::throughput() const
+{
+    return mThroughput;
+}
@@ -1,20 +1,233 @@
 #include "BLERole.hpp"
 #include "BLEDataService.hpp"
+#include "BluetoothController.hpp"
 #include "BluetoothDeviceInfo.hpp"
+#include "BLEIOThread.hpp"
+#include "BLELoopbackTransport.hpp"
+#include "BLEQtTransport.hpp"
+#include "BLEStreamTransport.hpp"
+#include "BLETrace.hpp"
+
+#include <utility>
 
 BLERole::BLERole(QObject *parent)
     : QObject{ parent }
-    , mController { nullptr }
+    , mTransport { nullptr }
     , mDevice { nullptr }
+    , mThreadingMode { ThreadingMode::GuiThreadMode }
+    , mLoopbackLink { nullptr }
+    , mStreamLink { nullptr }
+    , mMetrics { new BLEMetrics(this) }
+    , mConnectionProfile { ConnectionProfile::DefaultProfile }
+    , mHasConnectionParameters { false }
 {}
 
+BLERole::~BLERole()
+{
+    destroyTransport();
+}
+
+void BLERole::setThreadingMode(ThreadingMode mode)
+{
+    if (mThreadingMode == mode) {
+        return;
+    }
+
+    if (mTransport) {
+        qWarning() << "BLERole: Threading mode can't be changed after the transport is created";
+        return;
+    }
+
+    mThreadingMode = mode;
+    emit threadingModeChanged();
+}
+
+void BLERole::setLoopbackLink(BLELoopbackLink* link)
+{
+    if (mLoopbackLink == link) {
+        return;
+    }
+
+    if (mTransport) {
+        qWarning() << "BLERole: Loopback link can't be changed after the transport is created";
+        return;
+    }
+
+    mLoopbackLink = link;
+    emit loopbackLinkChanged();
+}
+
+void BLERole::setStreamLink(BLEStreamLink* link)
+{
+    if (mStreamLink == link) {
+        return;
+    }
+
+    if (mTransport) {
+        qWarning() << "BLERole: Stream link can't be changed after the transport is created";
+        return;
+    }
+
+    mStreamLink = link;
+    emit streamLinkChanged();
+}
+
+void BLERole::setSharedSamples(BLESharedSamples* samples)
+{
+    if (mSharedSamples == samples) {
+        return;
+    }
+
+    if (mSharedSamples) {
+        disconnect(mSharedSamples, &QObject::destroyed, this, &BLERole::sharedSamplesDestroyed);
+    }
+
+    mSharedSamples = samples;
+    if (mSharedSamples) {
+        connect(mSharedSamples, &QObject::destroyed, this, &BLERole::sharedSamplesDestroyed);
+    }
+
+    for (BLEDataService* service : std::as_const(mServices)) {
+        service->setSharedSamples(mSharedSamples);
+    }
+    emit sharedSamplesChanged();
+}
+
+void BLERole::sharedSamplesDestroyed()
+{
+    for (BLEDataService* service : std::as_const(mServices)) {
+        service->setSharedSamples(nullptr);
+    }
+
+    //! A service may have loaded the pointer right before it was unset
+    waitForTransport();
+    emit sharedSamplesChanged();
+}
+
+void BLERole::setExportStream(BLEExportStream* stream)
+{
+    if (mExportStream == stream) {
+        return;
+    }
+
+    if (mExportStream) {
+        disconnect(mExportStream, &QObject::destroyed, this, &BLERole::exportStreamDestroyed);
+    }
+
+    mExportStream = stream;
+    if (mExportStream) {
+        connect(mExportStream, &QObject::destroyed, this, &BLERole::exportStreamDestroyed);
+    }
+
+    for (BLEDataService* service : std::as_const(mServices)) {
+        service->setExportStream(mExportStream);
+    }
+    emit exportStreamChanged();
+}
+
+void BLERole::exportStreamDestroyed()
+{
+    for (BLEDataService* service : std::as_const(mServices)) {
+        service->setExportStream(nullptr);
+    }
+
+    waitForTransport();
+    emit exportStreamChanged();
+}
+
+void BLERole::setConnectionProfile(ConnectionProfile profile)
+{
+    if (mConnectionProfile == profile) {
+        return;
+    }
+
+    mConnectionProfile = profile;
+    emit connectionProfileChanged();
+
+    setPreferredParameters(profileParameters(profile));
+}
+
+void BLERole::requestConnectionParameters(qreal minInterval,
+                                          qreal maxInterval,
+                                          int latency,
+                                          int supervisionTimeout)
+{
+    QLowEnergyConnectionParameters parameters;
+    parameters.setIntervalRange(minInterval, maxInterval);
+    parameters.setLatency(latency);
+    parameters.setSupervisionTimeout(supervisionTimeout);
+
+    requestConnectionParameters(parameters);
+}
+
+void BLERole::requestConnectionParameters(const QLowEnergyConnectionParameters& parameters)
+{
+    //! The supervision timeout must outlast the peripheral skipping its events
+    const qreal skipped = (1 + parameters.latency()) * parameters.maximumInterval() * 2;
+    if (parameters.minimumInterval() < 7.5 || parameters.maximumInterval() > 4000
+        || parameters.minimumInterval() > parameters.maximumInterval()
+        || parameters.latency() < 0 || parameters.latency() > 499
+        || parameters.supervisionTimeout() < 100 || parameters.supervisionTimeout() > 32000
+        || parameters.supervisionTimeout() <= skipped) {
+        qWarning() << "BLERole: Invalid connection parameters, interval:"
+                   << parameters.minimumInterval() << "-" << parameters.maximumInterval()
+                   << "latency:" << parameters.latency()
+                   << "supervision timeout:" << parameters.supervisionTimeout();
+        return;
+    }
+
+    setPreferredParameters(parameters);
+}
+
+std::optional<QLowEnergyConnectionParameters> BLERole::profileParameters(
+    ConnectionProfile profile)
+{
+    QLowEnergyConnectionParameters parameters;
+
+    switch (profile) {
+    case ConnectionProfile::DefaultProfile:
+        return std::nullopt;
+    case ConnectionProfile::LowLatencyProfile:
+        parameters.setIntervalRange(7.5, 7.5);
+        parameters.setLatency(0);
+        parameters.setSupervisionTimeout(2000);
+        break;
+    case ConnectionProfile::HighThroughputProfile:
+        parameters.setIntervalRange(7.5, 15);
+        parameters.setLatency(0);
+        parameters.setSupervisionTimeout(4000);
+        break;
+    case ConnectionProfile::LowPowerProfile:
+        parameters.setIntervalRange(100, 200);
+        parameters.setLatency(4);
+        parameters.setSupervisionTimeout(6000);
+        break;
+    }
+
+    return parameters;
+}
+
+void BLERole::setPreferredParameters(
+    const std::optional<QLowEnergyConnectionParameters>& parameters)
+{
+    mPreferredParameters = parameters;
+
+    invokeOnTransport([transport = mTransport, parameters]() {
+        transport->setPreferredConnectionParameters(parameters);
+    });
+}
+
 void BLERole::serviceAdd(BLEDataService* ble)
 {
     if (!ble) {
         return;
     }
 
+    ble->setMetrics(mMetrics);
+    ble->setSharedSamples(mSharedSamples);
+    ble->setExportStream(mExportStream);
     mServices.append(ble);
+    syncTransportServices();
     emit servicesChanged();
 }
 
@@ -30,35 +243,204 @@ BLEDataService* BLERole::serviceAt(qsizetype index)
 
 void BLERole::serviceClear()
 {
-    qDeleteAll(mServices);
-    mServices.clear();
+    const QList<BLEDataService*> services = std::exchange(mServices, QList<BLEDataService*>());
+
+    if (!mTransport || mTransport->thread() == QThread::currentThread()) {
+        mTransportServices.clear();
+        qDeleteAll(services);
+        return;
+    }
+
+    //! The services are deleted once the transport's thread doesn't use them anymore
+    QMetaObject::invokeMethod(mTransport, [this, services]() {
+        mTransportServices.clear();
+        QMetaObject::invokeMethod(this, [services]() {
+            qDeleteAll(services);
+        });
+    });
 }
 
-ServicesListProperty BLERole::services()
+void BLERole::syncTransportServices()
 {
-    return QQmlListProperty<BLEDataService>(this, this,
-                                            &BLERole::servicesListAppend,
-                                            &BLERole::servicesListCount,
-                                            &BLERole::servicesListAt,
-                                            &BLERole::servicesListClear);
+    invokeOnTransport([this, services = mServices]() {
+        mTransportServices = services;
+    });
 }
 
-void BLERole::servicesListAppend(ServicesListProperty* services, BLEDataService* service)
+BLETransport* BLERole::createTransport(QLowEnergyController::Role role,
+                                       const QBluetoothDeviceInfo& remoteDevice)
 {
-    reinterpret_cast<BLERole*>(services->object)->serviceAdd(service);
+    //! Centrals are spread over the local adapters to get past the connection limit of each one
+    //! An RFCOMM socket can't pick the adapter it connects through
+    if (!mLoopbackLink && !mStreamLink && role == QLowEnergyController::CentralRole) {
+        mAdapter = BluetoothController::instance().acquireAdapter();
+        if (!mAdapter.isNull()) {
+            emit adapterChanged();
+        }
+    }
+
+    std::optional<BLEStreamLink::Settings> stream;
+    if (mStreamLink) {
+        stream = mStreamLink->settings();
+    }
+
+    auto factory = [role, remoteDevice, link = mLoopbackLink, stream, adapter = mAdapter,
+                    preferred = mPreferredParameters,
+                    metrics = mMetrics](QObject* parent) -> BLETransport* {
+        BLETransport* transport = nullptr;
+        if (link) {
+            transport = new BLELoopbackTransport(link, role, parent);
+        } else if (stream) {
+            transport = role == QLowEnergyController::CentralRole
+                            ? BLEStreamTransport::createCentral(*stream, remoteDevice, parent)
+                            : BLEStreamTransport::createPeripheral(*stream, parent);
+        } else {
+            transport = role == QLowEnergyController::CentralRole
+                            ? BLEQtTransport::createCentral(remoteDevice, adapter, parent)
+                            : BLEQtTransport::createPeripheral(parent);
+        }
+
+        transport->setPreferredConnectionParameters(preferred);
+        transport->setMetrics(metrics);
+        return transport;
+    };
+
+    BLETransport* transport = nullptr;
+    if (mThreadingMode == ThreadingMode::IOThreadMode) {
+        //! The transport is created on the I/O thread so its backend objects live there as well
+        BLEIOThread::instance().run([&]() {
+            transport = factory(nullptr);
+        });
+    } else {
+        transport = factory(this);
+    }
+
+    //! Queued before anything else runs for this role on the transport's thread
+    QMetaObject::invokeMethod(
+        transport,
+        [this, services = mServices]() {
+            mTransportServices = services;
+        },
+        transport->thread() == QThread::currentThread() ? Qt::DirectConnection
+                                                        : Qt::QueuedConnection);
+
+    connect(transport, &BLETransport::stateChanged, this, &BLERole::stateChanged);
+
+    //! Received and read values are dispatched on the transport's thread
+    connect(transport, &BLETransport::characteristicChanged, transport,
+            [this](const QBluetoothUuid& service, const QBluetoothUuid& characteristic,
+                   const QByteArray& value) {
+                dispatchValue(service, characteristic, value);
+            });
+    connect(transport, &BLETransport::characteristicRead, transport,
+            [this](const QBluetoothUuid& service, const QBluetoothUuid& characteristic,
+                   const QByteArray& value) {
+                dispatchValue(service, characteristic, value);
+            });
+
+    //! The metrics are thread safe, these run on the transport's thread as well
+    connect(transport, &BLETransport::characteristicWritten, transport,
+            [metrics = mMetrics](const QBluetoothUuid& service,
+                                 const QBluetoothUuid& characteristic) {
+                metrics->finishWrite(metrics->channel(service.toUInt32(),
+                                                      characteristic.toUInt32()));
+            });
+    connect(transport, &BLETransport::characteristicWritten, transport,
+            [this](const QBluetoothUuid& service, const QBluetoothUuid& characteristic,
+                   const QByteArray& value) {
+                for (BLEDataService* srv : std::as_const(mTransportServices)) {
+                    if (srv->characterBluetoothUuid() == characteristic
+                        && srv->serviceBluetoothUuid() == service) {
+                        srv->acknowledgeValue(value);
+                        break;
+                    }
+                }
+            });
+    connect(transport, &BLETransport::connected, transport, [metrics = mMetrics]() {
+        if (metrics->counter(BLEMetrics::Connections) > 0) {
+            metrics->increment(BLEMetrics::Reconnects);
+        }
+        metrics->increment(BLEMetrics::Connections);
+    });
+    connect(transport, &BLETransport::disconnected, transport, [metrics = mMetrics]() {
+        metrics->increment(BLEMetrics::Disconnections);
+    });
+    connect(transport, &BLETransport::errorOccurred, transport, [metrics = mMetrics]() {
+        metrics->increment(BLEMetrics::Errors);
+    });
+
+    //! The parameters in effect are kept on the thread of this role
+    connect(transport, &BLETransport::connectionUpdated, this,
+            [this](const QLowEnergyConnectionParameters& parameters) {
+                mConnectionParameters = parameters;
+                mHasConnectionParameters = true;
+                emit connectionUpdated();
+            });
+    connect(transport, &BLETransport::disconnected, this, [this]() {
+        if (std::exchange(mHasConnectionParameters, false)) {
+            emit connectionUpdated();
+        }
+    });
+
+    return transport;
 }
 
-BLEDataService* BLERole::servicesListAt(ServicesListProperty* services, qsizetype index)
+void BLERole::destroyTransport()
 {
-    return reinterpret_cast<BLERole*>(services->object)->serviceAt(index);
+    if (!mTransport) {
+        return;
+    }
+
+    BLETransport* transport = std::exchange(mTransport, nullptr);
+
+    if (!mAdapter.isNull()) {
+        BluetoothController::instance().releaseAdapter(std::exchange(mAdapter, QBluetoothAddress()));
+        emit adapterChanged();
+    }
+
+    for (BLEDataService* service : std::as_const(mServices)) {
+        service->release();
+    }
+
+    //! Some connections run on the transport's thread and capture this role, its services and
+    //! its metrics. They are dropped on that thread, which waits for a slot already running there
+    auto drop = [this, transport]() {
+        transport->disconnect();
+        mTransportServices.clear();
+        transport->disconnectFromDevice();
+        delete transport;
+    };
+
+    if (transport->thread() == QThread::currentThread()) {
+        drop();
+    } else {
+        BLEIOThread::instance().run(drop);
+    }
 }
 
-qsizetype BLERole::servicesListCount(ServicesListProperty* services)
+void BLERole::waitForTransport()
 {
-    return reinterpret_cast<BLERole*>(services->object)->serviceCount();
+    if (mTransport && mTransport->thread() != QThread::currentThread()) {
+        BLEIOThread::instance().run([]() {});
+    }
 }
 
-void BLERole::servicesListClear(ServicesListProperty* services)
+void BLERole::dispatchValue(const QBluetoothUuid& service,
+                            const QBluetoothUuid& characteristic,
+                            const QByteArray& value)
 {
-    reinterpret_cast<BLERole*>(services->object)->serviceClear();
+    QB_TRACE_SCOPE("dispatchValue");
+    const qint64 start = mMetrics->enabled() ? BLEMetrics::now() : 0;
+
+    for (BLEDataService* srv : std::as_const(mTransportServices)) {
+        if (srv->characterBluetoothUuid() == characteristic
+            && srv->serviceBluetoothUuid() == service) {
+            srv->receiveValue(value);
+            break;
+        }
+    }
+
+    if (start) {
+        mMetrics->record(BLEMetrics::DispatchTime, quint64(BLEMetrics::now() - start));
+    }
 }
@@ -1,17 +1,24 @@
 #pragma once
 
 #include <QObject>
-#include <QQmlEngine>
-#include <QQmlListProperty>
+#include <QLowEnergyConnectionParameters>
 #include <QLowEnergyController>
+#include <QPointer>
+#include <QThread>
+
+#include <optional>
 
 #include "BluetoothDeviceInfo.hpp"
+#include "BLELoopbackLink.hpp"
+#include "BLEExportStream.hpp"
+#include "BLEMetrics.hpp"
+#include "BLESharedSamples.hpp"
+#include "BLEStreamLink.hpp"
+#include "BLETransport.hpp"
 
 class BluetoothDeviceInfo;
 class BLEDataService;
 
-using ServicesListProperty = QQmlListProperty<BLEDataService>;
-
 /*!
  * \brief The BLERole class is the base class of BLE peripherals and centrals which provides the
  * common functionalities in both
@@ -19,13 +26,22 @@ using ServicesListProperty = QQmlListProperty<BLEDataService>;
 class BLERole : public QObject
 {
     Q_OBJECT
-    QML_ELEMENT
-    QML_UNCREATABLE("BLERole is an interface")
 
-    Q_CLASSINFO("DefaultProperty", "services")
-    Q_PROPERTY(ServicesListProperty services READ services NOTIFY servicesChanged FINAL)
+    friend class BLESessionReplayer;
+
     Q_PROPERTY(BluetoothDeviceInfo* device READ device NOTIFY deviceChanged)
     Q_PROPERTY(ControllerState state READ state NOTIFY stateChanged)
+    Q_PROPERTY(ThreadingMode threadingMode READ threadingMode WRITE setThreadingMode NOTIFY threadingModeChanged FINAL)
+    Q_PROPERTY(BLELoopbackLink* loopbackLink READ loopbackLink WRITE setLoopbackLink NOTIFY loopbackLinkChanged FINAL)
+    Q_PROPERTY(BLEStreamLink* streamLink READ streamLink WRITE setStreamLink NOTIFY streamLinkChanged FINAL)
+    Q_PROPERTY(BLESharedSamples* sharedSamples READ sharedSamples WRITE setSharedSamples NOTIFY sharedSamplesChanged FINAL)
+    Q_PROPERTY(BLEExportStream* exportStream READ exportStream WRITE setExportStream NOTIFY exportStreamChanged FINAL)
+    Q_PROPERTY(BLEMetrics* metrics READ metrics CONSTANT)
+    Q_PROPERTY(QString adapter READ adapter NOTIFY adapterChanged FINAL)
+    Q_PROPERTY(ConnectionProfile connectionProfile READ connectionProfile WRITE setConnectionProfile NOTIFY connectionProfileChanged FINAL)
+    Q_PROPERTY(qreal connectionInterval READ connectionInterval NOTIFY connectionUpdated)
+    Q_PROPERTY(int connectionLatency READ connectionLatency NOTIFY connectionUpdated)
+    Q_PROPERTY(int supervisionTimeout READ supervisionTimeout NOTIFY connectionUpdated)
 
 public:
     /*!
@@ -42,14 +58,32 @@ public:
     };
     Q_ENUM(ControllerState)
 
-
-    explicit BLERole(QObject *parent = nullptr);
+    /*!
+     * \brief The ThreadingMode enum determines which thread the controller, services and the
+     * decoding of received values run on
+     */
+    enum ThreadingMode : uint8_t {
+        GuiThreadMode = 0,  //! Everything runs on the thread this object lives in
+        IOThreadMode,       //! Everything runs on \ref BLEIOThread and only the decoded values are
+                            //! handed to this thread
+    };
+    Q_ENUM(ThreadingMode)
 
     /*!
-     * \brief services Returns a \a QQmlListProperty instance for services property
-     * \return
+     * \brief The ConnectionProfile enum lists presets of the connection parameters requested once
+     * connected
      */
-    ServicesListProperty services();
+    enum ConnectionProfile : uint8_t {
+        DefaultProfile = 0,     //! Nothing is requested, the backend picks the parameters
+        LowLatencyProfile,      //! 7.5 ms interval and no peripheral latency
+        HighThroughputProfile,  //! 7.5 - 15 ms interval, the most packets per second
+        LowPowerProfile,        //! 100 - 200 ms interval and a peripheral latency of 4
+    };
+    Q_ENUM(ConnectionProfile)
+
+
+    explicit BLERole(QObject *parent = nullptr);
+    ~BLERole() override;
 
     /*!
      * \brief device Getter for the device info of this \ref BLECentral
@@ -63,6 +97,143 @@ public:
      */
     ControllerState state() const;
 
+    /*!
+     * \brief threadingMode Getter for the threading mode
+     * \return
+     */
+    ThreadingMode threadingMode() const;
+    /*!
+     * \brief setThreadingMode Sets the threading mode
+     * \note The mode can't be changed after the transport is created
+     * \param mode
+     */
+    void setThreadingMode(ThreadingMode mode);
+
+    /*!
+     * \brief loopbackLink Getter for the loopback link
+     * \return
+     */
+    BLELoopbackLink* loopbackLink() const;
+    /*!
+     * \brief setLoopbackLink Sets the link used instead of the radio. When set, the role uses a
+     * \ref BLELoopbackTransport on this link, otherwise a \ref BLEQtTransport
+     * \note The link can't be changed after the transport is created
+     * \param link
+     */
+    void setLoopbackLink(BLELoopbackLink* link);
+
+    /*!
+     * \brief streamLink Getter for the stream link
+     * \return
+     */
+    BLEStreamLink* streamLink() const;
+    /*!
+     * \brief setStreamLink Sets the stream that carries the data instead of GATT. When set, the
+     * role uses a \ref BLEStreamTransport, ie RFCOMM for Classic devices. A \ref loopbackLink
+     * takes precedence
+     * \note The link can't be changed after the transport is created
+     * \param link
+     */
+    void setStreamLink(BLEStreamLink* link);
+
+    /*!
+     * \brief sharedSamples Getter for the shared samples
+     * \return
+     */
+    BLESharedSamples* sharedSamples() const;
+    /*!
+     * \brief setSharedSamples Sets where the samples received by the services are published for
+     * other processes of the host, in addition to their \ref BLESampleBus. It can be changed at
+     * any time, and it is unset when \a samples is destroyed
+     * \param samples
+     */
+    void setSharedSamples(BLESharedSamples* samples);
+
+    /*!
+     * \brief exportStream Getter for the export stream
+     * \return
+     */
+    BLEExportStream* exportStream() const;
+    /*!
+     * \brief setExportStream Sets the stream that the samples received by the services are
+     * exported to. Several roles can export to the same stream. It can be changed at any time, and
+     * it is unset when \a stream is destroyed
+     * \param stream
+     */
+    void setExportStream(BLEExportStream* stream);
+
+    /*!
+     * \brief metrics Returns the runtime metrics of this role and its services
+     * \return
+     */
+    BLEMetrics* metrics() const;
+
+    /*!
+     * \brief adapter Returns the address of the local adapter a central is connected through, it
+     * is picked by \ref BluetoothController::acquireAdapter(). Empty for the default adapter
+     * \return
+     */
+    QString adapter() const;
+
+    /*!
+     * \brief connectionProfile Getter for the connection profile
+     * \return
+     */
+    ConnectionProfile connectionProfile() const;
+    /*!
+     * \brief setConnectionProfile Requests the parameters of \a profile now if connected and on
+     * every later connection, e.g. a fast interval during a bulk transfer and a slow one afterwards.
+     * \ref DefaultProfile stops requesting from the next connection
+     * \param profile
+     */
+    void setConnectionProfile(ConnectionProfile profile);
+
+    /*!
+     * \brief requestConnectionParameters Requests explicit connection parameters now if connected
+     * and on every later connection, until another request or profile replaces them
+     * \param minInterval Minimum connection interval in milliseconds, at least 7.5
+     * \param maxInterval Maximum connection interval in milliseconds, at most 4000
+     * \param latency Number of connection events the peripheral may skip
+     * \param supervisionTimeout Time in milliseconds without a packet before the link is lost
+     */
+    Q_INVOKABLE void requestConnectionParameters(qreal minInterval,
+                                                 qreal maxInterval,
+                                                 int latency,
+                                                 int supervisionTimeout);
+    void requestConnectionParameters(const QLowEnergyConnectionParameters& parameters);
+
+    /*!
+     * \brief connectionInterval Returns the connection interval in effect in milliseconds, 0 until
+     * the backend reports one
+     * \return
+     */
+    qreal connectionInterval() const;
+
+    /*!
+     * \brief connectionLatency Returns the peripheral latency in effect
+     * \return
+     */
+    int connectionLatency() const;
+
+    /*!
+     * \brief supervisionTimeout Returns the supervision timeout in effect in milliseconds
+     * \return
+     */
+    int supervisionTimeout() const;
+
+    /*!
+     * \brief profileParameters Returns the connection parameters of \a profile, or
+     * \a std::nullopt for \ref DefaultProfile
+     */
+    static std::optional<QLowEnergyConnectionParameters> profileParameters(
+        ConnectionProfile profile);
+
+    /*!
+     * \brief transport Returns the transport of this role, may be null
+     * \return
+     */
+    BLETransport* transport() const;
+
     /*!
      * \brief serviceAdd Adds the \ref BLEDataService instance to the list of servcies for
      * this peripheral
@@ -102,27 +273,135 @@ protected:
      */
     virtual void writeData(const QBluetoothUuid& uuid, const QVariant& value) = 0;
 
-protected:
-    //! ServicesListProperty methods
-    static void servicesListAppend(ServicesListProperty* services, BLEDataService* service);
-    static BLEDataService* servicesListAt(ServicesListProperty* services, qsizetype index);
-    static qsizetype servicesListCount(ServicesListProperty* services);
-    static void servicesListClear(ServicesListProperty* services);
+    /*!
+     * \brief invokeOnTransport Calls \a func on the thread that \ref mTransport lives in. It is
+     * called directly if that is the current thread, otherwise it is queued
+     */
+    template <typename Func>
+    void invokeOnTransport(Func&& func);
+
+    /*!
+     * \brief createTransport Creates the transport of \a role for this role based on the loopback
+     * link and the threading mode. In \ref IOThreadMode the transport is created on \ref
+     * BLEIOThread with no parent, otherwise it is created with this object as parent. The signals
+     * of the transport that are common to both roles are connected as well
+     * \param role Central or peripheral
+     * \param remoteDevice The device to connect to, only used by centrals
+     * \return The created transport
+     */
+    BLETransport* createTransport(QLowEnergyController::Role role,
+                                  const QBluetoothDeviceInfo& remoteDevice = QBluetoothDeviceInfo());
+
+    /*!
+     * \brief setPreferredParameters Keeps \a parameters for the next transports and hands them to
+     * the current one
+     */
+    void setPreferredParameters(const std::optional<QLowEnergyConnectionParameters>& parameters);
+
+    /*!
+     * \brief destroyTransport Releases the services and deletes \ref mTransport on its own thread.
+     * This blocks until nothing of this role runs on that thread anymore
+     */
+    void destroyTransport();
+
+    /*!
+     * \brief syncTransportServices Hands a copy of \ref mServices to the thread of the transport,
+     * see \ref mTransportServices
+     */
+    void syncTransportServices();
+
+    /*!
+     * \brief dispatchValue Hands a value received from the other end to the \ref BLEDataService
+     * of the characteristic. This is called on the thread of the transport, see
+     * \ref mTransportServices
+     */
+    void dispatchValue(const QBluetoothUuid& service,
+                       const QBluetoothUuid& characteristic,
+                       const QByteArray& value);
+
+    /*!
+     * \brief waitForTransport Blocks until what is already running or queued on the thread of
+     * \ref mTransport is done, i.e. once the services stopped using an object
+     */
+    void waitForTransport();
+
+    /*!
+     * \brief sharedSamplesDestroyed Unsets the shared samples of the services before the object
+     * goes away, nothing on the transport's thread uses it anymore afterwards
+     */
+    void sharedSamplesDestroyed();
+
+    /*!
+     * \brief exportStreamDestroyed Unsets the export stream of the services before the object
+     * goes away, see \ref sharedSamplesDestroyed()
+     */
+    void exportStreamDestroyed();
 
 signals:
     void deviceChanged();
     void stateChanged();
     void servicesChanged();
+    void threadingModeChanged();
+    void loopbackLinkChanged();
+    void streamLinkChanged();
+    void sharedSamplesChanged();
+    void exportStreamChanged();
+    void adapterChanged();
+    void connectionProfileChanged();
+
+    /*!
+     * \brief connectionUpdated Emitted when the connection parameters in effect change
+     */
+    void connectionUpdated();
 
 protected:
-    //! \brief mController Holds the \a QLowEnergyController instance
-    QLowEnergyController* mController;
+    //! \brief mTransport The link to the other end of the connection
+    BLETransport* mTransport;
 
     //! \brief Connected device
     BluetoothDeviceInfo* mDevice;
 
     //! \brief mServices All the services for this \ref BLEPeripheral
     QList<BLEDataService*> mServices;
+
+    //! \brief mTransportServices The copy of \ref mServices used on the thread of the transport,
+    //! only ever accessed there
+    QList<BLEDataService*> mTransportServices;
+
+    //! \brief mThreadingMode The threading mode of this role
+    ThreadingMode mThreadingMode;
+
+    //! \brief mLoopbackLink If set, the link used instead of the radio
+    BLELoopbackLink* mLoopbackLink;
+
+    //! \brief mStreamLink If set, the stream used instead of GATT
+    BLEStreamLink* mStreamLink;
+
+    //! \brief mSharedSamples If set, the shared memory the services publish their samples to.
+    //! It usually belongs to QML, see \ref sharedSamplesDestroyed()
+    QPointer<BLESharedSamples> mSharedSamples;
+
+    //! \brief mExportStream If set, the stream the services export their samples to. It usually
+    //! belongs to QML, see \ref exportStreamDestroyed()
+    QPointer<BLEExportStream> mExportStream;
+
+    //! \brief mMetrics Runtime metrics, shared with the services
+    BLEMetrics* mMetrics;
+
+    //! \brief mAdapter The local adapter acquired for \ref mTransport, null for the default one
+    QBluetoothAddress mAdapter;
+
+    //! \brief mConnectionProfile The preset of \ref mPreferredParameters
+    ConnectionProfile mConnectionProfile;
+
+    //! \brief mPreferredParameters Connection parameters requested on every connection
+    std::optional<QLowEnergyConnectionParameters> mPreferredParameters;
+
+    //! \brief mConnectionParameters The connection parameters in effect
+    QLowEnergyConnectionParameters mConnectionParameters;
+
+    //! \brief mHasConnectionParameters True once the backend reported the parameters in effect
+    bool mHasConnectionParameters;
 };
 
 
@@ -133,5 +412,80 @@ inline BluetoothDeviceInfo* BLERole::device() const
 
 inline BLERole::ControllerState BLERole::state() const
 {
-    return mController ? ControllerState(mController->state()) : ControllerState::UnconnectedState;
+    return mTransport ? ControllerState(mTransport->state()) : ControllerState::UnconnectedState;
+}
+
+inline BLERole::ThreadingMode BLERole::threadingMode() const
+{
+    return mThreadingMode;
+}
+
+inline BLELoopbackLink* BLERole::loopbackLink() const
+{
+    return mLoopbackLink;
+}
+
+inline BLEStreamLink* BLERole::streamLink() const
+{
+    return mStreamLink;
+}
+
+inline BLESharedSamples* BLERole::sharedSamples() const
+{
+    return mSharedSamples;
+}
+
+inline BLEExportStream* BLERole::exportStream() const
+{
+    return mExportStream;
+}
+
+inline BLEMetrics* BLERole::metrics() const
+{
+    return mMetrics;
+}
+
+inline QString BLERole::adapter() const
+{
+    return mAdapter.isNull() ? QString() : mAdapter.toString();
+}
+
+inline BLERole::ConnectionProfile BLERole::connectionProfile() const
+{
+    return mConnectionProfile;
+}
+
+inline qreal BLERole::connectionInterval() const
+{
+    return mHasConnectionParameters ? mConnectionParameters.minimumInterval() : 0;
+}
+
+inline int BLERole::connectionLatency() const
+{
+    return mHasConnectionParameters ? mConnectionParameters.latency() : 0;
+}
+
+inline int BLERole::supervisionTimeout() const
+{
+    return mHasConnectionParameters ? mConnectionParameters.supervisionTimeout() : 0;
+}
+
+inline BLETransport* BLERole::transport() const
+{
+    return mTransport;
+}
+
+template <typename Func>
+inline void BLERole::invokeOnTransport(Func&& func)
+{
+    if (!mTransport) {
+        return;
+    }
+
+    if (mTransport->thread() == QThread::currentThread()) {
+        func();
+        return;
+    }
+
+    QMetaObject::invokeMethod(mTransport, std::forward<Func>(func), Qt::QueuedConnection);
 }
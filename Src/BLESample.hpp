@@ -0,0 +1,133 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+
+#include "BLECodecRegistry.hpp"
+
+/*!
+ * \brief The BLESample struct is a decoded value of a characteristic. It is a fixed size, trivially
+ * copyable type so it can be passed through lock-free queues without any allocation
+ */
+struct BLESample
+{
+    //! \brief MaxSize Maximum number of payload bytes kept in a sample. This matches the 31 bytes
+    //! limit of \ref BLEDataService::valueLength
+    static constexpr qsizetype MaxSize = 31;
+
+    //! \brief The type of the decoded value, values match \ref BLEDataService::DataType
+    enum Type : quint8 {
+        Int = 0,
+        Float,
+        String,
+        Standard
+    };
+
+    //! \brief timestamp Monotonic time of receiving this sample in nanoseconds, see \ref now()
+    qint64 timestamp = 0;
+
+    //! \brief serviceUuid The 32 bit form of the service uuid
+    quint32 serviceUuid = 0;
+
+    //! \brief characterUuid The 32 bit form of the characteristic uuid
+    quint32 characterUuid = 0;
+
+    //! \brief type The type of the decoded value
+    Type type = Int;
+
+    //! \brief size The number of valid bytes in \ref data
+    quint8 size = 0;
+
+    //! \brief intValue Decoded value when \ref type is \ref Int
+    qint16 intValue = 0;
+
+    //! \brief floatValue Decoded value when \ref type is \ref Float, the main field of a
+    //! \ref Standard value
+    float floatValue = 0;
+
+    //! \brief data The raw payload, for \ref String this is the UTF-8 text and for \ref Standard
+    //! the value of the characteristic as its codec in \ref BLECodecRegistry reads it
+    char data[MaxSize] = {};
+
+    /*!
+     * \brief setData Copies the raw payload into \ref data
+     * \return False if \a bytes does not fit in a sample
+     */
+    bool setData(const QByteArray& bytes);
+
+    /*!
+     * \brief bytes Returns a copy of the raw payload
+     */
+    QByteArray bytes() const;
+
+    /*!
+     * \brief samePayload Returns true if \a other has the same type, raw payload and decoded
+     * value, the uuids and the timestamp are not compared
+     */
+    bool samePayload(const BLESample& other) const;
+
+    /*!
+     * \brief toVariant Returns the decoded value as a \a QVariant with the same type used by
+     * \ref BLEDataService::value
+     */
+    QVariant toVariant() const;
+
+    /*!
+     * \brief now Monotonic time in nanoseconds used for \ref timestamp
+     */
+    static qint64 now();
+};
+
+static_assert(std::is_trivially_copyable_v<BLESample>, "BLESample must be trivially copyable");
+
+
+inline bool BLESample::setData(const QByteArray& bytes)
+{
+    if (bytes.size() > MaxSize) {
+        return false;
+    }
+
+    size = quint8(bytes.size());
+    std::memcpy(data, bytes.constData(), size);
+    return true;
+}
+
+inline QByteArray BLESample::bytes() const
+{
+    return QByteArray(data, size);
+}
+
+inline bool BLESample::samePayload(const BLESample& other) const
+{
+    return type == other.type && size == other.size && intValue == other.intValue
+           && std::memcmp(&floatValue, &other.floatValue, sizeof(floatValue)) == 0
+           && std::memcmp(data, other.data, size) == 0;
+}
+
+inline QVariant BLESample::toVariant() const
+{
+    switch (type) {
+    case Int:
+        return QVariant::fromValue<short>(intValue);
+    case Float:
+        return QVariant::fromValue<float>(floatValue);
+    case String:
+        return QString::fromUtf8(data, size);
+    case Standard:
+        return BLECodecRegistry::decode(characterUuid, data, size);
+    }
+
+    return QVariant();
+}
+
+inline qint64 BLESample::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
@@ -0,0 +1,122 @@
+#include "BLESampleBus.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+std::size_t roundUpToPowerOfTwo(std::size_t value)
+{
+    std::size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+
+    return result;
+}
+
+} // namespace
+
+BLESampleBus::BLESampleBus(std::size_t capacity)
+    : mSlots { new Slot[roundUpToPowerOfTwo(capacity)] }
+    , mMask { roundUpToPowerOfTwo(capacity) - 1 }
+    , mHead { 0 }
+{}
+
+BLESampleBus::~BLESampleBus() = default;
+
+BLESampleBus& BLESampleBus::instance()
+{
+    static BLESampleBus bus;
+    return bus;
+}
+
+void BLESampleBus::publish(const BLESample& sample)
+{
+    const quint64 sequence = mHead.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = mSlots[sequence & mMask];
+
+    //! Claim the slot. A newer publisher that lapped this one wins and this sample is dropped.
+    //! An older one that is still writing the slot isn't waited for either, this sample is dropped
+    //! and marked so readers skip it as an overrun
+    const quint64 writing = 2 * sequence + 1;
+    quint64 version = slot.version.load(std::memory_order_relaxed);
+    for (;;) {
+        if (version >= writing) {
+            return;
+        }
+        if (version & 1) {
+            markDropped(slot, sequence);
+            return;
+        }
+        if (slot.version.compare_exchange_weak(version, writing, std::memory_order_acquire,
+                                               std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(static_cast<void*>(&slot.sample), &sample, sizeof(BLESample));
+    slot.version.store(writing + 1, std::memory_order_release);
+}
+
+void BLESampleBus::markDropped(Slot& slot, quint64 sequence)
+{
+    quint64 dropped = slot.dropped.load(std::memory_order_relaxed);
+    while (dropped <= sequence
+           && !slot.dropped.compare_exchange_weak(dropped, sequence + 1, std::memory_order_release,
+                                                  std::memory_order_relaxed)) {
+    }
+}
+
+BLESampleBus::Reader::Reader(const BLESampleBus& bus)
+    : mBus { &bus }
+    , mCursor { bus.mHead.load(std::memory_order_acquire) }
+    , mOverruns { 0 }
+{}
+
+bool BLESampleBus::Reader::read(BLESample& sample)
+{
+    for (;;) {
+        const Slot& slot = mBus->mSlots[mCursor & mBus->mMask];
+        const quint64 expected = 2 * mCursor + 2;
+
+        const quint64 before = slot.version.load(std::memory_order_acquire);
+        if (before < expected) {
+            //! A publisher that found the slot busy dropped this sample
+            if (slot.dropped.load(std::memory_order_acquire) > mCursor) {
+                skipOverwritten();
+                continue;
+            }
+
+            //! Not published yet or still being written
+            return false;
+        }
+        if (before > expected) {
+            skipOverwritten();
+            continue;
+        }
+
+        std::memcpy(static_cast<void*>(&sample), &slot.sample, sizeof(BLESample));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (slot.version.load(std::memory_order_relaxed) != expected) {
+            //! The slot was reused while copying
+            skipOverwritten();
+            continue;
+        }
+
+        ++mCursor;
+        return true;
+    }
+}
+
+void BLESampleBus::Reader::skipOverwritten()
+{
+    const quint64 head = mBus->mHead.load(std::memory_order_acquire);
+    const quint64 oldest = head > mBus->capacity() ? head - mBus->capacity() : 0;
+    const quint64 next = std::max(mCursor + 1, oldest);
+
+    mOverruns += next - mCursor;
+    mCursor = next;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "BLESample.hpp"
+
+/*!
+ * \brief The BLESampleBus class is a lock-free, bounded ring buffer that every \ref BLEDataService
+ * publishes its received samples to. Any number of threads can publish and any number of
+ * \ref Reader instances can consume at their own pace, each with its own cursor. When a reader falls
+ * more than \ref capacity() samples behind, the oldest samples are overwritten and counted as
+ * overruns of that reader. Publishers never wait, neither for readers nor for each other: a sample
+ * whose slot is still being written by a publisher a whole lap behind is dropped and counted as an
+ * overrun as well.
+ */
+class BLESampleBus
+{
+public:
+    //! \brief DefaultCapacity Number of samples kept by \ref instance()
+    static constexpr std::size_t DefaultCapacity = 1024;
+
+    /*!
+     * \brief BLESampleBus Creates a bus that keeps the last \a capacity samples
+     * \param capacity Is rounded up to a power of two
+     */
+    explicit BLESampleBus(std::size_t capacity = DefaultCapacity);
+    ~BLESampleBus();
+
+    BLESampleBus(const BLESampleBus&) = delete;
+    BLESampleBus& operator=(const BLESampleBus&) = delete;
+
+    /*!
+     * \brief instance Returns the default bus that \ref BLEDataService instances publish to
+     */
+    static BLESampleBus& instance();
+
+    /*!
+     * \brief publish Adds a copy of \a sample to the bus. This is thread safe and never blocks
+     * on readers
+     * \param sample
+     */
+    void publish(const BLESample& sample);
+
+    /*!
+     * \brief published Returns the number of samples published so far
+     */
+    quint64 published() const;
+
+    /*!
+     * \brief capacity Returns the number of samples that the bus keeps
+     */
+    std::size_t capacity() const;
+
+    /*!
+     * \brief The Reader class reads samples from a \ref BLESampleBus. A reader must only be used
+     * from one thread at a time
+     */
+    class Reader
+    {
+    public:
+        /*!
+         * \brief Reader Creates a reader of \a bus that starts at the next published sample
+         * \param bus
+         */
+        explicit Reader(const BLESampleBus& bus);
+
+        /*!
+         * \brief read Copies the next sample into \a sample
+         * \return False if there is no new sample
+         */
+        bool read(BLESample& sample);
+
+        /*!
+         * \brief readAll Calls \a func with every available sample, up to \a max samples
+         * \return The number of samples read
+         */
+        template <typename Func>
+        std::size_t readAll(Func&& func, std::size_t max = std::size_t(-1));
+
+        /*!
+         * \brief overruns Returns the number of samples this reader missed because they were
+         * overwritten before being read
+         */
+        quint64 overruns() const;
+
+        /*!
+         * \brief pending Returns the approximate number of samples waiting to be read
+         */
+        quint64 pending() const;
+
+    private:
+        /*!
+         * \brief skipOverwritten Moves the cursor to the oldest sample that is still in the bus
+         */
+        void skipOverwritten();
+
+    private:
+        //! \brief mBus The bus that is read
+        const BLESampleBus* mBus;
+
+        //! \brief mCursor Sequence number of the next sample to read
+        quint64 mCursor;
+
+        //! \brief mOverruns Number of samples that are missed
+        quint64 mOverruns;
+    };
+
+private:
+    /*!
+     * \brief The Slot struct holds one sample. \ref version is odd while the slot is being written
+     * and is 2 * (sequence + 1) once the sample with that sequence number is complete. \ref dropped
+     * is sequence + 1 of the latest sample dropped because the slot was busy, 0 if none
+     */
+    struct Slot
+    {
+        std::atomic<quint64> version { 0 };
+        std::atomic<quint64> dropped { 0 };
+        BLESample sample;
+    };
+
+    /*!
+     * \brief markDropped Marks the sample with \a sequence as dropped in \a slot, whose previous
+     * sample is still being written
+     */
+    static void markDropped(Slot& slot, quint64 sequence);
+
+    //! \brief mSlots The ring of samples
+    std::unique_ptr<Slot[]> mSlots;
+
+    //! \brief mMask Capacity - 1, used to map a sequence number to a slot
+    std::size_t mMask;
+
+    //! \brief mHead Sequence number of the next sample to publish
+    alignas(64) std::atomic<quint64> mHead;
+};
+
+
+inline quint64 BLESampleBus::published() const
+{
+    return mHead.load(std::memory_order_relaxed);
+}
+
+inline std::size_t BLESampleBus::capacity() const
+{
+    return mMask + 1;
+}
+
+inline quint64 BLESampleBus::Reader::overruns() const
+{
+    return mOverruns;
+}
+
+inline quint64 BLESampleBus::Reader::pending() const
+{
+    const quint64 head = mBus->mHead.load(std::memory_order_acquire);
+    return head > mCursor ? head - mCursor : 0;
+}
+
+template <typename Func>
+inline std::size_t BLESampleBus::Reader::readAll(Func&& func, std::size_t max)
+{
+    std::size_t count = 0;
+    BLESample sample;
+    while (count < max && read(sample)) {
+        func(sample);
+        ++count;
+    }
+
+    return count;
+}
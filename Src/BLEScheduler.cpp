@@ -0,0 +1,94 @@
+#include "BLEScheduler.hpp"
+
+int BLEScheduler::defaultDeadline(Priority priority)
+{
+    switch (priority) {
+    case UrgentPriority:
+        return 0;
+    case HighPriority:
+        return 20;
+    case NormalPriority:
+        return 100;
+    default:
+        return 1000;
+    }
+}
+
+void BLEScheduler::setPriority(const QBluetoothUuid& characteristic, Priority priority,
+                               int deadline)
+{
+    const int milliseconds = deadline > 0 ? deadline : defaultDeadline(priority);
+    mClasses.insert(characteristic, Class { priority, qint64(milliseconds) * 1000000 });
+}
+
+bool BLEScheduler::push(const QBluetoothUuid& service,
+                        const QBluetoothUuid& characteristic,
+                        const QByteArray& value,
+                        qint64 now,
+                        QBluetoothUuid* dropped)
+{
+    //! Characteristics without a priority are normal ones
+    const Class cls = mClasses.value(characteristic,
+                                     Class { NormalPriority,
+                                             qint64(defaultDeadline(NormalPriority)) * 1000000 });
+
+    std::deque<Entry>& queue = mQueues[cls.priority];
+    bool kept = true;
+    if (queue.size() >= QueueSize) {
+        if (dropped) {
+            *dropped = queue.front().characteristic;
+        }
+        queue.pop_front();
+        --mWaiting;
+        kept = false;
+    }
+
+    queue.push_back(Entry { service, characteristic, value, now, now + cls.deadline });
+    ++mWaiting;
+    return kept;
+}
+
+bool BLEScheduler::pop(qint64 now, Entry& entry, Priority& priority)
+{
+    if (mWaiting == 0) {
+        return false;
+    }
+
+    //! The oldest value of a class has its earliest deadline, so only the heads are compared
+    int next = -1;
+    qint64 earliest = 0;
+    for (int i = 0; i < PriorityCount; ++i) {
+        if (mQueues[i].empty()) {
+            continue;
+        }
+
+        const qint64 deadline = mQueues[i].front().deadline;
+        if (deadline <= now && (next < 0 || deadline < earliest)) {
+            next = i;
+            earliest = deadline;
+        }
+    }
+
+    if (next < 0) {
+        for (int i = 0; i < PriorityCount; ++i) {
+            if (!mQueues[i].empty()) {
+                next = i;
+                break;
+            }
+        }
+    }
+
+    entry = std::move(mQueues[next].front());
+    mQueues[next].pop_front();
+    --mWaiting;
+    priority = Priority(next);
+    return true;
+}
+
+void BLEScheduler::clear()
+{
+    for (std::deque<Entry>& queue : mQueues) {
+        queue.clear();
+    }
+    mWaiting = 0;
+}
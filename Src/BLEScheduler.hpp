@@ -0,0 +1,126 @@
+#pragma once
+
+#include <QBluetoothUuid>
+#include <QByteArray>
+#include <QHash>
+
+#include <array>
+#include <deque>
+
+/*!
+ * \brief The BLEScheduler class orders the values a \ref BLETransport sends by the priority class
+ * of their characteristic. A value whose deadline passed goes first, the one with the earliest
+ * deadline among them, otherwise the oldest value of the most urgent class does. Every class has a
+ * default deadline so the low classes are never starved by a burst of urgent values
+ * \note A scheduler is used from the thread of its transport only
+ */
+class BLEScheduler
+{
+public:
+    /*!
+     * \brief The Priority enum lists the priority classes, values match
+     * \ref BLEDataService::Priority
+     */
+    enum Priority : quint8 {
+        UrgentPriority = 0,
+        HighPriority,
+        NormalPriority,
+        BulkPriority,
+        PriorityCount
+    };
+
+    //! \brief QueueSize Number of values waiting in a class before the oldest is dropped
+    static constexpr int QueueSize = 64;
+
+    /*!
+     * \brief The Entry struct is a value waiting to be sent
+     */
+    struct Entry
+    {
+        QBluetoothUuid service;
+        QBluetoothUuid characteristic;
+        QByteArray value;
+
+        //! \brief queued Time the value was queued in nanoseconds, see \ref BLESample::now()
+        qint64 queued = 0;
+
+        //! \brief deadline Time the value should be sent by in nanoseconds
+        qint64 deadline = 0;
+    };
+
+    /*!
+     * \brief defaultDeadline Returns the time in milliseconds a value of \a priority may wait
+     * when its characteristic has no deadline hint
+     */
+    static int defaultDeadline(Priority priority);
+
+    /*!
+     * \brief setPriority Sets the class of \a characteristic and the time in milliseconds its
+     * values may wait, 0 uses the \ref defaultDeadline() of the class
+     */
+    void setPriority(const QBluetoothUuid& characteristic, Priority priority, int deadline = 0);
+
+    /*!
+     * \brief isEnabled Returns true once a characteristic has a priority. Until then values are
+     * written directly
+     */
+    bool isEnabled() const;
+
+    /*!
+     * \brief push Queues \a value of \a characteristic at \a now
+     * \param dropped If not null, set to the characteristic of the value dropped if any
+     * \return False if the oldest value of the class was dropped to make room
+     */
+    bool push(const QBluetoothUuid& service,
+              const QBluetoothUuid& characteristic,
+              const QByteArray& value,
+              qint64 now,
+              QBluetoothUuid* dropped = nullptr);
+
+    /*!
+     * \brief pop Takes the next value to send at \a now into \a entry and its class into
+     * \a priority
+     * \return False if nothing is waiting
+     */
+    bool pop(qint64 now, Entry& entry, Priority& priority);
+
+    /*!
+     * \brief isEmpty Returns true if nothing is waiting
+     */
+    bool isEmpty() const;
+
+    /*!
+     * \brief clear Drops every waiting value
+     */
+    void clear();
+
+private:
+    /*!
+     * \brief The Class struct is the setting of a characteristic
+     */
+    struct Class
+    {
+        Priority priority = NormalPriority;
+        qint64 deadline = 0;
+    };
+
+    //! \brief mClasses The class of each characteristic with a priority
+    QHash<QBluetoothUuid, Class> mClasses;
+
+    //! \brief mQueues The waiting values of each class, oldest first
+    std::array<std::deque<Entry>, PriorityCount> mQueues;
+
+    //! \brief mWaiting Number of values in every queue
+    int mWaiting = 0;
+};
+
+
+inline bool BLEScheduler::isEnabled() const
+{
+    return !mClasses.isEmpty();
+}
+
+inline bool BLEScheduler::isEmpty() const
+{
+    return mWaiting == 0;
+}
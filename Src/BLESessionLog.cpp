@@ -0,0 +1,230 @@
+#include "BLESessionLog.hpp"
+
+#include <QtEndian>
+
+namespace {
+
+constexpr char Magic[4] = { 'Q', 'B', 'S', 'L' };
+
+} // namespace
+
+template <typename T>
+void BLESessionLog::appendInt(QByteArray& out, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, sizeof(T));
+}
+
+void BLESessionLog::appendVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+QByteArray BLESessionLog::header(qint64 startTime)
+{
+    QByteArray out;
+    out.reserve(HeaderSize);
+    out.append(Magic, sizeof(Magic));
+    appendInt<quint16>(out, Version);
+    appendInt<quint16>(out, 0);
+    appendInt<qint64>(out, startTime);
+    return out;
+}
+
+void BLESessionLog::appendNotification(QByteArray& out, quint64 delta,
+                                       quint32 serviceUuid, quint32 characterUuid,
+                                       const QByteArray& value)
+{
+    out.append(char(BLESessionRecord::Notification));
+    appendVarint(out, delta);
+    appendInt<quint32>(out, serviceUuid);
+    appendInt<quint32>(out, characterUuid);
+    appendVarint(out, quint64(value.size()));
+    out.append(value);
+}
+
+void BLESessionLog::appendAdvertisement(QByteArray& out, quint64 delta,
+                                        const QBluetoothDeviceInfo& device)
+{
+    out.append(char(BLESessionRecord::Advertisement));
+    appendVarint(out, delta);
+    appendInt<quint64>(out, device.address().toUInt64());
+    appendInt<qint16>(out, device.rssi());
+    appendInt<quint8>(out, quint8(device.coreConfigurations().toInt()));
+
+    const QByteArray name = device.name().toUtf8();
+    appendVarint(out, quint64(name.size()));
+    out.append(name);
+
+    const QMultiHash<quint16, QByteArray> manufacturerData = device.manufacturerData();
+    appendVarint(out, quint64(manufacturerData.size()));
+    for (auto it = manufacturerData.cbegin(); it != manufacturerData.cend(); ++it) {
+        appendInt<quint16>(out, it.key());
+        appendVarint(out, quint64(it.value().size()));
+        out.append(it.value());
+    }
+
+    const QList<QBluetoothUuid> services = device.serviceUuids();
+    appendVarint(out, quint64(services.size()));
+    for (const QBluetoothUuid& uuid : services) {
+        out.append(uuid.toRfc4122());
+    }
+}
+
+BLESessionLog::Reader::Reader(const QByteArray& data)
+    : mData { data }
+    , mPos { HeaderSize }
+    , mValid { false }
+    , mStartTime { 0 }
+    , mTimestamp { 0 }
+{
+    if (mData.size() < HeaderSize || !mData.startsWith(QByteArray::fromRawData(Magic, 4))) {
+        return;
+    }
+
+    const quint16 version = qFromLittleEndian<quint16>(mData.constData() + 4);
+    mStartTime = qFromLittleEndian<qint64>(mData.constData() + 8);
+    mValid = version <= Version;
+}
+
+bool BLESessionLog::Reader::isValid() const
+{
+    return mValid;
+}
+
+qint64 BLESessionLog::Reader::startTime() const
+{
+    return mStartTime;
+}
+
+bool BLESessionLog::Reader::readVarint(quint64& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && mPos < mData.size(); shift += 7) {
+        const uchar byte = uchar(mData.at(mPos++));
+        value |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+bool BLESessionLog::Reader::readInt(T& value)
+{
+    if (mData.size() - mPos < qsizetype(sizeof(T))) {
+        return false;
+    }
+
+    value = qFromLittleEndian<T>(mData.constData() + mPos);
+    mPos += sizeof(T);
+    return true;
+}
+
+bool BLESessionLog::Reader::readBytes(qsizetype size, QByteArray& bytes)
+{
+    if (size < 0 || mData.size() - mPos < size) {
+        return false;
+    }
+
+    bytes = mData.mid(mPos, size);
+    mPos += size;
+    return true;
+}
+
+bool BLESessionLog::Reader::next(BLESessionRecord& record)
+{
+    if (!mValid || mPos >= mData.size()) {
+        return false;
+    }
+
+    //! Read into locals first so a truncated record leaves the reader where it was
+    const qsizetype start = mPos;
+    auto truncated = [this, start]() {
+        mPos = start;
+        return false;
+    };
+
+    const quint8 kind = quint8(mData.at(mPos++));
+    quint64 delta = 0;
+    if (!readVarint(delta)) {
+        return truncated();
+    }
+
+    quint64 length = 0;
+    switch (kind) {
+    case BLESessionRecord::Notification: {
+        quint32 service = 0;
+        quint32 characteristic = 0;
+        QByteArray value;
+        if (!readInt(service) || !readInt(characteristic) || !readVarint(length)
+            || !readBytes(qsizetype(length), value)) {
+            return truncated();
+        }
+
+        record.kind = BLESessionRecord::Notification;
+        record.serviceUuid = service;
+        record.characterUuid = characteristic;
+        record.value = value;
+        break;
+    }
+    case BLESessionRecord::Advertisement: {
+        quint64 address = 0;
+        qint16 rssi = 0;
+        quint8 coreConfigurations = 0;
+        QByteArray name;
+        if (!readInt(address) || !readInt(rssi) || !readInt(coreConfigurations)
+            || !readVarint(length) || !readBytes(qsizetype(length), name)) {
+            return truncated();
+        }
+
+        QBluetoothDeviceInfo device(QBluetoothAddress(address), QString::fromUtf8(name), 0);
+        device.setRssi(rssi);
+        device.setCoreConfigurations(
+            QBluetoothDeviceInfo::CoreConfigurations::fromInt(coreConfigurations));
+
+        quint64 count = 0;
+        if (!readVarint(count)) {
+            return truncated();
+        }
+        for (quint64 i = 0; i < count; ++i) {
+            quint16 company = 0;
+            QByteArray data;
+            if (!readInt(company) || !readVarint(length) || !readBytes(qsizetype(length), data)) {
+                return truncated();
+            }
+            device.setManufacturerData(company, data);
+        }
+
+        if (!readVarint(count)) {
+            return truncated();
+        }
+        QList<QBluetoothUuid> services;
+        for (quint64 i = 0; i < count; ++i) {
+            QByteArray uuid;
+            if (!readBytes(16, uuid)) {
+                return truncated();
+            }
+            services.append(QBluetoothUuid(QUuid::fromRfc4122(uuid)));
+        }
+        device.setServiceUuids(services);
+
+        record.kind = BLESessionRecord::Advertisement;
+        record.device = device;
+        break;
+    }
+    default:
+        //! Unknown records can't be skipped since their size is unknown
+        return truncated();
+    }
+
+    mTimestamp += qint64(delta) * 1000;
+    record.timestamp = mTimestamp;
+    return true;
+}
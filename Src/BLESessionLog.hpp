@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QBluetoothDeviceInfo>
+#include <QByteArray>
+#include <QtGlobal>
+
+/*!
+ * \brief The BLESessionRecord struct is one entry of a session log, either a notification received
+ * by a \ref BLEDataService or an advertisement seen by a \ref BluetoothDiscovery
+ */
+struct BLESessionRecord
+{
+    enum Kind : quint8 {
+        Notification = 1,
+        Advertisement = 2,
+    };
+
+    Kind kind = Notification;
+
+    //! \brief timestamp Nanoseconds since the first record of the session
+    qint64 timestamp = 0;
+
+    //! Notification
+    quint32 serviceUuid = 0;
+    quint32 characterUuid = 0;
+    QByteArray value;
+
+    //! Advertisement
+    QBluetoothDeviceInfo device;
+};
+
+/*!
+ * \brief The BLESessionLog class reads and writes the binary session log of
+ * \ref BLESessionRecorder and \ref BLESessionReplayer. A log is a header followed by records that
+ * are only ever appended, so a log cut short by a crash is still readable up to its last complete
+ * record. Integers are little endian and lengths and time deltas are LEB128 varints:
+ *
+ *  header:        "QBSL" u16:version u16:reserved i64:start time in ms since epoch
+ *  record:        u8:kind varint:microseconds since the previous record payload
+ *  notification:  u32:service u32:characteristic varint:length bytes
+ *  advertisement: u64:address i16:rssi u8:core configurations varint:length utf8:name
+ *                 varint:count (u16:company varint:length bytes)...
+ *                 varint:count (16 bytes:service uuid)...
+ */
+class BLESessionLog
+{
+public:
+    //! \brief Version Version written in the header, readers reject newer versions
+    static constexpr quint16 Version = 1;
+
+    //! \brief HeaderSize Size of the header in bytes
+    static constexpr int HeaderSize = 16;
+
+    /*!
+     * \brief header Returns the header of a log started at \a startTime, in ms since epoch
+     */
+    static QByteArray header(qint64 startTime);
+
+    /*!
+     * \brief appendNotification Appends a notification record to \a out
+     * \param delta Microseconds since the previous record
+     */
+    static void appendNotification(QByteArray& out, quint64 delta,
+                                   quint32 serviceUuid, quint32 characterUuid,
+                                   const QByteArray& value);
+
+    /*!
+     * \brief appendAdvertisement Appends an advertisement record to \a out
+     * \param delta Microseconds since the previous record
+     */
+    static void appendAdvertisement(QByteArray& out, quint64 delta,
+                                    const QBluetoothDeviceInfo& device);
+
+    /*!
+     * \brief The Reader class reads the records of a log held in memory
+     */
+    class Reader
+    {
+    public:
+        explicit Reader(const QByteArray& data);
+
+        /*!
+         * \brief isValid Returns false if the header is missing or of a newer version
+         */
+        bool isValid() const;
+
+        /*!
+         * \brief startTime Returns the start time of the session in ms since epoch
+         */
+        qint64 startTime() const;
+
+        /*!
+         * \brief next Reads the next record into \a record
+         * \return False at the end of the log or at a truncated record
+         */
+        bool next(BLESessionRecord& record);
+
+    private:
+        bool readVarint(quint64& value);
+        template <typename T>
+        bool readInt(T& value);
+        bool readBytes(qsizetype size, QByteArray& bytes);
+
+    private:
+        QByteArray mData;
+        qsizetype mPos;
+        bool mValid;
+        qint64 mStartTime;
+        qint64 mTimestamp;
+    };
+
+private:
+    static void appendVarint(QByteArray& out, quint64 value);
+    template <typename T>
+    static void appendInt(QByteArray& out, T value);
+};
@@ -0,0 +1,185 @@
+#include "BLESessionRecorder.hpp"
+#include "BLESample.hpp"
+#include "BLESessionLog.hpp"
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+
+//! \brief Initialize the active recorder
+std::atomic<BLESessionRecorder*> BLESessionRecorder::sActive { nullptr };
+
+//! \brief Initialize the records in progress
+std::atomic<int> BLESessionRecorder::sPublishers { 0 };
+
+BLESessionRecorder::BLESessionRecorder(QObject* parent)
+    : QObject{ parent }
+    , mLastTime { 0 }
+    , mRecording { false }
+    , mRecords { 0 }
+    , mFlushTimer { new QTimer(this) }
+{
+    mFlushTimer->setInterval(FlushInterval);
+    connect(mFlushTimer, &QTimer::timeout, this, &BLESessionRecorder::flush);
+}
+
+BLESessionRecorder::~BLESessionRecorder()
+{
+    stop();
+}
+
+void BLESessionRecorder::setFileName(const QString& fileName)
+{
+    if (mFileName == fileName) {
+        return;
+    }
+
+    if (isRecording()) {
+        qWarning() << "BLESessionRecorder: File name can't be changed while recording";
+        return;
+    }
+
+    mFileName = fileName;
+    emit fileNameChanged();
+}
+
+bool BLESessionRecorder::isRecording() const
+{
+    return active() == this;
+}
+
+bool BLESessionRecorder::start()
+{
+    if (isRecording()) {
+        return true;
+    }
+
+    mFile.setFileName(mFileName);
+    if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "BLESessionRecorder: Can't open" << mFileName << mFile.errorString();
+        return false;
+    }
+    mFile.write(BLESessionLog::header(QDateTime::currentMSecsSinceEpoch()));
+
+    {
+        QMutexLocker locker(&mMutex);
+        mBuffer.clear();
+        mLastTime = BLESample::now();
+        mRecording = true;
+    }
+    mRecords.store(0, std::memory_order_relaxed);
+
+    //! Only one recorder records at a time
+    if (BLESessionRecorder* previous = sActive.exchange(this, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(previous, &BLESessionRecorder::stop);
+    }
+
+    mFlushTimer->start();
+    emit recordingChanged();
+    return true;
+}
+
+void BLESessionRecorder::stop()
+{
+    BLESessionRecorder* self = this;
+    sActive.compare_exchange_strong(self, nullptr, std::memory_order_seq_cst);
+
+    //! A record that saw this recorder active is done once the count drops, the recorder may be
+    //! deleted after that
+    while (sPublishers.load(std::memory_order_seq_cst) > 0) {
+        QThread::yieldCurrentThread();
+    }
+
+    {
+        QMutexLocker locker(&mMutex);
+        if (!mRecording) {
+            return;
+        }
+        mRecording = false;
+    }
+
+    mFlushTimer->stop();
+    flush();
+    mFile.close();
+
+    emit recordingChanged();
+}
+
+void BLESessionRecorder::recordNotification(quint32 serviceUuid,
+                                            quint32 characterUuid,
+                                            const QByteArray& value)
+{
+    //! Not recording costs one load, the count is only taken to use a recorder
+    if (!sActive.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    sPublishers.fetch_add(1, std::memory_order_seq_cst);
+    if (BLESessionRecorder* recorder = sActive.load(std::memory_order_seq_cst)) {
+        recorder->appendNotification(serviceUuid, characterUuid, value);
+    }
+    sPublishers.fetch_sub(1, std::memory_order_release);
+}
+
+void BLESessionRecorder::recordAdvertisement(const QBluetoothDeviceInfo& device)
+{
+    //! Not recording costs one load, the count is only taken to use a recorder
+    if (!sActive.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    sPublishers.fetch_add(1, std::memory_order_seq_cst);
+    if (BLESessionRecorder* recorder = sActive.load(std::memory_order_seq_cst)) {
+        recorder->appendAdvertisement(device);
+    }
+    sPublishers.fetch_sub(1, std::memory_order_release);
+}
+
+void BLESessionRecorder::appendNotification(quint32 serviceUuid, quint32 characterUuid,
+                                            const QByteArray& value)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mRecording) {
+        return;
+    }
+
+    BLESessionLog::appendNotification(mBuffer, deltaLocked(), serviceUuid, characterUuid, value);
+    mRecords.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BLESessionRecorder::appendAdvertisement(const QBluetoothDeviceInfo& device)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mRecording) {
+        return;
+    }
+
+    BLESessionLog::appendAdvertisement(mBuffer, deltaLocked(), device);
+    mRecords.fetch_add(1, std::memory_order_relaxed);
+}
+
+quint64 BLESessionRecorder::deltaLocked()
+{
+    const qint64 now = BLESample::now();
+    const qint64 delta = std::max<qint64>(now - mLastTime, 0) / 1000;
+
+    //! Keep the remainder so rounding doesn't drift over a long session
+    mLastTime += delta * 1000;
+    return quint64(delta);
+}
+
+void BLESessionRecorder::flush()
+{
+    QByteArray buffer;
+    {
+        QMutexLocker locker(&mMutex);
+        buffer.swap(mBuffer);
+    }
+
+    if (!buffer.isEmpty() && mFile.isOpen()) {
+        mFile.write(buffer);
+        mFile.flush();
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <QObject>
+#include <QBluetoothDeviceInfo>
+#include <QFile>
+#include <QMutex>
+#include <QTimer>
+
+#include <atomic>
+
+/*!
+ * \brief The BLESessionRecorder class writes every notification received by a \ref BLEDataService
+ * and every advertisement seen by a \ref BluetoothDiscovery to a \ref BLESessionLog file, so a
+ * session can be replayed later with \ref BLESessionReplayer. Only one recorder records at a time.
+ * Recording is thread safe, records are buffered in memory and written to the file periodically
+ * by the thread of the recorder
+ */
+class BLESessionRecorder : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString fileName READ fileName WRITE setFileName NOTIFY fileNameChanged FINAL)
+    Q_PROPERTY(bool recording READ isRecording NOTIFY recordingChanged FINAL)
+
+public:
+    //! \brief FlushInterval Interval of writing the buffered records to the file in milliseconds
+    static constexpr int FlushInterval = 500;
+
+    explicit BLESessionRecorder(QObject* parent = nullptr);
+    ~BLESessionRecorder() override;
+
+    /*!
+     * \brief active Returns the recorder that is recording, if any
+     */
+    static BLESessionRecorder* active();
+
+    /*!
+     * \brief fileName The file the session is written to, an existing file is overwritten
+     * \return
+     */
+    QString fileName() const;
+    void setFileName(const QString& fileName);
+
+    /*!
+     * \brief isRecording Returns true between \ref start() and \ref stop()
+     * \return
+     */
+    bool isRecording() const;
+
+    /*!
+     * \brief start Opens the file and starts recording. If another recorder is recording it is
+     * stopped
+     * \return False if the file can't be opened
+     */
+    Q_INVOKABLE bool start();
+
+    /*!
+     * \brief stop Stops recording and writes the remaining records to the file
+     */
+    Q_INVOKABLE void stop();
+
+    /*!
+     * \brief records Returns the number of records of the current or last session
+     */
+    Q_INVOKABLE quint64 records() const;
+
+    /*!
+     * \brief recordNotification Records a value received on a characteristic with the
+     * \ref active() recorder, if any. This is thread safe
+     */
+    static void recordNotification(quint32 serviceUuid,
+                                   quint32 characterUuid,
+                                   const QByteArray& value);
+
+    /*!
+     * \brief recordAdvertisement Records an advertisement of \a device with the \ref active()
+     * recorder, if any. This is thread safe
+     */
+    static void recordAdvertisement(const QBluetoothDeviceInfo& device);
+
+signals:
+    void fileNameChanged();
+    void recordingChanged();
+
+private slots:
+    /*!
+     * \brief flush Writes the buffered records to the file
+     */
+    void flush();
+
+private:
+    /*!
+     * \brief appendNotification Buffers a record of a value received on a characteristic
+     */
+    void appendNotification(quint32 serviceUuid, quint32 characterUuid, const QByteArray& value);
+
+    /*!
+     * \brief appendAdvertisement Buffers a record of an advertisement of \a device
+     */
+    void appendAdvertisement(const QBluetoothDeviceInfo& device);
+
+    /*!
+     * \brief deltaLocked Returns the microseconds since the previous record. \ref mMutex must be
+     * locked
+     */
+    quint64 deltaLocked();
+
+private:
+    //! \brief sActive The recorder that is recording
+    static std::atomic<BLESessionRecorder*> sActive;
+
+    //! \brief sPublishers Number of records in progress that may use a recorder they saw in
+    //! \ref sActive, \ref stop() waits for them
+    static std::atomic<int> sPublishers;
+
+    //! \brief mMutex Protects \ref mBuffer, \ref mLastTime and \ref mRecording
+    QMutex mMutex;
+
+    //! \brief mBuffer Records waiting to be written
+    QByteArray mBuffer;
+
+    //! \brief mLastTime Time of the previous record, see \ref BLESample::now()
+    qint64 mLastTime;
+
+    bool mRecording;
+
+    std::atomic<quint64> mRecords;
+
+    QString mFileName;
+    QFile mFile;
+    QTimer* mFlushTimer;
+};
+
+
+inline BLESessionRecorder* BLESessionRecorder::active()
+{
+    return sActive.load(std::memory_order_acquire);
+}
+
+inline QString BLESessionRecorder::fileName() const
+{
+    return mFileName;
+}
+
+inline quint64 BLESessionRecorder::records() const
+{
+    return mRecords.load(std::memory_order_relaxed);
+}
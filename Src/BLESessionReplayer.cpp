@@ -0,0 +1,174 @@
+#include "BLESessionReplayer.hpp"
+
+#include <QFile>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+
+BLESessionReplayer::BLESessionReplayer(QObject* parent)
+    : QObject{ parent }
+    , mSpeed { 1 }
+    , mTimer { new QTimer(this) }
+    , mReplayed { 0 }
+{
+    mTimer->setSingleShot(true);
+    mTimer->setTimerType(Qt::PreciseTimer);
+    connect(mTimer, &QTimer::timeout, this, &BLESessionReplayer::step);
+}
+
+BLESessionReplayer::~BLESessionReplayer() = default;
+
+void BLESessionReplayer::setFileName(const QString& fileName)
+{
+    if (mFileName == fileName) {
+        return;
+    }
+
+    mFileName = fileName;
+    emit fileNameChanged();
+}
+
+void BLESessionReplayer::setSpeed(qreal speed)
+{
+    speed = std::max<qreal>(speed, 0);
+    if (qFuzzyCompare(mSpeed + 1, speed + 1)) {
+        return;
+    }
+
+    mSpeed = speed;
+    emit speedChanged();
+}
+
+void BLESessionReplayer::setRole(BLERole* role)
+{
+    if (mRole == role) {
+        return;
+    }
+
+    mRole = role;
+    emit roleChanged();
+}
+
+void BLESessionReplayer::setDiscovery(BluetoothDiscovery* discovery)
+{
+    if (mDiscovery == discovery) {
+        return;
+    }
+
+    mDiscovery = discovery;
+    emit discoveryChanged();
+}
+
+bool BLESessionReplayer::start()
+{
+    stop();
+
+    QFile file(mFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "BLESessionReplayer: Can't open" << mFileName << file.errorString();
+        return false;
+    }
+
+    auto reader = std::make_unique<BLESessionLog::Reader>(file.readAll());
+    if (!reader->isValid()) {
+        qWarning() << "BLESessionReplayer:" << mFileName << "is not a session log";
+        return false;
+    }
+
+    mReader = std::move(reader);
+    mReplayed = 0;
+    emit runningChanged();
+
+    if (!readNext()) {
+        stop();
+        emit finished();
+        return true;
+    }
+
+    mClock.start();
+    mTimer->start(0);
+    return true;
+}
+
+void BLESessionReplayer::stop()
+{
+    mTimer->stop();
+    if (mReader) {
+        mReader.reset();
+        emit runningChanged();
+    }
+}
+
+bool BLESessionReplayer::readNext()
+{
+    return mReader && mReader->next(mNext);
+}
+
+void BLESessionReplayer::step()
+{
+    if (!mReader) {
+        return;
+    }
+
+    const bool maxSpeed = mSpeed <= 0;
+    const qint64 elapsed = maxSpeed ? 0 : qint64(mClock.nsecsElapsed() * mSpeed);
+
+    int batch = 0;
+    bool more = true;
+    while (more && (maxSpeed ? batch < BatchSize : mNext.timestamp <= elapsed)) {
+        replay(mNext);
+        ++batch;
+        more = readNext();
+    }
+
+    if (!more) {
+        stop();
+        emit finished();
+        return;
+    }
+
+    if (maxSpeed) {
+        //! Let the event loop run between batches
+        mTimer->start(0);
+    } else {
+        const qreal wait = (mNext.timestamp - elapsed) / mSpeed / 1e6;
+        mTimer->start(int(std::max<qreal>(std::ceil(wait), 0)));
+    }
+}
+
+void BLESessionReplayer::replay(const BLESessionRecord& record)
+{
+    ++mReplayed;
+
+    switch (record.kind) {
+    case BLESessionRecord::Notification: {
+        BLERole* role = mRole;
+        if (!role) {
+            return;
+        }
+
+        const QBluetoothUuid service(record.serviceUuid);
+        const QBluetoothUuid characteristic(record.characterUuid);
+
+        //! Values are dispatched on the thread of the transport, like live ones
+        BLETransport* transport = role->transport();
+        if (transport && transport->thread() != QThread::currentThread()) {
+            QMetaObject::invokeMethod(transport, [role = QPointer<BLERole>(role), service,
+                                                  characteristic, value = record.value]() {
+                if (role) {
+                    role->dispatchValue(service, characteristic, value);
+                }
+            });
+        } else {
+            role->dispatchValue(service, characteristic, record.value);
+        }
+        break;
+    }
+    case BLESessionRecord::Advertisement:
+        if (mDiscovery) {
+            mDiscovery->addDevice(record.device);
+        }
+        break;
+    }
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QTimer>
+
+#include <memory>
+
+#include "BLERole.hpp"
+#include "BLESessionLog.hpp"
+#include "BluetoothDiscovery.hpp"
+
+/*!
+ * \brief The BLESessionReplayer class feeds a log written by \ref BLESessionRecorder back into a
+ * \ref BLERole and a \ref BluetoothDiscovery without a radio. Notifications go through
+ * \ref BLERole::dispatchValue() and advertisements through \ref BluetoothDiscovery::addDevice(),
+ * the same code paths as a live session, either at the recorded pace or as fast as possible
+ */
+class BLESessionReplayer : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString fileName READ fileName WRITE setFileName NOTIFY fileNameChanged FINAL)
+    Q_PROPERTY(qreal speed READ speed WRITE setSpeed NOTIFY speedChanged FINAL)
+    Q_PROPERTY(BLERole* role READ role WRITE setRole NOTIFY roleChanged FINAL)
+    Q_PROPERTY(BluetoothDiscovery* discovery READ discovery WRITE setDiscovery NOTIFY discoveryChanged FINAL)
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged FINAL)
+
+public:
+    //! \brief BatchSize Records replayed per event loop iteration at maximum speed
+    static constexpr int BatchSize = 256;
+
+    explicit BLESessionReplayer(QObject* parent = nullptr);
+    ~BLESessionReplayer() override;
+
+    /*!
+     * \brief fileName The log to replay
+     * \return
+     */
+    QString fileName() const;
+    void setFileName(const QString& fileName);
+
+    /*!
+     * \brief speed Multiplier of the recorded pace, 1 replays in real time and 0 replays as fast
+     * as possible
+     * \return
+     */
+    qreal speed() const;
+    void setSpeed(qreal speed);
+
+    /*!
+     * \brief role The role that receives the notifications, may be null
+     * \return
+     */
+    BLERole* role() const;
+    void setRole(BLERole* role);
+
+    /*!
+     * \brief discovery The discovery that receives the advertisements, may be null
+     * \return
+     */
+    BluetoothDiscovery* discovery() const;
+    void setDiscovery(BluetoothDiscovery* discovery);
+
+    /*!
+     * \brief isRunning Returns true while replaying
+     * \return
+     */
+    bool isRunning() const;
+
+    /*!
+     * \brief start Loads the log and starts replaying it from the beginning
+     * \return False if the log can't be read
+     */
+    Q_INVOKABLE bool start();
+
+    /*!
+     * \brief stop Stops replaying
+     */
+    Q_INVOKABLE void stop();
+
+    /*!
+     * \brief replayed Returns the number of records replayed since \ref start()
+     */
+    Q_INVOKABLE quint64 replayed() const;
+
+signals:
+    /*!
+     * \brief finished Emitted when the whole log is replayed
+     */
+    void finished();
+
+    void fileNameChanged();
+    void speedChanged();
+    void roleChanged();
+    void discoveryChanged();
+    void runningChanged();
+
+private slots:
+    /*!
+     * \brief step Replays the records that are due and schedules the next step
+     */
+    void step();
+
+private:
+    /*!
+     * \brief replay Hands \a record to the role or the discovery
+     */
+    void replay(const BLESessionRecord& record);
+
+    /*!
+     * \brief readNext Reads the next record into \ref mNext
+     * \return False at the end of the log
+     */
+    bool readNext();
+
+private:
+    QString mFileName;
+    qreal mSpeed;
+    QPointer<BLERole> mRole;
+    QPointer<BluetoothDiscovery> mDiscovery;
+
+    //! \brief mReader Reads the loaded log, null when not running
+    std::unique_ptr<BLESessionLog::Reader> mReader;
+
+    //! \brief mNext The next record to replay
+    BLESessionRecord mNext;
+
+    //! \brief mClock Time since \ref start()
+    QElapsedTimer mClock;
+
+    //! \brief mTimer Fires when the next record is due
+    QTimer* mTimer;
+
+    quint64 mReplayed;
+};
+
+
+inline QString BLESessionReplayer::fileName() const
+{
+    return mFileName;
+}
+
+inline qreal BLESessionReplayer::speed() const
+{
+    return mSpeed;
+}
+
+inline BLERole* BLESessionReplayer::role() const
+{
+    return mRole;
+}
+
+inline BluetoothDiscovery* BLESessionReplayer::discovery() const
+{
+    return mDiscovery;
+}
+
+inline bool BLESessionReplayer::isRunning() const
+{
+    return mReader != nullptr;
+}
+
+inline quint64 BLESessionReplayer::replayed() const
+{
+    return mReplayed;
+}
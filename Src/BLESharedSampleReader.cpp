@@ -0,0 +1,146 @@
+#include "BLESharedSampleReader.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+BLESharedSampleReader::BLESharedSampleReader(const QString& key)
+    : mMemory { key }
+    , mRing { nullptr }
+    , mMask { 0 }
+    , mCursor { 0 }
+    , mOverruns { 0 }
+    , mAcquired { false }
+{
+    attach();
+}
+
+BLESharedSampleReader::~BLESharedSampleReader() = default;
+
+bool BLESharedSampleReader::attach()
+{
+    if (mRing) {
+        return true;
+    }
+
+    if (!mMemory.isAttached() && !mMemory.attach(QSharedMemory::ReadOnly)) {
+        return false;
+    }
+
+    const auto* ring = static_cast<const BLESharedSampleRing::Header*>(mMemory.constData());
+
+    //! The publisher may still be setting up the header
+    if (std::size_t(mMemory.size()) < sizeof(BLESharedSampleRing::Header)
+        || ring->magic.load(std::memory_order_acquire) != BLESharedSampleRing::Magic) {
+        mMemory.detach();
+        return false;
+    }
+
+    const quint32 capacity = ring->capacity;
+    if (ring->version != BLESharedSampleRing::Version || ring->sampleSize != sizeof(BLESample)
+        || capacity < 2 || (capacity & (capacity - 1)) != 0
+        || std::size_t(mMemory.size()) < BLESharedSampleRing::size(capacity)) {
+        qWarning() << "BLESharedSampleReader: The ring of" << mMemory.key()
+                   << "has another layout, version" << ring->version;
+        mMemory.detach();
+        return false;
+    }
+
+    mRing = ring;
+    mMask = capacity - 1;
+    mCursor = mRing->head.load(std::memory_order_acquire);
+    return true;
+}
+
+const BLESample* BLESharedSampleReader::acquire()
+{
+    if (!attach()) {
+        return nullptr;
+    }
+
+    const BLESharedSampleRing::Slot* slots = BLESharedSampleRing::slots(mRing);
+
+    for (;;) {
+        const BLESharedSampleRing::Slot& slot = slots[mCursor & mMask];
+        const quint64 expected = 2 * mCursor + 2;
+
+        const quint64 version = slot.version.load(std::memory_order_acquire);
+        if (version < expected) {
+            //! A publisher that found the slot busy dropped this sample
+            if (slot.dropped.load(std::memory_order_acquire) > mCursor) {
+                skipOverwritten();
+                continue;
+            }
+
+            //! Not published yet or still being written
+            mAcquired = false;
+            return nullptr;
+        }
+        if (version > expected) {
+            skipOverwritten();
+            continue;
+        }
+
+        mAcquired = true;
+        return &slot.sample;
+    }
+}
+
+bool BLESharedSampleReader::release()
+{
+    if (!mAcquired) {
+        return false;
+    }
+    mAcquired = false;
+
+    const BLESharedSampleRing::Slot& slot = BLESharedSampleRing::slots(mRing)[mCursor & mMask];
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.version.load(std::memory_order_relaxed) != 2 * mCursor + 2) {
+        //! The slot was reused while the sample was used
+        skipOverwritten();
+        return false;
+    }
+
+    ++mCursor;
+    return true;
+}
+
+bool BLESharedSampleReader::read(BLESample& sample)
+{
+    while (const BLESample* shared = acquire()) {
+        std::memcpy(static_cast<void*>(&sample), shared, sizeof(BLESample));
+        if (release()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+quint64 BLESharedSampleReader::pending() const
+{
+    if (!mRing) {
+        return 0;
+    }
+
+    const quint64 head = mRing->head.load(std::memory_order_acquire);
+    return head > mCursor ? head - mCursor : 0;
+}
+
+quint64 BLESharedSampleReader::published() const
+{
+    return mRing ? mRing->head.load(std::memory_order_relaxed) : 0;
+}
+
+void BLESharedSampleReader::skipOverwritten()
+{
+    const quint64 head = mRing->head.load(std::memory_order_acquire);
+    const quint64 capacity = mMask + 1;
+    const quint64 oldest = head > capacity ? head - capacity : 0;
+    const quint64 next = std::max(mCursor + 1, oldest);
+
+    mOverruns += next - mCursor;
+    mCursor = next;
+}
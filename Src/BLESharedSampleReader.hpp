@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QSharedMemory>
+#include <QString>
+
+#include <cstddef>
+
+#include "BLESharedSampleRing.hpp"
+
+/*!
+ * \brief The BLESharedSampleReader class reads the samples a \ref BLESharedSamples of another
+ * process publishes, the client side of the shared ring. It only needs QtCore, see the
+ * QuickBluetoothSamples library. Each reader has its own cursor and starts at the next published
+ * sample. A reader that falls more than the capacity of the ring behind misses the oldest samples,
+ * they are counted as overruns. A reader must only be used from one thread at a time.
+ *
+ * Samples are read in place with \ref acquire() and \ref release(), or copied with \ref read()
+ */
+class BLESharedSampleReader
+{
+public:
+    /*!
+     * \brief BLESharedSampleReader Creates a reader of the ring published with \a key, see
+     * \ref attach()
+     */
+    explicit BLESharedSampleReader(const QString& key);
+    ~BLESharedSampleReader();
+
+    BLESharedSampleReader(const BLESharedSampleReader&) = delete;
+    BLESharedSampleReader& operator=(const BLESharedSampleReader&) = delete;
+
+    /*!
+     * \brief attach Maps the ring, read only. It's called by the other functions until it
+     * succeeds, so a reader can be created before the publisher starts
+     * \return False if nothing is published with the key or the ring has another layout
+     */
+    bool attach();
+
+    /*!
+     * \brief isAttached Returns true once the ring is mapped
+     */
+    bool isAttached() const;
+
+    /*!
+     * \brief acquire Returns the next sample where it's stored in the ring, without copying it.
+     * The sample may be overwritten while it's used, \ref release() tells whether it was
+     * \return Null if there is no new sample
+     */
+    const BLESample* acquire();
+
+    /*!
+     * \brief release Moves past the sample returned by \ref acquire()
+     * \return False if the sample was overwritten while it was used, it must be discarded
+     */
+    bool release();
+
+    /*!
+     * \brief read Copies the next sample into \a sample
+     * \return False if there is no new sample
+     */
+    bool read(BLESample& sample);
+
+    /*!
+     * \brief readAll Calls \a func with every available sample in place, up to \a max samples.
+     * A sample overwritten while \a func used it is counted as an overrun instead, \a func must
+     * tolerate seeing it
+     * \return The number of samples read
+     */
+    template <typename Func>
+    std::size_t readAll(Func&& func, std::size_t max = std::size_t(-1));
+
+    /*!
+     * \brief overruns Returns the number of samples this reader missed because they were
+     * overwritten before being read
+     */
+    quint64 overruns() const;
+
+    /*!
+     * \brief pending Returns the approximate number of samples waiting to be read
+     */
+    quint64 pending() const;
+
+    /*!
+     * \brief published Returns the number of samples published to the ring so far
+     */
+    quint64 published() const;
+
+private:
+    /*!
+     * \brief skipOverwritten Moves the cursor to the oldest sample that is still in the ring
+     */
+    void skipOverwritten();
+
+private:
+    //! \brief mMemory The shared memory of the ring
+    QSharedMemory mMemory;
+
+    //! \brief mRing The mapped ring, null until \ref attach() succeeds
+    const BLESharedSampleRing::Header* mRing;
+
+    //! \brief mMask Capacity of the ring - 1
+    quint64 mMask;
+
+    //! \brief mCursor Sequence number of the next sample to read
+    quint64 mCursor;
+
+    //! \brief mOverruns Number of samples that are missed
+    quint64 mOverruns;
+
+    //! \brief mAcquired The sample returned by \ref acquire() is not released yet
+    bool mAcquired;
+};
+
+
+inline bool BLESharedSampleReader::isAttached() const
+{
+    return mRing != nullptr;
+}
+
+inline quint64 BLESharedSampleReader::overruns() const
+{
+    return mOverruns;
+}
+
+template <typename Func>
+inline std::size_t BLESharedSampleReader::readAll(Func&& func, std::size_t max)
+{
+    std::size_t count = 0;
+    while (count < max) {
+        const BLESample* sample = acquire();
+        if (!sample) {
+            break;
+        }
+
+        func(*sample);
+        if (release()) {
+            ++count;
+        }
+    }
+
+    return count;
+}
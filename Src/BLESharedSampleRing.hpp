@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include "BLESample.hpp"
+
+/*!
+ * \brief The BLESharedSampleRing struct is the layout of the shared memory that
+ * \ref BLESharedSamples publishes to and \ref BLESharedSampleReader reads from. It's a
+ * \ref Header followed by \ref Header::capacity slots, the same ring as \ref BLESampleBus: a slot
+ * holds the sample with sequence number s at index s & (capacity - 1), and its version is odd
+ * while it's written and 2 * (s + 1) once it's complete. A sample whose slot is still written by
+ * a publisher a lap behind is dropped and marked instead of waited for. Readers never write to
+ * the memory, each keeps its own cursor. \ref BLESample::timestamp is on the monotonic clock,
+ * which every process of the host shares
+ */
+struct BLESharedSampleRing
+{
+    //! \brief Magic Marks a segment as a ring, set once the header is complete
+    static constexpr quint32 Magic = 0x51425352;
+
+    //! \brief Version The version of the layout, a reader refuses any other
+    static constexpr quint32 Version = 2;
+
+    /*!
+     * \brief The Header struct describes the ring, only \ref head changes once it's published
+     */
+    struct Header
+    {
+        std::atomic<quint32> magic;
+        quint32 version;
+
+        //! \brief capacity Number of slots, a power of two
+        quint32 capacity;
+
+        //! \brief sampleSize sizeof(BLESample) of the publisher
+        quint32 sampleSize;
+
+        //! \brief head Sequence number of the next sample to publish
+        alignas(64) std::atomic<quint64> head;
+    };
+
+    /*!
+     * \brief The Slot struct holds one sample and its version
+     */
+    struct Slot
+    {
+        std::atomic<quint64> version;
+
+        //! \brief dropped s + 1 of the latest sample dropped because the slot was busy, 0 if none
+        std::atomic<quint64> dropped;
+
+        BLESample sample;
+    };
+
+    /*!
+     * \brief size Returns the size of a ring with \a capacity slots
+     */
+    static constexpr std::size_t size(std::size_t capacity);
+
+    /*!
+     * \brief markDropped Marks the sample with \a sequence as dropped in \a slot
+     */
+    static void markDropped(Slot& slot, quint64 sequence);
+
+    /*!
+     * \brief slots Returns the slots that follow \a header
+     */
+    static Slot* slots(Header* header);
+    static const Slot* slots(const Header* header);
+};
+
+static_assert(std::atomic<quint64>::is_always_lock_free
+                  && std::atomic<quint32>::is_always_lock_free,
+              "BLESharedSampleRing needs lock-free atomics to be shared between processes");
+static_assert(std::is_standard_layout_v<BLESharedSampleRing::Header>
+                  && std::is_standard_layout_v<BLESharedSampleRing::Slot>,
+              "BLESharedSampleRing must have the same layout in every process");
+
+
+constexpr std::size_t BLESharedSampleRing::size(std::size_t capacity)
+{
+    return sizeof(Header) + capacity * sizeof(Slot);
+}
+
+inline BLESharedSampleRing::Slot* BLESharedSampleRing::slots(Header* header)
+{
+    return reinterpret_cast<Slot*>(header + 1);
+}
+
+inline const BLESharedSampleRing::Slot* BLESharedSampleRing::slots(const Header* header)
+{
+    return reinterpret_cast<const Slot*>(header + 1);
+}
+
+inline void BLESharedSampleRing::markDropped(Slot& slot, quint64 sequence)
+{
+    quint64 dropped = slot.dropped.load(std::memory_order_relaxed);
+    while (dropped <= sequence
+           && !slot.dropped.compare_exchange_weak(dropped, sequence + 1, std::memory_order_release,
+                                                  std::memory_order_relaxed)) {
+    }
+}
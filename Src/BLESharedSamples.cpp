@@ -0,0 +1,190 @@
+#include "BLESharedSamples.hpp"
+
+#include <QThread>
+
+#include <cstring>
+
+namespace {
+
+quint32 roundUpToPowerOfTwo(int value)
+{
+    quint32 result = 2;
+    while (result < quint32(value)) {
+        result <<= 1;
+    }
+
+    return result;
+}
+
+} // namespace
+
+BLESharedSamples::BLESharedSamples(QObject* parent)
+    : QObject{ parent }
+    , mKey { QString::fromLatin1(DefaultKey) }
+    , mCapacity { DefaultCapacity }
+    , mRing { nullptr }
+    , mPublishers { 0 }
+{}
+
+BLESharedSamples::~BLESharedSamples()
+{
+    stop();
+}
+
+void BLESharedSamples::setKey(const QString& key)
+{
+    if (mKey == key) {
+        return;
+    }
+
+    if (isPublishing()) {
+        qWarning() << "BLESharedSamples: Key can't be changed while publishing";
+        return;
+    }
+
+    if (key.isEmpty()) {
+        qWarning() << "BLESharedSamples: Key can't be empty";
+        return;
+    }
+
+    mKey = key;
+    emit keyChanged();
+}
+
+void BLESharedSamples::setCapacity(int capacity)
+{
+    if (mCapacity == capacity) {
+        return;
+    }
+
+    if (isPublishing()) {
+        qWarning() << "BLESharedSamples: Capacity can't be changed while publishing";
+        return;
+    }
+
+    if (capacity < 2 || capacity > (1 << 24)) {
+        qWarning() << "BLESharedSamples: Capacity must be between 2 and 16M samples";
+        return;
+    }
+
+    mCapacity = capacity;
+    emit capacityChanged();
+}
+
+bool BLESharedSamples::start()
+{
+    if (isPublishing()) {
+        return true;
+    }
+
+    const quint32 capacity = roundUpToPowerOfTwo(mCapacity);
+    const qsizetype size = qsizetype(BLESharedSampleRing::size(capacity));
+
+    mMemory.setKey(mKey);
+
+    BLESharedSampleRing::Header* ring = nullptr;
+    if (mMemory.create(size)) {
+        std::memset(mMemory.data(), 0, size_t(size));
+
+        ring = static_cast<BLESharedSampleRing::Header*>(mMemory.data());
+        ring->version = BLESharedSampleRing::Version;
+        ring->capacity = capacity;
+        ring->sampleSize = sizeof(BLESample);
+        ring->head.store(0, std::memory_order_relaxed);
+
+        //! Readers only use the ring once the header is complete
+        ring->magic.store(BLESharedSampleRing::Magic, std::memory_order_release);
+    } else if (mMemory.error() == QSharedMemory::AlreadyExists && mMemory.attach()) {
+        ring = static_cast<BLESharedSampleRing::Header*>(mMemory.data());
+
+        if (mMemory.size() < size
+            || ring->magic.load(std::memory_order_acquire) != BLESharedSampleRing::Magic
+            || ring->version != BLESharedSampleRing::Version || ring->capacity != capacity
+            || ring->sampleSize != sizeof(BLESample)) {
+            qWarning() << "BLESharedSamples: The shared memory of" << mKey
+                       << "has another layout, its readers must detach first";
+            mMemory.detach();
+            return false;
+        }
+
+        //! A sample the previous publisher didn't finish is dropped, its slot goes back to an even
+        //! version that readers never expect
+        BLESharedSampleRing::Slot* slots = BLESharedSampleRing::slots(ring);
+        for (quint32 i = 0; i < capacity; ++i) {
+            const quint64 version = slots[i].version.load(std::memory_order_relaxed);
+            if (version & 1) {
+                BLESharedSampleRing::markDropped(slots[i], version / 2);
+                slots[i].version.store(version - 1, std::memory_order_release);
+            }
+        }
+    } else {
+        qWarning() << "BLESharedSamples: Can't create the shared memory of" << mKey
+                   << mMemory.errorString();
+        return false;
+    }
+
+    mRing.store(ring, std::memory_order_seq_cst);
+    emit publishingChanged();
+    return true;
+}
+
+void BLESharedSamples::stop()
+{
+    if (!mRing.exchange(nullptr, std::memory_order_seq_cst)) {
+        return;
+    }
+
+    //! A publish() that saw the ring before the exchange is done once the count drops
+    while (mPublishers.load(std::memory_order_seq_cst) > 0) {
+        QThread::yieldCurrentThread();
+    }
+
+    mMemory.detach();
+    emit publishingChanged();
+}
+
+quint64 BLESharedSamples::published() const
+{
+    const BLESharedSampleRing::Header* ring = mRing.load(std::memory_order_acquire);
+    return ring ? ring->head.load(std::memory_order_relaxed) : 0;
+}
+
+void BLESharedSamples::publish(const BLESample& sample)
+{
+    mPublishers.fetch_add(1, std::memory_order_seq_cst);
+
+    BLESharedSampleRing::Header* ring = mRing.load(std::memory_order_seq_cst);
+    if (!ring) {
+        mPublishers.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    const quint64 sequence = ring->head.fetch_add(1, std::memory_order_relaxed);
+    BLESharedSampleRing::Slot& slot
+        = BLESharedSampleRing::slots(ring)[sequence & (ring->capacity - 1)];
+
+    //! Claim the slot like BLESampleBus::publish() does, a busy slot drops the sample
+    const quint64 writing = 2 * sequence + 1;
+    quint64 version = slot.version.load(std::memory_order_relaxed);
+    for (;;) {
+        if (version >= writing) {
+            mPublishers.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        if (version & 1) {
+            BLESharedSampleRing::markDropped(slot, sequence);
+            mPublishers.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        if (slot.version.compare_exchange_weak(version, writing, std::memory_order_acquire,
+                                               std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(static_cast<void*>(&slot.sample), &sample, sizeof(BLESample));
+    slot.version.store(writing + 1, std::memory_order_release);
+
+    mPublishers.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QObject>
+#include <QSharedMemory>
+#include <QString>
+
+#include <atomic>
+
+#include "BLESharedSampleRing.hpp"
+
+/*!
+ * \brief The BLESharedSamples class publishes the samples received by the services of a
+ * \ref BLERole to a \ref BLESharedSampleRing in shared memory, so other processes of the host read
+ * the same live values with a \ref BLESharedSampleReader instead of owning a connection. Publishing
+ * is lock-free and never waits for the readers, a reader that falls behind misses the oldest
+ * samples. A ring left by a publisher that exited is taken over with its sequence numbers, so
+ * readers that stayed attached carry on
+ */
+class BLESharedSamples : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString key READ key WRITE setKey NOTIFY keyChanged FINAL)
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged FINAL)
+    Q_PROPERTY(bool publishing READ isPublishing NOTIFY publishingChanged FINAL)
+
+public:
+    //! \brief DefaultKey The key of the shared memory by default
+    static constexpr const char* DefaultKey = "QuickBluetoothSamples";
+
+    //! \brief DefaultCapacity Number of samples kept by default
+    static constexpr int DefaultCapacity = 1024;
+
+    explicit BLESharedSamples(QObject* parent = nullptr);
+    ~BLESharedSamples() override;
+
+    /*!
+     * \brief key The key readers attach to the shared memory with
+     */
+    QString key() const;
+    void setKey(const QString& key);
+
+    /*!
+     * \brief capacity Number of samples the ring keeps, rounded up to a power of two
+     */
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    /*!
+     * \brief isPublishing Returns true between \ref start() and \ref stop()
+     */
+    bool isPublishing() const;
+
+    /*!
+     * \brief start Creates the shared memory, or takes over the one with the same key, and starts
+     * publishing
+     * \return False if the shared memory can't be created
+     */
+    Q_INVOKABLE bool start();
+
+    /*!
+     * \brief stop Stops publishing and detaches from the shared memory, which is removed once no
+     * reader is attached either
+     */
+    Q_INVOKABLE void stop();
+
+    /*!
+     * \brief published Returns the number of samples published to the ring
+     */
+    Q_INVOKABLE quint64 published() const;
+
+    /*!
+     * \brief publish Adds a copy of \a sample to the ring if publishing. This is thread safe and
+     * never blocks on readers
+     */
+    void publish(const BLESample& sample);
+
+signals:
+    void keyChanged();
+    void capacityChanged();
+    void publishingChanged();
+
+private:
+    QString mKey;
+    int mCapacity;
+
+    //! \brief mMemory The shared memory of the ring
+    QSharedMemory mMemory;
+
+    //! \brief mRing The ring while publishing, null otherwise
+    std::atomic<BLESharedSampleRing::Header*> mRing;
+
+    //! \brief mPublishers Number of \ref publish() calls using \ref mRing, \ref stop() waits for
+    //! them before detaching
+    std::atomic<int> mPublishers;
+};
+
+
+inline QString BLESharedSamples::key() const
+{
+    return mKey;
+}
+
+inline int BLESharedSamples::capacity() const
+{
+    return mCapacity;
+}
+
+inline bool BLESharedSamples::isPublishing() const
+{
+    return mRing.load(std::memory_order_relaxed) != nullptr;
+}
@@ -0,0 +1,123 @@
+#include "BLEStamp.hpp"
+#include "BLESample.hpp"
+
+#include <QtEndian>
+
+#include <cstring>
+#include <limits>
+
+namespace {
+
+//! \brief Number of sequences remembered by the received bits of a tracker
+constexpr int ReceivedBits = 64;
+
+} // namespace
+
+BLEStamp::Tracker::Tracker()
+{
+    reset();
+}
+
+BLEStamp::Result BLEStamp::Tracker::track(quint16 sequence, quint32 sendTime, quint32 receiveTime)
+{
+    Result result;
+
+    const bool first = !mStarted;
+    const qint16 distance = qint16(quint16(sequence - mHighest));
+    if (first || qAbs(int(distance)) > ResyncDistance) {
+        //! The first value, or the sender started over
+        mStarted = true;
+        mHighest = sequence;
+        mReceived = 1;
+    } else if (distance > 0) {
+        result.lost = distance - 1;
+        mReceived = distance < ReceivedBits ? (mReceived << distance) | 1 : 1;
+        mHighest = sequence;
+    } else {
+        //! An older sequence, it was either counted as lost or is received again
+        const int age = -distance;
+        const quint64 bit = age < ReceivedBits ? quint64(1) << age : 0;
+        if (distance == 0 || (mReceived & bit)) {
+            result.duplicate = true;
+            return result;
+        }
+
+        result.reordered = true;
+        if (bit) {
+            mReceived |= bit;
+            result.lost = -1;
+        }
+    }
+
+    //! Both clocks wrap, so differences are taken modulo 2^32 around the current offset
+    const quint32 difference = receiveTime - sendTime;
+    if (first) {
+        mOffset = difference;
+    }
+
+    qint32 latency = qint32(difference - mOffset);
+    if (latency < 0) {
+        //! Faster than any value before, the offset was overestimated
+        mOffset = difference;
+        if (mWindowMin != std::numeric_limits<qint32>::max()) {
+            mWindowMin -= latency;
+        }
+        latency = 0;
+    }
+    result.latency = latency;
+
+    mWindowMin = qMin(mWindowMin, latency);
+    if (++mWindowCount == OffsetWindow) {
+        //! Every value of the window was slower, the clocks drifted apart
+        mOffset += quint32(mWindowMin);
+        mWindowMin = std::numeric_limits<qint32>::max();
+        mWindowCount = 0;
+    }
+
+    return result;
+}
+
+void BLEStamp::Tracker::reset()
+{
+    mStarted = false;
+    mHighest = 0;
+    mReceived = 0;
+    mOffset = 0;
+    mWindowMin = std::numeric_limits<qint32>::max();
+    mWindowCount = 0;
+}
+
+QByteArray BLEStamp::stamp(const QByteArray& payload, quint16 sequence)
+{
+    QByteArray frame(HeaderSize + payload.size(), Qt::Uninitialized);
+    uchar* data = reinterpret_cast<uchar*>(frame.data());
+
+    qToLittleEndian<quint16>(sequence, data);
+    qToLittleEndian<quint32>(clock(), data + sizeof(quint16));
+    std::memcpy(data + HeaderSize, payload.constData(), payload.size());
+
+    return frame;
+}
+
+bool BLEStamp::read(const QByteArray& frame, quint16& sequence, quint32& sendTime)
+{
+    if (frame.size() < HeaderSize) {
+        return false;
+    }
+
+    const uchar* data = reinterpret_cast<const uchar*>(frame.constData());
+    sequence = qFromLittleEndian<quint16>(data);
+    sendTime = qFromLittleEndian<quint32>(data + sizeof(quint16));
+    return true;
+}
+
+QByteArray BLEStamp::payload(const QByteArray& frame)
+{
+    //! The raw data isn't copied, receiving a stamped value allocates nothing more
+    return QByteArray::fromRawData(frame.constData() + HeaderSize, frame.size() - HeaderSize);
+}
+
+quint32 BLEStamp::clock()
+{
+    return quint32(BLESample::now() / 1000);
+}
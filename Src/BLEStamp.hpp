@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QByteArray>
+#include <QtGlobal>
+
+/*!
+ * \brief The BLEStamp class holds the framing of \ref BLEDataService::stamped. The sender puts a
+ * header in front of every value, a 16 bit sequence number then the 32 bit send time in
+ * microseconds of its monotonic clock, both little endian.
+ *
+ * The clocks of the two ends are not synchronized, so the \ref Tracker estimates their offset as
+ * the smallest difference between receive and send time seen recently. The latency it reports is
+ * the time above that fastest value, ie the queueing and retransmission delays. The fixed part of
+ * the link delay, a few milliseconds, can't be known without synchronized clocks
+ */
+class BLEStamp
+{
+public:
+    //! \brief HeaderSize Number of bytes in front of every stamped value
+    static constexpr int HeaderSize = 6;
+
+    //! \brief ResyncDistance A sequence further than this from the expected one means the sender
+    //! started over, it is not counted as lost or reordered
+    static constexpr int ResyncDistance = 1024;
+
+    //! \brief OffsetWindow Number of values after which the clock offset is raised to the
+    //! smallest difference of the last values, so the estimate follows the drift of the clocks
+    static constexpr int OffsetWindow = 256;
+
+    /*!
+     * \brief The Result struct is what \ref Tracker::track() learned from a value
+     */
+    struct Result
+    {
+        //! \brief lost Number of values missing before this one, negative when this value was
+        //! counted as missing before and arrived late
+        int lost = 0;
+
+        //! \brief reordered True if this value arrived after a later one
+        bool reordered = false;
+
+        //! \brief duplicate True if this value was already received
+        bool duplicate = false;
+
+        //! \brief latency Microseconds above the fastest recent value, -1 for a duplicate
+        qint64 latency = -1;
+    };
+
+    /*!
+     * \brief The Tracker class follows the values received on one characteristic
+     */
+    class Tracker
+    {
+    public:
+        Tracker();
+
+        /*!
+         * \brief track Counts the value of \a sequence sent at \a sendTime and received at
+         * \a receiveTime, both in microseconds of the clock of each end
+         */
+        Result track(quint16 sequence, quint32 sendTime, quint32 receiveTime);
+
+        /*!
+         * \brief reset Forgets every value, the next one starts over
+         */
+        void reset();
+
+    private:
+        //! \brief mStarted True once a value was received
+        bool mStarted;
+
+        //! \brief mHighest The highest sequence received
+        quint16 mHighest;
+
+        //! \brief mReceived Bit i is set if sequence mHighest - i was received
+        quint64 mReceived;
+
+        //! \brief mOffset Estimated receive time minus send time of a value without delay
+        quint32 mOffset;
+
+        //! \brief mWindowMin Smallest difference to \ref mOffset in the current window
+        qint32 mWindowMin;
+
+        //! \brief mWindowCount Number of values in the current window
+        int mWindowCount;
+    };
+
+    /*!
+     * \brief stamp Returns \a payload with the header of \a sequence and the current time in
+     * front of it
+     */
+    static QByteArray stamp(const QByteArray& payload, quint16 sequence);
+
+    /*!
+     * \brief read Reads the header of \a frame into \a sequence and \a sendTime
+     * \return False if \a frame is shorter than a header
+     */
+    static bool read(const QByteArray& frame, quint16& sequence, quint32& sendTime);
+
+    /*!
+     * \brief payload Returns the value after the header of \a frame. It refers to the data of
+     * \a frame and is only valid as long as \a frame is
+     */
+    static QByteArray payload(const QByteArray& frame);
+
+    /*!
+     * \brief clock Returns the monotonic time in microseconds, wrapping every 71 minutes
+     */
+    static quint32 clock();
+};
@@ -0,0 +1,74 @@
+#include "BLEStreamLink.hpp"
+#include "BLELoopbackLink.hpp"
+
+BLEStreamLink::BLEStreamLink(QObject* parent)
+    : QObject{ parent }
+    , mBackend { Backend::RfcommBackend }
+    , mServiceUuid { QBluetoothUuid::ServiceClassUuid::SerialPort }
+    , mServerName { QStringLiteral("QuickBluetoothStream") }
+    , mReadBufferSize { DefaultReadBufferSize }
+    , mDevice { nullptr }
+{
+    //! The address is only a key for the peripheral's subscriptions, nothing dials it
+    QBluetoothDeviceInfo info(BLELoopbackLink::addressOf(QLowEnergyController::PeripheralRole),
+                              QStringLiteral("Stream"), 0);
+    info.setCoreConfigurations(QBluetoothDeviceInfo::BaseRateCoreConfiguration);
+    mDevice = new BluetoothDeviceInfo(info, this);
+}
+
+void BLEStreamLink::setBackend(Backend backend)
+{
+    if (mBackend == backend) {
+        return;
+    }
+
+    mBackend = backend;
+    emit backendChanged();
+}
+
+void BLEStreamLink::setServiceUuid(uint32_t uuid)
+{
+    QBluetoothUuid serviceUuid(uuid);
+
+    if (mServiceUuid == serviceUuid) {
+        return;
+    }
+
+    mServiceUuid = serviceUuid;
+    emit serviceUuidChanged();
+}
+
+void BLEStreamLink::setServerName(const QString& name)
+{
+    if (mServerName == name) {
+        return;
+    }
+
+    if (name.isEmpty()) {
+        qWarning() << "BLEStreamLink: Server name can't be empty";
+        return;
+    }
+
+    mServerName = name;
+    emit serverNameChanged();
+}
+
+void BLEStreamLink::setReadBufferSize(int size)
+{
+    if (mReadBufferSize == size) {
+        return;
+    }
+
+    if (size < 1024) {
+        qWarning() << "BLEStreamLink: Read buffer size must be at least 1024 bytes";
+        return;
+    }
+
+    mReadBufferSize = size;
+    emit readBufferSizeChanged();
+}
+
+BLEStreamLink::Settings BLEStreamLink::settings() const
+{
+    return Settings { mBackend, mServiceUuid, mServerName, mReadBufferSize };
+}
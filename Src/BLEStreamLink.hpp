@@ -0,0 +1,136 @@
+#pragma once
+
+#include <QObject>
+#include <QBluetoothUuid>
+
+#include "BluetoothDeviceInfo.hpp"
+
+/*!
+ * \brief The BLEStreamLink class carries the data of a \ref BLECentral and a \ref BLEPeripheral
+ * over a byte stream instead of GATT, ie Classic Bluetooth RFCOMM for devices that need far more
+ * than the throughput of BLE. The services and their codecs are the same, only the transport is a
+ * \ref BLEStreamTransport. The peripheral end listens while it advertises and the central end
+ * connects to it. A \ref BLERole uses the stream when its \ref BLERole::streamLink is set.
+ * With \ref LocalSocketBackend both ends meet on a local socket, a stand-in for RFCOMM to test
+ * and benchmark the stream path without a radio
+ */
+class BLEStreamLink : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(Backend backend READ backend WRITE setBackend NOTIFY backendChanged FINAL)
+    Q_PROPERTY(uint32_t serviceUuid READ serviceUuid WRITE setServiceUuid NOTIFY serviceUuidChanged FINAL)
+    Q_PROPERTY(QString serverName READ serverName WRITE setServerName NOTIFY serverNameChanged FINAL)
+    Q_PROPERTY(int readBufferSize READ readBufferSize WRITE setReadBufferSize NOTIFY readBufferSizeChanged FINAL)
+    Q_PROPERTY(BluetoothDeviceInfo* device READ device CONSTANT)
+
+public:
+    /*!
+     * \brief The Backend enum lists what carries the stream
+     */
+    enum Backend : quint8 {
+        RfcommBackend = 0,  //! A Classic Bluetooth RFCOMM socket
+        LocalSocketBackend, //! A local socket named \ref serverName, no radio is used
+    };
+    Q_ENUM(Backend)
+
+    /*!
+     * \brief The Settings struct is a copy of the properties handed to a transport on its thread
+     */
+    struct Settings
+    {
+        Backend backend = RfcommBackend;
+        QBluetoothUuid serviceUuid;
+        QString serverName;
+        int readBufferSize = 0;
+    };
+
+    //! \brief DefaultReadBufferSize Bytes read from the stream at once by default
+    static constexpr int DefaultReadBufferSize = 64 * 1024;
+
+    explicit BLEStreamLink(QObject* parent = nullptr);
+
+    /*!
+     * \brief backend Getter for backend
+     */
+    Backend backend() const;
+    /*!
+     * \brief setBackend Sets what carries the stream
+     * \note Only used by the transports created afterwards
+     */
+    void setBackend(Backend backend);
+
+    /*!
+     * \brief serviceUuid The uuid of the RFCOMM service the peripheral end registers and the
+     * central end connects to, the Serial Port Profile by default
+     */
+    uint32_t serviceUuid() const;
+    void setServiceUuid(uint32_t uuid);
+
+    /*!
+     * \brief serverName The name of the local socket of \ref LocalSocketBackend, or the service
+     * name of the RFCOMM service record of \ref RfcommBackend
+     */
+    QString serverName() const;
+    void setServerName(const QString& name);
+
+    /*!
+     * \brief readBufferSize Bytes read from the stream at once, every frame complete in them is
+     * handled in one go
+     */
+    int readBufferSize() const;
+    void setReadBufferSize(int size);
+
+    /*!
+     * \brief device Returns the device info that a \ref BLECentral uses to connect to the
+     * peripheral of this link with \ref LocalSocketBackend. With \ref RfcommBackend the central
+     * connects to a Classic device found by \ref BluetoothDiscovery
+     */
+    BluetoothDeviceInfo* device() const;
+
+    /*!
+     * \brief settings Returns a copy of the properties for a new transport
+     */
+    Settings settings() const;
+
+signals:
+    void backendChanged();
+    void serviceUuidChanged();
+    void serverNameChanged();
+    void readBufferSizeChanged();
+
+private:
+    Backend mBackend;
+    QBluetoothUuid mServiceUuid;
+    QString mServerName;
+    int mReadBufferSize;
+
+    //! \brief mDevice The device info of the peripheral end on a local socket
+    BluetoothDeviceInfo* mDevice;
+};
+
+
+inline BLEStreamLink::Backend BLEStreamLink::backend() const
+{
+    return mBackend;
+}
+
+inline uint32_t BLEStreamLink::serviceUuid() const
+{
+    return mServiceUuid.toUInt32();
+}
+
+inline QString BLEStreamLink::serverName() const
+{
+    return mServerName;
+}
+
+inline int BLEStreamLink::readBufferSize() const
+{
+    return mReadBufferSize;
+}
+
+inline BluetoothDeviceInfo* BLEStreamLink::device() const
+{
+    return mDevice;
+}
@@ -0,0 +1,562 @@
+#include "BLEStreamTransport.hpp"
+
+#include <QBluetoothLocalDevice>
+#include <QBluetoothServer>
+#include <QBluetoothSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QtEndian>
+
+#include <utility>
+
+namespace {
+
+//! \brief Size of the field holding the size of a frame
+constexpr int SizeField = 4;
+
+/*!
+ * \brief Appends \a uuid as a u8 length and its bytes, 16 and 32 bit uuids take 4 bytes
+ */
+void appendUuid(QByteArray& frame, const QBluetoothUuid& uuid)
+{
+    if (uuid.isNull()) {
+        frame.append(char(0));
+        return;
+    }
+
+    bool isShort = false;
+    const quint32 value = uuid.toUInt32(&isShort);
+    if (isShort) {
+        char bytes[4];
+        qToLittleEndian(value, bytes);
+        frame.append(char(4));
+        frame.append(bytes, 4);
+        return;
+    }
+
+    frame.append(char(16));
+    frame.append(uuid.toRfc4122());
+}
+
+/*!
+ * \brief Reads a uuid written by \ref appendUuid() at the start of \a data
+ * \return The bytes used, -1 if the uuid is malformed
+ */
+qsizetype readUuid(QByteArrayView data, QBluetoothUuid& uuid)
+{
+    if (data.isEmpty()) {
+        return -1;
+    }
+
+    const quint8 length = quint8(data.at(0));
+    if (data.size() < 1 + length) {
+        return -1;
+    }
+
+    switch (length) {
+    case 0:
+        uuid = QBluetoothUuid();
+        break;
+    case 4:
+        uuid = QBluetoothUuid(qFromLittleEndian<quint32>(data.data() + 1));
+        break;
+    case 16:
+        uuid = QBluetoothUuid(QUuid::fromRfc4122(data.sliced(1, 16)));
+        break;
+    default:
+        return -1;
+    }
+
+    return 1 + length;
+}
+
+} // namespace
+
+BLEStreamTransport* BLEStreamTransport::createCentral(const BLEStreamLink::Settings& settings,
+                                                      const QBluetoothDeviceInfo& remoteDevice,
+                                                      QObject* parent)
+{
+    auto* transport = new BLEStreamTransport(settings, QLowEnergyController::CentralRole, parent);
+    transport->mRemoteDevice = remoteDevice;
+    return transport;
+}
+
+BLEStreamTransport* BLEStreamTransport::createPeripheral(const BLEStreamLink::Settings& settings,
+                                                         QObject* parent)
+{
+    return new BLEStreamTransport(settings, QLowEnergyController::PeripheralRole, parent);
+}
+
+BLEStreamTransport::BLEStreamTransport(const BLEStreamLink::Settings& settings,
+                                       Role role,
+                                       QObject* parent)
+    : BLELoopbackTransport{ nullptr, role, parent }
+    , mSettings { settings }
+    , mSocket { nullptr }
+    , mBluetoothServer { nullptr }
+    , mLocalServer { nullptr }
+    , mWritten { 0 }
+    , mFlushed { 0 }
+{
+}
+
+BLEStreamTransport::~BLEStreamTransport()
+{
+    if (mServiceInfo.isRegistered()) {
+        mServiceInfo.unregisterService();
+    }
+}
+
+QBluetoothAddress BLEStreamTransport::localAddress() const
+{
+    if (mSettings.backend == BLEStreamLink::LocalSocketBackend) {
+        return BLELoopbackTransport::localAddress();
+    }
+
+    //! Asked on the thread of the transport, creating the local device blocks on some platforms
+    if (!mLocalAddress) {
+        mLocalAddress = QBluetoothLocalDevice().address();
+    }
+
+    return *mLocalAddress;
+}
+
+QBluetoothAddress BLEStreamTransport::remoteAddress() const
+{
+    if (mSettings.backend == BLEStreamLink::LocalSocketBackend) {
+        return BLELoopbackTransport::remoteAddress();
+    }
+
+    auto* socket = qobject_cast<QBluetoothSocket*>(mSocket);
+    return socket ? socket->peerAddress() : QBluetoothAddress();
+}
+
+int BLEStreamTransport::mtu() const
+{
+    //! The payload of a notification is mtu - 3 bytes
+    return MaxValueSize + 3;
+}
+
+bool BLEStreamTransport::writeCharacteristic(const QBluetoothUuid& service,
+                                             const QBluetoothUuid& characteristic,
+                                             const QByteArray& value)
+{
+    if (value.size() > MaxValueSize) {
+        qWarning() << "BLEStreamTransport: A value of" << value.size()
+                   << "bytes is larger than the stream allows, rejected";
+        return false;
+    }
+
+    return BLELoopbackTransport::writeCharacteristic(service, characteristic, value);
+}
+
+void BLEStreamTransport::connectToDevice()
+{
+    if (role() != QLowEnergyController::CentralRole
+        || state() != QLowEnergyController::UnconnectedState) {
+        return;
+    }
+
+    setState(QLowEnergyController::ConnectingState);
+
+    //! The connect request goes out once the stream is up, see onSocketConnected()
+    if (mSettings.backend == BLEStreamLink::LocalSocketBackend) {
+        auto* socket = new QLocalSocket(this);
+        setSocket(socket);
+        socket->connectToServer(mSettings.serverName);
+    } else {
+        auto* socket = new QBluetoothSocket(QBluetoothServiceInfo::RfcommProtocol, this);
+        setSocket(socket);
+        socket->connectToService(mRemoteDevice.address(), mSettings.serviceUuid);
+    }
+}
+
+void BLEStreamTransport::disconnectFromDevice()
+{
+    //! The other end is told before the stream is closed
+    BLELoopbackTransport::disconnectFromDevice();
+    dropSocket();
+}
+
+void BLEStreamTransport::startAdvertising(const QLowEnergyAdvertisingParameters& parameters,
+                                          const QLowEnergyAdvertisingData& advertisingData,
+                                          const QLowEnergyAdvertisingData& scanResponseData)
+{
+    BLELoopbackTransport::startAdvertising(parameters, advertisingData, scanResponseData);
+
+    if (role() == QLowEnergyController::PeripheralRole && !listen()) {
+        stopAdvertising();
+        fail(QLowEnergyController::AdvertisingError,
+             QStringLiteral("The stream server can't listen"));
+    }
+}
+
+void BLEStreamTransport::stopAdvertising()
+{
+    BLELoopbackTransport::stopAdvertising();
+
+    //! A central already accepted keeps its stream
+    if (mServiceInfo.isRegistered()) {
+        mServiceInfo.unregisterService();
+    }
+    if (mBluetoothServer) {
+        mBluetoothServer->close();
+    }
+    if (mLocalServer) {
+        mLocalServer->close();
+    }
+}
+
+void BLEStreamTransport::requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters)
+{
+    //! A stream has no connection parameters
+    Q_UNUSED(parameters);
+}
+
+void BLEStreamTransport::encode(const BLELoopbackPacket& packet, QByteArray& frame)
+{
+    const qsizetype start = frame.size();
+    frame.append(SizeField, '\0');
+    frame.append(char(packet.kind));
+
+    appendUuid(frame, packet.service);
+    appendUuid(frame, packet.characteristic);
+    appendUuid(frame, packet.descriptor);
+
+    if (packet.kind == BLELoopbackPacket::DiscoverResponse) {
+        char count[2];
+        qToLittleEndian(quint16(packet.services.size()), count);
+        frame.append(count, 2);
+        for (const QBluetoothUuid& uuid : packet.services) {
+            appendUuid(frame, uuid);
+        }
+    } else {
+        frame.append(packet.value);
+    }
+
+    qToLittleEndian(quint32(frame.size() - start - SizeField), frame.data() + start);
+}
+
+qsizetype BLEStreamTransport::decode(QByteArrayView data, BLELoopbackPacket& packet)
+{
+    if (data.size() < SizeField) {
+        return 0;
+    }
+
+    const quint32 size = qFromLittleEndian<quint32>(data.data());
+    if (size < 1 || size > quint32(MaxFrameSize)) {
+        return -1;
+    }
+    if (data.size() < SizeField + qsizetype(size)) {
+        return 0;
+    }
+
+    const QByteArrayView body = data.sliced(SizeField, size);
+
+    //! ConnectionUpdate is the last kind
+    const quint8 kind = quint8(body.at(0));
+    if (kind > BLELoopbackPacket::ConnectionUpdate) {
+        return -1;
+    }
+    packet.kind = BLELoopbackPacket::Kind(kind);
+
+    qsizetype offset = 1;
+    for (QBluetoothUuid* uuid : { &packet.service, &packet.characteristic, &packet.descriptor }) {
+        const qsizetype used = readUuid(body.sliced(offset), *uuid);
+        if (used < 0) {
+            return -1;
+        }
+        offset += used;
+    }
+
+    packet.services.clear();
+    packet.value.clear();
+
+    if (packet.kind == BLELoopbackPacket::DiscoverResponse) {
+        if (body.size() < offset + 2) {
+            return -1;
+        }
+
+        const quint16 count = qFromLittleEndian<quint16>(body.data() + offset);
+        offset += 2;
+
+        packet.services.reserve(count);
+        for (quint16 i = 0; i < count; ++i) {
+            QBluetoothUuid uuid;
+            const qsizetype used = readUuid(body.sliced(offset), uuid);
+            if (used < 0) {
+                return -1;
+            }
+            offset += used;
+            packet.services.append(uuid);
+        }
+    } else {
+        packet.value = body.sliced(offset).toByteArray();
+    }
+
+    return SizeField + size;
+}
+
+bool BLEStreamTransport::post(BLELoopbackPacket packet)
+{
+    if (!mSocket || !mSocket->isOpen()) {
+        return false;
+    }
+
+    QByteArray frame;
+    frame.reserve(64 + packet.value.size());
+    encode(packet, frame);
+
+    //! The other end would take it for a corrupt stream and drop it
+    if (frame.size() - SizeField > MaxFrameSize) {
+        qWarning() << "BLEStreamTransport: A frame of" << frame.size() - SizeField
+                   << "bytes is larger than" << MaxFrameSize << "bytes, rejected";
+        return false;
+    }
+
+    if (mSocket->write(frame) != frame.size()) {
+        return false;
+    }
+    mWritten += frame.size();
+
+    if (packet.kind == BLELoopbackPacket::Notification) {
+        mSent.push_back(Sent { mWritten, std::move(packet.service),
+                               std::move(packet.characteristic), std::move(packet.value) });
+    } else if (packet.kind == BLELoopbackPacket::ConnectFailed) {
+        //! The refused central must not hold the stream the next one connects with
+        dropSocket();
+    }
+
+    return true;
+}
+
+void BLEStreamTransport::setSocket(QIODevice* socket)
+{
+    dropSocket();
+
+    mSocket = socket;
+    mSocket->setParent(this);
+
+    connect(mSocket, &QIODevice::readyRead, this, &BLEStreamTransport::onReadyRead);
+    connect(mSocket, &QIODevice::bytesWritten, this, &BLEStreamTransport::onBytesWritten);
+
+    if (auto* bluetoothSocket = qobject_cast<QBluetoothSocket*>(mSocket)) {
+        connect(bluetoothSocket, &QBluetoothSocket::connected, this,
+                &BLEStreamTransport::onSocketConnected);
+        connect(bluetoothSocket, &QBluetoothSocket::disconnected, this,
+                &BLEStreamTransport::onSocketDisconnected);
+        connect(bluetoothSocket, &QBluetoothSocket::errorOccurred, this,
+                [this, bluetoothSocket]() {
+                    onSocketError(bluetoothSocket->errorString());
+                });
+    } else if (auto* localSocket = qobject_cast<QLocalSocket*>(mSocket)) {
+        localSocket->setReadBufferSize(mSettings.readBufferSize);
+        connect(localSocket, &QLocalSocket::connected, this,
+                &BLEStreamTransport::onSocketConnected);
+        connect(localSocket, &QLocalSocket::disconnected, this,
+                &BLEStreamTransport::onSocketDisconnected);
+        connect(localSocket, &QLocalSocket::errorOccurred, this, [this, localSocket]() {
+            onSocketError(localSocket->errorString());
+        });
+    }
+}
+
+void BLEStreamTransport::dropSocket()
+{
+    if (!mSocket) {
+        return;
+    }
+
+    QIODevice* socket = std::exchange(mSocket, nullptr);
+    socket->disconnect(this);
+
+    //! What was written still goes out, the socket is deleted once it's closed
+    if (auto* bluetoothSocket = qobject_cast<QBluetoothSocket*>(socket)) {
+        connect(bluetoothSocket, &QBluetoothSocket::disconnected, bluetoothSocket,
+                &QObject::deleteLater);
+        bluetoothSocket->disconnectFromService();
+        if (bluetoothSocket->state() == QBluetoothSocket::SocketState::UnconnectedState) {
+            bluetoothSocket->deleteLater();
+        }
+    } else if (auto* localSocket = qobject_cast<QLocalSocket*>(socket)) {
+        connect(localSocket, &QLocalSocket::disconnected, localSocket, &QObject::deleteLater);
+        localSocket->disconnectFromServer();
+        if (localSocket->state() == QLocalSocket::UnconnectedState) {
+            localSocket->deleteLater();
+        }
+    } else {
+        socket->deleteLater();
+    }
+
+    mReadBuffer.clear();
+    mSent.clear();
+    mWritten = 0;
+    mFlushed = 0;
+}
+
+bool BLEStreamTransport::listen()
+{
+    if (mSettings.backend == BLEStreamLink::LocalSocketBackend) {
+        if (!mLocalServer) {
+            mLocalServer = new QLocalServer(this);
+            connect(mLocalServer, &QLocalServer::newConnection, this,
+                    &BLEStreamTransport::onNewConnection);
+        }
+
+        if (mLocalServer->isListening()) {
+            return true;
+        }
+
+        //! A server that crashed leaves its socket behind
+        QLocalServer::removeServer(mSettings.serverName);
+        return mLocalServer->listen(mSettings.serverName);
+    }
+
+    if (!mBluetoothServer) {
+        mBluetoothServer = new QBluetoothServer(QBluetoothServiceInfo::RfcommProtocol, this);
+        connect(mBluetoothServer, &QBluetoothServer::newConnection, this,
+                &BLEStreamTransport::onNewConnection);
+    }
+
+    if (mBluetoothServer->isListening()) {
+        return true;
+    }
+
+    //! Registers a Serial Port Profile record so the centrals find the service by its uuid
+    mServiceInfo = mBluetoothServer->listen(mSettings.serviceUuid, mSettings.serverName);
+    return mServiceInfo.isValid();
+}
+
+void BLEStreamTransport::onNewConnection()
+{
+    auto accept = [this](QIODevice* socket) {
+        //! One central at a time, like a peripheral that stops advertising once connected
+        if (mSocket) {
+            socket->close();
+            socket->deleteLater();
+            return;
+        }
+
+        setSocket(socket);
+    };
+
+    if (mLocalServer) {
+        while (QLocalSocket* socket = mLocalServer->nextPendingConnection()) {
+            accept(socket);
+        }
+    }
+    if (mBluetoothServer) {
+        while (QBluetoothSocket* socket = mBluetoothServer->nextPendingConnection()) {
+            accept(socket);
+        }
+    }
+}
+
+void BLEStreamTransport::onSocketConnected()
+{
+    if (role() != QLowEnergyController::CentralRole) {
+        return;
+    }
+
+    BLELoopbackPacket packet;
+    packet.kind = BLELoopbackPacket::ConnectRequest;
+    if (!post(std::move(packet))) {
+        dropSocket();
+        fail(QLowEnergyController::UnknownRemoteDeviceError,
+             QStringLiteral("The stream closed before the peripheral answered"));
+    }
+}
+
+void BLEStreamTransport::onSocketDisconnected()
+{
+    dropSocket();
+
+    switch (state()) {
+    case QLowEnergyController::UnconnectedState:
+    case QLowEnergyController::AdvertisingState:
+        return;
+    case QLowEnergyController::ConnectingState:
+        fail(QLowEnergyController::UnknownRemoteDeviceError,
+             QStringLiteral("The stream closed before the peripheral answered"));
+        return;
+    default:
+        break;
+    }
+
+    //! The other end is gone without saying so, handled as if it did
+    BLELoopbackPacket packet;
+    packet.kind = BLELoopbackPacket::Disconnect;
+    receive(packet);
+}
+
+void BLEStreamTransport::onSocketError(const QString& description)
+{
+    if (state() == QLowEnergyController::ConnectingState) {
+        dropSocket();
+        fail(QLowEnergyController::UnknownRemoteDeviceError, description);
+        return;
+    }
+
+    onSocketDisconnected();
+}
+
+void BLEStreamTransport::onReadyRead()
+{
+    //! Handling a packet may drop the stream or, through the signals, delete this transport
+    QPointer<BLEStreamTransport> self(this);
+    BLELoopbackPacket packet;
+
+    while (mSocket && mSocket->bytesAvailable() > 0) {
+        const qsizetype buffered = mReadBuffer.size();
+        const qint64 chunk = qMin<qint64>(mSocket->bytesAvailable(), mSettings.readBufferSize);
+        mReadBuffer.resize(buffered + chunk);
+
+        const qint64 read = mSocket->read(mReadBuffer.data() + buffered, chunk);
+        mReadBuffer.resize(buffered + qMax<qint64>(read, 0));
+        if (read <= 0) {
+            return;
+        }
+
+        qsizetype offset = 0;
+        while (true) {
+            const qsizetype used = decode(QByteArrayView(mReadBuffer).sliced(offset), packet);
+            if (used == 0) {
+                break;
+            }
+
+            if (used < 0) {
+                qWarning() << "BLEStreamTransport: Malformed frame, dropping the stream";
+                onSocketDisconnected();
+                return;
+            }
+
+            offset += used;
+            receive(packet);
+            if (!self || !mSocket) {
+                return;
+            }
+        }
+
+        //! Only the start of a frame split between two reads is kept
+        mReadBuffer.remove(0, offset);
+    }
+}
+
+void BLEStreamTransport::onBytesWritten(qint64 bytes)
+{
+    mFlushed += bytes;
+
+    QPointer<BLEStreamTransport> self(this);
+    while (self && !mSent.empty() && mSent.front().end <= mFlushed) {
+        Sent sent = std::move(mSent.front());
+        mSent.pop_front();
+
+        BLELoopbackPacket packet;
+        packet.kind = BLELoopbackPacket::NotificationSent;
+        packet.service = std::move(sent.service);
+        packet.characteristic = std::move(sent.characteristic);
+        packet.value = std::move(sent.value);
+        receive(packet);
+    }
+}
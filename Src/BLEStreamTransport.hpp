@@ -0,0 +1,199 @@
+#pragma once
+
+#include <QBluetoothDeviceInfo>
+#include <QBluetoothServiceInfo>
+#include <QByteArray>
+#include <QIODevice>
+
+#include <deque>
+#include <optional>
+
+#include "BLELoopbackTransport.hpp"
+#include "BLEStreamLink.hpp"
+
+class QBluetoothServer;
+class QLocalServer;
+
+/*!
+ * \brief The BLEStreamTransport class is the \ref BLETransport of one end of a
+ * \ref BLEStreamLink. It runs the protocol of a \ref BLELoopbackTransport with the packets framed
+ * on a byte stream, so services, subscriptions, reads and writes behave the same as over GATT
+ * while the values are as large as the stream allows. The stream is an RFCOMM socket or, as a
+ * stand-in, a local socket. The peripheral end listens while it advertises and accepts one central
+ * at a time.
+ *
+ * A frame is, little endian:
+ *  - u32 size of the rest of the frame
+ *  - u8 \ref BLELoopbackPacket::Kind
+ *  - service, characteristic and descriptor uuids, each a u8 length of 0, 4 or 16 and its bytes
+ *  - for \ref BLELoopbackPacket::DiscoverResponse a u16 count and that many uuids, otherwise the
+ *    value up to the end of the frame
+ *
+ * A notification is reported written once its frame is handed to the stream, so pacing and rate
+ * control follow what the stream drains
+ */
+class BLEStreamTransport : public BLELoopbackTransport
+{
+    Q_OBJECT
+
+public:
+    //! \brief MaxFrameSize Largest frame accepted, a larger size means the stream is corrupt
+    static constexpr int MaxFrameSize = 1024 * 1024;
+
+    //! \brief MaxValueSize Largest value that fits in a frame with three 128 bit uuids
+    static constexpr int MaxValueSize = MaxFrameSize - 1 - 3 * 17;
+
+    /*!
+     * \brief createCentral Creates a central transport that connects to \a remoteDevice with
+     * \a settings. \a remoteDevice is ignored on a local socket
+     */
+    static BLEStreamTransport* createCentral(const BLEStreamLink::Settings& settings,
+                                             const QBluetoothDeviceInfo& remoteDevice,
+                                             QObject* parent = nullptr);
+
+    /*!
+     * \brief createPeripheral Creates a peripheral transport that listens with \a settings
+     */
+    static BLEStreamTransport* createPeripheral(const BLEStreamLink::Settings& settings,
+                                                QObject* parent = nullptr);
+
+    ~BLEStreamTransport() override;
+
+    QBluetoothAddress localAddress() const override;
+    QBluetoothAddress remoteAddress() const override;
+    int mtu() const override;
+
+    /*!
+     * \brief writeCharacteristic Rejects values larger than \ref MaxValueSize, the other end
+     * would drop the stream on their frame
+     */
+    bool writeCharacteristic(const QBluetoothUuid& service,
+                             const QBluetoothUuid& characteristic,
+                             const QByteArray& value) override;
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+
+    void startAdvertising(const QLowEnergyAdvertisingParameters& parameters,
+                          const QLowEnergyAdvertisingData& advertisingData,
+                          const QLowEnergyAdvertisingData& scanResponseData) override;
+    void stopAdvertising() override;
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters) override;
+
+    /*!
+     * \brief encode Appends the frame of \a packet to \a frame
+     */
+    static void encode(const BLELoopbackPacket& packet, QByteArray& frame);
+
+    /*!
+     * \brief decode Reads the frame at the start of \a data into \a packet
+     * \return The size of the frame, 0 if it's not complete yet or -1 if it's malformed
+     */
+    static qsizetype decode(QByteArrayView data, BLELoopbackPacket& packet);
+
+protected:
+    /*!
+     * \brief post Writes the frame of \a packet to the stream
+     * \return False if there is no stream or the frame is larger than \ref MaxFrameSize
+     */
+    bool post(BLELoopbackPacket packet) override;
+
+private:
+    BLEStreamTransport(const BLEStreamLink::Settings& settings, Role role, QObject* parent);
+
+    /*!
+     * \brief The Sent struct is a notification whose frame is not handed to the stream yet
+     */
+    struct Sent
+    {
+        //! \brief end Bytes written to the stream once the frame is handed over
+        qint64 end;
+        QBluetoothUuid service;
+        QBluetoothUuid characteristic;
+        QByteArray value;
+    };
+
+    /*!
+     * \brief setSocket Makes \a socket the stream of this transport
+     */
+    void setSocket(QIODevice* socket);
+
+    /*!
+     * \brief dropSocket Closes the stream once what was written to it is sent, deletes it and
+     * forgets what was buffered for it
+     */
+    void dropSocket();
+
+    /*!
+     * \brief listen Starts accepting a central, peripheral only
+     * \return False if the server can't listen
+     */
+    bool listen();
+
+    /*!
+     * \brief onNewConnection Takes the next pending connection of the server
+     */
+    void onNewConnection();
+
+    /*!
+     * \brief onSocketConnected Asks the peripheral end to connect, central only
+     */
+    void onSocketConnected();
+
+    /*!
+     * \brief onSocketDisconnected Reports the link lost if the other end didn't disconnect first
+     */
+    void onSocketDisconnected();
+
+    /*!
+     * \brief onSocketError Reports a central that can't reach the peripheral, otherwise the link
+     * is lost
+     */
+    void onSocketError(const QString& description);
+
+    /*!
+     * \brief onReadyRead Reads what the stream has, up to the read buffer size at once, and
+     * handles every complete frame in it
+     */
+    void onReadyRead();
+
+    /*!
+     * \brief onBytesWritten Reports the notifications whose frames left
+     */
+    void onBytesWritten(qint64 bytes);
+
+private:
+    //! \brief mSettings The settings of the link this transport was created for
+    const BLEStreamLink::Settings mSettings;
+
+    //! \brief mRemoteDevice The device a central connects to
+    QBluetoothDeviceInfo mRemoteDevice;
+
+    //! \brief mLocalAddress The address of the local adapter with \ref BLEStreamLink::RfcommBackend,
+    //! asked on first use since it blocks on some platforms
+    mutable std::optional<QBluetoothAddress> mLocalAddress;
+
+    //! \brief mSocket The stream, a \a QBluetoothSocket or a \a QLocalSocket, null if there is none
+    QIODevice* mSocket;
+
+    //! \brief mBluetoothServer Accepts the central with \ref BLEStreamLink::RfcommBackend
+    QBluetoothServer* mBluetoothServer;
+
+    //! \brief mLocalServer Accepts the central with \ref BLEStreamLink::LocalSocketBackend
+    QLocalServer* mLocalServer;
+
+    //! \brief mServiceInfo The RFCOMM service record registered while listening
+    QBluetoothServiceInfo mServiceInfo;
+
+    //! \brief mReadBuffer Bytes read and not handled yet, a frame may be split between reads
+    QByteArray mReadBuffer;
+
+    //! \brief mWritten Bytes written to the stream
+    qint64 mWritten;
+
+    //! \brief mFlushed Bytes the stream reported written
+    qint64 mFlushed;
+
+    //! \brief mSent Notifications in the order of their frames
+    std::deque<Sent> mSent;
+};
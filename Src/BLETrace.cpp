@@ -0,0 +1,218 @@
+#include "BLETrace.hpp"
+#include "BLESample.hpp"
+#include "SPSCQueue.hpp"
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+#include <QThread>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+/*!
+ * \brief The ThreadBuffer struct holds the events of one thread. The thread is the only producer
+ * and exports, serialized by the registry mutex, are the only consumer
+ */
+struct ThreadBuffer
+{
+    SPSCQueue<BLETraceEvent, BLETrace::BufferSize> events;
+    quint64 threadId = 0;
+    QString threadName;
+};
+
+/*!
+ * \brief The Registry struct keeps the buffer of every thread that ever recorded an event. Buffers
+ * outlive their threads so their events can still be exported
+ */
+struct Registry
+{
+    QMutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::atomic<quint64> dropped { 0 };
+};
+
+Registry& registry()
+{
+    static Registry sRegistry;
+    return sRegistry;
+}
+
+ThreadBuffer& threadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        //! Only the first event of each thread takes the lock
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->threadId = quint64(quintptr(QThread::currentThreadId()));
+        buffer->threadName = QThread::currentThread()->objectName();
+
+        Registry& reg = registry();
+        QMutexLocker locker(&reg.mutex);
+        reg.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+//! \brief Appends a JSON string literal of \a text to \a out
+void appendString(QByteArray& out, const QByteArray& text)
+{
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (uchar(c) < 0x20) {
+            out += "\\u00";
+            out += QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+//! \brief Chrome traces use microseconds
+QByteArray micros(qint64 nanoseconds)
+{
+    return QByteArray::number(qreal(nanoseconds) / 1000, 'f', 3);
+}
+
+} // namespace
+
+std::atomic_bool BLETrace::sEnabled { false };
+
+void BLETrace::setEnabled(bool enabled)
+{
+    sEnabled.store(enabled && isCompiledIn(), std::memory_order_relaxed);
+}
+
+void BLETrace::record(const BLETraceEvent& event)
+{
+    if (!threadBuffer().events.push(event)) {
+        registry().dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void BLETrace::beginAsync(const char* name, quint64 id, const char* category)
+{
+    BLETraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.timestamp = now();
+    event.id = id;
+    event.phase = BLETraceEvent::AsyncBegin;
+    record(event);
+}
+
+void BLETrace::endAsync(const char* name, quint64 id, const char* category)
+{
+    BLETraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.timestamp = now();
+    event.id = id;
+    event.phase = BLETraceEvent::AsyncEnd;
+    record(event);
+}
+
+void BLETrace::instant(const char* name, const char* category)
+{
+    BLETraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.timestamp = now();
+    event.phase = BLETraceEvent::Instant;
+    record(event);
+}
+
+quint64 BLETrace::id(const void* owner,
+                     const QBluetoothUuid& service,
+                     const QBluetoothUuid& characteristic)
+{
+    return quint64(qHashMulti(0, quintptr(owner), service, characteristic));
+}
+
+quint64 BLETrace::dropped()
+{
+    return registry().dropped.load(std::memory_order_relaxed);
+}
+
+QByteArray BLETrace::takeChromeJson()
+{
+    Registry& reg = registry();
+    QMutexLocker locker(&reg.mutex);
+
+    QByteArray out;
+    out += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+    auto separator = [&out, &first]() {
+        if (!first) {
+            out += ",\n";
+        }
+        first = false;
+    };
+
+    for (const std::shared_ptr<ThreadBuffer>& buffer : reg.buffers) {
+        const QByteArray tid = QByteArray::number(buffer->threadId);
+
+        if (!buffer->threadName.isEmpty()) {
+            separator();
+            out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + tid
+                   + ",\"args\":{\"name\":";
+            appendString(out, buffer->threadName.toUtf8());
+            out += "}}";
+        }
+
+        BLETraceEvent event;
+        while (buffer->events.pop(event)) {
+            separator();
+            out += "{\"name\":";
+            appendString(out, event.name);
+            out += ",\"cat\":";
+            appendString(out, event.category);
+            out += ",\"ph\":\"";
+            out += char(event.phase);
+            out += "\",\"ts\":" + micros(event.timestamp) + ",\"pid\":1,\"tid\":" + tid;
+
+            switch (event.phase) {
+            case BLETraceEvent::Complete:
+                out += ",\"dur\":" + micros(event.duration);
+                break;
+            case BLETraceEvent::AsyncBegin:
+            case BLETraceEvent::AsyncEnd:
+                out += ",\"id\":\"0x" + QByteArray::number(event.id, 16) + '"';
+                break;
+            case BLETraceEvent::Instant:
+                out += ",\"s\":\"t\"";
+                break;
+            }
+            out += '}';
+        }
+    }
+
+    out += "]}\n";
+    return out;
+}
+
+bool BLETrace::dump(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "BLETrace: Can't write the trace to" << fileName << file.errorString();
+        return false;
+    }
+
+    file.write(takeChromeJson());
+    return true;
+}
+
+qint64 BLETrace::now()
+{
+    return BLESample::now();
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <QBluetoothUuid>
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+/*!
+ * \brief The BLETraceEvent struct is one entry of a trace. Names and categories must be string
+ * literals since only their pointers are kept
+ */
+struct BLETraceEvent
+{
+    enum Phase : char {
+        Complete = 'X',     //! A scoped span with a duration
+        AsyncBegin = 'b',   //! Start of an operation that completes in a callback
+        AsyncEnd = 'e',     //! End of the operation with the same id
+        Instant = 'i',
+    };
+
+    const char* name = nullptr;
+    const char* category = nullptr;
+    qint64 timestamp = 0;   //! Nanoseconds, see \ref BLETrace::now()
+    qint64 duration = 0;    //! Nanoseconds, only for \ref Complete
+    quint64 id = 0;         //! Only for \ref AsyncBegin and \ref AsyncEnd
+    Phase phase = Complete;
+};
+
+/*!
+ * \brief The BLETrace class records spans of GATT operations into lock-free per-thread buffers and
+ * exports them in the Chrome trace event JSON format, which chrome://tracing and Perfetto open.
+ * Recording happens only when the library is built with QUICKBLUETOOTH_TRACE and tracing is
+ * enabled with \ref setEnabled(). Use the QB_TRACE_* macros, they compile to nothing otherwise.
+ * A thread whose buffer is full drops new events until the next \ref takeChromeJson()
+ */
+class BLETrace
+{
+public:
+    //! \brief BufferSize Number of events each thread buffers between two exports
+    static constexpr std::size_t BufferSize = 8192;
+
+    /*!
+     * \brief isEnabled Returns true if events are being recorded
+     */
+    static bool isEnabled();
+
+    /*!
+     * \brief setEnabled Starts or stops recording. Has no effect if tracing is compiled out
+     */
+    static void setEnabled(bool enabled);
+
+    /*!
+     * \brief isCompiledIn Returns true if the library is built with QUICKBLUETOOTH_TRACE
+     */
+    static constexpr bool isCompiledIn();
+
+    /*!
+     * \brief record Adds \a event to the buffer of the current thread
+     */
+    static void record(const BLETraceEvent& event);
+
+    /*!
+     * \brief beginAsync Starts an operation named \a name that ends with \ref endAsync() with the
+     * same \a id, possibly on another thread
+     */
+    static void beginAsync(const char* name, quint64 id, const char* category = "gatt");
+
+    /*!
+     * \brief endAsync Ends the operation started by \ref beginAsync()
+     */
+    static void endAsync(const char* name, quint64 id, const char* category = "gatt");
+
+    /*!
+     * \brief instant Records an event without duration
+     */
+    static void instant(const char* name, const char* category = "gatt");
+
+    /*!
+     * \brief id Returns an id for the async operations of \a owner on a service or characteristic
+     */
+    static quint64 id(const void* owner,
+                      const QBluetoothUuid& service = QBluetoothUuid(),
+                      const QBluetoothUuid& characteristic = QBluetoothUuid());
+
+    /*!
+     * \brief dropped Returns the number of events dropped because a buffer was full
+     */
+    static quint64 dropped();
+
+    /*!
+     * \brief takeChromeJson Removes the buffered events of every thread and returns them as a
+     * Chrome trace JSON document
+     */
+    static QByteArray takeChromeJson();
+
+    /*!
+     * \brief dump Writes \ref takeChromeJson() to \a fileName
+     * \return False if the file can't be written
+     */
+    static bool dump(const QString& fileName);
+
+    /*!
+     * \brief now Monotonic time in nanoseconds used for timestamps
+     */
+    static qint64 now();
+
+private:
+    static std::atomic_bool sEnabled;
+};
+
+/*!
+ * \brief The BLETraceScope class records a \ref BLETraceEvent::Complete span from its construction
+ * to its destruction. Use \ref QB_TRACE_SCOPE instead of using it directly
+ */
+class BLETraceScope
+{
+public:
+    explicit BLETraceScope(const char* name, const char* category = "gatt");
+    ~BLETraceScope();
+
+    BLETraceScope(const BLETraceScope&) = delete;
+    BLETraceScope& operator=(const BLETraceScope&) = delete;
+
+private:
+    const char* mName;
+    const char* mCategory;
+    qint64 mStart;  //! 0 when tracing was disabled at construction
+};
+
+
+constexpr bool BLETrace::isCompiledIn()
+{
+#ifdef QUICKBLUETOOTH_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline bool BLETrace::isEnabled()
+{
+    return isCompiledIn() && sEnabled.load(std::memory_order_relaxed);
+}
+
+inline BLETraceScope::BLETraceScope(const char* name, const char* category)
+    : mName { name }
+    , mCategory { category }
+    , mStart { BLETrace::isEnabled() ? BLETrace::now() : 0 }
+{}
+
+inline BLETraceScope::~BLETraceScope()
+{
+    if (mStart) {
+        BLETraceEvent event;
+        event.name = mName;
+        event.category = mCategory;
+        event.timestamp = mStart;
+        event.duration = BLETrace::now() - mStart;
+        event.phase = BLETraceEvent::Complete;
+        BLETrace::record(event);
+    }
+}
+
+#define QB_TRACE_CONCAT_IMPL(a, b) a##b
+#define QB_TRACE_CONCAT(a, b) QB_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef QUICKBLUETOOTH_TRACE
+//! \brief QB_TRACE_SCOPE Records a span named \a name until the end of the enclosing scope
+#define QB_TRACE_SCOPE(name) BLETraceScope QB_TRACE_CONCAT(qbTraceScope, __LINE__)(name)
+//! \brief QB_TRACE_BEGIN Starts an operation that ends in a callback with \ref QB_TRACE_END
+#define QB_TRACE_BEGIN(name, id) \
+    do { if (BLETrace::isEnabled()) BLETrace::beginAsync(name, id); } while (false)
+//! \brief QB_TRACE_END Ends the operation started with \ref QB_TRACE_BEGIN
+#define QB_TRACE_END(name, id) \
+    do { if (BLETrace::isEnabled()) BLETrace::endAsync(name, id); } while (false)
+//! \brief QB_TRACE_INSTANT Records an event without duration
+#define QB_TRACE_INSTANT(name) \
+    do { if (BLETrace::isEnabled()) BLETrace::instant(name); } while (false)
+#else
+#define QB_TRACE_SCOPE(name) do {} while (false)
+#define QB_TRACE_BEGIN(name, id) do {} while (false)
+#define QB_TRACE_END(name, id) do {} while (false)
+#define QB_TRACE_INSTANT(name) do {} while (false)
+#endif
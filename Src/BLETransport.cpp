@@ -0,0 +1,433 @@
+#include "BLETransport.hpp"
+#include "BLEMetrics.hpp"
+#include "BLETrace.hpp"
+
+#include <QDebug>
+#include <QtMath>
+
+#include <utility>
+
+static_assert(BLEMetrics::HighQueueTime == BLEMetrics::UrgentQueueTime + BLEScheduler::HighPriority
+                  && BLEMetrics::BulkQueueTime == BLEMetrics::UrgentQueueTime + BLEScheduler::BulkPriority,
+              "BLEMetrics queue time histograms must follow BLEScheduler::Priority");
+
+#ifdef QUICKBLUETOOTH_TRACE
+namespace {
+
+//! \brief Name of the span covering a transient state, null for the states that last
+const char* stateSpan(QLowEnergyController::ControllerState state)
+{
+    switch (state) {
+    case QLowEnergyController::ConnectingState:
+        return "connect";
+    case QLowEnergyController::DiscoveringState:
+        return "discoverServices";
+    case QLowEnergyController::ClosingState:
+        return "disconnect";
+    default:
+        return nullptr;
+    }
+}
+
+} // namespace
+#endif
+
+BLETransport::BLETransport(Role role, QObject* parent)
+    : QObject{ parent }
+    , mRole { role }
+    , mState { QLowEnergyController::UnconnectedState }
+    , mEventTimer { new QTimer(this) }
+    , mBudget { EventBudget }
+    , mMetrics { nullptr }
+    , mRateTimer { new QTimer(this) }
+{
+    mRateTimer->setTimerType(Qt::PreciseTimer);
+    mRateTimer->setSingleShot(true);
+    connect(mRateTimer, &QTimer::timeout, this, &BLETransport::releaseThrottled);
+
+    mEventTimer->setTimerType(Qt::PreciseTimer);
+    mEventTimer->setInterval(DefaultEventInterval);
+    connect(mEventTimer, &QTimer::timeout, this, &BLETransport::onConnectionEvent);
+
+    //! Scheduled values are spread over the connection events
+    connect(this, &BLETransport::connectionUpdated, this,
+            [this](const QLowEnergyConnectionParameters& parameters) {
+                mEventTimer->setInterval(qMax(1, qCeil(parameters.minimumInterval())));
+            });
+
+    connect(this, &BLETransport::characteristicWritten, this,
+            [this](const QBluetoothUuid&, const QBluetoothUuid& characteristic) {
+                onWritten(characteristic);
+            });
+
+    connect(this, &BLETransport::connected, this, [this]() {
+        if (mPreferredParameters) {
+            requestConnectionUpdate(*mPreferredParameters);
+        }
+    });
+
+    //! Nothing completes after a disconnection
+    connect(this, &BLETransport::disconnected, this, [this]() {
+        for (Pacing& pacing : mPacing) {
+            pacing = Pacing();
+        }
+
+        mScheduler.clear();
+        mEventTimer->stop();
+        mBudget = EventBudget;
+
+        //! The next connection may be a different link, the rates are learned again
+        for (auto it = mThrottles.begin(); it != mThrottles.end(); ++it) {
+            it->controller.reset();
+            it->hasPending = false;
+            it->pending.clear();
+            reportRate(it.key(), *it);
+        }
+        mRateTimer->stop();
+    });
+
+#ifdef QUICKBLUETOOTH_TRACE
+    //! The GATT client operations started by the backends all complete with one of these signals,
+    //! a peripheral only notifies which is traced as an instant event
+    if (mRole == QLowEnergyController::CentralRole) {
+        connect(this, &BLETransport::serviceReady, this, [this](const QBluetoothUuid& service) {
+            QB_TRACE_END("discoverDetails", BLETrace::id(this, service));
+        });
+        connect(this, &BLETransport::descriptorWritten, this,
+                [this](const QBluetoothUuid& service, const QBluetoothUuid& characteristic) {
+                    QB_TRACE_END("writeCCCD", BLETrace::id(this, service, characteristic));
+                });
+        connect(this, &BLETransport::characteristicRead, this,
+                [this](const QBluetoothUuid& service, const QBluetoothUuid& characteristic) {
+                    QB_TRACE_END("readCharacteristic",
+                                 BLETrace::id(this, service, characteristic));
+                });
+        connect(this, &BLETransport::characteristicWritten, this,
+                [this](const QBluetoothUuid& service, const QBluetoothUuid& characteristic) {
+                    QB_TRACE_END("writeCharacteristic",
+                                 BLETrace::id(this, service, characteristic));
+                });
+    }
+#endif
+}
+
+void BLETransport::setState(ControllerState state)
+{
+    const auto previous = ControllerState(mState.exchange(int(state), std::memory_order_relaxed));
+    if (previous == state) {
+        return;
+    }
+
+#ifdef QUICKBLUETOOTH_TRACE
+    if (const char* span = stateSpan(previous)) {
+        QB_TRACE_END(span, BLETrace::id(this));
+    }
+    if (const char* span = stateSpan(state)) {
+        QB_TRACE_BEGIN(span, BLETrace::id(this));
+    }
+#endif
+
+    emit stateChanged(state);
+}
+
+void BLETransport::setPreferredConnectionParameters(
+    const std::optional<QLowEnergyConnectionParameters>& parameters)
+{
+    mPreferredParameters = parameters;
+
+    const ControllerState current = state();
+    const bool isConnected = current == QLowEnergyController::ConnectedState
+                             || current == QLowEnergyController::DiscoveringState
+                             || current == QLowEnergyController::DiscoveredState;
+
+    if (mPreferredParameters && isConnected) {
+        requestConnectionUpdate(*mPreferredParameters);
+    }
+}
+
+bool BLETransport::sendValue(const QBluetoothUuid& service,
+                             const QBluetoothUuid& characteristic,
+                             const QByteArray& value)
+{
+    auto pacing = mPacing.find(characteristic);
+    if (pacing == mPacing.end()) {
+        return transmit(service, characteristic, value);
+    }
+
+    if (pacing->inFlight) {
+        //! Only the latest value matters, it replaces the one already waiting
+        pacing->service = service;
+        pacing->pending = value;
+        pacing->hasPending = true;
+        return true;
+    }
+
+    //! Marked before writing since a backend may report the write done right away
+    pacing->inFlight = true;
+    if (!transmit(service, characteristic, value)) {
+        if (auto it = mPacing.find(characteristic); it != mPacing.end()) {
+            it->inFlight = false;
+        }
+        return false;
+    }
+    return true;
+}
+
+void BLETransport::setPaced(const QBluetoothUuid& characteristic, bool paced)
+{
+    if (paced && !confirmsWrites()) {
+        return;
+    }
+
+    if (paced) {
+        if (!mPacing.contains(characteristic)) {
+            mPacing.insert(characteristic, Pacing());
+        }
+        return;
+    }
+
+    const Pacing pacing = mPacing.take(characteristic);
+    if (pacing.hasPending) {
+        transmit(pacing.service, characteristic, pacing.pending);
+    }
+}
+
+bool BLETransport::isPaced(const QBluetoothUuid& characteristic) const
+{
+    return mPacing.contains(characteristic);
+}
+
+void BLETransport::onWritten(const QBluetoothUuid& characteristic)
+{
+    if (auto throttle = mThrottles.find(characteristic); throttle != mThrottles.end()) {
+        throttle->controller.onWritten(BLEMetrics::now());
+        reportRate(characteristic, *throttle);
+
+        //! A value may wait for this write to be reported done
+        if (throttle->hasPending) {
+            releaseThrottled();
+        }
+    }
+
+    releasePacing(characteristic);
+}
+
+void BLETransport::releasePacing(const QBluetoothUuid& characteristic)
+{
+    auto pacing = mPacing.find(characteristic);
+    if (pacing == mPacing.end()) {
+        return;
+    }
+
+    pacing->inFlight = false;
+    if (!pacing->hasPending) {
+        return;
+    }
+
+    const QBluetoothUuid service = pacing->service;
+    const QByteArray value = std::exchange(pacing->pending, QByteArray());
+    pacing->hasPending = false;
+    pacing->inFlight = true;
+    if (!transmit(service, characteristic, value)) {
+        if (auto it = mPacing.find(characteristic); it != mPacing.end()) {
+            it->inFlight = false;
+        }
+    }
+}
+
+void BLETransport::setPriority(const QBluetoothUuid& characteristic,
+                               BLEScheduler::Priority priority,
+                               int deadline)
+{
+    mScheduler.setPriority(characteristic, priority, deadline);
+}
+
+void BLETransport::setMetrics(BLEMetrics* metrics)
+{
+    mMetrics = metrics;
+}
+
+void BLETransport::setRateControlled(const QBluetoothUuid& characteristic, bool controlled)
+{
+    //! Every write of such a transport is reported done at once, the rate would only climb
+    if (controlled && !confirmsWrites()) {
+        qWarning() << "Rate control needs a transport that confirms writes, disabled for"
+                   << characteristic;
+        return;
+    }
+
+    if (controlled) {
+        if (!mThrottles.contains(characteristic)) {
+            Throttle& throttle = mThrottles[characteristic];
+            reportRate(characteristic, throttle);
+        }
+        return;
+    }
+
+    const Throttle throttle = mThrottles.take(characteristic);
+    if (throttle.hasPending) {
+        enqueue(throttle.service, characteristic, throttle.pending);
+    }
+}
+
+qreal BLETransport::sendRate(const QBluetoothUuid& characteristic) const
+{
+    auto throttle = mThrottles.constFind(characteristic);
+    return throttle != mThrottles.constEnd() ? throttle->controller.rate() : 0;
+}
+
+bool BLETransport::transmit(const QBluetoothUuid& service,
+                            const QBluetoothUuid& characteristic,
+                            const QByteArray& value)
+{
+    auto throttle = mThrottles.find(characteristic);
+    if (throttle == mThrottles.end()) {
+        return enqueue(service, characteristic, value);
+    }
+
+    //! A value already held keeps its place, the newer value replaces it
+    if (throttle->hasPending || !throttle->controller.admit(BLEMetrics::now())) {
+        throttle->service = service;
+        throttle->pending = value;
+        throttle->hasPending = true;
+        reportRate(characteristic, *throttle);
+
+        if (!mRateTimer->isActive()) {
+            releaseThrottled();
+        }
+        return true;
+    }
+
+    return enqueue(service, characteristic, value);
+}
+
+bool BLETransport::enqueue(const QBluetoothUuid& service,
+                           const QBluetoothUuid& characteristic,
+                           const QByteArray& value)
+{
+    if (mRole != QLowEnergyController::PeripheralRole || !mScheduler.isEnabled()) {
+        if (!writeCharacteristic(service, characteristic, value)) {
+            onCongestion(characteristic);
+            return false;
+        }
+        return true;
+    }
+
+    QBluetoothUuid dropped;
+    if (!mScheduler.push(service, characteristic, value, BLEMetrics::now(), &dropped)) {
+        if (mMetrics) {
+            mMetrics->increment(BLEMetrics::ScheduleDrops);
+        }
+        onCongestion(dropped);
+
+        //! A paced characteristic would wait forever for the dropped write
+        releasePacing(dropped);
+    }
+
+    flushScheduled();
+    return true;
+}
+
+void BLETransport::releaseThrottled()
+{
+    const qint64 now = BLEMetrics::now();
+    qint64 next = -1;
+
+    for (auto it = mThrottles.begin(); it != mThrottles.end(); ++it) {
+        if (!it->hasPending) {
+            continue;
+        }
+
+        if (it->controller.admit(now)) {
+            //! Taken out first since writing may report the write done right away
+            const QBluetoothUuid characteristic = it.key();
+            const QBluetoothUuid service = it->service;
+            const QByteArray value = std::exchange(it->pending, QByteArray());
+            it->hasPending = false;
+            enqueue(service, characteristic, value);
+            continue;
+        }
+
+        const qint64 wait = it->controller.nextAdmission(now);
+        if (wait >= 0 && (next < 0 || wait < next)) {
+            next = wait;
+        }
+    }
+
+    //! Values held back by outstanding writes are released by the next one reported done
+    if (next >= 0) {
+        mRateTimer->start(qMax(1, int(qCeil(qreal(next) / 1e6))));
+    }
+}
+
+void BLETransport::onCongestion(const QBluetoothUuid& characteristic)
+{
+    auto throttle = mThrottles.find(characteristic);
+    if (throttle == mThrottles.end()) {
+        return;
+    }
+
+    throttle->controller.onLost(BLEMetrics::now());
+    reportRate(characteristic, *throttle);
+}
+
+void BLETransport::reportRate(const QBluetoothUuid& characteristic, Throttle& throttle)
+{
+    const qreal rate = throttle.controller.rate();
+    if (qAbs(rate - throttle.reported) < 1) {
+        return;
+    }
+
+    throttle.reported = rate;
+    emit sendRateChanged(characteristic, rate);
+}
+
+void BLETransport::flushScheduled()
+{
+    BLEScheduler::Entry entry;
+    BLEScheduler::Priority priority;
+    while (mBudget > 0) {
+        const qint64 now = BLEMetrics::now();
+        if (!mScheduler.pop(now, entry, priority)) {
+            break;
+        }
+
+        --mBudget;
+        if (mMetrics) {
+            mMetrics->record(BLEMetrics::Histogram(BLEMetrics::UrgentQueueTime + priority),
+                             quint64(now - entry.queued));
+            if (now > entry.deadline) {
+                mMetrics->increment(BLEMetrics::MissedDeadlines);
+            }
+        }
+
+        //! A value late for its deadline means the link is too slow for the rate
+        if (now > entry.deadline && mThrottles.contains(entry.characteristic)) {
+            auto throttle = mThrottles.find(entry.characteristic);
+            throttle->controller.onCongestion(now);
+            reportRate(entry.characteristic, *throttle);
+        }
+
+        if (!writeCharacteristic(entry.service, entry.characteristic, entry.value)) {
+            onCongestion(entry.characteristic);
+
+            //! A paced characteristic would wait forever for this write
+            releasePacing(entry.characteristic);
+        }
+    }
+
+    //! The budget is refilled by the next connection event
+    if (!mEventTimer->isActive() && (mBudget < EventBudget || !mScheduler.isEmpty())) {
+        mEventTimer->start();
+    }
+}
+
+void BLETransport::onConnectionEvent()
+{
+    mBudget = EventBudget;
+    flushScheduled();
+
+    if (mScheduler.isEmpty() && mBudget == EventBudget) {
+        mEventTimer->stop();
+    }
+}
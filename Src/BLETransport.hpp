@@ -0,0 +1,413 @@
+#pragma once
+
+#include <QObject>
+#include <QBluetoothAddress>
+#include <QBluetoothUuid>
+#include <QLowEnergyAdvertisingData>
+#include <QLowEnergyAdvertisingParameters>
+#include <QLowEnergyConnectionParameters>
+#include <QLowEnergyController>
+#include <QLowEnergyServiceData>
+#include <QHash>
+#include <QTimer>
+
+#include <atomic>
+#include <optional>
+
+#include "BLERateController.hpp"
+#include "BLEScheduler.hpp"
+
+class BLEMetrics;
+
+/*!
+ * \brief The BLETransport class is the interface between a \ref BLERole and the link that carries
+ * its data. \ref BLEQtTransport implements it on top of Qt Bluetooth and \ref BLELoopbackTransport
+ * connects a central and a peripheral in the same process. Services and characteristics are
+ * addressed by their uuids so the users of a transport never deal with backend objects.
+ * \note A transport is used from the thread it lives in, except for \ref state() which can be read
+ * from any thread
+ */
+class BLETransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    using ControllerState = QLowEnergyController::ControllerState;
+    using Role = QLowEnergyController::Role;
+
+    //! \brief EventBudget Number of scheduled values written per connection event, see
+    //! \ref setPriority()
+    static constexpr int EventBudget = 4;
+
+    //! \brief DefaultEventInterval Connection interval in milliseconds assumed until the backend
+    //! reports one
+    static constexpr int DefaultEventInterval = 15;
+
+    explicit BLETransport(Role role, QObject* parent = nullptr);
+
+    /*!
+     * \brief role Returns whether this transport is the central or the peripheral end of the link
+     */
+    Role role() const;
+
+    /*!
+     * \brief state Returns the current state of the link. This is safe to call from any thread
+     */
+    ControllerState state() const;
+
+    /*!
+     * \brief errorString Returns a description of the last error
+     */
+    virtual QString errorString() const = 0;
+
+    /*!
+     * \brief localAddress Returns the address of the local end of the link
+     */
+    virtual QBluetoothAddress localAddress() const = 0;
+
+    /*!
+     * \brief remoteAddress Returns the address of the connected remote device, null when there is
+     * no connection
+     */
+    virtual QBluetoothAddress remoteAddress() const = 0;
+
+    /*!
+     * \brief mtu Returns the ATT MTU of the link, the payload of a notification is mtu - 3 bytes
+     */
+    virtual int mtu() const = 0;
+
+    /*!
+     * \brief confirmsWrites Returns true if \ref characteristicWritten() means the other end got
+     * the value. A Qt peripheral only echoes its own write, Qt doesn't report the confirmation
+     * of an indication, so pacing and rate control have nothing to wait for there
+     */
+    virtual bool confirmsWrites() const = 0;
+
+    /*!
+     * \brief connectToDevice Connects to the remote device, central only
+     */
+    virtual void connectToDevice() = 0;
+
+    /*!
+     * \brief disconnectFromDevice Disconnects from the remote device
+     */
+    virtual void disconnectFromDevice() = 0;
+
+    /*!
+     * \brief discoverServices Starts discovering the services of the remote device, \ref
+     * serviceDiscovered() is emitted for each one. Central only
+     */
+    virtual void discoverServices() = 0;
+
+    /*!
+     * \brief openService Discovers the details of a remote service, \ref serviceReady() is emitted
+     * when its characteristics can be used. Calling this more than once for a service is allowed.
+     * Central only
+     * \return False if the service is not known
+     */
+    virtual bool openService(const QBluetoothUuid& service) = 0;
+
+    /*!
+     * \brief subscribe Enables notifications of a characteristic of an open service, or
+     * indications if \a indication is true. Central only
+     */
+    virtual void subscribe(const QBluetoothUuid& service,
+                           const QBluetoothUuid& characteristic,
+                           bool indication = false) = 0;
+
+    /*!
+     * \brief addService Adds a local service, peripheral only
+     * \return False if the service can't be added
+     */
+    virtual bool addService(const QLowEnergyServiceData& service) = 0;
+
+    /*!
+     * \brief startAdvertising Starts advertising, peripheral only. While advertising, this
+     * replaces the advertised payloads and parameters
+     */
+    virtual void startAdvertising(const QLowEnergyAdvertisingParameters& parameters,
+                                  const QLowEnergyAdvertisingData& advertisingData,
+                                  const QLowEnergyAdvertisingData& scanResponseData) = 0;
+
+    /*!
+     * \brief stopAdvertising Stops advertising, peripheral only
+     */
+    virtual void stopAdvertising() = 0;
+
+    /*!
+     * \brief writeCharacteristic Writes \a value to a characteristic. For a central this writes to
+     * the remote device, for a peripheral it updates the local value and notifies subscribers
+     * \return False if the characteristic is not known
+     */
+    virtual bool writeCharacteristic(const QBluetoothUuid& service,
+                                     const QBluetoothUuid& characteristic,
+                                     const QByteArray& value) = 0;
+
+    /*!
+     * \brief readCharacteristic Reads the value of a characteristic, the result is reported by
+     * \ref characteristicRead()
+     */
+    virtual void readCharacteristic(const QBluetoothUuid& service,
+                                    const QBluetoothUuid& characteristic) = 0;
+
+    /*!
+     * \brief requestConnectionUpdate Asks the other end to change the connection parameters, the
+     * parameters in effect are reported by \ref connectionUpdated()
+     */
+    virtual void requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters) = 0;
+
+    /*!
+     * \brief setPreferredConnectionParameters Requests \a parameters now if connected and on every
+     * later connection. \a std::nullopt keeps whatever the backend picks from the next connection
+     */
+    void setPreferredConnectionParameters(
+        const std::optional<QLowEnergyConnectionParameters>& parameters);
+
+    /*!
+     * \brief sendValue Writes \a value with \ref writeCharacteristic(). For a paced
+     * characteristic only one value is in flight at a time, values sent meanwhile replace each
+     * other and the latest is written once \ref characteristicWritten() reports the previous one
+     * done. This is how indications wait for their confirmation on a transport that
+     * \ref confirmsWrites()
+     * \return False if the characteristic is not known
+     */
+    bool sendValue(const QBluetoothUuid& service,
+                   const QBluetoothUuid& characteristic,
+                   const QByteArray& value);
+
+    /*!
+     * \brief setPaced Enables or disables pacing of the values of \a characteristic, see
+     * \ref sendValue(). A value waiting when pacing is disabled is written right away. Pacing is
+     * never enabled on a transport that doesn't \ref confirmsWrites()
+     */
+    void setPaced(const QBluetoothUuid& characteristic, bool paced);
+
+    /*!
+     * \brief isPaced Returns true if the values of \a characteristic are paced
+     */
+    bool isPaced(const QBluetoothUuid& characteristic) const;
+
+    /*!
+     * \brief setPriority Puts \a characteristic in a priority class of the \ref BLEScheduler,
+     * peripheral only. Once a characteristic has a priority the values sent by \ref sendValue()
+     * are queued, at most \ref EventBudget of them are written per connection event and the
+     * others wait in the order of the scheduler. Characteristics without a priority are
+     * \ref BLEScheduler::NormalPriority then
+     * \param deadline Time in milliseconds a value may wait, 0 for the default of the class
+     */
+    void setPriority(const QBluetoothUuid& characteristic,
+                     BLEScheduler::Priority priority,
+                     int deadline = 0);
+
+    /*!
+     * \brief setRateControlled Enables or disables adapting the rate of the values of
+     * \a characteristic to the link, peripheral only. Values sent faster than the
+     * \ref BLERateController admits replace each other and the latest is written once admitted.
+     * A value waiting when rate control is disabled is written right away. Rate control is never
+     * enabled on a transport that doesn't \ref confirmsWrites()
+     */
+    void setRateControlled(const QBluetoothUuid& characteristic, bool controlled);
+
+    /*!
+     * \brief sendRate Returns the values per second admitted for \a characteristic, 0 if it's not
+     * rate controlled
+     */
+    qreal sendRate(const QBluetoothUuid& characteristic) const;
+
+    /*!
+     * \brief setMetrics Sets the metrics that the time values wait in the scheduler is recorded
+     * to, may be null
+     */
+    void setMetrics(BLEMetrics* metrics);
+
+protected:
+    /*!
+     * \brief setState Updates the state and emits \ref stateChanged() if it's changed
+     * \param state
+     */
+    void setState(ControllerState state);
+
+signals:
+    void stateChanged(QLowEnergyController::ControllerState state);
+    void connected();
+    void disconnected();
+    void errorOccurred(QLowEnergyController::Error error);
+
+    /*!
+     * \brief serviceDiscovered Emitted for each service found by \ref discoverServices()
+     */
+    void serviceDiscovered(const QBluetoothUuid& service);
+
+    /*!
+     * \brief serviceReady Emitted when the details of a service opened by \ref openService() are
+     * discovered
+     */
+    void serviceReady(const QBluetoothUuid& service);
+
+    /*!
+     * \brief characteristicChanged Emitted when the other end of the link changes the value of a
+     * characteristic, ie a notification for a central or a write for a peripheral
+     */
+    void characteristicChanged(const QBluetoothUuid& service,
+                               const QBluetoothUuid& characteristic,
+                               const QByteArray& value);
+
+    /*!
+     * \brief characteristicRead Emitted with the result of \ref readCharacteristic()
+     */
+    void characteristicRead(const QBluetoothUuid& service,
+                            const QBluetoothUuid& characteristic,
+                            const QByteArray& value);
+
+    /*!
+     * \brief characteristicWritten Emitted when a \ref writeCharacteristic() is done
+     */
+    void characteristicWritten(const QBluetoothUuid& service,
+                               const QBluetoothUuid& characteristic,
+                               const QByteArray& value);
+
+    /*!
+     * \brief descriptorWritten Emitted when a descriptor is written, for a peripheral this is the
+     * remote device writing it, eg to enable notifications
+     */
+    void descriptorWritten(const QBluetoothUuid& service,
+                           const QBluetoothUuid& characteristic,
+                           const QBluetoothUuid& descriptor,
+                           const QByteArray& value);
+
+    /*!
+     * \brief connectionUpdated Emitted when the connection parameters change, the interval in
+     * effect is both the minimum and maximum interval of \a parameters
+     */
+    void connectionUpdated(const QLowEnergyConnectionParameters& parameters);
+
+    /*!
+     * \brief sendRateChanged Emitted when the rate admitted for a rate controlled characteristic
+     * changed by at least one value per second
+     */
+    void sendRateChanged(const QBluetoothUuid& characteristic, qreal rate);
+
+private:
+    /*!
+     * \brief The Pacing struct is the state of a paced characteristic
+     */
+    struct Pacing
+    {
+        bool inFlight = false;
+        bool hasPending = false;
+        QBluetoothUuid service;
+        QByteArray pending;
+    };
+
+    /*!
+     * \brief The Throttle struct is the state of a rate controlled characteristic
+     */
+    struct Throttle
+    {
+        BLERateController controller;
+        bool hasPending = false;
+        QBluetoothUuid service;
+        QByteArray pending;
+
+        //! \brief reported The rate last reported by \ref sendRateChanged()
+        qreal reported = 0;
+    };
+
+    /*!
+     * \brief onWritten Sends the value waiting for \a characteristic if it's paced
+     */
+    void onWritten(const QBluetoothUuid& characteristic);
+
+    /*!
+     * \brief releasePacing Ends the write in flight of \a characteristic if it's paced, written
+     * or lost, and sends the value waiting for it
+     */
+    void releasePacing(const QBluetoothUuid& characteristic);
+
+    /*!
+     * \brief transmit Writes \a value once its rate controller admits it, see \ref enqueue()
+     * \return False if the characteristic is not known
+     */
+    bool transmit(const QBluetoothUuid& service,
+                  const QBluetoothUuid& characteristic,
+                  const QByteArray& value);
+
+    /*!
+     * \brief enqueue Writes \a value, or queues it in \ref mScheduler if it's enabled
+     * \return False if the characteristic is not known
+     */
+    bool enqueue(const QBluetoothUuid& service,
+                 const QBluetoothUuid& characteristic,
+                 const QByteArray& value);
+
+    /*!
+     * \brief releaseThrottled Sends the values held by their rate controllers that are admitted
+     * now and waits for the next one
+     */
+    void releaseThrottled();
+
+    /*!
+     * \brief onCongestion Tells the rate controller of \a characteristic, if any, that a value
+     * of it was refused or dropped
+     */
+    void onCongestion(const QBluetoothUuid& characteristic);
+
+    /*!
+     * \brief reportRate Emits \ref sendRateChanged() if the rate of \a throttle moved enough
+     */
+    void reportRate(const QBluetoothUuid& characteristic, Throttle& throttle);
+
+    /*!
+     * \brief flushScheduled Writes the values of \ref mScheduler in order while the budget of the
+     * current connection event lasts
+     */
+    void flushScheduled();
+
+    /*!
+     * \brief onConnectionEvent Refills the budget at the start of a connection event
+     */
+    void onConnectionEvent();
+
+private:
+    //! \brief mRole Central or peripheral
+    const Role mRole;
+
+    //! \brief mPreferredParameters Requested on every connection, only used on the transport's
+    //! thread
+    std::optional<QLowEnergyConnectionParameters> mPreferredParameters;
+
+    //! \brief mPacing Paced characteristics, only used on the transport's thread
+    QHash<QBluetoothUuid, Pacing> mPacing;
+
+    //! \brief mState The state of the link, written from the transport's thread only
+    std::atomic<int> mState;
+
+    //! \brief mScheduler Orders the values sent by priority, only used on the transport's thread
+    BLEScheduler mScheduler;
+
+    //! \brief mEventTimer Ticks every connection interval while values are scheduled
+    QTimer* mEventTimer;
+
+    //! \brief mBudget Number of values that may still be written in this connection event
+    int mBudget;
+
+    //! \brief mMetrics Records the time values wait in the scheduler, may be null
+    BLEMetrics* mMetrics;
+
+    //! \brief mThrottles Rate controlled characteristics, only used on the transport's thread
+    QHash<QBluetoothUuid, Throttle> mThrottles;
+
+    //! \brief mRateTimer Fires when the next value held by a rate controller is admitted
+    QTimer* mRateTimer;
+};
+
+
+inline BLETransport::Role BLETransport::role() const
+{
+    return mRole;
+}
+
+inline BLETransport::ControllerState BLETransport::state() const
+{
+    return ControllerState(mState.load(std::memory_order_relaxed));
+}
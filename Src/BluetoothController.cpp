@@ -4,14 +4,14 @@
 #include <QBluetoothLocalDevice>
 #include <QBluetoothPermission>
 
+#include "BLEIOThread.hpp"
+
+#include <mutex>
+#include <utility>
+
 //! \brief Initialize the single instance
 BluetoothController* BluetoothController::sInstance = nullptr;
 
-BluetoothController* BluetoothController::create(QQmlEngine *qmlEngine, QJSEngine *jsEngine)
-{
-    return &instance();
-}
-
 BluetoothController &BluetoothController::instance()
 {
     if (!sInstance) {
@@ -24,9 +24,24 @@ BluetoothController &BluetoothController::instance()
 BluetoothController::BluetoothController(QObject *parent)
     : QObject{ parent }
     , mDevice { nullptr }
+    , mHostMode { HostMode::HostPoweredOff }
 {
     //! If permission is Undetermined request for it
     mPermission = qApp->checkPermission(QBluetoothPermission());
+
+    //! Callbacks are called through std::function<void (bool)>, callbacks that don't take the
+    //! result are called either way. The QML module adds the converter of JS functions
+    static std::once_flag registered;
+    std::call_once(registered, []() {
+        QMetaType::registerConverter<std::function<void ()>, std::function<void (bool)>>(
+            [](const std::function<void ()>& cb) {
+                return std::function<void (bool)>([cb](bool) {
+                    if (cb) {
+                        cb();
+                    }
+                });
+            });
+    });
 }
 
 void BluetoothController::initialize(QVariant callback)
@@ -39,16 +54,45 @@ void BluetoothController::initialize(QVariant callback)
     }
 
     if (mPermission == Qt::PermissionStatus::Granted) {
-        //! Note if bluetooth permission is not granted host info and bluetooth device will be null
-        if (QBluetoothLocalDevice::allDevices().length() == 0) {
-            qWarning() << "There is no bluetooth on the device.";
-        } else {
-            setHostInfo(QBluetoothLocalDevice::allDevices().at(0));
-            getDefaultDevice();
+        //! The callback waits on this thread until the device is created, see getDefaultDevice()
+        if (callback.isValid()) {
+            mReadyCallbacks.append(callback);
         }
+        return refreshAdapters();
     }
 
-    callVariantCallback(callback);
+    //! Note if bluetooth permission is not granted host info and bluetooth device will be null
+    qWarning() << "Bluetooth permission is not granted, the controller is not ready";
+    callVariantCallback(callback, false);
+}
+
+void BluetoothController::refreshAdapters()
+{
+    //! Enumerating the adapters is a blocking round trip to the bluetooth daemon on some
+    //! platforms, so it runs on the I/O thread and the result is applied on this thread
+    BLEIOThread::instance().post([this]() {
+        const QList<QBluetoothHostInfo> devices = QBluetoothLocalDevice::allDevices();
+
+        QMetaObject::invokeMethod(this, [this, devices]() {
+            setAdapters(devices);
+
+            if (devices.isEmpty()) {
+                qWarning() << "There is no bluetooth on the device.";
+
+                //! The controller can't get ready, the callbacks are told so
+                callReadyCallbacks(false);
+                return;
+            }
+
+            setHostInfo(devices.at(0));
+            getDefaultDevice();
+
+            //! The device of the same adapter already exists, otherwise it calls the callbacks
+            if (isReady()) {
+                callReadyCallbacks(true);
+            }
+        }, Qt::QueuedConnection);
+    });
 }
 
 QString BluetoothController::name() const
@@ -56,6 +100,68 @@ QString BluetoothController::name() const
     return mHostInfo.name();
 }
 
+QStringList BluetoothController::adapters() const
+{
+    QStringList addresses;
+    addresses.reserve(mAdapters.size());
+    for (const QBluetoothHostInfo& adapter : mAdapters) {
+        addresses.append(adapter.address().toString());
+    }
+
+    return addresses;
+}
+
+QBluetoothAddress BluetoothController::acquireAdapter()
+{
+    //! With a single adapter the backend's default is the same and works on every platform
+    if (mAdapters.size() < 2) {
+        return QBluetoothAddress();
+    }
+
+    qsizetype least = 0;
+    for (qsizetype i = 1; i < mAdapterLoads.size(); ++i) {
+        if (mAdapterLoads[i] < mAdapterLoads[least]) {
+            least = i;
+        }
+    }
+
+    ++mAdapterLoads[least];
+    return mAdapters[least].address();
+}
+
+void BluetoothController::releaseAdapter(const QBluetoothAddress& adapter)
+{
+    if (adapter.isNull()) {
+        return;
+    }
+
+    for (qsizetype i = 0; i < mAdapters.size(); ++i) {
+        if (mAdapters[i].address() == adapter) {
+            mAdapterLoads[i] = qMax(0, mAdapterLoads[i] - 1);
+            return;
+        }
+    }
+}
+
+void BluetoothController::setAdapters(const QList<QBluetoothHostInfo>& adapters)
+{
+    if (mAdapters == adapters) {
+        return;
+    }
+
+    QList<int> loads(adapters.size(), 0);
+    for (qsizetype i = 0; i < adapters.size(); ++i) {
+        const qsizetype old = mAdapters.indexOf(adapters[i]);
+        if (old >= 0) {
+            loads[i] = mAdapterLoads[old];
+        }
+    }
+
+    mAdapters = adapters;
+    mAdapterLoads = loads;
+    emit adaptersChanged();
+}
+
 void BluetoothController::setPermission(Permission permission)
 {
     if (mPermission == permission) {
@@ -72,8 +178,10 @@ void BluetoothController::setBluetoothMode(HostMode mode)
         return;
     }
 
-    mDevice->setHostMode(QBluetoothLocalDevice::HostMode(mode));
-    emit bluetoothModeChanged();
+    //! The cached mode is updated when the device reports the change
+    BLEIOThread::instance().post([device = mDevice, mode]() {
+        device->setHostMode(QBluetoothLocalDevice::HostMode(mode));
+    });
 }
 
 void BluetoothController::requestPermission(std::function<void ()> cb)
@@ -98,22 +206,27 @@ void BluetoothController::powerOn(QVariant callback)
         if (bluetoothMode() != BluetoothController::HostPoweredOff) {
             //! Already on
             qDebug() << "Already on";
-            callVariantCallback(callback);
+            callVariantCallback(callback, true);
             return;
         }
 
         //! Make sure the callback is called when devices turns on
         setupCallbackForPowerOn(callback);
-        mDevice->powerOn();
+        BLEIOThread::instance().post([device = mDevice]() {
+            device->powerOn();
+        });
     } else {
         qWarning() << "Bluetooth controller is not ready";
+        callVariantCallback(callback, false);
     }
 }
 
 void BluetoothController::powerOff()
 {
     if (isReady()) {
-        mDevice->setHostMode(QBluetoothLocalDevice::HostPoweredOff);
+        BLEIOThread::instance().post([device = mDevice]() {
+            device->setHostMode(QBluetoothLocalDevice::HostPoweredOff);
+        });
     } else {
         qWarning() << "Bluetooth controller is not ready";
     }
@@ -133,45 +246,79 @@ void BluetoothController::setHostInfo(const QBluetoothHostInfo& bh)
 
 void BluetoothController::getDefaultDevice()
 {
+    //! The device is only created again when the default adapter changed
+    const QBluetoothAddress address = mHostInfo.address();
+    if (mDevice && mDeviceAddress == address) {
+        return;
+    }
+
     if (mDevice) {
-        delete mDevice;
+        mDevice->disconnect(this);
+        mDevice->deleteLater();
+        mDevice = nullptr;
     }
+    mDeviceAddress = address;
 
-    mDevice = new QBluetoothLocalDevice();
-    emit bluetoothModeChanged();
+    //! The device lives on the I/O thread since creating it and querying its mode block as well
+    BLEIOThread::instance().post([this, address]() {
+        QBluetoothLocalDevice* device = new QBluetoothLocalDevice(address);
+        const HostMode mode = HostMode(device->hostMode());
 
-    connect(mDevice, &QBluetoothLocalDevice::hostModeStateChanged, this,
-            &BluetoothController::bluetoothModeChanged);
+        QMetaObject::invokeMethod(this, [this, device, address, mode]() {
+            if (mDeviceAddress != address) {
+                device->deleteLater();
+                return;
+            }
+
+            mDevice = device;
+            connect(mDevice, &QBluetoothLocalDevice::hostModeStateChanged, this,
+                    [this](QBluetoothLocalDevice::HostMode mode) {
+                        setHostMode(HostMode(mode));
+
+                        //! Adapters may come and go with their power, the list is refreshed
+                        refreshAdapters();
+                    });
+
+            setHostMode(mode);
+            emit isReadyChanged();
+            callReadyCallbacks(true);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void BluetoothController::setHostMode(HostMode mode)
+{
+    if (mHostMode == mode) {
+        return;
+    }
+
+    mHostMode = mode;
+    emit bluetoothModeChanged();
 }
 
 void BluetoothController::setupCallbackForPowerOn(QVariant callback)
 {
     connect(mDevice, &QBluetoothLocalDevice::hostModeStateChanged, this,
-            std::bind(&BluetoothController::callVariantCallback, this, callback),
+            std::bind(&BluetoothController::callVariantCallback, this, callback, true),
             Qt::SingleShotConnection);
 }
 
-void BluetoothController::callVariantCallback(QVariant callback)
+void BluetoothController::callReadyCallbacks(bool ready)
 {
-    if (callback.canConvert<std::function<void ()>>()) {
-        callback.value<std::function<void ()>>()();
-    } else if (callback.canConvert<QJSValue>()) {
-        callJsCallback(callback.value<QJSValue>());
+    //! A callback may call initialize() again, which queues a new callback
+    const QVariantList callbacks = std::exchange(mReadyCallbacks, QVariantList());
+    for (const QVariant& callback : callbacks) {
+        callVariantCallback(callback, ready);
     }
 }
 
-void BluetoothController::callJsCallback(QJSValue cb)
+void BluetoothController::callVariantCallback(QVariant callback, bool success)
 {
-    if (!cb.isCallable()) {
-        return;
-    }
-
-    QJSValue result = cb.call();
-
-    if (result.isError()) {
-        qDebug("%s:%s: %s",
-               qPrintable(result.property("fileName").toString()),
-               qPrintable(result.property("lineNumber").toString()),
-               qPrintable(result.toString().toStdString().c_str()));
+    //! JS functions are converted by the QML module, see QuickBluetoothQml
+    if (callback.canConvert<std::function<void (bool)>>()) {
+        const auto cb = callback.value<std::function<void (bool)>>();
+        if (cb) {
+            cb(success);
+        }
     }
 }
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <QObject>
-#include <QQmlEngine>
+#include <QStringList>
+#include <QVariant>
 
 #include <QBluetoothHostInfo>
 #include <QBluetoothLocalDevice>
 
+#include <functional>
+
 //! \brief Aliasing Qt::PermissionStatus
 using Permission = Qt::PermissionStatus;
 
@@ -16,11 +19,10 @@ using Permission = Qt::PermissionStatus;
 class BluetoothController : public QObject
 {
     Q_OBJECT
-    QML_ELEMENT
-    QML_SINGLETON
 
     Q_PROPERTY(bool bluetoothAvailable READ bluetoothAvailable NOTIFY bluetoothAvailableChanged)
     Q_PROPERTY(QString name READ name NOTIFY nameChanged)
+    Q_PROPERTY(QStringList adapters READ adapters NOTIFY adaptersChanged)
 
     Q_PROPERTY(HostMode bluetoothMode READ bluetoothMode NOTIFY bluetoothModeChanged)
     Q_PROPERTY(Permission permission READ permission NOTIFY permissionChanged)
@@ -39,15 +41,6 @@ public:
     };
     Q_ENUM(HostMode);
 
-    /*!
-     * \brief create Custom factory method for QML to make sure both QML and C++ accesses the same
-     * instance
-     * \param qmlEngine
-     * \param jsEngine
-     * \return
-     */
-    static BluetoothController* create(QQmlEngine* qmlEngine, QJSEngine* jsEngine);
-
     /*!
      * \brief instance Returns the singleton instance of this class. This is here for use in C++
      * \return
@@ -57,8 +50,10 @@ public:
     /*!
      * \brief initialize Initializes bluetooth related properties, fetches required permissions.
      * This method must be called before accessing any bluetooth permission on Android.
-     * \param Callback Can hold a callable (either JS callable or C++ std::function) to be called
-     * when initialization is finished
+     * \param Callback Can hold a callable (a \a std::function<void(bool)>, a
+     * \a std::function<void()> or a JS function once the QML module is loaded). It's called with
+     * true once \ref isReady is true, or with false if the permission is denied or there is no
+     * adapter
      */
     Q_INVOKABLE void initialize(QVariant callback = QVariant());
 
@@ -68,6 +63,33 @@ public:
      */
     QString name() const;
 
+    /*!
+     * \brief adapters Returns the addresses of every local bluetooth adapter, the first one is the
+     * default adapter whose \ref name is shown
+     * \return
+     */
+    QStringList adapters() const;
+
+    /*!
+     * \brief hostInfos Returns the info of every local bluetooth adapter
+     * \return
+     */
+    const QList<QBluetoothHostInfo>& hostInfos() const;
+
+    /*!
+     * \brief acquireAdapter Returns the adapter with the least connections placed on it and counts
+     * one more connection on it. A null address means the backend picks the adapter, ie there is
+     * at most one. Must be called on the thread of this object
+     * \return
+     */
+    QBluetoothAddress acquireAdapter();
+
+    /*!
+     * \brief releaseAdapter Counts one connection less on \a adapter, see \ref acquireAdapter()
+     * \param adapter
+     */
+    void releaseAdapter(const QBluetoothAddress& adapter);
+
     /*!
      * \brief Getter to check if host has bluetooth
      * \return
@@ -107,7 +129,8 @@ public:
 
     /*!
      * \brief powerOn
-     * \param callback Can hold a callable to be called after bluetooth is successfully turned on
+     * \param callback Can hold a callable, see \ref initialize(). It's called with true once
+     * bluetooth is turned on, or with false if the controller is not ready
      */
     Q_INVOKABLE void powerOn(QVariant callback = QVariant());
 
@@ -131,11 +154,23 @@ private:
     void setHostInfo(const QBluetoothHostInfo& bh);
 
     /*!
-     * \brief getDefaultDevice
-     * \param bld
+     * \brief refreshAdapters Enumerates the local adapters on \ref BLEIOThread and applies them on
+     * this thread
+     */
+    void refreshAdapters();
+
+    /*!
+     * \brief getDefaultDevice Creates the local device of the default adapter on \ref BLEIOThread,
+     * unless it already exists
      */
     void getDefaultDevice();
 
+    /*!
+     * \brief setHostMode Sets the cached mode of the default adapter
+     * \param mode
+     */
+    void setHostMode(HostMode mode);
+
     /*!
      * \brief setupCallbackForPowerOn
      * \param callback
@@ -143,21 +178,32 @@ private:
     void setupCallbackForPowerOn(QVariant callback);
 
     /*!
-     * \brief callVariantCallback
+     * \brief callReadyCallbacks Calls the callbacks of \ref initialize() that wait for the device
+     * with \a ready
+     */
+    void callReadyCallbacks(bool ready);
+
+    /*!
+     * \brief callVariantCallback Calls \a callback with \a success if it holds a callable
      * \param callback
+     * \param success
      */
-    void callVariantCallback(QVariant callback);
+    void callVariantCallback(QVariant callback, bool success);
 
+private slots:
     /*!
-     * \brief callJsCallback
+     * \brief setAdapters Sets the local adapters, the connections counted on the adapters that are
+     * still there are kept
+     * \param adapters
      */
-    void callJsCallback(QJSValue cb);
+    void setAdapters(const QList<QBluetoothHostInfo>& adapters);
 
 signals:
     void error(const QString& error);
 
     void bluetoothAvailableChanged();
     void nameChanged();
+    void adaptersChanged();
     void isReadyChanged();
     void permissionChanged();
     void bluetoothModeChanged();
@@ -166,12 +212,28 @@ private:
     //! \brief The single instance of this class
     static BluetoothController* sInstance;
 
-    //! \brief mDevice The instance related to this local device
+    //! \brief mDevice The instance related to this local device, it lives on \ref BLEIOThread
     QBluetoothLocalDevice* mDevice;
 
+    //! \brief mDeviceAddress The adapter address \ref mDevice is created for
+    QBluetoothAddress mDeviceAddress;
+
+    //! \brief mHostMode The mode of \ref mDevice, kept up to date by its notifications
+    HostMode mHostMode;
+
     //! \brief The info of the host bluetooth device
     QBluetoothHostInfo mHostInfo;
 
+    //! \brief mAdapters The info of every local adapter
+    QList<QBluetoothHostInfo> mAdapters;
+
+    //! \brief mAdapterLoads The number of connections placed on each of \ref mAdapters
+    QList<int> mAdapterLoads;
+
+    //! \brief mReadyCallbacks Callbacks of \ref initialize() waiting for \ref mDevice. They
+    //! only ever live on the thread of this object, a JS function can't be copied on another
+    QVariantList mReadyCallbacks;
+
     //! \brief mPermission The permission permission of the bluetooth
     Permission mPermission;
 };
@@ -182,6 +244,11 @@ inline bool BluetoothController::bluetoothAvailable() const
     return !mHostInfo.address().isNull();
 }
 
+inline const QList<QBluetoothHostInfo>& BluetoothController::hostInfos() const
+{
+    return mAdapters;
+}
+
 inline Permission BluetoothController::permission() const
 {
     return mPermission;
@@ -194,6 +261,5 @@ inline bool BluetoothController::isReady() const
 
 inline BluetoothController::HostMode BluetoothController::bluetoothMode() const
 {
-    return HostMode(mDevice ? mDevice->hostMode()
-                            : QBluetoothLocalDevice::HostMode::HostPoweredOff);
+    return mDevice ? mHostMode : HostMode::HostPoweredOff;
 }
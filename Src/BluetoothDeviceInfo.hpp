@@ -1,7 +1,6 @@
 #pragma once
 
 #include <QObject>
-#include <QQmlEngine>
 #include <QBluetoothDeviceInfo>
 #include <QBluetoothAddress>
 
@@ -11,8 +10,6 @@
 class BluetoothDeviceInfo : public QObject
 {
     Q_OBJECT
-    QML_ELEMENT
-    QML_UNCREATABLE("BluetoothDeviceInfo can only be created from C++")
 
     Q_PROPERTY(QString name READ name NOTIFY deviceChanged);
     Q_PROPERTY(QString address READ address NOTIFY deviceChanged);
@@ -1,44 +1,98 @@
 #include "BluetoothDiscovery.hpp"
+#include "BluetoothController.hpp"
 #include "BluetoothDeviceInfo.hpp"
+#include "BLESessionRecorder.hpp"
+#include "BLEBroadcastFormat.hpp"
+#include "BLEBroadcastValue.hpp"
 
 BluetoothDiscovery::BluetoothDiscovery(QObject *parent)
     : QObject{parent}
-    , mDevDiscovery { new QBluetoothDeviceDiscoveryAgent(this) }
+    , mRunningAgents { 0 }
+    , mTimeOut { 20000 }
     , mDiscoveryMethods { QBluetoothDeviceDiscoveryAgent::ClassicMethod }
     , mDeviceCoreConfig { QBluetoothDeviceInfo::CoreConfiguration::BaseRateCoreConfiguration }
     , mIsActive { false }
-{
-    mDevDiscovery->setLowEnergyDiscoveryTimeout(20000);
-
-    connect(mDevDiscovery, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered, this,
-            &BluetoothDiscovery::addDevice);
-
-    connect(mDevDiscovery, &QBluetoothDeviceDiscoveryAgent::finished, this, [&]() {
-        setIsActive(false);
-    });
-    connect(mDevDiscovery, &QBluetoothDeviceDiscoveryAgent::canceled, this, [&]() {
-        setIsActive(false);
-    });
-    connect(mDevDiscovery, &QBluetoothDeviceDiscoveryAgent::errorOccurred, this,
-            &BluetoothDiscovery::errorOccurred);
-}
+    , mMetrics { new BLEMetrics(this) }
+    , mObserve { false }
+    , mBroadcastCompanyId { BLEBroadcastFormat::DefaultCompanyId }
+{}
 
 void BluetoothDiscovery::start()
 {
     //! First clear current devices
     qDeleteAll(mDevices);
     mDevices.clear();
+    mDeviceIndex.clear();
     emit devicesChanged();
 
-    mDevDiscovery->start(
-        QBluetoothDeviceDiscoveryAgent::DiscoveryMethods::fromInt(mDiscoveryMethods));
+    if (!mBroadcastValues.isEmpty()) {
+        qDeleteAll(mBroadcastValues);
+        mBroadcastValues.clear();
+        mBroadcastIndex.clear();
+        emit broadcastValuesChanged();
+    }
+    mBroadcastSequences.clear();
+
+    createAgents();
+
+    //! Counted before starting since an agent may fail right away
+    mRunningAgents = int(mAgents.size());
     setIsActive(true);
+
+    for (QBluetoothDeviceDiscoveryAgent* agent : std::as_const(mAgents)) {
+        agent->start(QBluetoothDeviceDiscoveryAgent::DiscoveryMethods::fromInt(mDiscoveryMethods));
+    }
 }
 
 void BluetoothDiscovery::stop()
 {
-    if (mDevDiscovery->isActive()) {
-        mDevDiscovery->stop();
+    for (QBluetoothDeviceDiscoveryAgent* agent : std::as_const(mAgents)) {
+        if (agent->isActive()) {
+            agent->stop();
+        }
+    }
+}
+
+void BluetoothDiscovery::createAgents()
+{
+    const QList<QBluetoothHostInfo>& adapters = BluetoothController::instance().hostInfos();
+
+    QStringList addresses;
+    for (const QBluetoothHostInfo& adapter : adapters) {
+        addresses.append(adapter.address().toString());
+    }
+
+    if (!mAgents.isEmpty() && mAgentAdapters == addresses) {
+        return;
+    }
+
+    qDeleteAll(mAgents);
+    mAgents.clear();
+    mAgentAdapters = addresses;
+
+    //! A single adapter is left to the backend's default, it works on every platform
+    if (adapters.size() < 2) {
+        mAgents.append(new QBluetoothDeviceDiscoveryAgent(this));
+    } else {
+        for (const QBluetoothHostInfo& adapter : adapters) {
+            mAgents.append(new QBluetoothDeviceDiscoveryAgent(adapter.address(), this));
+        }
+    }
+
+    for (QBluetoothDeviceDiscoveryAgent* agent : std::as_const(mAgents)) {
+        agent->setLowEnergyDiscoveryTimeout(mTimeOut);
+
+        connect(agent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered, this,
+                &BluetoothDiscovery::addDevice);
+        connect(agent, &QBluetoothDeviceDiscoveryAgent::deviceUpdated, this,
+                &BluetoothDiscovery::updateDevice);
+
+        connect(agent, &QBluetoothDeviceDiscoveryAgent::finished, this,
+                &BluetoothDiscovery::agentStopped);
+        connect(agent, &QBluetoothDeviceDiscoveryAgent::canceled, this,
+                &BluetoothDiscovery::agentStopped);
+        connect(agent, &QBluetoothDeviceDiscoveryAgent::errorOccurred, this,
+                &BluetoothDiscovery::errorOccurred);
     }
 }
 
@@ -80,42 +134,141 @@ void BluetoothDiscovery::setIsActive(bool isActive)
 
 void BluetoothDiscovery::setTimeOut(int timeout)
 {
-    if (!mDevDiscovery) {
+    if (mTimeOut == timeout) {
+        return;
+    }
+
+    mTimeOut = timeout;
+    for (QBluetoothDeviceDiscoveryAgent* agent : std::as_const(mAgents)) {
+        agent->setLowEnergyDiscoveryTimeout(timeout);
+    }
+    emit timeOutChanged();
+}
+
+void BluetoothDiscovery::setObserve(bool observe)
+{
+    if (mObserve == observe) {
         return;
     }
 
-    if (mDevDiscovery->lowEnergyDiscoveryTimeout() == timeout) {
+    mObserve = observe;
+    emit observeChanged();
+}
+
+void BluetoothDiscovery::setBroadcastCompanyId(int companyId)
+{
+    if (mBroadcastCompanyId == companyId || companyId < 0 || companyId > 0xFFFF) {
         return;
     }
 
-    mDevDiscovery->setLowEnergyDiscoveryTimeout(timeout);
-    emit timeOutChanged();
+    mBroadcastCompanyId = companyId;
+    mBroadcastSequences.clear();
+    emit broadcastCompanyIdChanged();
+}
+
+BLEBroadcastValue* BluetoothDiscovery::broadcastValue(const QString& address,
+                                                      quint32 characterUuid) const
+{
+    const quint64 key = (QBluetoothAddress(address).toUInt64() << 16) | quint16(characterUuid);
+    return mBroadcastIndex.value(key);
 }
 
 void BluetoothDiscovery::addDevice(const QBluetoothDeviceInfo& dev)
 {
+    mMetrics->increment(BLEMetrics::DiscoveryReports);
+    BLESessionRecorder::recordAdvertisement(dev);
 
-    if (dev.coreConfigurations() & mDeviceCoreConfig) {
-        //! Check if it already exist
-        auto iter = std::find_if(mDevices.begin(), mDevices.end(), [&dev](BluetoothDeviceInfo* bd) {
-            return bd->address() == dev.address().toString();
-        });
+    if (mObserve) {
+        observeBroadcast(dev);
+    }
 
-        if (iter == mDevices.end()) {
+    if (dev.coreConfigurations() & mDeviceCoreConfig) {
+        //! Check if it already exist, every adapter reports the devices near it
+        const quint64 address = dev.address().toUInt64();
+        if (BluetoothDeviceInfo* existing = mDeviceIndex.value(address)) {
+            //! Modify existing one
+            existing->setDevice(dev);
+        } else {
             //! Create a new instance
-            mDevices.append(new BluetoothDeviceInfo(dev, this));
+            BluetoothDeviceInfo* device = new BluetoothDeviceInfo(dev, this);
+            mDevices.append(device);
+            mDeviceIndex.insert(address, device);
+            mMetrics->increment(BLEMetrics::DiscoveredDevices);
 
             emit devicesChanged();
-        } else {
-            //! Modify existing one
-            (*iter)->setDevice(dev);
         }
     }
 }
 
+void BluetoothDiscovery::updateDevice(const QBluetoothDeviceInfo& dev,
+                                      QBluetoothDeviceInfo::Fields fields)
+{
+    //! Only broadcast values are followed after a device is discovered
+    if (!mObserve || !(fields & QBluetoothDeviceInfo::Field::ManufacturerData)) {
+        return;
+    }
+
+    mMetrics->increment(BLEMetrics::DiscoveryReports);
+    BLESessionRecorder::recordAdvertisement(dev);
+
+    observeBroadcast(dev);
+}
+
+void BluetoothDiscovery::observeBroadcast(const QBluetoothDeviceInfo& dev)
+{
+    const QByteArray data = dev.manufacturerData(quint16(mBroadcastCompanyId));
+    const int sequence = BLEBroadcastFormat::sequence(data);
+    if (sequence < 0) {
+        return;
+    }
+
+    //! Repeated advertisements of the same values are skipped before decoding
+    const quint64 address = dev.address().toUInt64();
+    auto last = mBroadcastSequences.find(address);
+    if (last != mBroadcastSequences.end() && *last == sequence) {
+        return;
+    }
+
+    QList<BLEBroadcastFormat::Entry> entries;
+    if (!BLEBroadcastFormat::decode(data, entries)) {
+        return;
+    }
+    mBroadcastSequences.insert(address, quint8(sequence));
+
+    bool added = false;
+    for (const BLEBroadcastFormat::Entry& entry : std::as_const(entries)) {
+        const quint64 key = (address << 16) | entry.characteristic;
+
+        BLEBroadcastValue* value = mBroadcastIndex.value(key);
+        if (!value) {
+            value = new BLEBroadcastValue(dev.address(), entry.characteristic, this);
+            mBroadcastIndex.insert(key, value);
+            mBroadcastValues.append(value);
+            added = true;
+        }
+
+        value->setName(dev.name());
+        value->setRssi(dev.rssi());
+        value->setValue(BLEDataService::DataType(entry.type), entry.value);
+    }
+
+    if (added) {
+        emit broadcastValuesChanged();
+    }
+}
+
+void BluetoothDiscovery::agentStopped()
+{
+    if (mRunningAgents > 0 && --mRunningAgents == 0) {
+        setIsActive(false);
+    }
+}
+
 void BluetoothDiscovery::errorOccurred(QBluetoothDeviceDiscoveryAgent::Error error)
 {
-    setIsActive(false);
+    //! The other adapters keep searching
+    agentStopped();
+    mMetrics->increment(BLEMetrics::Errors);
 
     qWarning() << Q_FUNC_INFO << " Error: " << error;
 }
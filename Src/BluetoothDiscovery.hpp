@@ -1,24 +1,33 @@
 #pragma once
 
 #include <QObject>
-#include <QQmlEngine>
+#include <QStringList>
 #include <QBluetoothDeviceDiscoveryAgent>
 
+#include "BLEMetrics.hpp"
+
 class BluetoothDeviceInfo;
+class BLEBroadcastValue;
 
 /*!
  * \brief The BluetoothDiscovery class provides functionality to search and view nearby bluetooth
- * devices
+ * devices. The search runs on every local adapter in parallel and the devices found by several
+ * adapters are merged
  */
 class BluetoothDiscovery : public QObject
 {
     Q_OBJECT
-    QML_ELEMENT
+
+    friend class BLESessionReplayer;
 
     Q_PROPERTY(QList<BluetoothDeviceInfo*> devices READ devices NOTIFY devicesChanged)
     Q_PROPERTY(bool isActive READ isActive NOTIFY isActiveChanged)
     Q_PROPERTY(int timeOut READ timeOut WRITE setTimeOut NOTIFY timeOutChanged)
     Q_PROPERTY(DiscoveryMethods methods READ methods WRITE setMethods NOTIFY methodsChanged)
+    Q_PROPERTY(BLEMetrics* metrics READ metrics CONSTANT)
+    Q_PROPERTY(bool observe READ observe WRITE setObserve NOTIFY observeChanged FINAL)
+    Q_PROPERTY(int broadcastCompanyId READ broadcastCompanyId WRITE setBroadcastCompanyId NOTIFY broadcastCompanyIdChanged FINAL)
+    Q_PROPERTY(QList<BLEBroadcastValue*> broadcastValues READ broadcastValues NOTIFY broadcastValuesChanged)
 
 public:
     enum DiscoveryMethod
@@ -85,11 +94,50 @@ public:
      */
     const QList<BluetoothDeviceInfo*>& devices();
 
+    /*!
+     * \brief metrics Returns the runtime metrics of this discovery
+     * \return
+     */
+    BLEMetrics* metrics() const;
+
+    /*!
+     * \brief observe When true the values broadcast by peripherals are decoded from their
+     * advertisements into \ref broadcastValues, without connecting to them. This needs the
+     * \ref LowEnergyMethod, a \ref timeOut of 0 keeps observing until \ref stop()
+     * \return
+     */
+    bool observe() const;
+    void setObserve(bool observe);
+
+    /*!
+     * \brief broadcastCompanyId The company id of the manufacturer data holding broadcast values,
+     * see \ref BLEPeripheral::broadcastCompanyId
+     * \return
+     */
+    int broadcastCompanyId() const;
+    void setBroadcastCompanyId(int companyId);
+
+    /*!
+     * \brief broadcastValues Returns every observed broadcast value
+     * \return
+     */
+    const QList<BLEBroadcastValue*>& broadcastValues() const;
+
+    /*!
+     * \brief broadcastValue Returns the value of \a characterUuid broadcast by the device with
+     * \a address, or null if it was not observed
+     */
+    Q_INVOKABLE BLEBroadcastValue* broadcastValue(const QString& address,
+                                                  quint32 characterUuid) const;
+
 signals:
     void devicesChanged();
     void isActiveChanged();
     void timeOutChanged();
     void methodsChanged();
+    void observeChanged();
+    void broadcastCompanyIdChanged();
+    void broadcastValuesChanged();
 
 private slots:
     /*!
@@ -98,6 +146,19 @@ private slots:
      */
     void addDevice(const QBluetoothDeviceInfo& dev);
 
+    /*!
+     * \brief updateDevice Handles a new advertisement of an already discovered device
+     * \param dev
+     * \param fields
+     */
+    void updateDevice(const QBluetoothDeviceInfo& dev, QBluetoothDeviceInfo::Fields fields);
+
+    /*!
+     * \brief agentStopped Called when a discovery agent finishes, is canceled or fails. The
+     * discovery is inactive once every agent stopped
+     */
+    void agentStopped();
+
     /*!
      * \brief errorOccurred
      * \param error
@@ -105,12 +166,24 @@ private slots:
     void errorOccurred(QBluetoothDeviceDiscoveryAgent::Error error);
 
 private:
-    //! \brief The discovery agent
-    QBluetoothDeviceDiscoveryAgent* mDevDiscovery;
+    //! \brief mAgents One discovery agent per local adapter
+    QList<QBluetoothDeviceDiscoveryAgent*> mAgents;
+
+    //! \brief mAgentAdapters The adapters \ref mAgents were created for
+    QStringList mAgentAdapters;
+
+    //! \brief mRunningAgents The number of agents that did not stop yet
+    int mRunningAgents;
+
+    //! \brief mTimeOut The low energy discovery timeout of the agents
+    int mTimeOut;
 
     //! \brief A list of available devices
     QList<BluetoothDeviceInfo*> mDevices;
 
+    //! \brief mDeviceIndex The devices by address, merges the reports of the adapters
+    QHash<quint64, BluetoothDeviceInfo*> mDeviceIndex;
+
     //! \brief Is scanner running
     bool mIsActive;
 
@@ -120,6 +193,37 @@ private:
     //! \brief mDeviceCoreConfig Determines what kind of devices should be added to the list when
     //! discoverd. This depends on \ref mDiscoverMethods
     int mDeviceCoreConfig;
+
+    //! \brief mMetrics Counts discovery reports and discovered devices
+    BLEMetrics* mMetrics;
+
+    //! \brief mObserve Decode broadcast values from advertisements
+    bool mObserve;
+
+    //! \brief mBroadcastCompanyId Company id of the manufacturer data holding broadcast values
+    int mBroadcastCompanyId;
+
+    //! \brief mBroadcastValues Observed values in the order they were found
+    QList<BLEBroadcastValue*> mBroadcastValues;
+
+    //! \brief mBroadcastIndex Observed values by device address shifted left by 16 bits and the
+    //! 16 bit characteristic uuid, so hundreds of devices are looked up in constant time
+    QHash<quint64, BLEBroadcastValue*> mBroadcastIndex;
+
+    //! \brief mBroadcastSequences The last sequence decoded for each device address
+    QHash<quint64, quint8> mBroadcastSequences;
+
+private:
+    /*!
+     * \brief createAgents Creates an agent per adapter of \ref BluetoothController, unless the
+     * adapters did not change since the last time
+     */
+    void createAgents();
+
+    /*!
+     * \brief observeBroadcast Decodes the broadcast values of \a dev if its sequence changed
+     */
+    void observeBroadcast(const QBluetoothDeviceInfo& dev);
 };
 
 
@@ -130,15 +234,35 @@ inline BluetoothDiscovery::DiscoveryMethods BluetoothDiscovery::methods() const
 
 inline bool BluetoothDiscovery::isActive() const
 {
-    return mDevDiscovery && mDevDiscovery->isActive();
+    return mRunningAgents > 0;
 }
 
 inline int BluetoothDiscovery::timeOut() const
 {
-    return mDevDiscovery ? mDevDiscovery->lowEnergyDiscoveryTimeout() : 0;
+    return mTimeOut;
 }
 
 inline const QList<BluetoothDeviceInfo*>& BluetoothDiscovery::devices()
 {
     return mDevices;
 }
+
+inline BLEMetrics* BluetoothDiscovery::metrics() const
+{
+    return mMetrics;
+}
+
+inline bool BluetoothDiscovery::observe() const
+{
+    return mObserve;
+}
+
+inline int BluetoothDiscovery::broadcastCompanyId() const
+{
+    return mBroadcastCompanyId;
+}
+
+inline const QList<BLEBroadcastValue*>& BluetoothDiscovery::broadcastValues() const
+{
+    return mBroadcastValues;
+}
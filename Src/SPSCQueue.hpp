@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+/*!
+ * \brief The SPSCQueue class is a bounded, lock-free, single producer single consumer ring buffer.
+ * It is used to hand decoded samples from the BLE I/O thread to the GUI thread without locking
+ * or allocating.
+ * \note Exactly one thread may call \ref push() and exactly one (other) thread may call \ref pop()
+ * \tparam T The element type, must be default constructible and copy assignable
+ * \tparam Capacity Number of slots, must be a power of two
+ */
+template <typename T, std::size_t Capacity>
+class SPSCQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SPSCQueue capacity must be a power of two");
+    static_assert(std::is_default_constructible_v<T>, "SPSCQueue element must be default constructible");
+
+public:
+    SPSCQueue() = default;
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    /*!
+     * \brief push Appends a copy of \a value, this must only be called from the producer thread
+     * \return False if the queue is full and \a value is not added
+     */
+    bool push(const T& value)
+    {
+        const std::size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mTailCache == Capacity) {
+            mTailCache = mTail.load(std::memory_order_acquire);
+            if (head - mTailCache == Capacity) {
+                return false;
+            }
+        }
+
+        mSlots[head & Mask] = value;
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * \brief pop Removes the oldest element and copies it into \a value, this must only be called
+     * from the consumer thread
+     * \return False if the queue is empty
+     */
+    bool pop(T& value)
+    {
+        const std::size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHeadCache) {
+            mHeadCache = mHead.load(std::memory_order_acquire);
+            if (tail == mHeadCache) {
+                return false;
+            }
+        }
+
+        value = mSlots[tail & Mask];
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * \brief size Approximate number of queued elements, exact only when both ends are idle
+     */
+    std::size_t size() const
+    {
+        return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+    }
+
+    bool isEmpty() const
+    {
+        return size() == 0;
+    }
+
+    static constexpr std::size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    static constexpr std::size_t Mask = Capacity - 1;
+
+    //! \brief Indexes are kept on separate cache lines so producer and consumer don't false share
+    static constexpr std::size_t CacheLine = 64;
+
+    //! \brief mHead Next slot to be written, owned by the producer
+    alignas(CacheLine) std::atomic<std::size_t> mHead { 0 };
+    //! \brief mTailCache Producer's last seen value of \ref mTail
+    std::size_t mTailCache { 0 };
+
+    //! \brief mTail Next slot to be read, owned by the consumer
+    alignas(CacheLine) std::atomic<std::size_t> mTail { 0 };
+    //! \brief mHeadCache Consumer's last seen value of \ref mHead
+    std::size_t mHeadCache { 0 };
+
+    alignas(CacheLine) std::array<T, Capacity> mSlots {};
+};
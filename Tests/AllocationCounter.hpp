@@ -0,0 +1,16 @@
+#pragma once
+
+#include <QtGlobal>
+
+/*!
+ * \brief The AllocationCounter class counts the calls to the global operator new of the test
+ * executable, Qt's own allocations included
+ */
+class AllocationCounter
+{
+public:
+    /*!
+     * \brief count Returns the number of allocations since the process started
+     */
+    static quint64 count();
+};
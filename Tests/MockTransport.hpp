@@ -0,0 +1,119 @@
+#pragma once
+
+#include "BLEDataService.hpp"
+#include "BLERole.hpp"
+#include "BLETransport.hpp"
+
+/*!
+ * \brief The MockTransport class is a \ref BLETransport that talks to nothing. Values are injected
+ * with \ref inject() so the receive path can be measured without a radio or an event loop
+ */
+class MockTransport : public BLETransport
+{
+    Q_OBJECT
+
+public:
+    explicit MockTransport(Role role, QObject* parent = nullptr)
+        : BLETransport{ role, parent }
+    {
+        setState(QLowEnergyController::DiscoveredState);
+    }
+
+    /*!
+     * \brief inject Delivers \a value as if the other end changed the characteristic
+     */
+    void inject(const QBluetoothUuid& service,
+                const QBluetoothUuid& characteristic,
+                const QByteArray& value)
+    {
+        emit characteristicChanged(service, characteristic, value);
+    }
+
+    //! \brief writes Number of \ref writeCharacteristic() calls
+    quint64 writes = 0;
+
+    //! \brief written The value of the last \ref writeCharacteristic() call
+    QByteArray written;
+
+    //! \brief requests The parameters passed to \ref requestConnectionUpdate()
+    QList<QLowEnergyConnectionParameters> requests;
+
+    //! \brief confirms Returned by \ref confirmsWrites()
+    bool confirms = true;
+
+    QString errorString() const override { return QString(); }
+    QBluetoothAddress localAddress() const override { return QBluetoothAddress(quint64(1)); }
+    QBluetoothAddress remoteAddress() const override { return QBluetoothAddress(quint64(2)); }
+    int mtu() const override { return 247; }
+    bool confirmsWrites() const override { return confirms; }
+
+    void connectToDevice() override {}
+    void disconnectFromDevice() override {}
+    void discoverServices() override {}
+    bool openService(const QBluetoothUuid& service) override
+    {
+        emit serviceReady(service);
+        return true;
+    }
+    void subscribe(const QBluetoothUuid&, const QBluetoothUuid&, bool) override {}
+
+    bool addService(const QLowEnergyServiceData&) override { return true; }
+    void startAdvertising(const QLowEnergyAdvertisingParameters&,
+                          const QLowEnergyAdvertisingData&,
+                          const QLowEnergyAdvertisingData&) override {}
+    void stopAdvertising() override {}
+
+    bool writeCharacteristic(const QBluetoothUuid&, const QBluetoothUuid&,
+                             const QByteArray& value) override
+    {
+        ++writes;
+        written = value;
+        return true;
+    }
+    void readCharacteristic(const QBluetoothUuid&, const QBluetoothUuid&) override {}
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters) override
+    {
+        requests.append(parameters);
+    }
+};
+
+/*!
+ * \brief The MockRole class is a \ref BLERole on a \ref MockTransport. Values injected in the
+ * transport go through \ref BLERole::dispatchValue() like the values of a real connection
+ */
+class MockRole : public BLERole
+{
+public:
+    MockRole()
+        : mMock { new MockTransport(QLowEnergyController::CentralRole, this) }
+    {
+        mTransport = mMock;
+        connect(mMock, &BLETransport::characteristicChanged, mMock,
+                [this](const QBluetoothUuid& service, const QBluetoothUuid& characteristic,
+                       const QByteArray& value) {
+                    dispatchValue(service, characteristic, value);
+                });
+    }
+
+    BLEDataService* addService(quint32 serviceUuid, quint32 characterUuid,
+                               BLEDataService::DataType type)
+    {
+        auto* service = new BLEDataService(this);
+        service->setServiceUuid(serviceUuid);
+        service->setCharacterUuid(characterUuid);
+        service->setDataType(type);
+        service->setValueLength(type == BLEDataService::String ? 16 : 4);
+        service->setup(*mMock);
+        serviceAdd(service);
+        return service;
+    }
+
+    MockTransport* mock() const { return mMock; }
+
+protected:
+    void readData(const QBluetoothUuid&) override {}
+    void writeData(const QBluetoothUuid&, const QVariant&) override {}
+
+private:
+    MockTransport* mMock;
+};
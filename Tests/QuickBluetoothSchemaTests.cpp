@@ -0,0 +1,158 @@
+#include <QtTest>
+
+#include <iterator>
+#include <optional>
+#include <type_traits>
+
+#include "TestSchema.hpp"
+
+#include "BLEPeripheral.hpp"
+
+/*!
+ * \brief The QuickBluetoothSchemaTests class checks the code quickbluetooth_add_gatt_schema()
+ * generates from TestSchema.json
+ */
+class QuickBluetoothSchemaTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void table();
+    void intCodec();
+    void floatCodec();
+    void stringCodec();
+    void standardCodec();
+    void serviceData();
+    void services();
+};
+
+void QuickBluetoothSchemaTests::table()
+{
+    static_assert(std::size(TestSchema::Characteristics) == 4);
+    static_assert(TestSchema::CountService == 0xFFF0);
+    static_assert(TestSchema::HeartRateCharacteristic == 0x2A37);
+
+    //! The keys missing from the schema take the defaults of BLEDataService
+    const BLEGattSchema::Characteristic& temperature = TestSchema::Characteristics[1];
+    QCOMPARE(QByteArray(temperature.name), QByteArrayLiteral("temperature"));
+    QCOMPARE(temperature.type, BLESample::Float);
+    QCOMPARE(temperature.valueLength, quint8(2));
+    QVERIFY(!temperature.indicate);
+    QCOMPARE(temperature.encoding, quint8(BLEDataService::TextEncoding));
+    QCOMPARE(temperature.priority, quint8(BLEDataService::NormalPriority));
+
+    const BLEGattSchema::Characteristic& count = TestSchema::Characteristics[0];
+    QVERIFY(count.indicate);
+    QCOMPARE(count.encoding, quint8(BLEDataService::DeltaEncoding));
+    QCOMPARE(count.keyFrameInterval, 8);
+    QCOMPARE(count.priority, quint8(BLEDataService::HighPriority));
+}
+
+void QuickBluetoothSchemaTests::intCodec()
+{
+    static_assert(std::is_same_v<decltype(TestSchema::decodeCount(QByteArray())),
+                                 std::optional<int>>);
+
+    QCOMPARE(TestSchema::encodeCount(72), QByteArrayLiteral("72"));
+    const std::optional<int> count = TestSchema::decodeCount(TestSchema::encodeCount(1234));
+    QVERIFY(count);
+    QCOMPARE(*count, 1234);
+    QVERIFY(!TestSchema::decodeCount(QByteArrayLiteral("abc")));
+}
+
+void QuickBluetoothSchemaTests::floatCodec()
+{
+    static_assert(std::is_same_v<decltype(TestSchema::decodeTemperature(QByteArray())),
+                                 std::optional<float>>);
+
+    const std::optional<float> temperature
+        = TestSchema::decodeTemperature(TestSchema::encodeTemperature(36.5f));
+    QVERIFY(temperature);
+    QCOMPARE(*temperature, 36.5f);
+    QVERIFY(!TestSchema::decodeTemperature(QByteArrayLiteral("warm")));
+}
+
+void QuickBluetoothSchemaTests::stringCodec()
+{
+    static_assert(std::is_same_v<decltype(TestSchema::decodeLabel(QByteArray())),
+                                 std::optional<QString>>);
+
+    const QString label = QStringLiteral("Resting");
+    QCOMPARE(TestSchema::encodeLabel(label), label.toUtf8());
+    const std::optional<QString> decoded = TestSchema::decodeLabel(label.toUtf8());
+    QVERIFY(decoded);
+    QCOMPARE(*decoded, label);
+}
+
+void QuickBluetoothSchemaTests::standardCodec()
+{
+    static_assert(std::is_same_v<decltype(TestSchema::decodeHeartRate(QByteArray())),
+                                 std::optional<QVariantMap>>);
+
+    //! Heart Rate Measurement, flags then 72 bpm as a byte
+    const QByteArray bytes = TestSchema::encodeHeartRate({ { QStringLiteral("heartRate"), 72 } });
+    QCOMPARE(bytes, QByteArrayLiteral("\x00\x48"));
+
+    const std::optional<QVariantMap> fields = TestSchema::decodeHeartRate(bytes);
+    QVERIFY(fields);
+    QCOMPARE(fields->value(QStringLiteral("heartRate")).toInt(), 72);
+
+    //! The flags alone miss the heart rate
+    QCOMPARE(TestSchema::encodeHeartRate(QVariantMap()), QByteArray());
+    QVERIFY(!TestSchema::decodeHeartRate(bytes.left(1)));
+}
+
+void QuickBluetoothSchemaTests::serviceData()
+{
+    const QList<QLowEnergyServiceData>& services = TestSchema::serviceData();
+    QCOMPARE(services.size(), qsizetype(std::size(TestSchema::Characteristics)));
+
+    //! Built once and shared by every instance
+    QCOMPARE(&TestSchema::serviceData(), &services);
+
+    for (qsizetype i = 0; i < services.size(); ++i) {
+        const BLEGattSchema::Characteristic& characteristic = TestSchema::Characteristics[i];
+        QCOMPARE(services[i].uuid(), QBluetoothUuid(characteristic.service));
+        QCOMPARE(services[i].characteristics().size(), qsizetype(1));
+        QCOMPARE(services[i].characteristics().first().uuid(),
+                 QBluetoothUuid(characteristic.characteristic));
+    }
+}
+
+void QuickBluetoothSchemaTests::services()
+{
+    BLEPeripheral peripheral;
+    TestSchema schema;
+
+    //! The services are created with the properties of the schema
+    QCOMPARE(schema.count()->serviceUuid(), TestSchema::CountService);
+    QCOMPARE(schema.count()->characterUuid(), TestSchema::CountCharacteristic);
+    QCOMPARE(schema.count()->dataType(), BLEDataService::Int);
+    QVERIFY(schema.count()->indicate());
+    QCOMPARE(schema.count()->encoding(), BLEDataService::DeltaEncoding);
+    QCOMPARE(schema.count()->keyFrameInterval(), 8);
+    QCOMPARE(schema.count()->priority(), BLEDataService::HighPriority);
+    QCOMPARE(schema.label()->dataType(), BLEDataService::String);
+    QVERIFY(schema.label()->stamped());
+    QCOMPARE(schema.heartRate()->dataType(), BLEDataService::Standard);
+    QCOMPARE(schema.heartRate()->deadline(), 50);
+
+    //! Setting the role hands the services over to it
+    QSignalSpy roleChanged(&schema, &TestSchema::roleChanged);
+    schema.setRole(&peripheral);
+    QCOMPARE(roleChanged.size(), 1);
+    QCOMPARE(peripheral.serviceCount(), qsizetype(4));
+    QCOMPARE(peripheral.serviceAt(3), schema.heartRate());
+    QCOMPARE(schema.count()->parent(), static_cast<QObject*>(&peripheral));
+
+    //! The services can only be added once
+    BLEPeripheral other;
+    QTest::ignoreMessage(QtWarningMsg, "TestSchema: The services are already added to a role");
+    schema.setRole(&other);
+    QCOMPARE(schema.role(), static_cast<BLERole*>(&peripheral));
+    QCOMPARE(other.serviceCount(), qsizetype(0));
+}
+
+QTEST_GUILESS_MAIN(QuickBluetoothSchemaTests)
+
+#include "QuickBluetoothSchemaTests.moc"
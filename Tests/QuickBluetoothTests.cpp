@@ -0,0 +1,1436 @@
+#include <QtTest>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QQmlComponent>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQmlEngine>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#include "AllocationCounter.hpp"
+#include "MockTransport.hpp"
+#include "TestData.hpp"
+
+#include "BLEAdvertiser.hpp"
+#include "BLEBroadcastFormat.hpp"
+#include "BLECentral.hpp"
+#include "BLECodecRegistry.hpp"
+#include "BLEDataService.hpp"
+#include "BLEDeltaCodec.hpp"
+#include "BLEExportStream.hpp"
+#include "BLELoopbackLink.hpp"
+#include "BLEMetrics.hpp"
+#include "BLEPeripheral.hpp"
+#include "BLERateController.hpp"
+#include "BLESampleBus.hpp"
+#include "BLEScheduler.hpp"
+#include "BLESessionLog.hpp"
+#include "BLESessionRecorder.hpp"
+#include "BLESessionReplayer.hpp"
+#include "BLESharedSampleReader.hpp"
+#include "BLESharedSamples.hpp"
+#include "BLEStamp.hpp"
+#include "BLEStreamLink.hpp"
+#include "BLEStreamTransport.hpp"
+#include "BLETrace.hpp"
+#include "BluetoothController.hpp"
+#include "BluetoothDeviceInfo.hpp"
+#include "BluetoothDiscovery.hpp"
+
+namespace {
+
+//! \brief Number of values sent by the tests of a data path
+constexpr int Rounds = 1000;
+
+//! \brief Blood Pressure Measurement, its main field is an IEEE 11073 SFLOAT after the flags
+constexpr quint32 BloodPressure = 0x2A35;
+
+//! \brief Temperature Measurement, its main field is an IEEE 11073 FLOAT after the flags
+constexpr quint32 Temperature = 0x2A1C;
+
+//! \brief Returns the size of the medical float that is the main field of \a characteristic
+constexpr int medicalFloatSize(quint32 characteristic)
+{
+    return characteristic == BloodPressure ? 2 : 4;
+}
+
+} // namespace
+
+/*!
+ * \brief The QuickBluetoothTests class checks the behaviour of the data path against a mock
+ * transport, a loopback link and a local socket stream, so it runs without a radio. The timings
+ * of the same paths are measured by QuickBluetoothBench
+ */
+class QuickBluetoothTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void dispatch_data();
+    void dispatch();
+
+    void allocationsPerNotification_data();
+    void allocationsPerNotification();
+
+    void qmlDelivery();
+
+    void deltaRoundTrip();
+
+    void medicalFloatDecode_data();
+    void medicalFloatDecode();
+    void medicalFloatEncode_data();
+    void medicalFloatEncode();
+
+    void stampFrame();
+    void stampTracker();
+    void stampOffsetDrift();
+
+    void discoveryAddDevice();
+
+    void controllerInitialize();
+    void controllerAdapters();
+
+    void loopbackRoundTrip_data();
+    void loopbackRoundTrip();
+
+    void streamRoundTrip();
+    void streamDecode();
+
+    void advertiserPack();
+
+    void connectionParameters_data();
+    void connectionParameters();
+    void connectionProfiles();
+
+    void broadcastFormat();
+
+    void pacing();
+    void subscriptions();
+
+    void schedulerUrgentBehindBulk();
+
+    void rateControllerConverges();
+
+    void sharedSamplesFanOut();
+
+    void exportStreamBatches();
+
+    void metricsSnapshot();
+
+    void traceExport();
+
+    void sessionLogRoundTrip();
+    void sessionRecordReplay();
+    void sessionRecorderStopWhileRecording();
+};
+
+void QuickBluetoothTests::initTestCase()
+{
+    //! Publishing is part of the data path, but the bus must not be read by anyone here
+    BLESampleBus::instance();
+}
+
+void QuickBluetoothTests::dispatch_data()
+{
+    addDataTypeRows();
+}
+
+void QuickBluetoothTests::dispatch()
+{
+    QFETCH(BLEDataService::DataType, type);
+
+    MockRole role;
+    BLEDataService* service = role.addService(ServiceUuid, CharacterUuid, type);
+    const QBluetoothUuid serviceUuid = service->serviceBluetoothUuid();
+    const QBluetoothUuid characterUuid = service->characterBluetoothUuid();
+
+    int updates = 0;
+    int changes = 0;
+    connect(service, &BLEDataService::valueUpdated, this, [&updates]() {
+        ++updates;
+    });
+    connect(service, &BLEDataService::valueChanged, this, [&changes]() {
+        ++changes;
+    });
+
+    for (int i = 0; i < Rounds; ++i) {
+        role.mock()->inject(serviceUuid, characterUuid, encodedValue(type, i));
+    }
+    QCOMPARE(updates, Rounds);
+    QCOMPARE(changes, Rounds);
+    QVERIFY(service->value().isValid());
+
+    //! A repeated value is an update but not a change
+    role.mock()->inject(serviceUuid, characterUuid, encodedValue(type, Rounds - 1));
+    QCOMPARE(updates, Rounds + 1);
+    QCOMPARE(changes, Rounds);
+}
+
+void QuickBluetoothTests::allocationsPerNotification_data()
+{
+    addDataTypeRows();
+}
+
+void QuickBluetoothTests::allocationsPerNotification()
+{
+    QFETCH(BLEDataService::DataType, type);
+
+    //! Numbers and the main field of standard values are decoded in place, only strings need a
+    //! QString for the value
+    if (type == BLEDataService::String) {
+        QSKIP("A string value allocates its QString");
+    }
+
+    MockRole role;
+    BLEDataService* service = role.addService(ServiceUuid, CharacterUuid, type);
+    const QBluetoothUuid serviceUuid = service->serviceBluetoothUuid();
+    const QBluetoothUuid characterUuid = service->characterBluetoothUuid();
+    const QByteArray values[2] = { encodedValue(type, 0), encodedValue(type, 1) };
+
+    //! Warm up so lazily created objects are not counted
+    role.mock()->inject(serviceUuid, characterUuid, values[0]);
+
+    const quint64 before = AllocationCounter::count();
+    for (int i = 0; i < Rounds; ++i) {
+        role.mock()->inject(serviceUuid, characterUuid, values[i & 1]);
+    }
+    QCOMPARE(AllocationCounter::count() - before, quint64(0));
+}
+
+void QuickBluetoothTests::qmlDelivery()
+{
+    MockRole role;
+    BLEDataService* service = role.addService(ServiceUuid, CharacterUuid, BLEDataService::Int);
+    const QBluetoothUuid serviceUuid = service->serviceBluetoothUuid();
+    const QBluetoothUuid characterUuid = service->characterBluetoothUuid();
+
+    //! A binding on the value, like a Text showing it
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData("import QtQml\n"
+                      "QtObject {\n"
+                      "    property QtObject source\n"
+                      "    property int updates: 0\n"
+                      "    property var current: source ? source.value : undefined\n"
+                      "    onCurrentChanged: ++updates\n"
+                      "}\n",
+                      QUrl());
+    QScopedPointer<QObject> binding(component.createWithInitialProperties(
+        { { QStringLiteral("source"), QVariant::fromValue<QObject*>(service) } }));
+    QVERIFY2(binding, qPrintable(component.errorString()));
+
+    const int initial = binding->property("updates").toInt();
+    for (int i = 0; i < Rounds; ++i) {
+        role.mock()->inject(serviceUuid, characterUuid, encodedValue(BLEDataService::Int, i));
+    }
+    QCOMPARE(binding->property("updates").toInt() - initial, Rounds);
+    QCOMPARE(binding->property("current"), service->value());
+}
+
+void QuickBluetoothTests::deltaRoundTrip()
+{
+    BLEDeltaCodec::Encoder encoder;
+    BLEDeltaCodec::Decoder decoder;
+
+    //! A counter that grows by small steps, like steps or calories, and jumps now and then
+    qint16 counter = 1200;
+    for (int i = 0; i < Rounds; ++i) {
+        counter = i % 100 == 99 ? qint16(-counter) : qint16(counter + i % 3);
+        const QByteArray frame = encoder.encode(counter);
+        QVERIFY(frame.size() <= BLEDeltaCodec::MaxFrameSize);
+
+        BLEDeltaCodec::Values values;
+        QVERIFY(decoder.decode(frame, values));
+        QCOMPARE(values.size(), qsizetype(1));
+        QCOMPARE(values[0], counter);
+    }
+
+    //! A batch decodes to the values it encoded
+    const qint16 batch[] = { 10, 11, 13, 12, -400, -398 };
+    int encoded = 0;
+    const QByteArray frame = encoder.encodeBatch(batch, int(std::size(batch)), &encoded);
+    QCOMPARE(encoded, int(std::size(batch)));
+
+    BLEDeltaCodec::Values values;
+    QVERIFY(decoder.decode(frame, values));
+    QCOMPARE(values.size(), qsizetype(encoded));
+    for (int i = 0; i < encoded; ++i) {
+        QCOMPARE(values[i], batch[i]);
+    }
+}
+
+void QuickBluetoothTests::medicalFloatDecode_data()
+{
+    QTest::addColumn<quint32>("characteristic");
+    QTest::addColumn<QByteArray>("raw");
+    QTest::addColumn<float>("value");
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    //! SFLOAT, 12 bits of mantissa then 4 bits of exponent
+    QTest::newRow("SFLOAT") << BloodPressure << QByteArray("\x48\x00", 2) << 72.0f;
+    QTest::newRow("SFLOAT exponent") << BloodPressure << QByteArray("\x6E\xF1", 2) << 36.6f;
+    QTest::newRow("SFLOAT negative") << BloodPressure << QByteArray("\xFB\x0F", 2) << -5.0f;
+    QTest::newRow("SFLOAT NaN") << BloodPressure << QByteArray("\xFF\x07", 2) << nan;
+    QTest::newRow("SFLOAT NRes") << BloodPressure << QByteArray("\x00\x08", 2) << nan;
+    QTest::newRow("SFLOAT reserved") << BloodPressure << QByteArray("\x01\x08", 2) << nan;
+    QTest::newRow("SFLOAT +INF") << BloodPressure << QByteArray("\xFE\x07", 2) << infinity;
+    QTest::newRow("SFLOAT -INF") << BloodPressure << QByteArray("\x02\x08", 2) << -infinity;
+
+    //! FLOAT, 24 bits of mantissa then 8 bits of exponent
+    QTest::newRow("FLOAT") << Temperature << QByteArray("\x6E\x01\x00\xFF", 4) << 36.6f;
+    QTest::newRow("FLOAT negative") << Temperature << QByteArray("\x2E\xFB\xFF\xFD", 4) << -1.234f;
+    QTest::newRow("FLOAT NaN") << Temperature << QByteArray("\xFF\xFF\x7F\x00", 4) << nan;
+    QTest::newRow("FLOAT NRes") << Temperature << QByteArray("\x00\x00\x80\x00", 4) << nan;
+    QTest::newRow("FLOAT reserved") << Temperature << QByteArray("\x01\x00\x80\x00", 4) << nan;
+    QTest::newRow("FLOAT +INF") << Temperature << QByteArray("\xFE\xFF\x7F\x00", 4) << infinity;
+    QTest::newRow("FLOAT -INF") << Temperature << QByteArray("\x02\x00\x80\x00", 4) << -infinity;
+}
+
+void QuickBluetoothTests::medicalFloatDecode()
+{
+    QFETCH(quint32, characteristic);
+    QFETCH(QByteArray, raw);
+    QFETCH(float, value);
+
+    const QByteArray data = QByteArray(1, '\0') + raw;
+    float decoded = 0;
+    QVERIFY(BLECodecRegistry::primary(characteristic, data.constData(), data.size(), decoded));
+    QCOMPARE(decoded, value);
+
+    //! A value cut in the middle of the field is malformed
+    QVERIFY(!BLECodecRegistry::primary(characteristic, data.constData(), data.size() - 1,
+                                       decoded));
+}
+
+void QuickBluetoothTests::medicalFloatEncode_data()
+{
+    QTest::addColumn<quint32>("characteristic");
+    QTest::addColumn<double>("value");
+    QTest::addColumn<QByteArray>("raw");
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    //! The reserved values are encoded as such, an empty raw value is checked by decoding it
+    QTest::newRow("SFLOAT NaN") << BloodPressure << nan << QByteArray("\xFF\x07", 2);
+    QTest::newRow("SFLOAT +INF") << BloodPressure << infinity << QByteArray("\xFE\x07", 2);
+    QTest::newRow("SFLOAT -INF") << BloodPressure << -infinity << QByteArray("\x02\x08", 2);
+    QTest::newRow("SFLOAT overflow") << BloodPressure << 1e12 << QByteArray("\xFE\x07", 2);
+    QTest::newRow("SFLOAT negative overflow") << BloodPressure << -1e12
+                                              << QByteArray("\x02\x08", 2);
+    QTest::newRow("SFLOAT largest") << BloodPressure << 2045e7 << QByteArray();
+    QTest::newRow("SFLOAT") << BloodPressure << 36.6 << QByteArray();
+    QTest::newRow("SFLOAT negative") << BloodPressure << -5.0 << QByteArray();
+    QTest::newRow("SFLOAT zero") << BloodPressure << 0.0 << QByteArray();
+    QTest::newRow("SFLOAT small") << BloodPressure << 1234e-8 << QByteArray();
+
+    QTest::newRow("FLOAT NaN") << Temperature << nan << QByteArray("\xFF\xFF\x7F\x00", 4);
+    QTest::newRow("FLOAT +INF") << Temperature << infinity << QByteArray("\xFE\xFF\x7F\x00", 4);
+    QTest::newRow("FLOAT -INF") << Temperature << -infinity << QByteArray("\x02\x00\x80\x00", 4);
+    QTest::newRow("FLOAT") << Temperature << 36.6 << QByteArray();
+    QTest::newRow("FLOAT negative") << Temperature << -1.234 << QByteArray();
+    QTest::newRow("FLOAT large") << Temperature << 1e12 << QByteArray();
+}
+
+void QuickBluetoothTests::medicalFloatEncode()
+{
+    QFETCH(quint32, characteristic);
+    QFETCH(double, value);
+    QFETCH(QByteArray, raw);
+
+    const QByteArray data = BLECodecRegistry::encode(characteristic, value);
+    QVERIFY(data.size() > medicalFloatSize(characteristic));
+    if (!raw.isEmpty()) {
+        QCOMPARE(data.mid(1, medicalFloatSize(characteristic)), raw);
+    }
+
+    float decoded = 0;
+    QVERIFY(BLECodecRegistry::primary(characteristic, data.constData(), data.size(), decoded));
+    if (raw.isEmpty()) {
+        QCOMPARE(decoded, float(value));
+    } else if (std::isnan(value)) {
+        QVERIFY(std::isnan(decoded));
+    } else {
+        QVERIFY(std::isinf(decoded));
+        QCOMPARE(decoded > 0, value > 0);
+    }
+}
+
+void QuickBluetoothTests::stampFrame()
+{
+    const quint32 before = BLEStamp::clock();
+    const QByteArray frame = BLEStamp::stamp(QByteArrayLiteral("abc"), 42);
+    QCOMPARE(frame.size(), BLEStamp::HeaderSize + 3);
+
+    quint16 sequence = 0;
+    quint32 sendTime = 0;
+    QVERIFY(BLEStamp::read(frame, sequence, sendTime));
+    QCOMPARE(sequence, quint16(42));
+    QVERIFY(sendTime - before <= BLEStamp::clock() - before);
+    QCOMPARE(BLEStamp::payload(frame), QByteArrayLiteral("abc"));
+
+    QVERIFY(!BLEStamp::read(frame.left(BLEStamp::HeaderSize - 1), sequence, sendTime));
+}
+
+void QuickBluetoothTests::stampTracker()
+{
+    BLEStamp::Tracker tracker;
+
+    //! The first value sets the clock offset to 4000 us
+    BLEStamp::Result result = tracker.track(10, 1000, 5000);
+    QCOMPARE(result.lost, 0);
+    QCOMPARE(result.latency, qint64(0));
+
+    result = tracker.track(11, 2000, 6100);
+    QCOMPARE(result.lost, 0);
+    QVERIFY(!result.reordered);
+    QCOMPARE(result.latency, qint64(100));
+
+    //! 12 and 13 are missing
+    result = tracker.track(14, 3000, 7000);
+    QCOMPARE(result.lost, 2);
+    QCOMPARE(result.latency, qint64(0));
+
+    //! 12 arrives late, it isn't lost anymore
+    result = tracker.track(12, 2500, 6600);
+    QVERIFY(result.reordered);
+    QVERIFY(!result.duplicate);
+    QCOMPARE(result.lost, -1);
+    QCOMPARE(result.latency, qint64(100));
+
+    //! Received again, either late or the newest one
+    for (quint16 sequence : { quint16(12), quint16(14) }) {
+        result = tracker.track(sequence, 3000, 7000);
+        QVERIFY(result.duplicate);
+        QCOMPARE(result.lost, 0);
+        QCOMPARE(result.latency, qint64(-1));
+    }
+
+    //! Faster than any value before, the offset becomes 3900 us
+    result = tracker.track(15, 4000, 7900);
+    QCOMPARE(result.latency, qint64(0));
+    result = tracker.track(16, 5000, 9000);
+    QCOMPARE(result.latency, qint64(100));
+
+    //! The sender started over, nothing is lost or reordered
+    result = tracker.track(16 + 2 * BLEStamp::ResyncDistance, 6000, 10000);
+    QCOMPARE(result.lost, 0);
+    QVERIFY(!result.reordered);
+    QVERIFY(!result.duplicate);
+
+    //! Both the sequence and the send time wrap
+    tracker.reset();
+    result = tracker.track(0xFFFF, 0xFFFFFF00, 100);
+    QCOMPARE(result.latency, qint64(0));
+    result = tracker.track(1, 0x50, 0x50 + 356 + 20);
+    QCOMPARE(result.lost, 1);
+    QVERIFY(!result.reordered);
+    QCOMPARE(result.latency, qint64(20));
+
+    result = tracker.track(0, 0x40, 0x40 + 356);
+    QVERIFY(result.reordered);
+    QCOMPARE(result.lost, -1);
+    QCOMPARE(result.latency, qint64(0));
+}
+
+void QuickBluetoothTests::stampOffsetDrift()
+{
+    BLEStamp::Tracker tracker;
+    QCOMPARE(tracker.track(0, 0, 1000).latency, qint64(0));
+
+    //! The first window holds the value that set the offset, the second one is 50 us slower
+    //! throughout, as if the clocks drifted apart
+    quint16 sequence = 1;
+    for (; sequence < 2 * BLEStamp::OffsetWindow; ++sequence) {
+        const quint32 sendTime = sequence * 10;
+        QCOMPARE(tracker.track(sequence, sendTime, sendTime + 1050).latency, qint64(50));
+    }
+
+    const quint32 sendTime = sequence * 10;
+    QCOMPARE(tracker.track(sequence, sendTime, sendTime + 1050).latency, qint64(0));
+}
+
+void QuickBluetoothTests::discoveryAddDevice()
+{
+    constexpr int Devices = 100;
+
+    BluetoothDiscovery discovery;
+    discovery.setMethods(BluetoothDiscovery::LowEnergyMethod);
+
+    //! addDevice is a private slot, it is called like the discovery agent does
+    auto addDevice = [&discovery](int i) {
+        QBluetoothDeviceInfo info(QBluetoothAddress(quint64(0x100000 + i)),
+                                  QStringLiteral("Device %1").arg(i), 0);
+        info.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+        info.setRssi(qint16(-40 - i % 50));
+        QMetaObject::invokeMethod(&discovery, "addDevice", Qt::DirectConnection,
+                                  Q_ARG(QBluetoothDeviceInfo, info));
+    };
+
+    for (int i = 0; i < Devices; ++i) {
+        addDevice(i);
+    }
+    QCOMPARE(discovery.devices().size(), qsizetype(Devices));
+
+    //! A device advertising again stays one entry
+    for (int i = 0; i < Devices; ++i) {
+        addDevice(i);
+    }
+    QCOMPARE(discovery.devices().size(), qsizetype(Devices));
+}
+
+void QuickBluetoothTests::controllerInitialize()
+{
+    BluetoothController& controller = BluetoothController::instance();
+    if (controller.permission() != Permission::Granted) {
+        QSKIP("Bluetooth permission is not granted, asking for it would block the test");
+    }
+
+    //! Called with the result whether there is an adapter or not, and only once
+    QList<bool> results;
+    controller.initialize(QVariant::fromValue(std::function<void (bool)>([&results](bool ready) {
+        results.append(ready);
+    })));
+    QVERIFY(results.isEmpty());
+    QTRY_COMPARE_WITH_TIMEOUT(results.size(), qsizetype(1), 30000);
+    QCOMPARE(results.first(), controller.isReady());
+
+    //! Callbacks that don't take the result are called as well
+    int called = 0;
+    controller.initialize(QVariant::fromValue(std::function<void ()>([&called]() {
+        ++called;
+    })));
+    QTRY_COMPARE_WITH_TIMEOUT(called, 1, 30000);
+    QCOMPARE(results.size(), qsizetype(1));
+
+    //! Without an adapter powering on fails right away, with one the host isn't touched
+    if (!controller.isReady()) {
+        QTest::ignoreMessage(QtWarningMsg, "Bluetooth controller is not ready");
+        controller.powerOn(QVariant::fromValue(std::function<void (bool)>([&results](bool on) {
+            results.append(on);
+        })));
+        QCOMPARE(results.size(), qsizetype(2));
+        QVERIFY(!results.last());
+    }
+}
+
+void QuickBluetoothTests::controllerAdapters()
+{
+    BluetoothController& controller = BluetoothController::instance();
+    const QList<QBluetoothHostInfo> original = controller.hostInfos();
+
+    //! setAdapters is a private slot, it is called like the enumeration on the I/O thread does
+    auto setAdapters = [&controller](const QList<QBluetoothHostInfo>& adapters) {
+        QMetaObject::invokeMethod(&controller, "setAdapters", Qt::DirectConnection,
+                                  Q_ARG(QList<QBluetoothHostInfo>, adapters));
+    };
+    auto adapter = [](quint64 address) {
+        QBluetoothHostInfo info;
+        info.setAddress(QBluetoothAddress(address));
+        info.setName(QStringLiteral("hci%1").arg(address));
+        return info;
+    };
+    const QBluetoothHostInfo first = adapter(1);
+    const QBluetoothHostInfo second = adapter(2);
+    const QBluetoothHostInfo third = adapter(3);
+
+    //! A single adapter is left to the backend
+    setAdapters({ first });
+    QVERIFY(controller.acquireAdapter().isNull());
+
+    QSignalSpy changed(&controller, &BluetoothController::adaptersChanged);
+    setAdapters({ first, second });
+    QCOMPARE(changed.size(), 1);
+    QCOMPARE(controller.adapters(),
+             QStringList({ first.address().toString(), second.address().toString() }));
+
+    //! Connections go to the least loaded adapter, the first one on a tie
+    QCOMPARE(controller.acquireAdapter(), first.address());
+    QCOMPARE(controller.acquireAdapter(), second.address());
+    QCOMPARE(controller.acquireAdapter(), first.address());
+
+    controller.releaseAdapter(first.address());
+    controller.releaseAdapter(first.address());
+    QCOMPARE(controller.acquireAdapter(), first.address());
+
+    //! Unknown and null adapters are ignored
+    controller.releaseAdapter(QBluetoothAddress());
+    controller.releaseAdapter(third.address());
+
+    //! The loads of the adapters that are still there are kept
+    setAdapters({ second, third });
+    QCOMPARE(controller.acquireAdapter(), third.address());
+    QCOMPARE(controller.acquireAdapter(), second.address());
+    QCOMPARE(controller.acquireAdapter(), third.address());
+
+    setAdapters(original);
+}
+
+void QuickBluetoothTests::loopbackRoundTrip_data()
+{
+    QTest::addColumn<BLERole::ThreadingMode>("mode");
+
+    QTest::newRow("GuiThreadMode") << BLERole::GuiThreadMode;
+    QTest::newRow("IOThreadMode") << BLERole::IOThreadMode;
+}
+
+void QuickBluetoothTests::loopbackRoundTrip()
+{
+    QFETCH(BLERole::ThreadingMode, mode);
+
+    BLELoopbackLink link;
+    link.setSeed(1);
+
+    BLEPeripheral peripheral;
+    peripheral.setThreadingMode(mode);
+    peripheral.setLoopbackLink(&link);
+    peripheral.setLocalName(QStringLiteral("Tests"));
+    BLEDataService* source = addIntService(peripheral);
+
+    BLECentral central;
+    central.setThreadingMode(mode);
+    central.setLoopbackLink(&link);
+    BLEDataService* sink = addIntService(central);
+
+    peripheral.initialize();
+    peripheral.startAdvertising();
+    QTRY_COMPARE(peripheral.state(), BLERole::AdvertisingState);
+
+    central.setDevice(link.device());
+    QTRY_COMPARE(central.state(), BLERole::DiscoveredState);
+
+    //! Values are only notified once the central has subscribed, keep writing until one arrives
+    QTRY_COMPARE_WITH_TIMEOUT((source->writeValue(1), sink->value().toInt()), 1, 5000);
+
+    //! Values written faster than the link drains them may be merged, the last one always arrives
+    for (short value = 2; value <= 100; ++value) {
+        source->writeValue(value);
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(sink->value().toInt(), 100, 5000);
+}
+
+void QuickBluetoothTests::streamRoundTrip()
+{
+    //! A local socket stands in for RFCOMM, the name is unique so runs don't meet
+    BLEStreamLink link;
+    link.setBackend(BLEStreamLink::LocalSocketBackend);
+    link.setServerName(
+        QStringLiteral("QuickBluetoothTests-%1").arg(QCoreApplication::applicationPid()));
+
+    BLEPeripheral peripheral;
+    peripheral.setStreamLink(&link);
+    peripheral.setLocalName(QStringLiteral("Tests"));
+    BLEDataService* source = addIntService(peripheral);
+
+    BLECentral central;
+    central.setStreamLink(&link);
+    BLEDataService* sink = addIntService(central);
+
+    peripheral.initialize();
+    peripheral.startAdvertising();
+    QTRY_COMPARE(peripheral.state(), BLERole::AdvertisingState);
+
+    central.setDevice(link.device());
+    QTRY_COMPARE(central.state(), BLERole::DiscoveredState);
+
+    QTRY_COMPARE_WITH_TIMEOUT((source->writeValue(1), sink->value().toInt()), 1, 5000);
+
+    for (short value = 2; value <= 100; ++value) {
+        source->writeValue(value);
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(sink->value().toInt(), 100, 5000);
+}
+
+void QuickBluetoothTests::streamDecode()
+{
+    BLELoopbackPacket packet;
+    packet.kind = BLELoopbackPacket::Notification;
+    packet.service = QBluetoothUuid(ServiceUuid);
+    packet.characteristic = QBluetoothUuid(CharacterUuid);
+    packet.value = QByteArray(244, 'x');
+
+    QByteArray stream;
+    BLEStreamTransport::encode(packet, stream);
+    BLEStreamTransport::encode(packet, stream);
+
+    //! A frame cut by the socket waits for the rest of it
+    BLELoopbackPacket decoded;
+    QCOMPARE(BLEStreamTransport::decode(QByteArrayView(stream).first(10), decoded), qsizetype(0));
+
+    const qsizetype used = BLEStreamTransport::decode(stream, decoded);
+    QCOMPARE(used * 2, stream.size());
+    QCOMPARE(decoded.kind, packet.kind);
+    QCOMPARE(decoded.service, packet.service);
+    QCOMPARE(decoded.characteristic, packet.characteristic);
+    QCOMPARE(decoded.value, packet.value);
+
+    QCOMPARE(BLEStreamTransport::decode(QByteArrayView(stream).sliced(used), decoded), used);
+
+    //! The largest value fits with 128 bit uuids, one byte more is taken for a corrupt stream
+    packet.service = QBluetoothUuid::createUuid();
+    packet.characteristic = QBluetoothUuid::createUuid();
+    packet.descriptor = QBluetoothUuid::createUuid();
+    packet.value = QByteArray(BLEStreamTransport::MaxValueSize, 'x');
+
+    QByteArray largest;
+    BLEStreamTransport::encode(packet, largest);
+    QCOMPARE(BLEStreamTransport::decode(largest, decoded), largest.size());
+
+    packet.value.append('x');
+    QByteArray larger;
+    BLEStreamTransport::encode(packet, larger);
+    QCOMPARE(BLEStreamTransport::decode(larger, decoded), qsizetype(-1));
+}
+
+void QuickBluetoothTests::advertiserPack()
+{
+    //! Whether a payload carries \a bytes, as a field Qt represents or as raw data
+    auto holds = [](const QLowEnergyAdvertisingData& payload, const QByteArray& bytes) {
+        return payload.manufacturerData().contains(bytes) || payload.rawData().contains(bytes);
+    };
+
+    //! Flags and services go in the advertising payload, the name prefers the scan response
+    BLEAdvertiser::Content content;
+    content.localName = QStringLiteral("Tests");
+    content.services = { QBluetoothUuid(ServiceUuid) };
+
+    BLEAdvertiser::Payloads payloads = BLEAdvertiser::pack(content);
+    QCOMPARE(payloads.dropped, 0);
+    QCOMPARE(payloads.advertisingSize, 3 + 4);
+    QCOMPARE(payloads.scanResponseSize, 2 + 5);
+    QCOMPARE(payloads.advertising.services(), content.services);
+    QCOMPARE(payloads.scanResponse.localName(), content.localName);
+
+    //! A name too long for the scan response is shortened to fill it
+    content.localName = QString(40, QLatin1Char('x'));
+    payloads = BLEAdvertiser::pack(content);
+    QCOMPARE(payloads.dropped, 0);
+    QCOMPARE(payloads.scanResponseSize, BLEAdvertiser::MaxPayload);
+    QCOMPARE(payloads.scanResponse.rawData().at(1), char(0x08));
+    QCOMPARE(payloads.scanResponse.rawData().size(), qsizetype(BLEAdvertiser::MaxPayload));
+
+    //! Three entries of 24 bytes, one fits in each payload and the other one is dropped
+    content.localName.clear();
+    content.services.clear();
+    const QByteArray data[3] = { QByteArray(20, 'a'), QByteArray(20, 'b'), QByteArray(20, 'c') };
+    for (int i = 0; i < 3; ++i) {
+        content.data.append({ true, quint16(0x0059 + i), QBluetoothUuid(), data[i] });
+    }
+
+    payloads = BLEAdvertiser::pack(content);
+    QCOMPARE(payloads.dropped, 1);
+    QVERIFY(payloads.advertisingSize <= BLEAdvertiser::MaxPayload);
+    QVERIFY(payloads.scanResponseSize <= BLEAdvertiser::MaxPayload);
+    QVERIFY(holds(payloads.advertising, data[0]));
+    QVERIFY(holds(payloads.scanResponse, data[1]));
+
+    //! The rotation starts with another entry, so every entry is advertised in turn
+    content.rotation = 2;
+    payloads = BLEAdvertiser::pack(content);
+    QCOMPARE(payloads.dropped, 1);
+    QVERIFY(holds(payloads.advertising, data[2]));
+    QVERIFY(holds(payloads.scanResponse, data[0]));
+    QVERIFY(!holds(payloads.advertising, data[1]) && !holds(payloads.scanResponse, data[1]));
+
+    //! Service data can only be carried as raw data, uuid little endian first
+    content = BLEAdvertiser::Content();
+    content.data.append({ false, 0, QBluetoothUuid(ServiceUuid), QByteArrayLiteral("\x48") });
+    payloads = BLEAdvertiser::pack(content);
+    QCOMPARE(payloads.dropped, 0);
+    QVERIFY(payloads.advertising.rawData().endsWith(QByteArrayLiteral("\x04\x16\x0D\x18\x48")));
+}
+
+void QuickBluetoothTests::connectionParameters_data()
+{
+    QTest::addColumn<qreal>("minInterval");
+    QTest::addColumn<qreal>("maxInterval");
+    QTest::addColumn<int>("latency");
+    QTest::addColumn<int>("timeout");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("valid") << 15.0 << 30.0 << 0 << 2000 << true;
+    QTest::newRow("fastest") << 7.5 << 7.5 << 0 << 100 << true;
+    QTest::newRow("slowest") << 4000.0 << 4000.0 << 0 << 32000 << true;
+    QTest::newRow("interval too short") << 5.0 << 30.0 << 0 << 2000 << false;
+    QTest::newRow("interval too long") << 100.0 << 5000.0 << 0 << 20000 << false;
+    QTest::newRow("inverted interval") << 30.0 << 15.0 << 0 << 2000 << false;
+    QTest::newRow("negative latency") << 15.0 << 30.0 << -1 << 2000 << false;
+    QTest::newRow("latency too high") << 7.5 << 7.5 << 500 << 32000 << false;
+    QTest::newRow("timeout too short") << 7.5 << 7.5 << 0 << 50 << false;
+    QTest::newRow("timeout too long") << 15.0 << 30.0 << 0 << 40000 << false;
+    QTest::newRow("timeout within skipped events") << 100.0 << 200.0 << 4 << 2000 << false;
+    QTest::newRow("timeout beyond skipped events") << 100.0 << 200.0 << 4 << 2100 << true;
+}
+
+void QuickBluetoothTests::connectionParameters()
+{
+    QFETCH(qreal, minInterval);
+    QFETCH(qreal, maxInterval);
+    QFETCH(int, latency);
+    QFETCH(int, timeout);
+    QFETCH(bool, valid);
+
+    MockRole role;
+    if (!valid) {
+        QTest::ignoreMessage(QtWarningMsg,
+                             QRegularExpression(QStringLiteral("Invalid connection parameters")));
+    }
+    role.requestConnectionParameters(minInterval, maxInterval, latency, timeout);
+
+    const QList<QLowEnergyConnectionParameters>& requests = role.mock()->requests;
+    QCOMPARE(requests.size(), qsizetype(valid ? 1 : 0));
+    if (valid) {
+        QCOMPARE(requests.first().minimumInterval(), minInterval);
+        QCOMPARE(requests.first().maximumInterval(), maxInterval);
+        QCOMPARE(requests.first().latency(), latency);
+        QCOMPARE(requests.first().supervisionTimeout(), timeout);
+    }
+}
+
+void QuickBluetoothTests::connectionProfiles()
+{
+    MockRole role;
+    const QList<QLowEnergyConnectionParameters>& requests = role.mock()->requests;
+
+    //! Every profile passes the validation of explicit requests
+    for (auto profile : { BLERole::LowLatencyProfile, BLERole::HighThroughputProfile,
+                          BLERole::LowPowerProfile }) {
+        const auto parameters = BLERole::profileParameters(profile);
+        QVERIFY(parameters);
+
+        const qsizetype before = requests.size();
+        role.requestConnectionParameters(*parameters);
+        QCOMPARE(requests.size(), before + 1);
+
+        role.setConnectionProfile(profile);
+        QCOMPARE(role.connectionProfile(), profile);
+        QCOMPARE(requests.size(), before + 2);
+        QCOMPARE(requests.last().maximumInterval(), parameters->maximumInterval());
+    }
+
+    //! The default profile leaves the parameters to the backend
+    QVERIFY(!BLERole::profileParameters(BLERole::DefaultProfile));
+    const qsizetype before = requests.size();
+    role.setConnectionProfile(BLERole::DefaultProfile);
+    QCOMPARE(requests.size(), before);
+}
+
+void QuickBluetoothTests::broadcastFormat()
+{
+    const QByteArray standard = encodedValue(BLEDataService::Standard, 1);
+    const QVariantMap heartRate = BLECodecRegistry::decode(CharacterUuid, standard.constData(),
+                                                           standard.size());
+    QVERIFY(!heartRate.isEmpty());
+
+    const QList<BLEBroadcastFormat::Entry> entries = {
+        { 0x2A6E, BLESample::Int, -1234 },
+        { 0x2A6F, BLESample::Float, 36.5f },
+        { 0x2A00, BLESample::String, QStringLiteral("\u00e9") },
+        { quint16(CharacterUuid), BLESample::Standard, heartRate },
+    };
+
+    int encoded = 0;
+    const QByteArray data = BLEBroadcastFormat::encode(7, entries, BLEBroadcastFormat::MaxSize,
+                                                       &encoded);
+    QCOMPARE(encoded, int(entries.size()));
+    QVERIFY(data.size() <= BLEBroadcastFormat::MaxSize);
+    QCOMPARE(BLEBroadcastFormat::sequence(data), 7);
+
+    QList<BLEBroadcastFormat::Entry> decoded;
+    QVERIFY(BLEBroadcastFormat::decode(data, decoded));
+    QCOMPARE(decoded.size(), entries.size());
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        QCOMPARE(decoded[i].characteristic, entries[i].characteristic);
+        QCOMPARE(decoded[i].type, entries[i].type);
+    }
+    QCOMPARE(decoded[0].value.toInt(), -1234);
+    QCOMPARE(decoded[1].value.toFloat(), 36.5f);
+    QCOMPARE(decoded[2].value.toString(), QStringLiteral("\u00e9"));
+    QCOMPARE(decoded[3].value.toMap(), heartRate);
+
+    //! Encoding stops at the first entry that doesn't fit
+    const QByteArray partial = BLEBroadcastFormat::encode(8, entries, 2 + 5 + 7, &encoded);
+    QCOMPARE(encoded, 2);
+    decoded.clear();
+    QVERIFY(BLEBroadcastFormat::decode(partial, decoded));
+    QCOMPARE(decoded.size(), qsizetype(2));
+
+    //! Other manufacturer data and truncated payloads are rejected
+    QCOMPARE(BLEBroadcastFormat::sequence(QByteArrayLiteral("\x02\x07")), -1);
+    QVERIFY(!BLEBroadcastFormat::decode(QByteArrayLiteral("\x02\x07"), decoded));
+    QVERIFY(!BLEBroadcastFormat::decode(data.first(data.size() - 1), decoded));
+    QVERIFY(!BLEBroadcastFormat::decode(data.first(3), decoded));
+}
+
+void QuickBluetoothTests::pacing()
+{
+    const QBluetoothUuid service(ServiceUuid);
+    const QBluetoothUuid characteristic(CharacterUuid);
+
+    MockTransport transport(QLowEnergyController::PeripheralRole);
+    transport.setPaced(characteristic, true);
+    QVERIFY(transport.isPaced(characteristic));
+
+    //! One value is in flight, the ones sent meanwhile replace each other
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(transport.sendValue(service, characteristic, QByteArray::number(i)));
+    }
+    QCOMPARE(transport.writes, quint64(1));
+    QCOMPARE(transport.written, QByteArray("0"));
+
+    //! The confirmation of the first one sends the latest one
+    emit transport.characteristicWritten(service, characteristic, transport.written);
+    QCOMPARE(transport.writes, quint64(2));
+    QCOMPARE(transport.written, QByteArray("9"));
+
+    emit transport.characteristicWritten(service, characteristic, transport.written);
+    QCOMPARE(transport.writes, quint64(2));
+
+    //! A value waiting when pacing is disabled is written right away
+    QVERIFY(transport.sendValue(service, characteristic, QByteArray("a")));
+    QVERIFY(transport.sendValue(service, characteristic, QByteArray("b")));
+    QCOMPARE(transport.writes, quint64(3));
+    transport.setPaced(characteristic, false);
+    QVERIFY(!transport.isPaced(characteristic));
+    QCOMPARE(transport.writes, quint64(4));
+    QCOMPARE(transport.written, QByteArray("b"));
+
+    //! A transport that only echoes its writes has no confirmation to wait for
+    MockTransport echo(QLowEnergyController::PeripheralRole);
+    echo.confirms = false;
+    echo.setPaced(characteristic, true);
+    QVERIFY(!echo.isPaced(characteristic));
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(echo.sendValue(service, characteristic, QByteArray::number(i)));
+    }
+    QCOMPARE(echo.writes, quint64(10));
+}
+
+void QuickBluetoothTests::subscriptions()
+{
+    BLELoopbackLink link;
+    link.setSeed(1);
+
+    BLEPeripheral peripheral;
+    peripheral.setLoopbackLink(&link);
+    peripheral.setLocalName(QStringLiteral("Tests"));
+    BLEDataService* source = addIntService(peripheral);
+    source->setIndicate(true);
+
+    BLECentral central;
+    central.setLoopbackLink(&link);
+    BLEDataService* sink = addIntService(central);
+    sink->setIndicate(true);
+
+    peripheral.initialize();
+    peripheral.startAdvertising();
+    QTRY_COMPARE(peripheral.state(), BLERole::AdvertisingState);
+    QCOMPARE(source->subscribers(), 0);
+
+    //! A value written before anyone subscribed is sent to the first subscriber
+    source->writeValue(7);
+
+    central.setDevice(link.device());
+    QTRY_COMPARE(source->subscribers(), 1);
+    QTRY_COMPARE(sink->value().toInt(), 7);
+
+    //! Indications wait for their confirmation, the last value written always arrives
+    QVERIFY(peripheral.transport()->isPaced(source->characterBluetoothUuid()));
+    for (short value = 8; value <= 100; ++value) {
+        source->writeValue(value);
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(sink->value().toInt(), 100, 5000);
+
+    //! A client that leaves unsubscribes
+    central.setDevice(nullptr);
+    QTRY_COMPARE(source->subscribers(), 0);
+    QVERIFY(!peripheral.transport()->isPaced(source->characterBluetoothUuid()));
+}
+
+void QuickBluetoothTests::schedulerUrgentBehindBulk()
+{
+    const QBluetoothUuid service(ServiceUuid);
+    const QBluetoothUuid bulk(CharacterUuid);
+    const QBluetoothUuid alarm(quint32(CharacterUuid + 1));
+    const QByteArray value = encodedValue(BLEDataService::Int, 1);
+
+    BLEScheduler scheduler;
+    scheduler.setPriority(bulk, BLEScheduler::BulkPriority);
+    scheduler.setPriority(alarm, BLEScheduler::UrgentPriority);
+
+    const qint64 now = BLEMetrics::now();
+    for (int i = 0; i < BLEScheduler::QueueSize; ++i) {
+        QVERIFY(scheduler.push(service, bulk, value, now));
+    }
+
+    //! A full class drops its oldest value
+    QBluetoothUuid dropped;
+    QVERIFY(!scheduler.push(service, bulk, value, now, &dropped));
+    QCOMPARE(dropped, bulk);
+
+    //! An alarm raised during a burst of telemetry is the next value written
+    QVERIFY(scheduler.push(service, alarm, value, now));
+
+    BLEScheduler::Entry entry;
+    BLEScheduler::Priority priority;
+    QVERIFY(scheduler.pop(now, entry, priority));
+    QCOMPARE(entry.characteristic, alarm);
+    QCOMPARE(priority, BLEScheduler::UrgentPriority);
+
+    int bulkValues = 0;
+    while (scheduler.pop(now, entry, priority)) {
+        QCOMPARE(entry.characteristic, bulk);
+        ++bulkValues;
+    }
+    QCOMPARE(bulkValues, BLEScheduler::QueueSize);
+    QVERIFY(scheduler.isEmpty());
+}
+
+void QuickBluetoothTests::rateControllerConverges()
+{
+    //! A link that drains one value every 10 ms, simulated on a virtual clock
+    constexpr qint64 Millisecond = 1000000;
+    constexpr qint64 Drain = 10 * Millisecond;
+    constexpr qreal Capacity = 1e9 / Drain;
+
+    BLERateController controller;
+
+    int inFlight = 0;
+    qint64 drained = 0;
+    for (qint64 now = Millisecond; now <= 20000 * Millisecond; now += Millisecond) {
+        if (inFlight > 0 && now >= drained + Drain) {
+            --inFlight;
+            drained = now;
+            controller.onWritten(now);
+        }
+
+        if (controller.admit(now)) {
+            if (inFlight++ == 0) {
+                drained = now;
+            }
+        }
+    }
+
+    //! Additive increase and multiplicative decrease keep the rate around what the link drains
+    QVERIFY(controller.rate() > Capacity / 4 && controller.rate() < Capacity * 2);
+    QVERIFY(controller.throughput() > Capacity / 4);
+}
+
+void QuickBluetoothTests::sharedSamplesFanOut()
+{
+    constexpr int Count = 256;
+
+    BLESharedSamples samples;
+    samples.setKey(
+        QStringLiteral("QuickBluetoothTests-%1").arg(QCoreApplication::applicationPid()));
+    samples.setCapacity(Count);
+    QVERIFY(samples.start());
+
+    //! Two readers, as two processes would, each with its own cursor
+    BLESharedSampleReader first(samples.key());
+    BLESharedSampleReader second(samples.key());
+    QVERIFY(first.attach());
+    QVERIFY(second.attach());
+
+    BLESample sample;
+    sample.serviceUuid = ServiceUuid;
+    sample.characterUuid = CharacterUuid;
+    sample.type = BLESample::Int;
+
+    auto publish = [&](int count) {
+        for (int i = 0; i < count; ++i) {
+            sample.timestamp = BLESample::now();
+            sample.intValue = qint16(i);
+            samples.publish(sample);
+        }
+    };
+
+    //! Every reader gets every sample, in order
+    publish(Count);
+
+    int expected = 0;
+    const std::size_t read = first.readAll([&expected](const BLESample& value) {
+        if (value.intValue == expected) {
+            ++expected;
+        }
+    });
+    QCOMPARE(read, std::size_t(Count));
+    QCOMPARE(expected, Count);
+
+    BLESample copy;
+    int copied = 0;
+    while (second.read(copy)) {
+        QCOMPARE(copy.intValue, qint16(copied++));
+    }
+    QCOMPARE(copied, Count);
+    QCOMPARE(first.overruns(), quint64(0));
+    QCOMPARE(second.overruns(), quint64(0));
+
+    //! A reader that falls a whole ring behind skips what was overwritten and counts it
+    publish(Count * 2);
+    copied = 0;
+    while (second.read(copy)) {
+        ++copied;
+    }
+    QVERIFY(copied <= Count);
+    QCOMPARE(second.overruns() + quint64(copied), quint64(Count * 2));
+
+    samples.stop();
+}
+
+void QuickBluetoothTests::exportStreamBatches()
+{
+    constexpr int Count = 1024;
+
+    //! A local socket consumer, the name is unique so runs don't meet
+    QLocalServer consumer;
+    QVERIFY(consumer.listen(
+        QStringLiteral("QuickBluetoothTestsExport-%1").arg(QCoreApplication::applicationPid())));
+
+    BLEExportStream stream;
+    stream.setBackend(BLEExportStream::LocalSocketBackend);
+    stream.setServerName(consumer.serverName());
+    stream.setBatchSize(64);
+    stream.setBatchDelay(1);
+    stream.setQueueSize(Count);
+    stream.start();
+
+    QTRY_VERIFY(consumer.hasPendingConnections());
+    QLocalSocket* socket = consumer.nextPendingConnection();
+    QTRY_VERIFY(stream.isConnected());
+
+    QByteArray buffer;
+    BLEExportStream::Frame frame;
+    int frames = 0;
+    int received = 0;
+    int dropped = 0;
+    int outOfOrder = 0;
+    bool malformed = false;
+    connect(socket, &QLocalSocket::readyRead, this, [&]() {
+        buffer.append(socket->readAll());
+
+        qsizetype offset = 0;
+        qsizetype used = 0;
+        while ((used = BLEExportStream::decode(QByteArrayView(buffer).sliced(offset), frame)) > 0) {
+            offset += used;
+            ++frames;
+            dropped += int(frame.dropped);
+            for (const BLESample& sample : std::as_const(frame.samples)) {
+                if (sample.intValue != qint16(received++)) {
+                    ++outOfOrder;
+                }
+            }
+        }
+        malformed |= used < 0;
+        buffer.remove(0, offset);
+    });
+
+    BLESample sample;
+    sample.serviceUuid = ServiceUuid;
+    sample.characterUuid = CharacterUuid;
+    sample.type = BLESample::Int;
+    for (int i = 0; i < Count; ++i) {
+        sample.timestamp = BLESample::now();
+        sample.intValue = qint16(i);
+        stream.publish(sample);
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(received, Count, 5000);
+    QVERIFY(!malformed);
+    QCOMPARE(dropped, 0);
+    QCOMPARE(outOfOrder, 0);
+    QCOMPARE(stream.dropped(), quint64(0));
+
+    //! Samples published in a burst share frames
+    QVERIFY(frames <= Count / 64 + 1);
+
+    stream.stop();
+}
+
+void QuickBluetoothTests::metricsSnapshot()
+{
+    BLEMetrics metrics;
+    BLEMetrics::Channel* channel = metrics.channel(ServiceUuid, CharacterUuid);
+    QCOMPARE(metrics.channel(ServiceUuid, CharacterUuid), channel);
+    metrics.update();
+
+    for (int i = 0; i < 10; ++i) {
+        metrics.countNotification(channel, 4);
+    }
+    metrics.record(BLEMetrics::DecodeTime, 2000);
+
+    //! The snapshot only changes on update()
+    QCOMPARE(metrics.snapshot().value(QStringLiteral("notifications")).toULongLong(),
+             quint64(0));
+
+    QTest::qWait(20);
+    metrics.update();
+    QVariantMap snapshot = metrics.snapshot();
+    const qreal interval = snapshot.value(QStringLiteral("interval")).toReal();
+    QVERIFY(interval > 0);
+    QCOMPARE(snapshot.value(QStringLiteral("notifications")).toULongLong(), quint64(10));
+    QCOMPARE(snapshot.value(QStringLiteral("notificationBytes")).toULongLong(), quint64(40));
+    QVERIFY(qAbs(snapshot.value(QStringLiteral("notificationsPerSecond")).toReal() * interval
+                 - 10) < 1e-6);
+
+    //! Durations are reported in microseconds
+    const QVariantMap decodeTime = snapshot.value(QStringLiteral("decodeTime")).toMap();
+    QCOMPARE(decodeTime.value(QStringLiteral("count")).toULongLong(), quint64(1));
+    QVERIFY(decodeTime.value(QStringLiteral("max")).toReal() >= 1.0);
+
+    const QVariantList characteristics = snapshot.value(QStringLiteral("characteristics")).toList();
+    QCOMPARE(characteristics.size(), qsizetype(1));
+    const QVariantMap characteristic = characteristics.first().toMap();
+    QCOMPARE(characteristic.value(QStringLiteral("characterUuid")).toUInt(), CharacterUuid);
+    QCOMPARE(characteristic.value(QStringLiteral("notifications")).toULongLong(), quint64(10));
+
+    //! Rates cover the interval since the previous update only
+    metrics.update();
+    snapshot = metrics.snapshot();
+    QCOMPARE(snapshot.value(QStringLiteral("notificationsPerSecond")).toReal(), qreal(0));
+
+    //! Nothing is recorded while disabled
+    metrics.setEnabled(false);
+    metrics.countNotification(channel, 4);
+    metrics.increment(BLEMetrics::Errors);
+    QCOMPARE(metrics.counter(BLEMetrics::Notifications), quint64(10));
+    QCOMPARE(metrics.counter(BLEMetrics::Errors), quint64(0));
+    metrics.setEnabled(true);
+
+    metrics.reset();
+    QVERIFY(metrics.snapshot().isEmpty());
+    QCOMPARE(metrics.counter(BLEMetrics::Notifications), quint64(0));
+    QCOMPARE(channel->notifications.load(), quint64(0));
+    QCOMPARE(metrics.histogram(BLEMetrics::DecodeTime).count(), quint64(0));
+
+    //! The services of a role count what they receive
+    MockRole role;
+    BLEDataService* service = role.addService(ServiceUuid, CharacterUuid, BLEDataService::Int);
+    for (int i = 0; i < Rounds; ++i) {
+        role.mock()->inject(service->serviceBluetoothUuid(), service->characterBluetoothUuid(),
+                            encodedValue(BLEDataService::Int, i));
+    }
+    QCOMPARE(role.metrics()->counter(BLEMetrics::Notifications), quint64(Rounds));
+}
+
+void QuickBluetoothTests::traceExport()
+{
+    //! Whatever the build, the export is a valid document
+    BLETrace::setEnabled(true);
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(BLETrace::takeChromeJson(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(document.object().value(QStringLiteral("traceEvents")).isArray());
+
+    if (!BLETrace::isCompiledIn()) {
+        QVERIFY(!BLETrace::isEnabled());
+        QSKIP("Tracing is compiled out, build with QUICKBLUETOOTH_TRACE");
+    }
+    QVERIFY(BLETrace::isEnabled());
+
+    {
+        BLETraceScope scope("scope \"quoted\"", "test");
+    }
+    BLETrace::beginAsync("write", 42, "test");
+    BLETrace::endAsync("write", 42, "test");
+    QScopedPointer<QThread> thread(QThread::create([]() {
+        BLETrace::instant("instant", "test");
+    }));
+    thread->start();
+    QVERIFY(thread->wait(5000));
+
+    //! Nothing is recorded once disabled
+    BLETrace::setEnabled(false);
+    BLETrace::instant("disabled", "test");
+
+    document = QJsonDocument::fromJson(BLETrace::takeChromeJson(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+
+    QHash<QString, QList<QJsonObject>> events;
+    const QJsonArray traced = document.object().value(QStringLiteral("traceEvents")).toArray();
+    for (const QJsonValue& value : traced) {
+        const QJsonObject event = value.toObject();
+        if (event.value(QStringLiteral("cat")).toString() == QLatin1String("test")) {
+            events[event.value(QStringLiteral("name")).toString()].append(event);
+        }
+    }
+
+    QCOMPARE(events.value(QStringLiteral("scope \"quoted\"")).size(), qsizetype(1));
+    const QJsonObject scope = events.value(QStringLiteral("scope \"quoted\"")).first();
+    QCOMPARE(scope.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+    QVERIFY(scope.value(QStringLiteral("dur")).toDouble() >= 0);
+
+    const QList<QJsonObject> write = events.value(QStringLiteral("write"));
+    QCOMPARE(write.size(), qsizetype(2));
+    QCOMPARE(write[0].value(QStringLiteral("ph")).toString(), QStringLiteral("b"));
+    QCOMPARE(write[1].value(QStringLiteral("ph")).toString(), QStringLiteral("e"));
+    QCOMPARE(write[0].value(QStringLiteral("id")).toString(), QStringLiteral("0x2a"));
+    QCOMPARE(write[1].value(QStringLiteral("id")), write[0].value(QStringLiteral("id")));
+
+    //! Each thread has its own buffer and track
+    QCOMPARE(events.value(QStringLiteral("instant")).size(), qsizetype(1));
+    const QJsonObject instant = events.value(QStringLiteral("instant")).first();
+    QCOMPARE(instant.value(QStringLiteral("ph")).toString(), QStringLiteral("i"));
+    QVERIFY(instant.value(QStringLiteral("tid")) != scope.value(QStringLiteral("tid")));
+
+    QVERIFY(!events.contains(QStringLiteral("disabled")));
+
+    //! Taking the events empties the buffers
+    document = QJsonDocument::fromJson(BLETrace::takeChromeJson());
+    const QJsonArray remaining = document.object().value(QStringLiteral("traceEvents")).toArray();
+    for (const QJsonValue& value : remaining) {
+        QVERIFY(value.toObject().value(QStringLiteral("cat")).toString() != QLatin1String("test"));
+    }
+}
+
+void QuickBluetoothTests::sessionLogRoundTrip()
+{
+    constexpr qint64 StartTime = 1700000000000;
+
+    QBluetoothDeviceInfo device(QBluetoothAddress(quint64(0x112233445566)),
+                                QStringLiteral("Sensor"), 0);
+    device.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+    device.setRssi(-60);
+    device.setManufacturerData(0x0059, QByteArrayLiteral("\x01\x02\x03"));
+    device.setServiceUuids({ QBluetoothUuid(ServiceUuid) });
+
+    QByteArray log = BLESessionLog::header(StartTime);
+    BLESessionLog::appendNotification(log, 0, ServiceUuid, CharacterUuid,
+                                      encodedValue(BLEDataService::Int, 0));
+    BLESessionLog::appendAdvertisement(log, 1500, device);
+    BLESessionLog::appendNotification(log, 250, ServiceUuid, CharacterUuid,
+                                      encodedValue(BLEDataService::Int, 1));
+
+    BLESessionLog::Reader reader(log);
+    QVERIFY(reader.isValid());
+    QCOMPARE(reader.startTime(), StartTime);
+
+    BLESessionRecord record;
+    QVERIFY(reader.next(record));
+    QCOMPARE(record.kind, BLESessionRecord::Notification);
+    QCOMPARE(record.timestamp, qint64(0));
+    QCOMPARE(record.serviceUuid, ServiceUuid);
+    QCOMPARE(record.characterUuid, CharacterUuid);
+    QCOMPARE(record.value, encodedValue(BLEDataService::Int, 0));
+
+    //! Deltas are microseconds, timestamps nanoseconds since the first record
+    QVERIFY(reader.next(record));
+    QCOMPARE(record.kind, BLESessionRecord::Advertisement);
+    QCOMPARE(record.timestamp, qint64(1500000));
+    QCOMPARE(record.device.address(), device.address());
+    QCOMPARE(record.device.name(), device.name());
+    QCOMPARE(record.device.rssi(), device.rssi());
+    QCOMPARE(record.device.manufacturerData(0x0059), device.manufacturerData(0x0059));
+    QCOMPARE(record.device.serviceUuids(), device.serviceUuids());
+
+    QVERIFY(reader.next(record));
+    QCOMPARE(record.kind, BLESessionRecord::Notification);
+    QCOMPARE(record.timestamp, qint64(1750000));
+    QCOMPARE(record.value, encodedValue(BLEDataService::Int, 1));
+    QVERIFY(!reader.next(record));
+
+    //! A log cut by a crash is readable up to its last complete record
+    BLESessionLog::Reader cut(log.first(log.size() - 1));
+    int complete = 0;
+    while (cut.next(record)) {
+        ++complete;
+    }
+    QCOMPARE(complete, 2);
+
+    //! A log of a newer version is rejected
+    QByteArray newer = log;
+    newer[4] = char(BLESessionLog::Version + 1);
+    QVERIFY(!BLESessionLog::Reader(newer).isValid());
+}
+
+void QuickBluetoothTests::sessionRecordReplay()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("session.qbsl"));
+
+    {
+        MockRole role;
+        BLEDataService* service = role.addService(ServiceUuid, CharacterUuid,
+                                                  BLEDataService::Int);
+
+        BLESessionRecorder recorder;
+        recorder.setFileName(fileName);
+        QVERIFY(recorder.start());
+        QCOMPARE(BLESessionRecorder::active(), &recorder);
+
+        for (int i = 0; i < Rounds; ++i) {
+            role.mock()->inject(service->serviceBluetoothUuid(),
+                                service->characterBluetoothUuid(),
+                                encodedValue(BLEDataService::Int, i));
+        }
+
+        recorder.stop();
+        QVERIFY(!BLESessionRecorder::active());
+        QCOMPARE(recorder.records(), quint64(Rounds));
+    }
+
+    //! Replayed notifications go through the same dispatch as live ones
+    MockRole role;
+    BLEDataService* service = role.addService(ServiceUuid, CharacterUuid, BLEDataService::Int);
+    int updates = 0;
+    connect(service, &BLEDataService::valueUpdated, this, [&updates]() {
+        ++updates;
+    });
+
+    BLESessionReplayer replayer;
+    replayer.setFileName(fileName);
+    replayer.setSpeed(0);
+    replayer.setRole(&role);
+
+    QSignalSpy finished(&replayer, &BLESessionReplayer::finished);
+    QVERIFY(replayer.start());
+    QTRY_COMPARE(finished.count(), 1);
+    QVERIFY(!replayer.isRunning());
+    QCOMPARE(replayer.replayed(), quint64(Rounds));
+    QCOMPARE(updates, Rounds);
+    QCOMPARE(service->value().toInt(), encodedValue(BLEDataService::Int, Rounds - 1).toInt());
+}
+
+void QuickBluetoothTests::sessionRecorderStopWhileRecording()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("session.qbsl"));
+    const QByteArray value = encodedValue(BLEDataService::Int, 0);
+
+    //! A thread records like the transport of a role does while recorders come and go
+    std::atomic_bool running { true };
+    QScopedPointer<QThread> publisher(QThread::create([&running, &value]() {
+        while (running.load(std::memory_order_relaxed)) {
+            BLESessionRecorder::recordNotification(ServiceUuid, CharacterUuid, value);
+        }
+    }));
+    publisher->start();
+
+    for (int i = 0; i < 100; ++i) {
+        auto recorder = std::make_unique<BLESessionRecorder>();
+        recorder->setFileName(fileName);
+        QVERIFY(recorder->start());
+        QThread::usleep(100);
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    QVERIFY(publisher->wait(5000));
+    QVERIFY(!BLESessionRecorder::active());
+}
+
+QTEST_GUILESS_MAIN(QuickBluetoothTests)
+
+#include "QuickBluetoothTests.moc"
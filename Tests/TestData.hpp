@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QtTest>
+
+#include "BLEDataService.hpp"
+#include "BLERole.hpp"
+
+//! \brief ServiceUuid Heart Rate service, used by the tests and the benchmarks
+constexpr quint32 ServiceUuid = 0x180D;
+
+//! \brief CharacterUuid Heart Rate Measurement characteristic
+constexpr quint32 CharacterUuid = 0x2A37;
+
+/*!
+ * \brief encodedValue Returns one of two encoded values of each type, the tests and benchmarks
+ * alternate between them so every notification really changes the value
+ */
+inline QByteArray encodedValue(BLEDataService::DataType type, int index)
+{
+    switch (type) {
+    case BLEDataService::Int:
+        return index % 2 ? QByteArrayLiteral("72") : QByteArrayLiteral("1234");
+    case BLEDataService::Float:
+        return index % 2 ? QByteArrayLiteral("36.6") : QByteArrayLiteral("-12.25");
+    case BLEDataService::String:
+        return index % 2 ? QByteArrayLiteral("Heart rate") : QByteArrayLiteral("Resting");
+    case BLEDataService::Standard: //! Heart Rate Measurement, 72 bpm or 76 bpm with RR intervals
+        return index % 2 ? QByteArrayLiteral("\x00\x48")
+                         : QByteArrayLiteral("\x10\x4C\x00\x04\x00\x04");
+    }
+    return QByteArray();
+}
+
+/*!
+ * \brief addDataTypeRows Adds a "type" column with a row for each \ref BLEDataService::DataType
+ */
+inline void addDataTypeRows()
+{
+    QTest::addColumn<BLEDataService::DataType>("type");
+
+    QTest::newRow("Int") << BLEDataService::Int;
+    QTest::newRow("Float") << BLEDataService::Float;
+    QTest::newRow("String") << BLEDataService::String;
+    QTest::newRow("Standard") << BLEDataService::Standard;
+}
+
+/*!
+ * \brief addIntService Adds an \ref BLEDataService::Int service of \ref ServiceUuid to \a role,
+ * the two ends of a link use it to talk to each other
+ */
+inline BLEDataService* addIntService(BLERole& role)
+{
+    auto* service = new BLEDataService(&role);
+    service->setServiceUuid(ServiceUuid);
+    service->setCharacterUuid(CharacterUuid);
+    service->setDataType(BLEDataService::Int);
+    role.serviceAdd(service);
+    return service;
+}
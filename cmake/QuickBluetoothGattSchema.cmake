@@ -0,0 +1,394 @@
+#
+# quickbluetooth_add_gatt_schema(<target> <schema> [QML])
+#
+# Generates a C++ class from a GATT schema file and adds it to <target>, which is linked to
+# QuickBluetoothCore. The class is named after the "name" of the schema and holds:
+#   - constexpr uuids and a constexpr BLEGattSchema::Characteristic table, checked with
+#     static_assert so a malformed schema fails the build
+#   - typed encode/decode functions for every service, eg for a Float service "bodyTemp"
+#         static QByteArray encodeBodyTemp(float value);
+#         static std::optional<float> decodeBodyTemp(const QByteArray& bytes);
+#     Int values are int, String values QString and Standard values the QVariantMap of their fields
+#   - the QLowEnergyServiceData of every service, built once and shared by all instances
+#   - a BLEDataService for every service, created with the properties of the schema and added to
+#     the BLERole set as "role"
+# With QML the class is a QML_ELEMENT of the QML module of <target>, ie
+#
+#     BLEPeripheral {
+#         id: peripheral
+#         property HealthSchema schema: HealthSchema { role: peripheral }
+#     }
+#
+# A schema is a JSON file, every key but "name", "service" and "characteristic" is optional:
+#
+#     {
+#         "name": "HealthSchema",
+#         "services": [
+#             {
+#                 "name": "heartRate",
+#                 "service": "0x180D",
+#                 "characteristic": "0x2A37",
+#                 "type": "Standard",          // Int, Float, String or Standard
+#                 "valueLength": 8,
+#                 "indicate": false,
+#                 "broadcast": false,
+#                 "encoding": "Text",          // Text or Delta
+#                 "keyFrameInterval": 16,
+#                 "stamped": false,
+#                 "priority": "High",          // Urgent, High, Normal or Bulk
+#                 "deadline": 0,
+#                 "adaptiveRate": false
+#             }
+#         ]
+#     }
+#
+# The code is generated when the project is configured and again whenever the schema changes.
+# Reading JSON needs CMake 3.19
+#
+
+function(quickbluetooth_add_gatt_schema target schema)
+    cmake_parse_arguments(PARSE_ARGV 2 ARG "QML" "" "")
+
+    if (CMAKE_VERSION VERSION_LESS 3.19)
+        message(FATAL_ERROR "quickbluetooth_add_gatt_schema needs CMake 3.19 or newer")
+    endif()
+
+    get_filename_component(schema "${schema}" ABSOLUTE)
+    get_filename_component(schemaFile "${schema}" NAME)
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${schema}")
+
+    file(READ "${schema}" json)
+    string(JSON className ERROR_VARIABLE error GET "${json}" name)
+    if (error)
+        message(FATAL_ERROR "${schemaFile}: ${error}")
+    endif()
+    if (NOT className MATCHES "^[A-Z][A-Za-z0-9_]*$")
+        message(FATAL_ERROR "${schemaFile}: name \"${className}\" must be a C++ class name "
+                            "starting with an upper case letter")
+    endif()
+
+    string(JSON count ERROR_VARIABLE error LENGTH "${json}" services)
+    if (error OR count EQUAL 0)
+        message(FATAL_ERROR "${schemaFile}: services must be a non empty array")
+    endif()
+
+    set(uuids "")
+    set(table "")
+    set(properties "")
+    set(getters "")
+    set(codecs "")
+    set(members "")
+    set(initializers "")
+    set(setup "")
+    set(attach "")
+    set(definitions "")
+    set(asserts "")
+
+    math(EXPR last "${count} - 1")
+    foreach (index RANGE ${last})
+        _quickbluetooth_schema_service("${json}" ${index} "${schemaFile}")
+
+        string(SUBSTRING "${name}" 0 1 head)
+        string(SUBSTRING "${name}" 1 -1 tail)
+        string(TOUPPER "${head}" head)
+        set(Name "${head}${tail}")
+
+        # The C++ type of the values of the service, and how encode takes it
+        if (type STREQUAL "Int")
+            set(valueType int)
+            set(argumentType int)
+        elseif (type STREQUAL "Float")
+            set(valueType float)
+            set(argumentType float)
+        elseif (type STREQUAL "String")
+            set(valueType QString)
+            set(argumentType "const QString&")
+        else()
+            set(valueType QVariantMap)
+            set(argumentType "const QVariantMap&")
+        endif()
+
+        string(APPEND uuids
+            "    static constexpr quint32 ${Name}Service = ${service};\n"
+            "    static constexpr quint32 ${Name}Characteristic = ${characteristic};\n")
+        string(APPEND table
+            "        { \"${name}\", ${service}, ${characteristic}, BLESample::${type},"
+            " ${valueLength},\n"
+            "          ${indicate}, ${broadcast}, quint8(BLEDataService::${encoding}Encoding),\n"
+            "          ${keyFrameInterval}, ${stamped},"
+            " quint8(BLEDataService::${priority}Priority),\n"
+            "          ${deadline}, ${adaptiveRate} },\n")
+        string(APPEND properties
+            "    Q_PROPERTY(BLEDataService* ${name} READ ${name} CONSTANT FINAL)\n")
+        string(APPEND getters
+            "    BLEDataService* ${name}() const;\n")
+        string(APPEND codecs
+            "    static QByteArray encode${Name}(${argumentType} value);\n"
+            "    static std::optional<${valueType}> decode${Name}(const QByteArray& bytes);\n")
+        string(APPEND members
+            "    QPointer<BLEDataService> m${Name};\n")
+        string(APPEND initializers
+            "    , m${Name} { new BLEDataService(Characteristics[${index}], this) }\n")
+        string(APPEND setup
+            "    m${Name}->setServiceData(services.at(${index}));\n")
+        string(APPEND attach
+            "        attach(m${Name});\n")
+        string(APPEND definitions
+            "BLEDataService* ${className}::${name}() const\n"
+            "{\n"
+            "    return m${Name};\n"
+            "}\n"
+            "\n"
+            "QByteArray ${className}::encode${Name}(${argumentType} value)\n"
+            "{\n"
+            "    return BLEDataCodec::encode(BLESample::${type}, QVariant::fromValue(value),\n"
+            "                                ${characteristic});\n"
+            "}\n"
+            "\n"
+            "std::optional<${valueType}> ${className}::decode${Name}(const QByteArray& bytes)\n"
+            "{\n"
+            "    const QVariant value\n"
+            "        = BLEDataCodec::decode(BLESample::${type}, bytes, ${characteristic});\n"
+            "    if (!value.isValid()) {\n"
+            "        return std::nullopt;\n"
+            "    }\n"
+            "\n"
+            "    return value.value<${valueType}>();\n"
+            "}\n"
+            "\n")
+        string(APPEND asserts
+            "static_assert(BLEGattSchema::valid(${className}::Characteristics[${index}]),\n"
+            "              \"${schemaFile}: ${name} is not valid, see BLEGattSchema::valid()\");\n")
+    endforeach()
+
+    if (ARG_QML)
+        set(qmlInclude "#include <QtQml/qqmlregistration.h>\n")
+        set(qmlElement "    QML_ELEMENT\n")
+    else()
+        set(qmlInclude "")
+        set(qmlElement "")
+    endif()
+
+    set(outputDir "${CMAKE_CURRENT_BINARY_DIR}/QuickBluetoothGattSchema")
+    set(header "${outputDir}/${className}.hpp")
+    set(source "${outputDir}/${className}.cpp")
+
+    file(CONFIGURE OUTPUT "${header}" @ONLY CONTENT [=[
+// Generated by quickbluetooth_add_gatt_schema() from @schemaFile@, don't edit
+
+#pragma once
+
+#include <QList>
+#include <QLowEnergyServiceData>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QVariantMap>
+@qmlInclude@
+#include "BLEDataService.hpp"
+#include "BLEGattSchema.hpp"
+
+#include <optional>
+
+class BLERole;
+
+/*!
+ * \brief The @className@ class holds the services of @schemaFile@. It creates them with the
+ * properties of the schema and adds them to \ref role, which owns them from then on
+ */
+class @className@ : public QObject
+{
+    Q_OBJECT
+@qmlElement@
+    Q_PROPERTY(BLERole* role READ role WRITE setRole NOTIFY roleChanged FINAL)
+@properties@
+public:
+    //! \brief The uuids of the services and their characteristics
+@uuids@
+    //! \brief Characteristics The services of the schema in its order
+    static constexpr BLEGattSchema::Characteristic Characteristics[] = {
+@table@    };
+
+    explicit @className@(QObject* parent = nullptr);
+
+    /*!
+     * \brief role The role the services are added to, it can be set once
+     */
+    BLERole* role() const;
+    void setRole(BLERole* role);
+
+@getters@
+    /*!
+     * \brief encode and decode convert the values of each service with its type, decode returns
+     * \a std::nullopt if the bytes are not a valid value
+     */
+@codecs@
+    /*!
+     * \brief serviceData Returns the services a peripheral adds, built on first use
+     */
+    static const QList<QLowEnergyServiceData>& serviceData();
+
+signals:
+    void roleChanged();
+
+private:
+    /*!
+     * \brief attach Adds \a service to \ref mRole and hands it over
+     */
+    void attach(BLEDataService* service);
+
+private:
+    QPointer<BLERole> mRole;
+@members@};
+
+@asserts@static_assert(BLEGattSchema::unique(@className@::Characteristics),
+              "@schemaFile@: two services have the same service and characteristic uuids");
+]=])
+
+    file(CONFIGURE OUTPUT "${source}" @ONLY CONTENT [=[
+// Generated by quickbluetooth_add_gatt_schema() from @schemaFile@, don't edit
+
+#include "@className@.hpp"
+#include "BLEDataCodec.hpp"
+#include "BLERole.hpp"
+
+#include <QDebug>
+
+@className@::@className@(QObject* parent)
+    : QObject{ parent }
+    , mRole { nullptr }
+@initializers@{
+    const QList<QLowEnergyServiceData>& services = serviceData();
+@setup@}
+
+BLERole* @className@::role() const
+{
+    return mRole;
+}
+
+void @className@::setRole(BLERole* role)
+{
+    if (mRole == role) {
+        return;
+    }
+
+    if (mRole) {
+        qWarning() << "@className@: The services are already added to a role";
+        return;
+    }
+
+    mRole = role;
+    if (mRole) {
+@attach@    }
+
+    emit roleChanged();
+}
+
+@definitions@const QList<QLowEnergyServiceData>& @className@::serviceData()
+{
+    static const QList<QLowEnergyServiceData> services = []() {
+        QList<QLowEnergyServiceData> services;
+        for (const BLEGattSchema::Characteristic& characteristic : Characteristics) {
+            services.append(BLEDataService::buildServiceData(
+                QBluetoothUuid(characteristic.service),
+                QBluetoothUuid(characteristic.characteristic),
+                characteristic.valueLength,
+                characteristic.indicate));
+        }
+        return services;
+    }();
+
+    return services;
+}
+
+void @className@::attach(BLEDataService* service)
+{
+    if (!service) {
+        return;
+    }
+
+    service->setParent(mRole);
+    mRole->serviceAdd(service);
+}
+]=])
+
+    target_sources(${target} PRIVATE "${header}" "${source}")
+    target_include_directories(${target} PRIVATE "${outputDir}")
+    target_link_libraries(${target} PRIVATE QuickBluetoothCore)
+endfunction()
+
+#
+# Reads service <index> of <json> into name, service, characteristic, type, valueLength, indicate,
+# broadcast, encoding, keyFrameInterval, stamped, priority, deadline and adaptiveRate in the scope
+# of the caller
+#
+function(_quickbluetooth_schema_service json index schemaFile)
+    string(JSON name ERROR_VARIABLE error GET "${json}" services ${index} name)
+    if (error OR NOT name MATCHES "^[a-z][A-Za-z0-9]*$")
+        message(FATAL_ERROR "${schemaFile}: service ${index} needs a name that starts with a "
+                            "lower case letter and only has letters and digits")
+    endif()
+
+    foreach (key service characteristic)
+        string(JSON uuid ERROR_VARIABLE error GET "${json}" services ${index} ${key})
+        if (error OR NOT uuid MATCHES "^(0[xX][0-9A-Fa-f]+|[0-9]+)$")
+            message(FATAL_ERROR "${schemaFile}: ${name} needs a ${key} uuid, a 16 or 32 bit "
+                                "number such as \"0x180D\"")
+        endif()
+        set(${key} ${uuid} PARENT_SCOPE)
+    endforeach()
+
+    set(defaults
+        type Int
+        valueLength 2
+        indicate OFF
+        broadcast OFF
+        encoding Text
+        keyFrameInterval BLEDeltaCodec::DefaultKeyFrameInterval
+        stamped OFF
+        priority Normal
+        deadline 0
+        adaptiveRate OFF)
+    set(choices_type Int Float String Standard)
+    set(choices_encoding Text Delta)
+    set(choices_priority Urgent High Normal Bulk)
+
+    list(LENGTH defaults length)
+    math(EXPR length "${length} - 1")
+    foreach (i RANGE 0 ${length} 2)
+        math(EXPR j "${i} + 1")
+        list(GET defaults ${i} key)
+        list(GET defaults ${j} value)
+
+        string(JSON member ERROR_VARIABLE error GET "${json}" services ${index} ${key})
+        if (error)
+            # Not in the schema, the default is already C++
+        elseif (DEFINED choices_${key})
+            if (NOT member IN_LIST choices_${key})
+                string(REPLACE ";" ", " choices "${choices_${key}}")
+                message(FATAL_ERROR "${schemaFile}: ${key} of ${name} must be one of ${choices}")
+            endif()
+            set(value ${member})
+        elseif (value STREQUAL "OFF")
+            if (member STREQUAL "ON")
+                set(value true)
+            elseif (member STREQUAL "OFF")
+                set(value false)
+            else()
+                message(FATAL_ERROR "${schemaFile}: ${key} of ${name} must be true or false")
+            endif()
+        elseif (member MATCHES "^-?[0-9]+$")
+            set(value ${member})
+        else()
+            message(FATAL_ERROR "${schemaFile}: ${key} of ${name} must be a number")
+        endif()
+
+        if (value STREQUAL "OFF")
+            set(value false)
+        endif()
+
+        set(${key} ${value} PARENT_SCOPE)
+    endforeach()
+
+    set(name ${name} PARENT_SCOPE)
+endfunction()